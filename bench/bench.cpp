@@ -0,0 +1,79 @@
+#include "bench.h"
+#include "bench_simulation.h"
+#include "bench_jobs.h"
+#include "bench_atlas.h"
+#include "bench_assets.h"
+#include "bench_mipmaps.h"
+#include "bench_spatial.h"
+#include "bench_culling.h"
+#include "bench_instance_format.h"
+#include "bench_profiler.h"
+#include "bench_session.h"
+#include "bench_memory.h"
+#include "bench_random.h"
+#include "bench_logger.h"
+#include "bench_interpolation.h"
+#include "bench_snapshot.h"
+#include "bench_file.h"
+#include "bench_entity_store.h"
+#include "bench_block_compression.h"
+#include "bench_sprite_batch.h"
+
+#include <cstdio>
+#include <cstring>
+
+struct BenchSuite {
+    const char* name;
+    void (*run)();
+};
+
+static constexpr BenchSuite suites[] = {
+    { "simulation", bench_simulation },
+    { "jobs", bench_jobs },
+    { "atlas", bench_atlas },
+    { "assets", bench_assets },
+    { "mipmaps", bench_mipmaps },
+    { "spatial", bench_spatial },
+    { "culling", bench_culling },
+    { "instance_format", bench_instance_format },
+    { "profiler", bench_profiler },
+    { "session", bench_session },
+    { "memory", bench_memory },
+    { "random", bench_random },
+    { "logger", bench_logger },
+    { "interpolation", bench_interpolation },
+    { "snapshot", bench_snapshot },
+    { "file", bench_file },
+    { "entity_store", bench_entity_store },
+    { "block_compression", bench_block_compression },
+    { "sprite_batch", bench_sprite_batch }
+};
+
+// Usage: bench [suite...]
+// Runs every suite when none are named.
+int main(int argc, char** argv) {
+    bool ran_any = false;
+    for(const BenchSuite& suite : suites) {
+        bool selected = argc < 2;
+        for(int i = 1; i < argc; ++i) {
+            if(strcmp(argv[i], suite.name) == 0) {
+                selected = true;
+            }
+        }
+
+        if(selected) {
+            suite.run();
+            ran_any = true;
+        }
+    }
+
+    if(!ran_any) {
+        printf("Unknown suite. Available suites:\n");
+        for(const BenchSuite& suite : suites) {
+            printf("  %s\n", suite.name);
+        }
+        return 1;
+    }
+
+    return 0;
+}
\ No newline at end of file
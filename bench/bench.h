@@ -0,0 +1,83 @@
+#pragma once
+
+#include <orshlib/types.h>
+#include <orshlib/time.h>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Where suites write their scratch files, relative to the directory bench runs from. A macro so suite paths built
+// from it stay string literals.
+#define BENCH_OUTPUT_DIRECTORY "build/"
+
+namespace Bench {
+
+    static constexpr OL::Time::Duration MIN_SAMPLE_TIME = OL::Time::Milliseconds(250);
+    static constexpr u32 MIN_SAMPLE_COUNT = 5;
+
+    struct Measurement {
+        f64 best_ns;
+        f64 mean_ns;
+        u64 samples;
+    };
+
+    [[nodiscard]] static f64 to_nanoseconds(OL::Time::Duration duration) {
+        return static_cast<f64>(duration.count());
+    }
+
+    // Runs the workload once to warm caches and page in memory, then repeatedly until MIN_SAMPLE_TIME has passed.
+    template<typename Workload>
+    [[nodiscard]] static Measurement measure(Workload&& workload) {
+        workload();
+
+        Measurement measurement = { .best_ns = 1e300, .mean_ns = 0.0, .samples = 0 };
+        OL::Time::Duration total = OL::Time::Duration::zero();
+        while(measurement.samples < MIN_SAMPLE_COUNT || total < MIN_SAMPLE_TIME) {
+            OL::Time::Stamp start = OL::Time::Clock::now();
+            workload();
+            OL::Time::Duration elapsed = OL::Time::Clock::now() - start;
+
+            f64 elapsed_ns = to_nanoseconds(elapsed);
+            if(elapsed_ns < measurement.best_ns) {
+                measurement.best_ns = elapsed_ns;
+            }
+            total += elapsed;
+            ++measurement.samples;
+        }
+
+        measurement.mean_ns = to_nanoseconds(total) / static_cast<f64>(measurement.samples);
+        return measurement;
+    }
+
+    // Creates BENCH_OUTPUT_DIRECTORY when it is missing. Suites that write files call it first and skip when it fails.
+    [[nodiscard]] static bool prepare_output_directory() {
+        std::error_code error;
+        std::filesystem::create_directories(BENCH_OUTPUT_DIRECTORY, error);
+        if(error) {
+            printf("Skipped, unable to create %s: %s.\n", BENCH_OUTPUT_DIRECTORY, error.message().c_str());
+            return false;
+        }
+        return true;
+    }
+
+    static void print_suite(const char* name) {
+        printf("\n== %s ==\n", name);
+    }
+
+    // Keeps the optimizer from discarding work whose result is otherwise unused.
+    template<typename T>
+    static void do_not_optimize(const T& value) {
+#if defined(_MSC_VER)
+        static const void* volatile sink;
+        sink = &value;
+        _ReadWriteBarrier();
+#else
+        asm volatile("" : : "r,m"(value) : "memory");
+#endif
+    }
+}
\ No newline at end of file
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "bench.h"
+#include "asset_cook.h"
+#include "asset_pack.h"
+#include "bench_jobs.h"
+
+#include <orshlib/memory.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static constexpr const char* BENCH_ASSET_PACK_PATH = BENCH_OUTPUT_DIRECTORY "bench_sprites.pack";
+
+// Drops the file from the page cache so the next read has to come from disk. No-op where fadvise isn't available.
+static void evict_from_page_cache(const char* path) {
+#ifndef _WIN32
+    int descriptor = open(path, O_RDONLY);
+    if(descriptor >= 0) {
+        fdatasync(descriptor);
+        posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED);
+        close(descriptor);
+    }
+#else
+    (void)path;
+#endif
+}
+
+// Startup cost of getting the atlas page into memory ready for a transfer buffer: decoding the source images
+// and packing them at runtime against copying the cooked levels out of the mapped pack. Run from the repository root.
+static void bench_assets() {
+    Bench::print_suite("assets");
+    if(!Bench::prepare_output_directory()) {
+        return;
+    }
+
+    ImageData images[MAX_TEXTURES_COUNT];
+    AtlasRect rects[MAX_TEXTURES_COUNT];
+    if(!decode_images(ASSETS_DIRECTORY, image_paths, MAX_TEXTURES_COUNT, images, rects)) {
+        printf("Skipped, the images in %s are needed to cook the pack.\n", ASSETS_DIRECTORY);
+        return;
+    }
+
+    OL::Buffer* scratch = OL::Buffer::allocate(OL::MB(1));
+    AtlasLayout layout = pack_atlas(rects, MAX_TEXTURES_COUNT, DEFAULT_ATLAS_PADDING, MAX_ATLAS_PAGE_SIZE, scratch);
+    assert(layout.packed());
+
+    AssetPackHeader header = make_asset_pack_header(layout, MAX_TEXTURES_COUNT, DEFAULT_ATLAS_PADDING);
+    OL::Buffer* pack_buffer = OL::Buffer::allocate(header.file_size);
+    OL::Buffer* mip_scratch = OL::Buffer::allocate(cook_scratch_size(layout, BlockFormat::RGBA8));
+    size_t pack_size = cook_asset_pack(images, image_paths, rects, MAX_TEXTURES_COUNT, layout, DEFAULT_ATLAS_PADDING, pack_buffer, mip_scratch);
+    free_images(images, MAX_TEXTURES_COUNT);
+    if(pack_size == 0 || OL::File::write_to_file(BENCH_ASSET_PACK_PATH, pack_buffer, 0, pack_size) != pack_size) {
+        printf("Skipped, unable to write %s.\n", BENCH_ASSET_PACK_PATH);
+        return;
+    }
+
+    // Stands in for the mapped transfer buffer on both paths.
+    size_t level0_size = static_cast<size_t>(layout.width) * layout.height * ASSET_PACK_BYTES_PER_TEXEL;
+    size_t all_levels_size = 0;
+    for(u32 level = 0; level < header.level_count; ++level) {
+        all_levels_size += header.levels[level].size;
+    }
+    OL::Buffer* staging = OL::Buffer::allocate(all_levels_size);
+    u8* staging_data = staging->reserve(all_levels_size);
+
+    auto decode_path = [&]() {
+        ImageData decoded[MAX_TEXTURES_COUNT];
+        AtlasRect decoded_rects[MAX_TEXTURES_COUNT];
+        bool decoded_all = decode_images(ASSETS_DIRECTORY, image_paths, MAX_TEXTURES_COUNT, decoded, decoded_rects);
+        assert(decoded_all);
+        scratch->allocated = 0;
+        AtlasLayout decoded_layout = pack_atlas(decoded_rects, MAX_TEXTURES_COUNT, DEFAULT_ATLAS_PADDING, MAX_ATLAS_PAGE_SIZE, scratch);
+        build_atlas_page(staging_data, decoded_layout, decoded, decoded_rects, MAX_TEXTURES_COUNT, DEFAULT_ATLAS_PADDING);
+        free_images(decoded, MAX_TEXTURES_COUNT);
+        Bench::do_not_optimize(staging_data);
+    };
+
+    bool pack_valid = true;
+    auto pack_path = [&]() {
+        AssetPack pack;
+        if(!open_asset_pack(BENCH_ASSET_PACK_PATH, &pack) || !asset_pack_matches(&pack, image_paths, MAX_TEXTURES_COUNT)) {
+            pack_valid = false;
+            return;
+        }
+
+        u8* destination = staging_data;
+        for(u32 level = 0; level < pack.header->level_count; ++level) {
+            memcpy(destination, pack.level_texels(level), pack.header->levels[level].size);
+            destination += pack.header->levels[level].size;
+        }
+        close_asset_pack(&pack);
+        Bench::do_not_optimize(staging_data);
+    };
+
+    printf("%ux%u page, %u levels, pack %zu bytes\n", layout.width, layout.height, header.level_count, pack_size);
+    printf("%22s %8s %12s %12s %10s\n", "path", "cache", "best ms", "mean ms", "MB/s");
+
+    auto report = [](const char* name, const char* cache, Bench::Measurement measurement, size_t bytes) {
+        f64 mb_per_second = static_cast<f64>(bytes) / OL::MB(1) / (measurement.best_ns * 1e-9);
+        printf("%22s %8s %12.3f %12.3f %10.1f\n", name, cache, measurement.best_ns * 1e-6, measurement.mean_ns * 1e-6, mb_per_second);
+    };
+
+    report("decode + pack (1 lvl)", "warm", Bench::measure(decode_path), level0_size);
+    report("mapped pack (all lvls)", "warm", Bench::measure(pack_path), all_levels_size);
+    // The cold row includes the eviction itself, treat it as an upper bound.
+    report("mapped pack (all lvls)", "cold", Bench::measure([&]() {
+        evict_from_page_cache(BENCH_ASSET_PACK_PATH);
+        pack_path();
+    }), all_levels_size);
+
+    if(!pack_valid) {
+        printf("Pack failed to load, results are invalid.\n");
+    }
+
+    // The streaming loader's decode: every image one after another against one job per image on the pool,
+    // including how long the first finished image takes to come out of the completion queue.
+    static ImageDecodeBatch decode_batch;
+    size_t decoded_size = 0;
+    for(u32 i = 0; i < MAX_TEXTURES_COUNT; ++i) {
+        decoded_size += static_cast<size_t>(rects[i].width) * rects[i].height * ASSET_PACK_BYTES_PER_TEXEL;
+    }
+
+    report("decode serial", "warm", Bench::measure([&]() {
+        ImageData decoded[MAX_TEXTURES_COUNT];
+        AtlasRect decoded_rects[MAX_TEXTURES_COUNT];
+        bool decoded_all = decode_images(ASSETS_DIRECTORY, image_paths, MAX_TEXTURES_COUNT, decoded, decoded_rects);
+        assert(decoded_all);
+        free_images(decoded, MAX_TEXTURES_COUNT);
+    }), decoded_size);
+
+    bench_job_system.init();
+    f64 best_first_ns = 0.0;
+    u32 decode_failures = 0;
+    Bench::Measurement parallel_decode = Bench::measure([&]() {
+        ImageData decoded[MAX_TEXTURES_COUNT];
+        OL::Time::Stamp start = OL::Time::Clock::now();
+        bool started = start_image_decode_batch(&decode_batch, &bench_job_system, ASSETS_DIRECTORY, image_paths, decoded, MAX_TEXTURES_COUNT);
+        assert(started);
+
+        u32 received = 0;
+        while(received < MAX_TEXTURES_COUNT) {
+            u32 image_index;
+            if(!decode_batch.completed.pop(&image_index)) {
+                [[maybe_unused]] bool ran = bench_job_system.try_run_job();
+                continue;
+            }
+
+            if(received++ == 0) {
+                f64 first_ns = static_cast<f64>(std::chrono::duration_cast<OL::Time::Nanoseconds>(OL::Time::Clock::now() - start).count());
+                best_first_ns = best_first_ns == 0.0 || first_ns < best_first_ns ? first_ns : best_first_ns;
+            }
+            decode_failures += decoded[image_index].pixels ? 0 : 1;
+            free_images(&decoded[image_index], 1);
+        }
+        bench_job_system.wait(&decode_batch.counter);
+    });
+
+    char parallel_name[32];
+    snprintf(parallel_name, sizeof(parallel_name), "decode jobs (%u thr)", bench_job_system.thread_count());
+    report(parallel_name, "warm", parallel_decode, decoded_size);
+    printf("first decoded image after %.3f ms, %u failed decodes\n", best_first_ns * 1e-6, decode_failures);
+    bench_job_system.shutdown();
+
+    // Level 0 must come out of the pack exactly as the runtime path builds it.
+    decode_path();
+    AssetPack pack;
+    bool opened = open_asset_pack(BENCH_ASSET_PACK_PATH, &pack);
+    bool identical = opened && memcmp(pack.level_texels(0), staging_data, level0_size) == 0;
+    if(opened) {
+        close_asset_pack(&pack);
+    }
+    printf("level 0 matches runtime decode: %s\n", identical ? "yes" : "NO");
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "bench.h"
+#include "atlas.h"
+
+#include <orshlib/memory.h>
+#include <random>
+
+struct AtlasBenchSet {
+    const char* name;
+    u32 count;
+    u32 min_size;
+    u32 max_size;
+};
+
+static constexpr AtlasBenchSet ATLAS_BENCH_SETS[] = {
+    { "icons", 256, 16, 64 },
+    { "sprites", 256, 32, 256 },
+    { "sprites", 1024, 32, 256 },
+    { "mixed", 64, 16, 1024 },
+    { "particles", 4096, 4, 32 }
+};
+
+// Every rect must sit inside the page with its padding and never overlap another rect's padded area.
+[[nodiscard]] static bool verify_atlas(const AtlasRect* rects, u32 count, u32 padding, AtlasLayout layout) {
+    for(u32 i = 0; i < count; ++i) {
+        const AtlasRect& a = rects[i];
+        if(a.x < padding || a.y < padding || a.x + a.width + padding > layout.width || a.y + a.height + padding > layout.height) {
+            return false;
+        }
+
+        for(u32 j = i + 1; j < count; ++j) {
+            const AtlasRect& b = rects[j];
+            bool separate = a.x + a.width + padding <= b.x - padding || b.x + b.width + padding <= a.x - padding ||
+                            a.y + a.height + padding <= b.y - padding || b.y + b.height + padding <= a.y - padding;
+            if(!separate) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static void bench_atlas() {
+    Bench::print_suite("atlas");
+
+    static constexpr u32 MAX_RECTS = 4096;
+    OL::Buffer* storage = OL::Buffer::allocate(sizeof(AtlasRect) * MAX_RECTS * 2);
+    OL::Buffer* scratch = OL::Buffer::allocate(OL::MB(1));
+    assert(storage && scratch);
+    AtlasRect* source_rects = storage->reserve<AtlasRect>(MAX_RECTS);
+    AtlasRect* rects = storage->reserve<AtlasRect>(MAX_RECTS);
+
+    // Fixed seed so every run packs the same sets.
+    std::mt19937 random(1234);
+
+    printf("%10s %6s %8s %12s %11s %12s %8s\n", "set", "rects", "padding", "page", "efficiency", "pack us", "valid");
+    for(const AtlasBenchSet& set : ATLAS_BENCH_SETS) {
+        assert(set.count <= MAX_RECTS);
+        std::uniform_int_distribution<u32> size(set.min_size, set.max_size);
+        for(u32 i = 0; i < set.count; ++i) {
+            source_rects[i] = { .width = size(random), .height = size(random) };
+        }
+
+        for(u32 padding : { 0u, DEFAULT_ATLAS_PADDING }) {
+            AtlasLayout layout = {};
+            Bench::Measurement measurement = Bench::measure([&]() {
+                memcpy(rects, source_rects, sizeof(AtlasRect) * set.count);
+                scratch->allocated = 0;
+                layout = pack_atlas(rects, set.count, padding, MAX_ATLAS_PAGE_SIZE, scratch);
+            });
+
+            bool valid = layout.packed() && verify_atlas(rects, set.count, padding, layout);
+            printf("%10s %6u %8u %6ux%-5u %10.1f%% %12.1f %8s\n", set.name, set.count, padding, layout.width, layout.height, layout.efficiency() * 100.0, measurement.best_ns * 1e-3, valid ? "yes" : "NO");
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "bench.h"
+#include "bench_jobs.h"
+#include "asset_cook.h"
+#include "asset_pack.h"
+#include "block_compression.h"
+
+#include <orshlib/memory.h>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+static constexpr const char* BENCH_BLOCK_PACK_PATH = BENCH_OUTPUT_DIRECTORY "bench_block_sprites.pack";
+
+static constexpr BlockFormat BLOCK_BENCH_FORMATS[] = { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC7 };
+static constexpr u32 BLOCK_BENCH_IMAGE_SIZE = 1024;
+static constexpr u32 BLOCK_BENCH_PAGE_SIZE = 2048;
+
+// Lowest acceptable PSNR per format on the sprite-like test images, RGB for BC1 and RGBA otherwise.
+static constexpr f64 BLOCK_BENCH_MIN_PSNR[] = { 0.0, 34.0, 34.0, 38.0 };
+
+// Sprite-like content: soft-edged discs with shaded gradients and a little noise, on transparent black unless opaque,
+// where a gradient background fills in.
+static void fill_block_bench_image(u8* texels, u32 width, u32 height, u32 seed, bool opaque) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<f32> unit(0.0f, 1.0f);
+    std::uniform_int_distribution<s32> noise(-4, 4);
+
+    struct Disc {
+        f32 x, y, radius;
+        f32 color[3];
+    };
+    Disc discs[12];
+    for(Disc& disc : discs) {
+        disc = { unit(random) * width, unit(random) * height, (0.05f + unit(random) * 0.2f) * width, { unit(random), unit(random), unit(random) } };
+    }
+
+    for(u32 y = 0; y < height; ++y) {
+        for(u32 x = 0; x < width; ++x) {
+            f32 color[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            if(opaque) {
+                color[0] = static_cast<f32>(x) / width * 0.6f;
+                color[1] = static_cast<f32>(y) / height * 0.5f;
+                color[2] = 0.3f;
+                color[3] = 1.0f;
+            }
+            for(const Disc& disc : discs) {
+                f32 distance = sqrtf((x - disc.x) * (x - disc.x) + (y - disc.y) * (y - disc.y));
+                f32 coverage = (disc.radius - distance) / 3.0f;
+                coverage = coverage < 0.0f ? 0.0f : (coverage > 1.0f ? 1.0f : coverage);
+                f32 shade = 1.0f - 0.6f * distance / disc.radius;
+                for(u32 channel = 0; channel < 3; ++channel) {
+                    color[channel] = color[channel] * (1.0f - coverage) + disc.color[channel] * shade * coverage;
+                }
+                color[3] = color[3] + (1.0f - color[3]) * coverage;
+            }
+
+            u8* texel = texels + (static_cast<size_t>(y) * width + x) * 4;
+            for(u32 channel = 0; channel < 3; ++channel) {
+                s32 value = static_cast<s32>(color[channel] * 255.0f + 0.5f) + (color[3] > 0.0f ? noise(random) : 0);
+                texel[channel] = static_cast<u8>(value < 0 ? 0 : (value > 255 ? 255 : value));
+            }
+            texel[3] = static_cast<u8>(color[3] * 255.0f + 0.5f);
+        }
+    }
+}
+
+[[nodiscard]] static f64 block_bench_psnr(const u8* expected, const u8* actual, size_t texel_count, u32 channel_count) {
+    f64 squared_error = 0.0;
+    for(size_t i = 0; i < texel_count; ++i) {
+        for(u32 channel = 0; channel < channel_count; ++channel) {
+            f64 difference = static_cast<f64>(expected[i * 4 + channel]) - actual[i * 4 + channel];
+            squared_error += difference * difference;
+        }
+    }
+    f64 mse = squared_error / (static_cast<f64>(texel_count) * channel_count);
+    return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+// Every kernel has to write the scalar kernel's blocks byte for byte, on an odd size too so partial edge blocks are
+// covered, and each format has to reach its PSNR floor.
+[[nodiscard]] static bool verify_block_kernels(OL::Buffer* scratch, const u8* opaque, const u8* sprite, u32 size) {
+    OL::BufferScope scope(scratch);
+    size_t level_size = block_format_level_size(BlockFormat::RGBA8, size, size);
+    u8* expected = scratch->reserve(level_size);
+    u8* actual = scratch->reserve(level_size);
+    u8* decoded = scratch->reserve(level_size);
+
+    bool identical = true;
+    bool quality = true;
+    for(BlockFormat format : BLOCK_BENCH_FORMATS) {
+        const u8* source = format == BlockFormat::BC1 ? opaque : sprite;
+        for(u32 width : { size, 37u }) {
+            u32 height = width == size ? size : 23;
+            size_t compressed_size = compress_image(format, source, width, height, expected, nullptr, select_block_indices_scalar);
+            for(s32 level_index = 1; level_index < static_cast<s32>(OL::SIMD::Level::MAX_COUNT); ++level_index) {
+                OL::SIMD::Level level = static_cast<OL::SIMD::Level>(level_index);
+                if(OL::SIMD::supported(level)) {
+                    compress_image(format, source, width, height, actual, nullptr, select_block_indices_kernel(level));
+                    identical &= memcmp(expected, actual, compressed_size) == 0;
+                }
+            }
+        }
+
+        compress_image(format, source, size, size, expected);
+        decompress_image(format, expected, size, size, decoded);
+        u32 channel_count = format == BlockFormat::BC1 ? 3 : 4;
+        f64 psnr = block_bench_psnr(source, decoded, static_cast<size_t>(size) * size, channel_count);
+        quality &= psnr >= BLOCK_BENCH_MIN_PSNR[static_cast<u32>(format)];
+        printf("%s: %.2f dB PSNR (%s, floor %.0f)\n", block_format_to_string(format), psnr, channel_count == 3 ? "RGB" : "RGBA", BLOCK_BENCH_MIN_PSNR[static_cast<u32>(format)]);
+    }
+
+    printf("every kernel matches scalar: %s, PSNR floors met: %s\n", identical ? "yes" : "NO", quality ? "yes" : "NO");
+    return identical && quality;
+}
+
+// Cooks the same sprites into an RGBA8 and a BC7 pack. The BC7 one has to open, store every level at a quarter of the
+// size and decode close to the RGBA8 page.
+[[nodiscard]] static bool verify_block_pack() {
+    static constexpr u32 SPRITE_COUNT = 3;
+    static constexpr u32 SPRITE_SIZES[SPRITE_COUNT][2] = { { 301, 187 }, { 128, 128 }, { 77, 250 } };
+    static const char* const SPRITE_NAMES[SPRITE_COUNT] = { "disc_a", "disc_b", "disc_c" };
+
+    ImageData images[SPRITE_COUNT];
+    AtlasRect rects[SPRITE_COUNT];
+    for(u32 i = 0; i < SPRITE_COUNT; ++i) {
+        u32 width = SPRITE_SIZES[i][0], height = SPRITE_SIZES[i][1];
+        images[i] = { .pixels = static_cast<u8*>(malloc(static_cast<size_t>(width) * height * 4)), .size = width * height * 4, .width = width, .height = height, .level_count = 1 };
+        assert(images[i].pixels);
+        fill_block_bench_image(images[i].pixels, width, height, i + 7, false);
+        rects[i] = { .width = width, .height = height };
+    }
+
+    OL::Buffer* scratch = OL::Buffer::allocate(OL::KB(64));
+    AtlasLayout layout = pack_atlas(rects, SPRITE_COUNT, DEFAULT_ATLAS_PADDING, MAX_ATLAS_PAGE_SIZE, scratch, BLOCK_DIMENSION);
+    assert(layout.packed());
+
+    AssetPackHeader rgba_header = make_asset_pack_header(layout, SPRITE_COUNT, DEFAULT_ATLAS_PADDING);
+    AssetPackHeader bc7_header = make_asset_pack_header(layout, SPRITE_COUNT, DEFAULT_ATLAS_PADDING, BlockFormat::BC7);
+    OL::Buffer* rgba_buffer = OL::Buffer::allocate(rgba_header.file_size);
+    OL::Buffer* bc7_buffer = OL::Buffer::allocate(bc7_header.file_size);
+    OL::Buffer* cook_scratch = OL::Buffer::allocate(cook_scratch_size(layout, BlockFormat::BC7));
+    u8* decoded = static_cast<u8*>(malloc(rgba_header.levels[0].size));
+    assert(rgba_buffer && bc7_buffer && cook_scratch && decoded);
+
+    size_t rgba_size = cook_asset_pack(images, SPRITE_NAMES, rects, SPRITE_COUNT, layout, DEFAULT_ATLAS_PADDING, rgba_buffer, cook_scratch);
+    cook_scratch->allocated = 0;
+    size_t bc7_size = cook_asset_pack(images, SPRITE_NAMES, rects, SPRITE_COUNT, layout, DEFAULT_ATLAS_PADDING, bc7_buffer, cook_scratch, BlockFormat::BC7, &bench_job_system);
+    free_images(images, SPRITE_COUNT);
+
+    bool valid = rgba_size > 0 && bc7_size > 0 && bc7_size < rgba_size;
+    AssetPack pack;
+    if(valid && OL::File::write_to_file(BENCH_BLOCK_PACK_PATH, bc7_buffer, 0, bc7_size) == bc7_size && open_asset_pack(BENCH_BLOCK_PACK_PATH, &pack)) {
+        valid &= pack.header->format == BlockFormat::BC7 && asset_pack_matches(&pack, SPRITE_NAMES, SPRITE_COUNT);
+        for(u32 level = 0; level < pack.header->level_count; ++level) {
+            u32 width = pack.header->levels[level].width, height = pack.header->levels[level].height;
+            valid &= pack.header->levels[level].size == (width >= 4 && height >= 4 ? rgba_header.levels[level].size / 4 : 16 * ((width + 3) / 4) * ((height + 3) / 4));
+        }
+        close_asset_pack(&pack);
+    } else {
+        valid = false;
+    }
+
+    f64 psnr = 0.0;
+    if(valid) {
+        decompress_image(BlockFormat::BC7, bc7_buffer->data + bc7_header.levels[0].offset, layout.width, layout.height, decoded);
+        psnr = block_bench_psnr(rgba_buffer->data + rgba_header.levels[0].offset, decoded, static_cast<size_t>(layout.width) * layout.height, 4);
+        valid &= psnr >= BLOCK_BENCH_MIN_PSNR[static_cast<u32>(BlockFormat::BC7)];
+    }
+
+    printf("%ux%u page: RGBA8 pack %zu bytes, BC7 pack %zu bytes, level 0 %.2f dB, pack valid: %s\n", layout.width, layout.height, rgba_size, bc7_size, psnr, valid ? "yes" : "NO");
+    free(decoded);
+    OL::Buffer::release(cook_scratch);
+    OL::Buffer::release(bc7_buffer);
+    OL::Buffer::release(rgba_buffer);
+    OL::Buffer::release(scratch);
+    return valid;
+}
+
+static void bench_block_compression() {
+    Bench::print_suite("block_compression");
+    if(!Bench::prepare_output_directory()) {
+        return;
+    }
+
+    u32 size = BLOCK_BENCH_IMAGE_SIZE;
+    size_t image_size = block_format_level_size(BlockFormat::RGBA8, size, size);
+    size_t page_chain_size = mip_chain_size(BLOCK_BENCH_PAGE_SIZE, BLOCK_BENCH_PAGE_SIZE, mip_level_count(BLOCK_BENCH_PAGE_SIZE, BLOCK_BENCH_PAGE_SIZE));
+    OL::Buffer* images = OL::Buffer::allocate(image_size * 2);
+    OL::Buffer* scratch = OL::Buffer::allocate(image_size * 4 + page_chain_size * 2);
+    assert(images && scratch);
+    u8* opaque = images->reserve(image_size);
+    u8* sprite = images->reserve(image_size);
+    fill_block_bench_image(opaque, size, size, 1, true);
+    fill_block_bench_image(sprite, size, size, 2, false);
+
+    bench_job_system.init();
+    bool valid = verify_block_kernels(scratch, opaque, sprite, size);
+    valid &= verify_block_pack();
+
+    // Single threaded per kernel, then the best kernel over the job system. Throughput is in source texels.
+    u8* output = scratch->reserve(image_size);
+    printf("\n%8s %8s %9s %12s %12s %10s\n", "format", "kernel", "threads", "best ms", "Mtexels/s", "MB/s in");
+    auto report = [&](BlockFormat format, const char* kernel_name, u32 threads, Bench::Measurement measurement) {
+        f64 seconds = measurement.best_ns * 1e-9;
+        printf("%8s %8s %9u %12.2f %12.2f %10.1f\n", block_format_to_string(format), kernel_name, threads, measurement.best_ns * 1e-6,
+               static_cast<f64>(size) * size / seconds * 1e-6, static_cast<f64>(image_size) / OL::MB(1) / seconds);
+    };
+    for(BlockFormat format : BLOCK_BENCH_FORMATS) {
+        const u8* source = format == BlockFormat::BC1 ? opaque : sprite;
+        BlockIndexKernel previous_kernel = nullptr;
+        for(s32 level_index = 0; level_index < static_cast<s32>(OL::SIMD::Level::MAX_COUNT); ++level_index) {
+            OL::SIMD::Level level = static_cast<OL::SIMD::Level>(level_index);
+            BlockIndexKernel kernel = select_block_indices_kernel(level);
+            // Levels that share a kernel would only measure it twice.
+            if(!OL::SIMD::supported(level) || kernel == previous_kernel) {
+                continue;
+            }
+            previous_kernel = kernel;
+            report(format, OL::SIMD::level_to_string(level), 1, Bench::measure([&]() {
+                compress_image(format, source, size, size, output, nullptr, kernel);
+            }));
+        }
+        report(format, "best", bench_job_system.thread_count(), Bench::measure([&]() {
+            compress_image(format, source, size, size, output, &bench_job_system);
+        }));
+    }
+    bench_job_system.shutdown();
+
+    // What a full-chain page costs to hold and to copy into a transfer buffer, the CPU side of the upload.
+    u8* staging = scratch->reserve(page_chain_size);
+    u8* chain = scratch->reserve(page_chain_size);
+    memset(chain, 0x5A, page_chain_size);
+    printf("\n%ux%u page with mips\n%8s %12s %8s %12s\n", BLOCK_BENCH_PAGE_SIZE, BLOCK_BENCH_PAGE_SIZE, "format", "KB", "ratio", "copy us");
+    for(BlockFormat format : { BlockFormat::RGBA8, BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC7 }) {
+        size_t chain_size = 0;
+        for(u32 level = 0; level < mip_level_count(BLOCK_BENCH_PAGE_SIZE, BLOCK_BENCH_PAGE_SIZE); ++level) {
+            chain_size += block_format_level_size(format, mip_dimension(BLOCK_BENCH_PAGE_SIZE, level), mip_dimension(BLOCK_BENCH_PAGE_SIZE, level));
+        }
+        Bench::Measurement measurement = Bench::measure([&]() {
+            memcpy(staging, chain, chain_size);
+            Bench::do_not_optimize(staging);
+        });
+        printf("%8s %12zu %8.2f %12.1f\n", block_format_to_string(format), chain_size / OL::KB(1), static_cast<f64>(page_chain_size) / chain_size, measurement.best_ns * 1e-3);
+    }
+
+    printf("valid: %s\n", valid ? "yes" : "NO");
+    OL::Buffer::release(scratch);
+    OL::Buffer::release(images);
+}
\ No newline at end of file
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "bench.h"
+#include "bench_jobs.h"
+#include "culling.h"
+#include "simulation.h"
+
+#include <orshlib/memory.h>
+#include <cmath>
+
+static constexpr size_t CULLING_BENCH_SIZES[] = {
+    MAX_ENTITIES,
+    1'000'000,
+    5'000'000
+};
+
+// Share of the [-1, 1] world inside the view. Entities are spread uniformly, so this is also the visible share.
+static constexpr f32 CULLING_BENCH_VISIBLE[] = {
+    1.0f,
+    0.5f,
+    0.1f
+};
+
+static constexpr u32 CULLING_BENCH_RANGES = 8;
+static constexpr Vector2 CULLING_BENCH_EXTENT = { 0.01f, 0.02f };
+
+[[nodiscard]] static ViewBounds culling_bench_view(f32 visible) {
+    f32 half = sqrtf(visible);
+    return { .min = { -half, -half }, .max = { half, half } };
+}
+
+static u32 culling_bench_ranges(u32 count, CullRange* ranges) {
+    for(u32 i = 0; i < CULLING_BENCH_RANGES; ++i) {
+        ranges[i] = {
+            .begin = static_cast<u32>(static_cast<u64>(count) * i / CULLING_BENCH_RANGES),
+            .end = static_cast<u32>(static_cast<u64>(count) * (i + 1) / CULLING_BENCH_RANGES),
+            .extent = { CULLING_BENCH_EXTENT.x * (i + 1), CULLING_BENCH_EXTENT.y }
+        };
+    }
+    return CULLING_BENCH_RANGES;
+}
+
+// Every kernel must keep exactly the scalar kernel's instances, in the same order. The odd count runs every tail path.
+[[nodiscard]] static bool verify_cull_kernel(CullKernel kernel, const InstanceData* instances, InstanceData* expected, InstanceData* actual) {
+    static constexpr size_t VERIFY_COUNT = 100'003;
+    for(f32 visible : CULLING_BENCH_VISIBLE) {
+        ViewBounds view = culling_bench_view(visible);
+        u32 expected_count = cull_instances_scalar(instances, VERIFY_COUNT, view.min, view.max, expected);
+        u32 actual_count = kernel(instances, VERIFY_COUNT, view.min, view.max, actual);
+        if(expected_count != actual_count || memcmp(expected, actual, sizeof(InstanceData) * expected_count) != 0) {
+            return false;
+        }
+
+        // In place, which is allowed as long as the kernel never overtakes its own reads.
+        memcpy(actual, instances, sizeof(InstanceData) * VERIFY_COUNT);
+        actual_count = kernel(actual, VERIFY_COUNT, view.min, view.max, actual);
+        if(expected_count != actual_count || memcmp(expected, actual, sizeof(InstanceData) * expected_count) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The chunked pass has to produce the same stream as culling each range in one go, with or without jobs.
+[[nodiscard]] static bool verify_cull_ranges(InstanceCuller* culler, const InstanceData* instances, u32 count, InstanceData* expected, InstanceData* actual) {
+    for(f32 visible : CULLING_BENCH_VISIBLE) {
+        ViewBounds view = culling_bench_view(visible);
+        CullRange ranges[CULLING_BENCH_RANGES];
+        u32 range_count = culling_bench_ranges(count, ranges);
+
+        u32 expected_total = 0;
+        u32 expected_counts[CULLING_BENCH_RANGES];
+        for(u32 i = 0; i < range_count; ++i) {
+            Vector2 min = { view.min.x - ranges[i].extent.x, view.min.y - ranges[i].extent.y };
+            Vector2 max = { view.max.x + ranges[i].extent.x, view.max.y + ranges[i].extent.y };
+            expected_counts[i] = cull_instances_scalar(instances + ranges[i].begin, ranges[i].end - ranges[i].begin, min, max, expected + expected_total);
+            expected_total += expected_counts[i];
+        }
+
+        for(OL::JobSystem* jobs : { static_cast<OL::JobSystem*>(nullptr), &bench_job_system }) {
+            u32 total = cull_instances(culler, instances, ranges, range_count, view, actual, jobs);
+            if(total != expected_total || memcmp(expected, actual, sizeof(InstanceData) * total) != 0) {
+                return false;
+            }
+
+            u32 first_visible = 0;
+            for(u32 i = 0; i < range_count; ++i) {
+                if(ranges[i].first_visible != first_visible || ranges[i].visible_count != expected_counts[i]) {
+                    return false;
+                }
+                first_visible += expected_counts[i];
+            }
+        }
+    }
+    return true;
+}
+
+static void bench_culling() {
+    Bench::print_suite("culling");
+
+    size_t max_count = 0;
+    for(size_t count : CULLING_BENCH_SIZES) {
+        max_count = count > max_count ? count : max_count;
+    }
+
+    OL::Buffer* storage = OL::Buffer::allocate((sizeof(InstanceData) * 3 + sizeof(Entity)) * max_count +
+                                               instance_culler_memory_size(static_cast<u32>(max_count), CULLING_BENCH_RANGES));
+    assert(storage);
+    Simulation simulation = {
+        .instances = storage->reserve<InstanceData>(max_count),
+        .entities = storage->reserve<Entity>(max_count),
+        .count = max_count
+    };
+    init_entities(&simulation);
+    InstanceData* expected = storage->reserve<InstanceData>(max_count);
+    InstanceData* output = storage->reserve<InstanceData>(max_count);
+
+    InstanceCuller culler;
+    bool initialized = init_instance_culler(&culler, static_cast<u32>(max_count), CULLING_BENCH_RANGES, storage);
+    assert(initialized);
+    bench_job_system.init();
+
+    printf("%8s %12s %10s %12s %14s %8s\n", "kernel", "instances", "visible", "best us", "Minstances/s", "valid");
+    for(s32 level_index = 0; level_index < static_cast<s32>(OL::SIMD::Level::MAX_COUNT); ++level_index) {
+        OL::SIMD::Level level = static_cast<OL::SIMD::Level>(level_index);
+        const char* level_name = OL::SIMD::level_to_string(level);
+        if(!OL::SIMD::supported(level)) {
+            printf("%8s unsupported on this CPU\n", level_name);
+            continue;
+        }
+
+        CullKernel kernel = cull_kernel(level);
+        const char* valid = verify_cull_kernel(kernel, simulation.instances, expected, output) ? "yes" : "NO";
+        for(size_t count : CULLING_BENCH_SIZES) {
+            for(f32 visible : CULLING_BENCH_VISIBLE) {
+                ViewBounds view = culling_bench_view(visible);
+                u32 visible_count = 0;
+                Bench::Measurement measurement = Bench::measure([&]() {
+                    visible_count = kernel(simulation.instances, count, view.min, view.max, output);
+                });
+                Bench::do_not_optimize(output[visible_count / 2]);
+
+                printf("%8s %12zu %9.1f%% %12.1f %14.1f %8s\n", level_name, count, 100.0 * visible_count / count, measurement.best_ns * 1e-3,
+                       count / (measurement.best_ns * 1e-3), valid);
+            }
+        }
+    }
+
+    // The whole stage as the client runs it: chunked culling per sprite range into a separate upload destination,
+    // against the full-stream memcpy it replaces.
+    printf("\n%12s %10s %9s %14s %14s %14s %12s %8s\n", "instances", "visible", "threads", "memcpy us", "cull us", "upload MB", "saved MB", "valid");
+    for(size_t count : CULLING_BENCH_SIZES) {
+        Bench::Measurement full = Bench::measure([&]() {
+            memcpy(output, simulation.instances, sizeof(InstanceData) * count);
+        });
+        Bench::do_not_optimize(output[count - 1]);
+
+        const char* valid = verify_cull_ranges(&culler, simulation.instances, static_cast<u32>(count), expected, output) ? "yes" : "NO";
+        for(f32 visible : CULLING_BENCH_VISIBLE) {
+            ViewBounds view = culling_bench_view(visible);
+            for(OL::JobSystem* jobs : { static_cast<OL::JobSystem*>(nullptr), &bench_job_system }) {
+                CullRange ranges[CULLING_BENCH_RANGES];
+                u32 range_count = culling_bench_ranges(static_cast<u32>(count), ranges);
+                u32 total = 0;
+                Bench::Measurement culled = Bench::measure([&]() {
+                    total = cull_instances(&culler, simulation.instances, ranges, range_count, view, output, jobs);
+                });
+                Bench::do_not_optimize(output[total / 2]);
+
+                f64 upload_mb = static_cast<f64>(sizeof(InstanceData) * total) / OL::MB(1);
+                f64 saved_mb = static_cast<f64>(sizeof(InstanceData) * (count - total)) / OL::MB(1);
+                u32 threads = jobs ? jobs->thread_count() : 1;
+                printf("%12zu %9.1f%% %9u %14.1f %14.1f %14.2f %12.2f %8s\n", count, 100.0 * total / count, threads, full.best_ns * 1e-3,
+                       culled.best_ns * 1e-3, upload_mb, saved_mb, valid);
+            }
+        }
+    }
+
+    bench_job_system.shutdown();
+}
\ No newline at end of file
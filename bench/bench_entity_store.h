@@ -0,0 +1,207 @@
+#pragma once
+
+#include "bench.h"
+#include "bench_jobs.h"
+#include "entity_store.h"
+
+#include <orshlib/memory.h>
+#include <orshlib/random.h>
+
+static constexpr u32 ENTITY_STORE_BENCH_CAPACITY = MAX_ENTITIES * 2;
+static constexpr u32 ENTITY_STORE_BENCH_LIVE = MAX_ENTITIES;
+static constexpr u32 ENTITY_STORE_BENCH_BATCHES[] = { 1'000, 25'000, 100'000 };
+static constexpr u32 ENTITY_STORE_VERIFY_ROUNDS = 8;
+
+// Tags an entity with its slot so a survivor can be checked against the handle it was spawned with.
+static void tag_spawned_entities(Simulation* simulation, const EntityStore* store, u32 first) {
+    for(size_t index = first; index < simulation->count; ++index) {
+        f32 tag = static_cast<f32>(store->dense_slots[index]);
+        simulation->instances[index].position = { tag, -tag };
+        simulation->entities[index].velocity = { tag, tag };
+        if(simulation->previous_instances) {
+            simulation->previous_instances[index].position = { tag, -tag };
+        }
+    }
+}
+
+// Both maps agree for every live entity.
+[[nodiscard]] static bool entity_store_links_valid(const EntityStore* store, const Simulation* simulation) {
+    for(u32 index = 0; index < simulation->count; ++index) {
+        if(store->slot_dense[store->dense_slots[index]] != index) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The maps agree and every live entity still carries the tag of its slot.
+[[nodiscard]] static bool entity_store_consistent(const EntityStore* store, const Simulation* simulation) {
+    for(u32 index = 0; index < simulation->count; ++index) {
+        f32 tag = static_cast<f32>(store->dense_slots[index]);
+        if(simulation->instances[index].position.x != tag || simulation->entities[index].velocity.y != tag || simulation->previous_instances[index].position.y != -tag) {
+            return false;
+        }
+    }
+    return entity_store_links_valid(store, simulation);
+}
+
+// Rounds of spawning a batch and despawning a random half of the world, duplicates included. Every despawned handle
+// has to go stale, every survivor has to keep its data and slots have to come back with a new generation.
+[[nodiscard]] static bool verify_entity_store(OL::Buffer* storage) {
+    OL::BufferScope scope(storage);
+    static constexpr u32 CAPACITY = 50'000;
+    Simulation simulation = {
+        .instances = storage->reserve<InstanceData>(CAPACITY),
+        .entities = storage->reserve<Entity>(CAPACITY),
+        .count = 0,
+        .previous_instances = storage->reserve<InstanceData>(CAPACITY)
+    };
+    EntityStore store;
+    EntityHandle* handles = storage->reserve<EntityHandle>(CAPACITY);
+    EntityHandle* despawned = storage->reserve<EntityHandle>(CAPACITY);
+    if(!init_entity_store(&store, &simulation, CAPACITY, storage)) {
+        return false;
+    }
+
+    OL::Random::Xoshiro256 random = OL::Random::Xoshiro256::seeded(DEFAULT_SIMULATION_SEED);
+    u32 handle_count = 0;
+    bool consistent = true;
+    bool stale_rejected = true;
+    bool survivors_found = true;
+    bool slots_reused = true;
+    for(u32 round = 0; round < ENTITY_STORE_VERIFY_ROUNDS; ++round) {
+        u32 slots_before = store.fresh_slot;
+        u32 first = spawn_entities(&store, &simulation, 10'000, handles + handle_count);
+        tag_spawned_entities(&simulation, &store, first);
+        u32 spawned = static_cast<u32>(simulation.count) - first;
+        // With despawned slots on the free list, a round hands those out before any fresh one.
+        slots_reused &= round == 0 || store.fresh_slot - slots_before < spawned;
+        handle_count += spawned;
+
+        u32 despawn_count = handle_count / 2;
+        for(u32 i = 0; i < despawn_count; ++i) {
+            despawned[i] = handles[random.next() % handle_count];
+        }
+        u32 live_before = static_cast<u32>(simulation.count);
+        u32 removed = despawn_entities(&store, &simulation, despawned, despawn_count);
+        consistent &= removed <= despawn_count && simulation.count == live_before - removed && entity_store_consistent(&store, &simulation);
+
+        // Drop the dead handles and check the survivors still resolve to their own data.
+        u32 kept = 0;
+        for(u32 i = 0; i < handle_count; ++i) {
+            u32 index = entity_index(&store, handles[i]);
+            if(index == INVALID_ENTITY_INDEX) {
+                continue;
+            }
+            survivors_found &= simulation.instances[index].position.x == static_cast<f32>(handles[i].slot);
+            handles[kept++] = handles[i];
+        }
+        consistent &= kept == simulation.count;
+        handle_count = kept;
+
+        for(u32 i = 0; i < despawn_count; ++i) {
+            stale_rejected &= !entity_alive(&store, despawned[i]);
+        }
+    }
+
+    // Filling to capacity stops there, and a reset hands out fresh generations to everything.
+    spawn_entities(&store, &simulation, CAPACITY);
+    bool capped = simulation.count == CAPACITY && spawn_entities(&store, &simulation, 1) == CAPACITY && simulation.count == CAPACITY;
+    EntityHandle before_reset = entity_handle(&store, 0);
+    reset_entity_store(&store, &simulation, CAPACITY / 2);
+    bool reset_valid = !entity_alive(&store, before_reset) && entity_alive(&store, entity_handle(&store, 0)) && simulation.count == CAPACITY / 2;
+
+    printf("%u rounds: maps consistent: %s, stale handles rejected: %s, survivors keep their data: %s, slots reused: %s, capacity and reset: %s\n",
+           ENTITY_STORE_VERIFY_ROUNDS, consistent ? "yes" : "NO", stale_rejected ? "yes" : "NO", survivors_found ? "yes" : "NO", slots_reused ? "yes" : "NO",
+           capped && reset_valid ? "yes" : "NO");
+    return consistent && stale_rejected && survivors_found && slots_reused && capped && reset_valid;
+}
+
+static void bench_entity_store() {
+    Bench::print_suite("entity_store");
+
+    OL::Buffer* storage = OL::Buffer::allocate(OL::reserve_size<InstanceData>(ENTITY_STORE_BENCH_CAPACITY, OL::CACHE_LINE_SIZE) * 3 +
+                                               OL::reserve_size<Entity>(ENTITY_STORE_BENCH_CAPACITY, OL::CACHE_LINE_SIZE) * 2 +
+                                               OL::reserve_size<EntityHandle>(ENTITY_STORE_BENCH_CAPACITY) +
+                                               entity_store_memory_size(ENTITY_STORE_BENCH_CAPACITY) + OL::MB(8));
+    assert(storage);
+    bool valid = verify_entity_store(storage);
+
+    Simulation simulation = {
+        .instances = storage->reserve<InstanceData>(ENTITY_STORE_BENCH_CAPACITY, OL::CACHE_LINE_SIZE),
+        .entities = storage->reserve<Entity>(ENTITY_STORE_BENCH_CAPACITY, OL::CACHE_LINE_SIZE),
+        .count = ENTITY_STORE_BENCH_LIVE,
+        .bounds = { .min = { -1.0f, -1.0f }, .max = { 1.0f, 1.0f }, .edge = WorldEdge::WRAP },
+        .previous_instances = storage->reserve<InstanceData>(ENTITY_STORE_BENCH_CAPACITY, OL::CACHE_LINE_SIZE)
+    };
+    EntityHandle* handles = storage->reserve<EntityHandle>(ENTITY_STORE_BENCH_CAPACITY);
+    EntityStore store;
+    bool store_ready = init_entity_store(&store, &simulation, ENTITY_STORE_BENCH_CAPACITY, storage);
+    assert(store_ready);
+    init_entities(&simulation);
+
+    // Each sample spawns a batch on top of the live world and despawns as many entities again, spread evenly from a
+    // random start so the holes land all over the packed range. The world stays at ENTITY_STORE_BENCH_LIVE and the
+    // free list stays in play. Spawning includes filling the new entities' components.
+    OL::Random::Xoshiro256 random = OL::Random::Xoshiro256::seeded(DEFAULT_SIMULATION_SEED);
+    printf("\n%12s %12s %14s %14s %10s\n", "live", "batch", "spawn Mops/s", "despawn Mops/s", "samples");
+    for(u32 batch : ENTITY_STORE_BENCH_BATCHES) {
+        u64 spawn_ns = 0;
+        u64 despawn_ns = 0;
+        u64 rounds = 0;
+        Bench::Measurement measurement = Bench::measure([&]() {
+            OL::Time::Stamp start = OL::Time::Clock::now();
+            u32 first = spawn_entities(&store, &simulation, batch);
+            spawn_random_entities(&simulation, first, simulation.count, random.next());
+            OL::Time::Stamp spawned = OL::Time::Clock::now();
+
+            u32 live = static_cast<u32>(simulation.count);
+            u32 stride = live / batch;
+            u32 offset = static_cast<u32>(random.next() % live);
+            for(u32 i = 0; i < batch; ++i) {
+                handles[i] = entity_handle(&store, (offset + i * stride) % live);
+            }
+            OL::Time::Stamp picked = OL::Time::Clock::now();
+            despawn_entities(&store, &simulation, handles, batch);
+            OL::Time::Stamp despawned = OL::Time::Clock::now();
+
+            spawn_ns += static_cast<u64>(OL::Time::Nanoseconds(spawned - start).count());
+            despawn_ns += static_cast<u64>(OL::Time::Nanoseconds(despawned - picked).count());
+            ++rounds;
+        });
+
+        f64 operations = static_cast<f64>(batch) * static_cast<f64>(rounds);
+        valid &= simulation.count == ENTITY_STORE_BENCH_LIVE;
+        printf("%12zu %12u %14.1f %14.1f %10llu\n", simulation.count, batch, operations / static_cast<f64>(spawn_ns) * 1e3,
+               operations / static_cast<f64>(despawn_ns) * 1e3, static_cast<unsigned long long>(measurement.samples));
+    }
+    valid &= entity_store_links_valid(&store, &simulation);
+
+    // The tick over the store's packed range after all that churn against the same world copied into flat arrays.
+    Simulation flat = simulation;
+    flat.instances = storage->reserve<InstanceData>(simulation.count, OL::CACHE_LINE_SIZE);
+    flat.entities = storage->reserve<Entity>(simulation.count, OL::CACHE_LINE_SIZE);
+    flat.previous_instances = nullptr;
+    memcpy(flat.instances, simulation.instances, sizeof(InstanceData) * simulation.count);
+    memcpy(flat.entities, simulation.entities, sizeof(Entity) * simulation.count);
+    Simulation packed = simulation;
+    packed.previous_instances = nullptr;
+
+    bench_job_system.init();
+    printf("\n%24s %12s %12s %12s\n", "tick", "entities", "best us", "ns/entity");
+    for(OL::JobSystem* jobs : { static_cast<OL::JobSystem*>(nullptr), &bench_job_system }) {
+        for(Simulation* world : { &flat, &packed }) {
+            Bench::Measurement measurement = Bench::measure([&]() {
+                simulation_tick(world, jobs);
+            });
+            Bench::do_not_optimize(world->instances[world->count - 1]);
+            char name[32];
+            snprintf(name, sizeof(name), "%s%s", world == &flat ? "flat arrays" : "store after churn", jobs ? " (jobs)" : "");
+            printf("%24s %12zu %12.1f %12.3f\n", name, world->count, measurement.best_ns * 1e-3, measurement.best_ns / static_cast<f64>(world->count));
+        }
+    }
+    bench_job_system.shutdown();
+
+    printf("valid: %s\n", valid ? "yes" : "NO");
+    OL::Buffer::release(storage);
+}
\ No newline at end of file
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "bench.h"
+#include "bench_jobs.h"
+#include "bench_assets.h"
+
+#include <orshlib/file.h>
+#include <orshlib/memory.h>
+#include <cstring>
+
+// From a SPIR-V blob up to a large pack, around the mapping threshold in between.
+static constexpr size_t FILE_BENCH_SIZES[] = {
+    OL::KB(4),
+    OL::KB(16),
+    OL::KB(64),
+    OL::KB(256),
+    OL::MB(4),
+    OL::MB(64)
+};
+
+static constexpr u32 FILE_BENCH_BATCH_FILES = 32;
+static constexpr size_t FILE_BENCH_BATCH_FILE_SIZE = OL::KB(512);
+
+static constexpr const char* FILE_BENCH_MISSING_PATH = BENCH_OUTPUT_DIRECTORY "bench_file_missing.bin";
+
+static void file_bench_path(char* path, const char* kind, size_t index) {
+    snprintf(path, OL::File::MAX_FILENAME_LENGTH, BENCH_OUTPUT_DIRECTORY "bench_file_%s_%zu.bin", kind, index);
+}
+
+// Bytes that depend on their offset and the file, so a view of the wrong file or offset never compares equal.
+static void fill_file_bench_pattern(u8* data, size_t size, u32 seed) {
+    for(size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<u8>((i * 131 + (i >> 12) * 7 + seed * 29) & 0xFF);
+    }
+}
+
+// Reads one byte per page, what any consumer of a view pays at least once.
+[[nodiscard]] static u64 touch_file_pages(const u8* data, size_t size) {
+    u64 sum = 0;
+    for(size_t offset = 0; offset < size; offset += OL::FILE_PAGE_SIZE) {
+        sum += data[offset];
+    }
+    return sum;
+}
+
+// Both view paths return the written bytes, a failed load leaves its buffer as it was, and a batch hands out every
+// file exactly once, with a null view for a missing one.
+[[nodiscard]] static bool verify_file_reads(OL::Buffer* scratch, const u8* pattern, const char* const* batch_paths, u32 batch_count) {
+    char path[OL::File::MAX_FILENAME_LENGTH];
+    bool views_valid = true;
+    for(size_t size : { OL::KB(4), OL::File::MAPPED_FILE_MIN_SIZE, OL::MB(4) }) {
+        file_bench_path(path, "size", size);
+        OL::BufferScope scope(scratch);
+        OL::FileView heap_view, arena_view;
+        bool viewed = OL::File::view(path, &heap_view) && OL::File::view(path, &arena_view, scratch);
+        views_valid &= viewed && heap_view.size == size && memcmp(heap_view.data, pattern, size) == 0 && memcmp(arena_view.data, pattern, size) == 0 &&
+                       heap_view.mapped() == (size >= OL::File::MAPPED_FILE_MIN_SIZE);
+        heap_view.release();
+        arena_view.release();
+    }
+
+    OL::Logger::LogLevel level = OL::Logger::logger_level;
+    OL::Logger::logger_level = OL::Logger::LEVEL_SILENT;
+    size_t allocated = scratch->allocated;
+    OL::FileView missing_view;
+    file_bench_path(path, "size", OL::MB(4));
+    OL::Buffer* tiny = OL::Buffer::allocate(OL::KB(64));
+    bool failures_clean = !OL::File::load(FILE_BENCH_MISSING_PATH, scratch) && scratch->allocated == allocated && !OL::File::load(path, tiny) &&
+                          tiny->allocated == 0 && !OL::File::view(FILE_BENCH_MISSING_PATH, &missing_view) && missing_view.data == nullptr;
+    OL::Buffer::release(tiny);
+
+    static OL::FileReadBatch batch;
+    const char* paths[FILE_BENCH_BATCH_FILES + 1];
+    OL::FileView views[FILE_BENCH_BATCH_FILES + 1];
+    memcpy(paths, batch_paths, sizeof(const char*) * batch_count);
+    paths[batch_count] = FILE_BENCH_MISSING_PATH;
+    bool started = OL::start_file_read_batch(&batch, &bench_job_system, paths, views, batch_count + 1);
+    u32 seen[FILE_BENCH_BATCH_FILES + 1] = {};
+    u32 file_index;
+    bool batch_valid = started;
+    while(started && OL::next_file_read(&batch, &bench_job_system, &file_index)) {
+        ++seen[file_index];
+        if(file_index < batch_count) {
+            u8 first[64];
+            fill_file_bench_pattern(first, sizeof(first), file_index + 1);
+            batch_valid &= views[file_index].size == FILE_BENCH_BATCH_FILE_SIZE && memcmp(views[file_index].data, first, sizeof(first)) == 0;
+        } else {
+            batch_valid &= views[file_index].data == nullptr;
+        }
+        views[file_index].release();
+    }
+    OL::Logger::logger_level = level;
+    for(u32 i = 0; i <= batch_count; ++i) {
+        batch_valid &= seen[i] == 1;
+    }
+
+    printf("views match the file: %s, failed loads leave nothing behind: %s, batch hands out every file once: %s\n", views_valid ? "yes" : "NO",
+           failures_clean ? "yes" : "NO", batch_valid ? "yes" : "NO");
+    return views_valid && failures_clean && batch_valid;
+}
+
+static void bench_file() {
+    Bench::print_suite("file");
+    if(!Bench::prepare_output_directory()) {
+        return;
+    }
+
+    size_t max_size = 0;
+    for(size_t size : FILE_BENCH_SIZES) {
+        max_size = size > max_size ? size : max_size;
+    }
+
+    OL::Buffer* pattern_buffer = OL::Buffer::allocate(max_size);
+    OL::Buffer* scratch = OL::Buffer::allocate(max_size * 2 + OL::KB(64));
+    assert(pattern_buffer && scratch);
+    u8* pattern = pattern_buffer->reserve(max_size);
+    fill_file_bench_pattern(pattern, max_size, 0);
+
+    char path[OL::File::MAX_FILENAME_LENGTH];
+    for(size_t size : FILE_BENCH_SIZES) {
+        file_bench_path(path, "size", size);
+        if(OL::File::write_to_file(path, pattern_buffer, 0, size) != size) {
+            printf("Skipped, unable to write %s.\n", path);
+            return;
+        }
+    }
+
+    char batch_path_storage[FILE_BENCH_BATCH_FILES][OL::File::MAX_FILENAME_LENGTH];
+    const char* batch_paths[FILE_BENCH_BATCH_FILES];
+    OL::Buffer* batch_buffer = OL::Buffer::allocate(FILE_BENCH_BATCH_FILE_SIZE);
+    assert(batch_buffer);
+    u8* batch_data = batch_buffer->reserve(FILE_BENCH_BATCH_FILE_SIZE);
+    for(u32 i = 0; i < FILE_BENCH_BATCH_FILES; ++i) {
+        file_bench_path(batch_path_storage[i], "batch", i);
+        batch_paths[i] = batch_path_storage[i];
+        fill_file_bench_pattern(batch_data, FILE_BENCH_BATCH_FILE_SIZE, i + 1);
+        if(OL::File::write_to_file(batch_paths[i], batch_buffer, 0, FILE_BENCH_BATCH_FILE_SIZE) != FILE_BENCH_BATCH_FILE_SIZE) {
+            printf("Skipped, unable to write %s.\n", batch_paths[i]);
+            return;
+        }
+    }
+
+    bench_job_system.init();
+    bool valid = verify_file_reads(scratch, pattern, batch_paths, FILE_BENCH_BATCH_FILES);
+
+    auto report = [](const char* name, size_t size, Bench::Measurement measurement) {
+        f64 mb_per_second = static_cast<f64>(size) / OL::MB(1) / (measurement.best_ns * 1e-9);
+        printf("%22s %10zu %12.2f %12.2f %10.1f\n", name, size / OL::KB(1), measurement.best_ns * 1e-3, measurement.mean_ns * 1e-3, mb_per_second);
+    };
+
+    // Warm page cache throughout, so this is the cost of the load path itself: copying against mapping.
+    printf("\n%22s %10s %12s %12s %10s\n", "path", "KB", "best us", "mean us", "MB/s");
+    u64 sink = 0;
+    for(size_t size : FILE_BENCH_SIZES) {
+        file_bench_path(path, "size", size);
+        report("File::load", size, Bench::measure([&]() {
+            OL::BufferScope scope(scratch);
+            OL::File* file = OL::File::load(path, scratch);
+            sink += file ? touch_file_pages(file->data(), file->size()) : 0;
+        }));
+        report("mapped + touched", size, Bench::measure([&]() {
+            OL::MappedFile mapped;
+            if(OL::MappedFile::map(path, &mapped)) {
+                sink += touch_file_pages(mapped.data, mapped.size);
+                mapped.unmap();
+            }
+        }));
+        report("File::view", size, Bench::measure([&]() {
+            OL::FileView view;
+            if(OL::File::view(path, &view)) {
+                sink += touch_file_pages(view.data, view.size);
+                view.release();
+            }
+        }));
+    }
+    Bench::do_not_optimize(sink);
+
+    // The same files one after another on the calling thread against one job per file. The cold rows include the
+    // evictions, treat them as an upper bound.
+    static OL::FileReadBatch batch;
+    OL::FileView views[FILE_BENCH_BATCH_FILES];
+    size_t batch_bytes = FILE_BENCH_BATCH_FILE_SIZE * FILE_BENCH_BATCH_FILES;
+    auto read_serial = [&]() {
+        for(u32 i = 0; i < FILE_BENCH_BATCH_FILES; ++i) {
+            if(OL::File::view(batch_paths[i], &views[i])) {
+                sink += touch_file_pages(views[i].data, views[i].size);
+                views[i].release();
+            }
+        }
+    };
+    auto read_batch = [&]() {
+        bool started = OL::start_file_read_batch(&batch, &bench_job_system, batch_paths, views, FILE_BENCH_BATCH_FILES);
+        assert(started);
+        u32 file_index;
+        while(OL::next_file_read(&batch, &bench_job_system, &file_index)) {
+            sink += touch_file_pages(views[file_index].data, views[file_index].size);
+            views[file_index].release();
+        }
+    };
+    auto evict_batch = [&]() {
+        for(u32 i = 0; i < FILE_BENCH_BATCH_FILES; ++i) {
+            evict_from_page_cache(batch_paths[i]);
+        }
+    };
+
+    char batch_name[32];
+    snprintf(batch_name, sizeof(batch_name), "batch (%u thr) warm", bench_job_system.thread_count());
+    printf("\n%u files of %zu KB\n", FILE_BENCH_BATCH_FILES, FILE_BENCH_BATCH_FILE_SIZE / OL::KB(1));
+    report("serial views warm", batch_bytes, Bench::measure(read_serial));
+    report(batch_name, batch_bytes, Bench::measure(read_batch));
+    report("serial views cold", batch_bytes, Bench::measure([&]() {
+        evict_batch();
+        read_serial();
+    }));
+    snprintf(batch_name, sizeof(batch_name), "batch (%u thr) cold", bench_job_system.thread_count());
+    report(batch_name, batch_bytes, Bench::measure([&]() {
+        evict_batch();
+        read_batch();
+    }));
+    Bench::do_not_optimize(sink);
+    bench_job_system.shutdown();
+
+    printf("valid: %s\n", valid ? "yes" : "NO");
+    OL::Buffer::release(batch_buffer);
+    OL::Buffer::release(scratch);
+    OL::Buffer::release(pattern_buffer);
+}
\ No newline at end of file
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "bench.h"
+#include "bench_jobs.h"
+#include "culling.h"
+#include "instance_format.h"
+
+#include <orshlib/memory.h>
+#include <cmath>
+#include <random>
+
+static constexpr size_t INSTANCE_FORMAT_BENCH_SIZES[] = {
+    MAX_ENTITIES,
+    1'000'000,
+    5'000'000
+};
+
+static constexpr InstanceFormat INSTANCE_FORMATS[] = {
+    InstanceFormat::FULL,
+    InstanceFormat::COMPACT
+};
+
+[[nodiscard]] static const char* instance_format_to_string(InstanceFormat format) {
+    return format == InstanceFormat::COMPACT ? "compact" : "full";
+}
+
+// Uniform positions plus the values rounding and clamping care about: the edges, zero, exact half steps and
+// out-of-range positions.
+static void fill_instance_format_positions(InstanceData* instances, size_t count) {
+    std::mt19937 random(5);
+    std::uniform_real_distribution<f32> coordinate(-1.0f, 1.0f);
+    for(size_t i = 0; i < count; ++i) {
+        instances[i].position = { coordinate(random), coordinate(random) };
+    }
+
+    static constexpr f32 EDGE_VALUES[] = { -1.0f, 1.0f, 0.0f, -0.0f, 1.5f, -1.5f, 1e-30f, -1e-30f };
+    size_t edge_count = OL::array_count(EDGE_VALUES);
+    for(size_t i = 0; i < edge_count && i < count; ++i) {
+        instances[i].position = { EDGE_VALUES[i], EDGE_VALUES[edge_count - 1 - i] };
+    }
+    for(size_t i = edge_count; i < count && i < edge_count + 1024; ++i) {
+        f32 half_step = (static_cast<f32>(i) - 512.0f + 0.5f) / COMPACT_POSITION_SCALE;
+        instances[i].position = { half_step, -half_step };
+    }
+}
+
+// Largest decode(encode(x)) - x over positions inside [-1, 1], in f64 so the measurement adds no error of its own.
+[[nodiscard]] static f64 compact_position_error(const InstanceData* instances, const CompactInstanceData* encoded, size_t count) {
+    f64 max_error = 0.0;
+    for(size_t i = 0; i < count; ++i) {
+        const f32* position = &instances[i].position.x;
+        for(u32 axis = 0; axis < 2; ++axis) {
+            if(position[axis] < -1.0f || position[axis] > 1.0f) {
+                continue;
+            }
+            f64 error = fabs(static_cast<f64>(decode_compact_position(encoded[i].position[axis])) - static_cast<f64>(position[axis]));
+            max_error = error > max_error ? error : max_error;
+        }
+    }
+    return max_error;
+}
+
+static void bench_instance_format() {
+    Bench::print_suite("instance_format");
+
+    size_t max_count = 0;
+    for(size_t count : INSTANCE_FORMAT_BENCH_SIZES) {
+        max_count = count > max_count ? count : max_count;
+    }
+
+    OL::Buffer* storage = OL::Buffer::allocate(sizeof(InstanceData) * max_count * 2 + sizeof(CompactInstanceData) * max_count * 2 +
+                                               instance_culler_memory_size(static_cast<u32>(max_count), 1) * 2);
+    assert(storage);
+    InstanceData* instances = storage->reserve<InstanceData>(max_count);
+    InstanceData* full_output = storage->reserve<InstanceData>(max_count);
+    CompactInstanceData* expected = storage->reserve<CompactInstanceData>(max_count);
+    CompactInstanceData* actual = storage->reserve<CompactInstanceData>(max_count);
+    fill_instance_format_positions(instances, max_count);
+
+    // Odd count so every kernel runs its tail, and every kernel must match scalar exactly.
+    static constexpr size_t VERIFY_COUNT = 1'000'003;
+    encode_instances_scalar(instances, VERIFY_COUNT, expected);
+    f64 max_error = compact_position_error(instances, expected, VERIFY_COUNT);
+    bool clamped = decode_compact_position(expected[4].position[0]) == 1.0f && decode_compact_position(expected[5].position[0]) == -1.0f;
+    printf("max position error %.4g (bound %.4g, %.4f px at 1920 wide), out of range clamps: %s\n", max_error, static_cast<f64>(COMPACT_POSITION_MAX_ERROR),
+           max_error / (2.0 / 1920.0), clamped ? "yes" : "NO");
+
+    printf("\n%8s %12s %12s %14s %12s %8s\n", "kernel", "instances", "best us", "Minstances/s", "GB/s out", "valid");
+    for(s32 level_index = 0; level_index < static_cast<s32>(OL::SIMD::Level::MAX_COUNT); ++level_index) {
+        OL::SIMD::Level level = static_cast<OL::SIMD::Level>(level_index);
+        const char* level_name = OL::SIMD::level_to_string(level);
+        if(!OL::SIMD::supported(level)) {
+            printf("%8s unsupported on this CPU\n", level_name);
+            continue;
+        }
+
+        InstanceEncodeKernel kernel = instance_encode_kernel(level);
+        kernel(instances, VERIFY_COUNT, actual);
+        bool valid = memcmp(expected, actual, sizeof(CompactInstanceData) * VERIFY_COUNT) == 0 && max_error <= COMPACT_POSITION_MAX_ERROR && clamped;
+
+        for(size_t count : INSTANCE_FORMAT_BENCH_SIZES) {
+            Bench::Measurement measurement = Bench::measure([&]() {
+                kernel(instances, count, actual);
+            });
+            Bench::do_not_optimize(actual[count - 1]);
+
+            f64 instances_per_second = static_cast<f64>(count) / (measurement.best_ns * 1e-9);
+            printf("%8s %12zu %12.1f %14.1f %12.2f %8s\n", level_name, count, measurement.best_ns * 1e-3, instances_per_second * 1e-6,
+                   instances_per_second * sizeof(CompactInstanceData) * 1e-9, valid ? "yes" : "NO");
+        }
+    }
+
+    // The client's whole path, cull plus write, with everything visible so only the layout differs.
+    bench_job_system.init();
+    InstanceCuller cullers[2];
+    for(u32 i = 0; i < OL::array_count(INSTANCE_FORMATS); ++i) {
+        bool initialized = init_instance_culler(&cullers[i], static_cast<u32>(max_count), 1, storage, INSTANCE_FORMATS[i]);
+        assert(initialized);
+    }
+
+    printf("\n%8s %12s %9s %12s %14s\n", "format", "instances", "threads", "best us", "upload MB");
+    for(size_t count : INSTANCE_FORMAT_BENCH_SIZES) {
+        for(u32 i = 0; i < OL::array_count(INSTANCE_FORMATS); ++i) {
+            void* destination = INSTANCE_FORMATS[i] == InstanceFormat::COMPACT ? static_cast<void*>(actual) : static_cast<void*>(full_output);
+            for(OL::JobSystem* jobs : { static_cast<OL::JobSystem*>(nullptr), &bench_job_system }) {
+                CullRange range = { .begin = 0, .end = static_cast<u32>(count), .extent = { 0.1f, 0.1f } };
+                ViewBounds view = { .min = { -1.0f, -1.0f }, .max = { 1.0f, 1.0f } };
+                u32 total = 0;
+                Bench::Measurement measurement = Bench::measure([&]() {
+                    total = cull_instances(&cullers[i], instances, &range, 1, view, destination, jobs);
+                });
+                Bench::do_not_optimize(total);
+
+                u32 threads = jobs ? jobs->thread_count() : 1;
+                f64 upload_mb = static_cast<f64>(instance_stride(INSTANCE_FORMATS[i])) * total / OL::MB(1);
+                printf("%8s %12zu %9u %12.1f %14.2f\n", instance_format_to_string(INSTANCE_FORMATS[i]), count, threads, measurement.best_ns * 1e-3, upload_mb);
+            }
+        }
+    }
+    bench_job_system.shutdown();
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "bench.h"
+#include "bench_jobs.h"
+#include "simulation.h"
+
+#include <orshlib/memory.h>
+#include <orshlib/time.h>
+#include <cstring>
+
+static constexpr size_t INTERPOLATION_BENCH_SIZES[] = {
+    100'000,
+    MAX_ENTITIES,
+    1'000'000,
+    5'000'000
+};
+
+static constexpr u32 INTERPOLATION_VERIFY_TICKS = 16;
+static constexpr f32 INTERPOLATION_VERIFY_ALPHAS[] = { 0.0f, 0.25f, 0.5f, 0.999f };
+
+// Previous and current positions are read, the interpolated ones written.
+static constexpr size_t INTERPOLATION_BYTES_PER_ENTITY = sizeof(InstanceData) * 3;
+
+// Every kernel must match scalar exactly at every alpha, and a value that jumped further than max_step must land on
+// its new value rather than somewhere in between.
+[[nodiscard]] static bool verify_lerp_kernel(OL::SIMD::LerpF32Kernel kernel, const f32* a, const f32* b, f32* expected, f32* actual, size_t count) {
+    for(f32 alpha : INTERPOLATION_VERIFY_ALPHAS) {
+        OL::SIMD::lerp_f32_scalar(expected, a, b, alpha, 1.0f, count);
+        kernel(actual, a, b, alpha, 1.0f, count);
+        if(memcmp(expected, actual, sizeof(f32) * count) != 0) {
+            return false;
+        }
+    }
+
+    f32 from[] = { -0.99f, 0.99f, 0.5f, -0.25f, 0.0f };
+    f32 to[] = { 0.99f, -0.99f, 0.6f, -0.35f, 0.0f };
+    f32 result[OL::array_count(from)];
+    kernel(result, from, to, 0.5f, 1.0f, OL::array_count(from));
+    return result[0] == to[0] && result[1] == to[1] && result[2] > from[2] && result[2] < to[2] && result[3] < from[3] && result[3] > to[3] && result[4] == 0.0f;
+}
+
+// A double-buffered tick has to move the world exactly like the in-place one, and leave the tick before it behind.
+[[nodiscard]] static bool verify_double_buffered_tick(const Simulation* initial, OL::Buffer* storage) {
+    size_t count = initial->count;
+    OL::BufferScope scope(storage);
+    Simulation single = *initial;
+    single.instances = storage->reserve<InstanceData>(count);
+    single.previous_instances = nullptr;
+    Simulation buffered = *initial;
+    buffered.instances = storage->reserve<InstanceData>(count);
+    buffered.previous_instances = storage->reserve<InstanceData>(count);
+    InstanceData* last = storage->reserve<InstanceData>(count);
+    memcpy(single.instances, initial->instances, sizeof(InstanceData) * count);
+    memcpy(buffered.instances, initial->instances, sizeof(InstanceData) * count);
+    memcpy(buffered.previous_instances, initial->instances, sizeof(InstanceData) * count);
+
+    for(u32 tick = 0; tick < INTERPOLATION_VERIFY_TICKS; ++tick) {
+        memcpy(last, single.instances, sizeof(InstanceData) * count);
+        simulation_tick(&single);
+        simulation_tick(&buffered);
+    }
+
+    return memcmp(single.instances, buffered.instances, sizeof(InstanceData) * count) == 0 &&
+           memcmp(last, buffered.previous_instances, sizeof(InstanceData) * count) == 0;
+}
+
+// A 60 Hz step fed steady 144 Hz frames ticks on schedule. A second-long stall runs the cap and drops the rest,
+// alpha always stays in [0, 1), and the phase within a step survives the drop.
+[[nodiscard]] static bool verify_fixed_timestep() {
+    OL::FixedTimestep timestep = { .step = OL::FixedTimestep::from_rate(60), .max_steps_per_frame = 4 };
+    bool alpha_in_range = true;
+    u32 steady_ticks = 0;
+    for(u32 frame = 0; frame < 144; ++frame) {
+        steady_ticks += timestep.advance(OL::Time::Duration(OL::Time::Seconds(1)) / 144);
+        f32 alpha = timestep.alpha();
+        alpha_in_range &= alpha >= 0.0f && alpha < 1.0f;
+    }
+    bool steady = steady_ticks >= 59 && steady_ticks <= 60 && timestep.dropped_steps == 0;
+
+    OL::Time::Duration phase = timestep.accumulator;
+    u32 stall_ticks = timestep.advance(timestep.step * 60);
+    bool capped = stall_ticks == 4 && timestep.dropped_steps == 56 && timestep.accumulator == phase && timestep.alpha() < 1.0f;
+
+    printf("60 Hz over 144 frames: %u ticks, 60 step stall: %u ticks, %llu dropped, alpha in [0, 1): %s\n", steady_ticks, stall_ticks,
+           static_cast<unsigned long long>(timestep.dropped_steps), alpha_in_range ? "yes" : "NO");
+    return steady && capped && alpha_in_range;
+}
+
+static void bench_interpolation() {
+    Bench::print_suite("interpolation");
+
+    size_t max_count = 0;
+    for(size_t count : INTERPOLATION_BENCH_SIZES) {
+        max_count = count > max_count ? count : max_count;
+    }
+
+    OL::Buffer* storage = OL::Buffer::allocate(OL::reserve_size<InstanceData>(max_count) * 3 + OL::reserve_size<Entity>(max_count));
+    OL::Buffer* verify_storage = OL::Buffer::allocate(OL::reserve_size<InstanceData>(max_count) * 4);
+    assert(storage && verify_storage);
+
+    Simulation simulation = {
+        .instances = storage->reserve<InstanceData>(max_count),
+        .entities = storage->reserve<Entity>(max_count),
+        .count = max_count,
+        .bounds = { .min = { -1.0f, -1.0f }, .max = { 1.0f, 1.0f }, .edge = WorldEdge::WRAP },
+        .previous_instances = storage->reserve<InstanceData>(max_count)
+    };
+    InstanceData* output = storage->reserve<InstanceData>(max_count);
+    init_entities(&simulation);
+
+    Simulation verify_simulation = simulation;
+    verify_simulation.count = 100'003;
+    bool tick_valid = verify_double_buffered_tick(&verify_simulation, verify_storage);
+    bool timestep_valid = verify_fixed_timestep();
+
+    // A few hundred ticks at the default speed so some entities have wrapped and the last tick holds real jumps.
+    for(u32 tick = 0; tick < 512; ++tick) {
+        simulation_tick(&simulation);
+    }
+
+    // Odd count so every kernel runs its remainder path.
+    static constexpr size_t VERIFY_COUNT = 200'007;
+    f32* expected = &verify_storage->reserve<InstanceData>(VERIFY_COUNT / 2 + 1)->position.x;
+    f32* actual = &verify_storage->reserve<InstanceData>(VERIFY_COUNT / 2 + 1)->position.x;
+    const f32* previous = &simulation.previous_instances[0].position.x;
+    const f32* current = &simulation.instances[0].position.x;
+
+    printf("double-buffered tick matches in place: %s\n", tick_valid ? "yes" : "NO");
+    printf("\n%8s %12s %9s %12s %12s %12s %8s\n", "kernel", "entities", "threads", "best us", "ns/entity", "GB/s", "valid");
+    for(s32 level_index = 0; level_index < static_cast<s32>(OL::SIMD::Level::MAX_COUNT); ++level_index) {
+        OL::SIMD::Level level = static_cast<OL::SIMD::Level>(level_index);
+        const char* level_name = OL::SIMD::level_to_string(level);
+        if(!OL::SIMD::supported(level)) {
+            printf("%8s unsupported on this CPU\n", level_name);
+            continue;
+        }
+
+        OL::SIMD::LerpF32Kernel kernel = OL::SIMD::lerp_f32_kernel(level);
+        bool valid = verify_lerp_kernel(kernel, previous, current, expected, actual, VERIFY_COUNT) && tick_valid && timestep_valid;
+
+        for(size_t count : INTERPOLATION_BENCH_SIZES) {
+            Simulation view = simulation;
+            view.count = count;
+            Bench::Measurement measurement = Bench::measure([&]() {
+                interpolate_instances(&view, 0.5f, output, nullptr, kernel);
+            });
+            Bench::do_not_optimize(output[count - 1]);
+
+            f64 seconds = measurement.best_ns * 1e-9;
+            printf("%8s %12zu %9u %12.1f %12.3f %12.2f %8s\n", level_name, count, 1u, measurement.best_ns * 1e-3, measurement.best_ns / static_cast<f64>(count),
+                   static_cast<f64>(INTERPOLATION_BYTES_PER_ENTITY * count) / seconds * 1e-9, valid ? "yes" : "NO");
+        }
+    }
+
+    // The client's path: the best kernel spread over the job system.
+    bench_job_system.init();
+    printf("\n%12s %9s %12s %12s\n", "entities", "threads", "best us", "ns/entity");
+    for(size_t count : INTERPOLATION_BENCH_SIZES) {
+        Simulation view = simulation;
+        view.count = count;
+        Bench::Measurement measurement = Bench::measure([&]() {
+            interpolate_instances(&view, 0.5f, output, &bench_job_system);
+        });
+        Bench::do_not_optimize(output[count - 1]);
+        printf("%12zu %9u %12.1f %12.3f\n", count, bench_job_system.thread_count(), measurement.best_ns * 1e-3, measurement.best_ns / static_cast<f64>(count));
+    }
+    bench_job_system.shutdown();
+
+    OL::Buffer::release(verify_storage);
+    OL::Buffer::release(storage);
+}
\ No newline at end of file
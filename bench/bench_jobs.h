@@ -0,0 +1,91 @@
+#pragma once
+
+#include "bench.h"
+#include "simulation.h"
+
+#include <orshlib/jobs.h>
+#include <orshlib/memory.h>
+
+static constexpr size_t JOBS_BENCH_SIZES[] = {
+    MAX_ENTITIES,
+    2'000'000,
+    10'000'000
+};
+
+static OL::JobSystem bench_job_system;
+
+// 1, 2, 4, ... up to the hardware thread count, always ending on the hardware thread count itself.
+[[nodiscard]] static u32 next_thread_count(u32 threads, u32 hardware_threads) {
+    if(threads >= hardware_threads) {
+        return 0;
+    }
+    return threads * 2 < hardware_threads ? threads * 2 : hardware_threads;
+}
+
+static void bench_jobs() {
+    Bench::print_suite("jobs");
+
+    u32 hardware_threads = std::thread::hardware_concurrency();
+    hardware_threads = hardware_threads > 0 ? hardware_threads : 1;
+
+    size_t max_count = 0;
+    for(size_t count : JOBS_BENCH_SIZES) {
+        max_count = count > max_count ? count : max_count;
+    }
+
+    // Extra line so the arrays can be pushed onto a cache line boundary, like the static arrays in main.cpp.
+    OL::Buffer* storage = OL::Buffer::allocate(sizeof(InstanceData) * max_count * 2 + sizeof(Entity) * max_count + OL::CACHE_LINE_SIZE * 2);
+    assert(storage);
+    auto align_line = [](void* pointer) {
+        uintptr_t address = reinterpret_cast<uintptr_t>(pointer);
+        return reinterpret_cast<void*>((address + OL::CACHE_LINE_SIZE - 1) & ~(OL::CACHE_LINE_SIZE - 1));
+    };
+    InstanceData* instances = static_cast<InstanceData*>(align_line(storage->data));
+    Entity* entities = static_cast<Entity*>(align_line(instances + max_count));
+    InstanceData* expected = reinterpret_cast<InstanceData*>(entities + max_count);
+
+    Simulation simulation = {
+        .instances = instances,
+        .entities = entities,
+        .count = max_count
+    };
+    init_entities(&simulation);
+
+    printf("%8s %12s %12s %10s %12s %14s\n", "threads", "entities", "best us", "speedup", "efficiency", "Mentities/s");
+    for(size_t count : JOBS_BENCH_SIZES) {
+        simulation.count = count;
+        f64 single_thread_ns = 0.0;
+
+        for(u32 threads = 1; threads != 0; threads = next_thread_count(threads, hardware_threads)) {
+            bench_job_system.init(threads - 1);
+
+            memcpy(expected, instances, sizeof(InstanceData) * count);
+            simulation_tick(&simulation, &bench_job_system);
+            integrate_positions(expected, entities, count);
+            if(memcmp(expected, instances, sizeof(InstanceData) * count) != 0) {
+                printf("%8u %12zu MISMATCH against the single threaded tick\n", threads, count);
+            }
+
+            Bench::Measurement measurement = Bench::measure([&]() {
+                simulation_tick(&simulation, &bench_job_system);
+            });
+            Bench::do_not_optimize(instances[count - 1]);
+            bench_job_system.shutdown();
+
+            if(threads == 1) {
+                single_thread_ns = measurement.best_ns;
+            }
+            f64 speedup = single_thread_ns / measurement.best_ns;
+            f64 entities_per_second = static_cast<f64>(count) / (measurement.best_ns * 1e-9);
+            printf("%8u %12zu %12.1f %9.2fx %11.0f%% %14.1f\n", threads, count, measurement.best_ns * 1e-3, speedup, speedup / threads * 100.0, entities_per_second * 1e-6);
+        }
+    }
+
+    // Fixed cost of fanning out and joining a full set of empty jobs.
+    bench_job_system.init();
+    Bench::Measurement overhead = Bench::measure([&]() {
+        bench_job_system.parallel_for(0, OL::JobSystem::MAX_JOBS_PER_PARALLEL_FOR, 1, [](size_t, size_t) {});
+    });
+    printf("parallel_for of %u empty jobs on %u threads: %.2f us (%.0f ns/job)\n", OL::JobSystem::MAX_JOBS_PER_PARALLEL_FOR, bench_job_system.thread_count(), overhead.best_ns * 1e-3, overhead.best_ns / OL::JobSystem::MAX_JOBS_PER_PARALLEL_FOR);
+    bench_job_system.shutdown();
+}
\ No newline at end of file
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "bench.h"
+#include "bench_jobs.h"
+
+#include <orshlib/log.h>
+#include <orshlib/session.h>
+#include <cstring>
+
+static constexpr u32 LOGGER_BENCH_MESSAGES = 100'000;
+static constexpr u32 LOGGER_BENCH_MESSAGES_PER_JOB = 1'000;
+static constexpr size_t LOGGER_BENCH_SMALL_RING = 1 << 12;
+// Holds the whole latency burst, so callers are timed on pushes alone and never wait for the writer.
+static constexpr size_t LOGGER_BENCH_LARGE_RING = 1 << 23;
+
+// The whole of a file written by the logger, NUL terminated. The caller frees it.
+[[nodiscard]] static char* read_log_output(FILE* stream, size_t* length) {
+    fflush(stream);
+    fseek(stream, 0, SEEK_END);
+    *length = static_cast<size_t>(ftell(stream));
+    rewind(stream);
+    char* text = static_cast<char*>(malloc(*length + 1));
+    assert(text);
+    *length = fread(text, 1, *length, stream);
+    text[*length] = '\0';
+    return text;
+}
+
+[[nodiscard]] static u32 count_log_lines(const char* text, const char* prefix) {
+    u32 count = 0;
+    size_t prefix_length = strlen(prefix);
+    for(const char* line = text; *line; ) {
+        count += strncmp(line, prefix, prefix_length) == 0;
+        const char* end = strchr(line, '\n');
+        line = end ? end + 1 : line + strlen(line);
+    }
+    return count;
+}
+
+// Records must come out exactly as the synchronous path formats them, strings copied at the call even though the
+// caller's buffer changes right after, and each thread's messages in the order it logged them.
+[[nodiscard]] static bool verify_async_output() {
+    FILE* expected_stream = tmpfile();
+    FILE* actual_stream = tmpfile();
+    assert(expected_stream && actual_stream);
+
+    bool started = OL::Logger::start_async(OL::Logger::OverflowPolicy::BLOCK, actual_stream);
+    assert(started);
+    char name[32];
+    for(u32 i = 0; i < 1000; ++i) {
+        snprintf(name, sizeof(name), "entity_%u", i);
+        OL::Logger::log("[verify] %s at %.3f, %zu bytes, %d%%", name, i * 0.25, static_cast<size_t>(i) * 3, -static_cast<s32>(i));
+        OL::Logger::log_sync(expected_stream, OL::Logger::logger_level, "[verify] %s at %.3f, %zu bytes, %d%%", name, i * 0.25, static_cast<size_t>(i) * 3, -static_cast<s32>(i));
+        memset(name, 'x', sizeof(name) - 1);
+    }
+    OL::Logger::log(OL::Logger::LEVEL_ERROR, "[verify] no arguments");
+    OL::Logger::log_sync(expected_stream, OL::Logger::LEVEL_ERROR, "[verify] no arguments");
+    // No flush(): an error is out, after everything logged before it, by the time log() returns.
+
+    size_t expected_length = 0;
+    size_t actual_length = 0;
+    char* expected = read_log_output(expected_stream, &expected_length);
+    char* actual = read_log_output(actual_stream, &actual_length);
+    bool matches = expected_length == actual_length && memcmp(expected, actual, expected_length) == 0;
+    free(expected);
+    free(actual);
+
+    // Job threads each log a numbered run, which must arrive complete and in order per thread.
+    bench_job_system.init();
+    u32 jobs = bench_job_system.thread_count() * 4;
+    bench_job_system.parallel_for(0, jobs, 1, [](size_t begin, size_t end) {
+        for(size_t job = begin; job < end; ++job) {
+            for(u32 i = 0; i < LOGGER_BENCH_MESSAGES_PER_JOB; ++i) {
+                OL::Logger::log("[job] %zu %u", job, i);
+            }
+        }
+    });
+    bench_job_system.shutdown();
+    OL::Logger::stop_async();
+
+    actual = read_log_output(actual_stream, &actual_length);
+    bool ordered = count_log_lines(actual, "[Debug][job]") == jobs * LOGGER_BENCH_MESSAGES_PER_JOB;
+    u32* next = static_cast<u32*>(calloc(jobs, sizeof(u32)));
+    for(const char* line = strstr(actual, "[Debug][job]"); line; line = strstr(line + 1, "[Debug][job]")) {
+        size_t job = 0;
+        u32 index = 0;
+        ordered &= sscanf(line, "[Debug][job] %zu %u", &job, &index) == 2 && job < jobs && next[job]++ == index;
+    }
+    free(next);
+    free(actual);
+
+    fclose(expected_stream);
+    fclose(actual_stream);
+    return matches && ordered;
+}
+
+// A burst into a tiny ring: DROP accounts for every message it loses, BLOCK loses none.
+[[nodiscard]] static bool verify_overflow_policy(OL::Logger::OverflowPolicy policy, u64* dropped) {
+    FILE* stream = tmpfile();
+    assert(stream);
+    bool started = OL::Logger::start_async(policy, stream, LOGGER_BENCH_SMALL_RING);
+    assert(started);
+    for(u32 i = 0; i < LOGGER_BENCH_MESSAGES; ++i) {
+        OL::Logger::log("[burst] %u", i);
+    }
+    *dropped = OL::Logger::async_logger.dropped.load();
+    OL::Logger::stop_async();
+
+    size_t length = 0;
+    char* text = read_log_output(stream, &length);
+    u32 written = count_log_lines(text, "[Debug][burst]");
+    free(text);
+    fclose(stream);
+    return policy == OL::Logger::OverflowPolicy::BLOCK ? written == LOGGER_BENCH_MESSAGES && *dropped == 0 : written + *dropped == LOGGER_BENCH_MESSAGES;
+}
+
+static void print_logger_latency(const char* name, const OL::DurationHistogram& histogram) {
+    OL::DurationPercentiles percentiles = OL::get_percentiles(histogram);
+    printf("%10s %10.0f %10.0f %10.0f %10.0f %12.0f\n", name, static_cast<f64>(percentiles.mean.count()), static_cast<f64>(percentiles.p50.count()),
+           static_cast<f64>(percentiles.p99.count()), static_cast<f64>(percentiles.p999.count()), static_cast<f64>(percentiles.max.count()));
+}
+
+static void bench_logger() {
+    Bench::print_suite("logger");
+
+    bool output_valid = verify_async_output();
+    u64 dropped = 0;
+    bool drop_valid = verify_overflow_policy(OL::Logger::OverflowPolicy::DROP, &dropped);
+    u64 blocked_dropped = 0;
+    bool block_valid = verify_overflow_policy(OL::Logger::OverflowPolicy::BLOCK, &blocked_dropped);
+    printf("async output matches sync: %s, drop policy accounts for %llu of %u: %s, block policy loses none: %s\n", output_valid ? "yes" : "NO",
+           static_cast<unsigned long long>(dropped), LOGGER_BENCH_MESSAGES, drop_valid ? "yes" : "NO", block_valid ? "yes" : "NO");
+
+    // What the calling thread pays per message. The sync file is line buffered like stdout on a terminal, so every
+    // message is a write call, as it was in the client.
+    static OL::DurationHistogram sync_latency;
+    static OL::DurationHistogram async_latency;
+    FILE* sync_stream = tmpfile();
+    FILE* async_stream = tmpfile();
+    assert(sync_stream && async_stream);
+    setvbuf(sync_stream, nullptr, _IOLBF, BUFSIZ);
+
+    const char* path = "assets/textures/example.png";
+    for(u32 i = 0; i < LOGGER_BENCH_MESSAGES; ++i) {
+        OL::Time::Stamp start = OL::Time::Clock::now();
+        OL::Logger::log_sync(sync_stream, OL::Logger::LEVEL_DEBUG, "[bench] frame %u took %.3f ms loading %s", i, i * 0.001, path);
+        sync_latency.record(OL::Time::Clock::now() - start);
+    }
+
+    bool started = OL::Logger::start_async(OL::Logger::OverflowPolicy::BLOCK, async_stream, LOGGER_BENCH_LARGE_RING, 1);
+    assert(started);
+    for(u32 i = 0; i < LOGGER_BENCH_MESSAGES; ++i) {
+        OL::Time::Stamp start = OL::Time::Clock::now();
+        OL::Logger::log("[bench] frame %u took %.3f ms loading %s", i, i * 0.001, path);
+        async_latency.record(OL::Time::Clock::now() - start);
+    }
+    OL::Time::Stamp flush_start = OL::Time::Clock::now();
+    OL::Logger::stop_async();
+    f64 drain_ms = OL::to_milliseconds(OL::Time::Clock::now() - flush_start);
+
+    printf("\n%10s %10s %10s %10s %10s %12s\n", "path", "mean ns", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+    print_logger_latency("sync", sync_latency);
+    print_logger_latency("async", async_latency);
+    printf("%u messages, writer finished %.2f ms after the last call\n", LOGGER_BENCH_MESSAGES, drain_ms);
+
+    fclose(sync_stream);
+    fclose(async_stream);
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "bench.h"
+
+#include <orshlib/memory.h>
+#include <cstring>
+
+static constexpr size_t MEMORY_BENCH_RESERVATION = OL::GB(16);
+static constexpr size_t MEMORY_BENCH_ALLOCATIONS = 1 << 16;
+static constexpr size_t MEMORY_BENCH_TOUCH_BYTES = OL::MB(64);
+
+struct alignas(OL::CACHE_LINE_SIZE) MemoryBenchLine {
+    u8 bytes[OL::CACHE_LINE_SIZE];
+};
+
+[[nodiscard]] static bool is_aligned(const void* pointer, size_t alignment) {
+    return reinterpret_cast<uintptr_t>(pointer) % alignment == 0;
+}
+
+// Every reservation is aligned no matter what came before it, in malloc'd buffers, virtual arenas and slices.
+[[nodiscard]] static bool verify_buffer_alignment(OL::Buffer* buffer) {
+    bool aligned = true;
+    for(u32 i = 0; i < 64; ++i) {
+        (void)buffer->reserve<u8>(1 + i % 7);
+        aligned &= is_aligned(buffer->reserve<u16>(1), alignof(u16));
+        (void)buffer->reserve<u8>(1);
+        aligned &= is_aligned(buffer->reserve<f64>(3), alignof(f64));
+        (void)buffer->reserve<u8>(1);
+        aligned &= is_aligned(buffer->reserve<MemoryBenchLine>(1), OL::CACHE_LINE_SIZE);
+        (void)buffer->reserve<u8>(1);
+        aligned &= is_aligned(buffer->reserve<u8>(16, 4096), 4096);
+    }
+    return aligned;
+}
+
+// Commit follows allocation in whole granules, markers and scopes rewind without giving memory back, and high water
+// remembers the peak.
+[[nodiscard]] static bool verify_virtual_arena(OL::Buffer* arena) {
+    bool valid = arena->is_virtual && arena->committed == 0 && arena->capacity >= MEMORY_BENCH_RESERVATION;
+
+    u8* first = arena->reserve(100);
+    valid &= first && arena->committed == OL::Buffer::COMMIT_GRANULARITY;
+    memset(first, 0xAB, 100);
+
+    OL::Buffer::Marker marker = arena->mark();
+    u8* large = arena->reserve(OL::MB(3));
+    valid &= large && arena->committed == OL::align_up(100 + OL::MB(3), OL::Buffer::COMMIT_GRANULARITY);
+    memset(large, 0xCD, OL::MB(3));
+    size_t peak = arena->allocated;
+    arena->rewind(marker);
+    valid &= arena->allocated == 100 && arena->high_water == peak && arena->committed >= peak;
+
+    {
+        OL::BufferScope scope(arena);
+        u8* scoped = arena->reserve(OL::MB(1));
+        valid &= scoped == large;
+    }
+    valid &= arena->allocated == 100 && first[99] == 0xAB && arena->bytes_remaining() == arena->capacity - 100;
+
+    arena->reset();
+    valid &= arena->allocated == 0 && arena->high_water == peak;
+    return valid;
+}
+
+static void bench_memory() {
+    Bench::print_suite("memory");
+
+    OL::Buffer* heap = OL::Buffer::allocate(OL::MB(8));
+    OL::Buffer* arena = OL::Buffer::allocate_virtual(MEMORY_BENCH_RESERVATION);
+    assert(heap && arena);
+
+    bool heap_aligned = verify_buffer_alignment(heap);
+    heap->reset();
+    OL::Buffer* slice = OL::Buffer::slice(heap, OL::MB(1) + 3);
+    (void)heap->reserve<u8>(5);
+    bool slice_aligned = verify_buffer_alignment(slice);
+    bool virtual_valid = verify_virtual_arena(arena);
+    bool arena_aligned = verify_buffer_alignment(arena);
+    arena->reset();
+
+    printf("aligned: heap %s, slice %s, virtual %s, commit/rewind/high water: %s\n", heap_aligned ? "yes" : "NO", slice_aligned ? "yes" : "NO",
+           arena_aligned ? "yes" : "NO", virtual_valid ? "yes" : "NO");
+
+    // Bump allocation is the hot path: a frame's worth of small reservations and one rewind.
+    printf("\n%10s %12s %12s\n", "buffer", "reserves", "ns/reserve");
+    for(OL::Buffer* buffer : { heap, arena }) {
+        buffer->reset();
+        Bench::Measurement measurement = Bench::measure([&]() {
+            OL::BufferScope scope(buffer);
+            for(size_t i = 0; i < MEMORY_BENCH_ALLOCATIONS; ++i) {
+                Bench::do_not_optimize(buffer->reserve<u32>(1 + (i & 7)));
+            }
+        });
+        printf("%10s %12zu %12.2f\n", buffer->is_virtual ? "virtual" : "heap", MEMORY_BENCH_ALLOCATIONS, measurement.best_ns / MEMORY_BENCH_ALLOCATIONS);
+    }
+
+    // What growing costs: fresh memory reserved, committed and touched once, against malloc and touch.
+    printf("\n%10s %12s %12s\n", "buffer", "MB touched", "ms");
+    for(bool use_virtual : { false, true }) {
+        Bench::Measurement measurement = Bench::measure([&]() {
+            OL::Buffer* fresh = use_virtual ? OL::Buffer::allocate_virtual(MEMORY_BENCH_RESERVATION) : OL::Buffer::allocate(MEMORY_BENCH_TOUCH_BYTES);
+            for(size_t offset = 0; offset < MEMORY_BENCH_TOUCH_BYTES; offset += OL::Buffer::COMMIT_GRANULARITY) {
+                u8* granule = fresh->reserve(OL::Buffer::COMMIT_GRANULARITY);
+                memset(granule, 1, OL::Buffer::COMMIT_GRANULARITY);
+            }
+            OL::Buffer::release(fresh);
+        });
+        printf("%10s %12zu %12.2f\n", use_virtual ? "virtual" : "heap", MEMORY_BENCH_TOUCH_BYTES / OL::MB(1), measurement.best_ns * 1e-6);
+    }
+
+    arena->log_stats("bench arena");
+    OL::Buffer::release(arena);
+    OL::Buffer::release(heap);
+}
\ No newline at end of file
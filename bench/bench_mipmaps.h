@@ -0,0 +1,197 @@
+#pragma once
+
+#include "bench.h"
+#include "mipmaps.h"
+
+#include <orshlib/memory.h>
+#include <random>
+
+struct MipmapBenchImage {
+    u32 width;
+    u32 height;
+};
+
+static constexpr MipmapBenchImage MIPMAP_BENCH_IMAGES[] = {
+    { 256, 256 },
+    { 1024, 1024 },
+    { 2048, 1024 },
+    { 2048, 2048 }
+};
+
+// Odd and degenerate sizes so the clamped row/column paths and every kernel tail get checked.
+static constexpr MipmapBenchImage MIPMAP_VERIFY_IMAGES[] = {
+    { 1, 1 },
+    { 1, 37 },
+    { 37, 1 },
+    { 3, 5 },
+    { 255, 129 },
+    { 512, 256 }
+};
+
+static constexpr MipmapFlags MIPMAP_VERIFY_FLAGS[] = {
+    MIPMAP_SRGB,
+    MIPMAP_SRGB | MIPMAP_PREMULTIPLIED,
+    MIPMAP_LINEAR,
+    MIPMAP_LINEAR | MIPMAP_PREMULTIPLIED
+};
+
+// Noise with runs of fully transparent and fully opaque texels, which is what the alpha weighting has to get right.
+static void fill_mipmap_bench_image(u8* texels, u32 width, u32 height, u32 seed) {
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<u32> byte(0, 255);
+    for(size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+        u32 alpha_kind = byte(random) % 4;
+        texels[i * 4 + 0] = static_cast<u8>(byte(random));
+        texels[i * 4 + 1] = static_cast<u8>(byte(random));
+        texels[i * 4 + 2] = static_cast<u8>(byte(random));
+        texels[i * 4 + 3] = alpha_kind == 0 ? 0 : (alpha_kind == 1 ? 255 : static_cast<u8>(byte(random)));
+    }
+}
+
+// Straightforward f64 implementation with the exact transfer functions and no tables, one level at a time.
+static void generate_mipmaps_reference(u8* const* levels, u32 width, u32 height, u32 level_count, MipmapFlags flags, f64* current, f64* next) {
+    bool srgb = flags & MIPMAP_SRGB;
+    bool premultiplied = flags & MIPMAP_PREMULTIPLIED;
+
+    for(size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+        f64 alpha = levels[0][i * 4 + 3] / 255.0;
+        for(u32 channel = 0; channel < 3; ++channel) {
+            f64 value = levels[0][i * 4 + channel] / 255.0;
+            value = srgb ? srgb_to_linear(value) : value;
+            current[i * 4 + channel] = premultiplied ? value : value * alpha;
+        }
+        current[i * 4 + 3] = alpha;
+    }
+
+    for(u32 level = 1; level < level_count; ++level) {
+        u32 source_width = mip_dimension(width, level - 1);
+        u32 source_height = mip_dimension(height, level - 1);
+        u32 level_width = mip_dimension(width, level);
+        u32 level_height = mip_dimension(height, level);
+
+        for(u32 y = 0; y < level_height; ++y) {
+            for(u32 x = 0; x < level_width; ++x) {
+                u32 x0 = x * 2, x1 = x0 + 1 < source_width ? x0 + 1 : x0;
+                u32 y0 = y * 2, y1 = y0 + 1 < source_height ? y0 + 1 : y0;
+                f64* output = next + (static_cast<size_t>(y) * level_width + x) * 4;
+                for(u32 channel = 0; channel < 4; ++channel) {
+                    output[channel] = (current[(static_cast<size_t>(y0) * source_width + x0) * 4 + channel] +
+                                       current[(static_cast<size_t>(y0) * source_width + x1) * 4 + channel] +
+                                       current[(static_cast<size_t>(y1) * source_width + x0) * 4 + channel] +
+                                       current[(static_cast<size_t>(y1) * source_width + x1) * 4 + channel]) / 4.0;
+                }
+
+                u8* texel = levels[level] + (static_cast<size_t>(y) * level_width + x) * 4;
+                f64 alpha = output[3];
+                for(u32 channel = 0; channel < 3; ++channel) {
+                    f64 value = premultiplied ? output[channel] : (alpha > 0.0 ? output[channel] / alpha : 0.0);
+                    value = value < 0.0 ? 0.0 : (value > 1.0 ? 1.0 : value);
+                    value = srgb ? linear_to_srgb(value) : value;
+                    texel[channel] = static_cast<u8>(value * 255.0 + 0.5);
+                }
+                texel[3] = static_cast<u8>(alpha * 255.0 + 0.5);
+            }
+        }
+
+        f64* swap = current;
+        current = next;
+        next = swap;
+    }
+}
+
+// Sets up per-level pointers into one back-to-back chain.
+static void mipmap_level_pointers(u8* chain, u32 width, u32 height, u32 level_count, u8** levels) {
+    size_t offset = 0;
+    for(u32 level = 0; level < level_count; ++level) {
+        levels[level] = chain + offset;
+        offset += static_cast<size_t>(mip_dimension(width, level)) * mip_dimension(height, level) * MIP_BYTES_PER_TEXEL;
+    }
+}
+
+static void bench_mipmaps() {
+    Bench::print_suite("mipmaps");
+
+    u32 max_width = 0, max_height = 0;
+    for(const MipmapBenchImage& image : MIPMAP_BENCH_IMAGES) {
+        max_width = image.width > max_width ? image.width : max_width;
+        max_height = image.height > max_height ? image.height : max_height;
+    }
+
+    u32 max_levels = mip_level_count(max_width, max_height);
+    size_t chain_size = mip_chain_size(max_width, max_height, max_levels);
+    OL::Buffer* storage = OL::Buffer::allocate(chain_size * 2 + mip_scratch_size(max_width, max_height) + sizeof(f64) * 4 * max_width * max_height * 2);
+    assert(storage);
+    u8* expected_chain = storage->reserve(chain_size);
+    u8* actual_chain = storage->reserve(chain_size);
+    f32* scratch = storage->reserve<f32>(mip_scratch_size(max_width, max_height) / sizeof(f32));
+    f64* reference_current = storage->reserve<f64>(static_cast<size_t>(max_width) * max_height * 4);
+    f64* reference_next = storage->reserve<f64>(static_cast<size_t>(max_width) * max_height * 4);
+
+    // Against the f64 reference every kernel may be off by one step from the sRGB table's rounding, and every
+    // SIMD level must match the scalar kernels exactly.
+    printf("%8s %10s %10s %14s %12s\n", "kernel", "images", "max error", "vs scalar", "valid");
+    MipmapKernels scalar_kernels = mipmap_kernels(OL::SIMD::Level::SCALAR);
+    for(s32 level_index = 0; level_index < static_cast<s32>(OL::SIMD::Level::MAX_COUNT); ++level_index) {
+        OL::SIMD::Level simd_level = static_cast<OL::SIMD::Level>(level_index);
+        if(!OL::SIMD::supported(simd_level)) {
+            continue;
+        }
+
+        MipmapKernels kernels = mipmap_kernels(simd_level);
+        u32 image_count = 0;
+        u32 max_error = 0;
+        bool identical = true;
+        for(const MipmapBenchImage& image : MIPMAP_VERIFY_IMAGES) {
+            for(MipmapFlags flags : MIPMAP_VERIFY_FLAGS) {
+                u32 level_count = mip_level_count(image.width, image.height);
+                size_t size = mip_chain_size(image.width, image.height, level_count);
+                u8* expected_levels[MAX_MIP_LEVELS];
+                u8* actual_levels[MAX_MIP_LEVELS];
+                mipmap_level_pointers(expected_chain, image.width, image.height, level_count, expected_levels);
+                mipmap_level_pointers(actual_chain, image.width, image.height, level_count, actual_levels);
+
+                fill_mipmap_bench_image(expected_chain, image.width, image.height, image.width * 31 + image.height);
+                memcpy(actual_chain, expected_chain, static_cast<size_t>(image.width) * image.height * MIP_BYTES_PER_TEXEL);
+
+                generate_mipmaps_reference(expected_levels, image.width, image.height, level_count, flags, reference_current, reference_next);
+                generate_mipmaps(kernels, actual_levels, image.width, image.height, level_count, flags, scratch);
+                for(size_t i = 0; i < size; ++i) {
+                    u32 error = expected_chain[i] > actual_chain[i] ? expected_chain[i] - actual_chain[i] : actual_chain[i] - expected_chain[i];
+                    max_error = error > max_error ? error : max_error;
+                }
+
+                generate_mipmaps(scalar_kernels, expected_levels, image.width, image.height, level_count, flags, scratch);
+                identical &= memcmp(expected_chain, actual_chain, size) == 0;
+                ++image_count;
+            }
+        }
+
+        printf("%8s %10u %10u %14s %12s\n", OL::SIMD::level_to_string(simd_level), image_count, max_error, identical ? "identical" : "DIFFERENT", max_error <= 1 && identical ? "yes" : "NO");
+    }
+
+    // Throughput counts level 0 bytes in, which is what a caller has to feed the generator.
+    printf("\n%8s %12s %8s %12s %12s\n", "kernel", "image", "levels", "best ms", "MB/s");
+    for(const MipmapBenchImage& image : MIPMAP_BENCH_IMAGES) {
+        u32 level_count = mip_level_count(image.width, image.height);
+        u8* levels[MAX_MIP_LEVELS];
+        mipmap_level_pointers(actual_chain, image.width, image.height, level_count, levels);
+        fill_mipmap_bench_image(actual_chain, image.width, image.height, 1234);
+        size_t level0_bytes = static_cast<size_t>(image.width) * image.height * MIP_BYTES_PER_TEXEL;
+
+        for(s32 level_index = 0; level_index < static_cast<s32>(OL::SIMD::Level::MAX_COUNT); ++level_index) {
+            OL::SIMD::Level simd_level = static_cast<OL::SIMD::Level>(level_index);
+            if(!OL::SIMD::supported(simd_level)) {
+                continue;
+            }
+
+            MipmapKernels kernels = mipmap_kernels(simd_level);
+            Bench::Measurement measurement = Bench::measure([&]() {
+                generate_mipmaps(kernels, levels, image.width, image.height, level_count, MIPMAP_SRGB, scratch);
+                Bench::do_not_optimize(levels[level_count - 1][0]);
+            });
+
+            f64 mb_per_second = static_cast<f64>(level0_bytes) / OL::MB(1) / (measurement.best_ns * 1e-9);
+            printf("%8s %6ux%-5u %8u %12.3f %12.1f\n", OL::SIMD::level_to_string(simd_level), image.width, image.height, level_count, measurement.best_ns * 1e-6, mb_per_second);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "bench.h"
+#include "bench_jobs.h"
+
+#include <orshlib/profiler.h>
+#include <orshlib/memory.h>
+#include <cstring>
+#include <thread>
+
+static constexpr u32 PROFILER_BENCH_RECORDS = 1 << 12;
+static constexpr u32 PROFILER_BENCH_JOB_ZONES_PER_THREAD = 64;
+static constexpr u32 PROFILER_BENCH_ZONES = 1 << 20;
+
+// What a zone may cost on the hot path, begin and end together. Enabled zones pay two timestamps and one record
+// store, disabled ones a single relaxed load.
+static constexpr f64 PROFILER_ZONE_BUDGET_NS = 50.0;
+static constexpr f64 PROFILER_DISABLED_ZONE_BUDGET_NS = 2.0;
+
+[[nodiscard]] static u32 count_occurrences(const char* text, size_t length, const char* pattern) {
+    u32 count = 0;
+    size_t pattern_length = strlen(pattern);
+    for(size_t i = 0; i + pattern_length <= length; ++i) {
+        count += memcmp(text + i, pattern, pattern_length) == 0;
+    }
+    return count;
+}
+
+// Duration in microseconds of the first complete event called name, or -1 when there is none.
+[[nodiscard]] static f64 trace_event_duration(const char* text, const char* name) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "{\"name\":\"%s\",\"ph\":\"X\"", name);
+    const char* event = strstr(text, pattern);
+    const char* duration = event ? strstr(event, "\"dur\":") : nullptr;
+    f64 value = -1.0;
+    return duration && sscanf(duration, "\"dur\":%lf", &value) == 1 ? value : -1.0;
+}
+
+// Rings wrap to the newest records, nested zones nest, threads get their own rings, and the export is well formed
+// with durations that match the wall clock.
+[[nodiscard]] static bool verify_profiler_capture() {
+    u32 thread_slots = OL::JobSystem::default_worker_count() + 1;
+    bool initialized = OL::profiler.init(PROFILER_BENCH_RECORDS, thread_slots);
+    assert(initialized);
+    OL::profiler.set_thread_name("Bench");
+
+    {
+        OL_PROFILE_ZONE("outer");
+        OL_PROFILE_ZONE("inner");
+    }
+    OL::ProfileThread* main_thread = OL::profiler.current_thread();
+    const OL::ProfileRecord& inner = main_thread->records[0];
+    const OL::ProfileRecord& outer = main_thread->records[1];
+    bool nested = strcmp(inner.name, "inner") == 0 && strcmp(outer.name, "outer") == 0 && outer.begin <= inner.begin && inner.end <= outer.end;
+
+    {
+        OL_PROFILE_ZONE("sleep");
+        std::this_thread::sleep_for(OL::Time::Milliseconds(20));
+    }
+    for(u32 i = 0; i < PROFILER_BENCH_RECORDS + 100; ++i) {
+        OL_PROFILE_ZONE("filler");
+    }
+
+    bench_job_system.init();
+    u32 job_zones = bench_job_system.thread_count() * PROFILER_BENCH_JOB_ZONES_PER_THREAD;
+    bench_job_system.parallel_for(0, job_zones, 1, [](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; ++i) {
+            OL_PROFILE_ZONE("job");
+        }
+    });
+    bench_job_system.shutdown();
+
+    OL::Buffer* trace = OL::Buffer::allocate(OL::profiler.chrome_trace_size());
+    assert(trace);
+    size_t length = OL::profiler.write_chrome_trace(trace);
+    trace->data[length] = '\0';
+    const char* text = reinterpret_cast<const char*>(trace->data);
+
+    // The main thread's ring only holds its newest records: fillers plus whichever jobs it ran itself. Nothing from
+    // before the fillers survives, and the oldest slot of a full ring is left out since its owner writes there next.
+    u32 threads = OL::profiler.thread_count.load();
+    u32 complete_events = count_occurrences(text, length, "\"ph\":\"X\"");
+    u32 job_events = count_occurrences(text, length, "{\"name\":\"job\"");
+    u32 main_job_events = count_occurrences(text, length, "{\"name\":\"job\",\"ph\":\"X\",\"pid\":1,\"tid\":0,");
+    u32 filler_events = count_occurrences(text, length, "{\"name\":\"filler\"");
+    bool wrapped = filler_events + main_job_events == PROFILER_BENCH_RECORDS - 1 && trace_event_duration(text, "outer") < 0.0 && trace_event_duration(text, "sleep") < 0.0;
+    bool jobs_recorded = job_events == job_zones;
+    bool balanced = count_occurrences(text, length, "{") == count_occurrences(text, length, "}") && text[0] == '{' && text[length - 1] == '}';
+    bool named = count_occurrences(text, length, "\"thread_name\"") == threads && strstr(text, "\"args\":{\"name\":\"Bench\"}");
+    size_t trace_length = length;
+
+    // The sleep zone is long gone from the ring, so time it again on a fresh capture.
+    OL::profiler.shutdown();
+    initialized = OL::profiler.init(PROFILER_BENCH_RECORDS, thread_slots);
+    assert(initialized);
+    {
+        OL_PROFILE_ZONE("sleep");
+        std::this_thread::sleep_for(OL::Time::Milliseconds(20));
+    }
+    trace->allocated = 0;
+    length = OL::profiler.write_chrome_trace(trace);
+    trace->data[length] = '\0';
+    f64 sleep_us = trace_event_duration(text, "sleep");
+    bool calibrated = sleep_us >= 20000.0 && sleep_us < 30000.0;
+    OL::profiler.shutdown();
+
+    printf("nested: %s, ring keeps newest: %s, per-thread rings: %s, trace well formed: %s, 20 ms zone measured as %.1f us: %s\n", nested ? "yes" : "NO",
+           wrapped ? "yes" : "NO", jobs_recorded ? "yes" : "NO", balanced && named ? "yes" : "NO", sleep_us, calibrated ? "yes" : "NO");
+    printf("%u events on %u threads, %zu bytes of trace\n", complete_events, threads, trace_length);
+
+    return nested && wrapped && jobs_recorded && balanced && named && calibrated;
+}
+
+static void bench_profiler() {
+    Bench::print_suite("profiler");
+
+    bool valid = verify_profiler_capture();
+
+    bool initialized = OL::profiler.init(PROFILER_BENCH_RECORDS, 1);
+    assert(initialized);
+
+    u64 sink = 0;
+    Bench::Measurement baseline = Bench::measure([&]() {
+        for(u32 i = 0; i < PROFILER_BENCH_ZONES; ++i) {
+            Bench::do_not_optimize(sink += i);
+        }
+    });
+    Bench::Measurement enabled = Bench::measure([&]() {
+        for(u32 i = 0; i < PROFILER_BENCH_ZONES; ++i) {
+            OL_PROFILE_ZONE("bench_zone");
+            Bench::do_not_optimize(sink += i);
+        }
+    });
+    OL::profiler.set_enabled(false);
+    Bench::Measurement disabled = Bench::measure([&]() {
+        for(u32 i = 0; i < PROFILER_BENCH_ZONES; ++i) {
+            OL_PROFILE_ZONE("bench_zone");
+            Bench::do_not_optimize(sink += i);
+        }
+    });
+    OL::profiler.shutdown();
+
+    f64 enabled_ns = (enabled.best_ns - baseline.best_ns) / PROFILER_BENCH_ZONES;
+    f64 disabled_ns = (disabled.best_ns - baseline.best_ns) / PROFILER_BENCH_ZONES;
+    bool within_budget = enabled_ns <= PROFILER_ZONE_BUDGET_NS && disabled_ns <= PROFILER_DISABLED_ZONE_BUDGET_NS;
+
+    printf("\n%10s %14s %14s %12s\n", "zones", "state", "ns/zone", "budget ns");
+    printf("%10u %14s %14.2f %12.1f\n", PROFILER_BENCH_ZONES, "enabled", enabled_ns, PROFILER_ZONE_BUDGET_NS);
+    printf("%10u %14s %14.2f %12.1f\n", PROFILER_BENCH_ZONES, "disabled", disabled_ns, PROFILER_DISABLED_ZONE_BUDGET_NS);
+    printf("valid: %s, within budget: %s\n", valid ? "yes" : "NO", within_budget ? "yes" : "NO");
+}
\ No newline at end of file
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "bench.h"
+#include "bench_jobs.h"
+#include "simulation.h"
+
+#include <orshlib/random.h>
+#include <orshlib/memory.h>
+#include <cmath>
+#include <random>
+
+static constexpr size_t RANDOM_BENCH_SIZES[] = {
+    MAX_ENTITIES * 4,
+    10'000'000
+};
+
+static constexpr u32 RANDOM_HISTOGRAM_BINS = 256;
+
+// Published xoshiro256** outputs for state { 1, 2, 3, 4 }, then the first two after one jump().
+static constexpr u64 XOSHIRO_REFERENCE[] = { 0x2D00ull, 0x0ull, 0x5A007080ull, 0x10E0000000009D80ull };
+static constexpr u64 XOSHIRO_JUMP_REFERENCE[] = { 0xBBD2F312298443D8ull, 0x62E57DB2D5706577ull };
+
+[[nodiscard]] static bool verify_xoshiro_reference() {
+    OL::Random::Xoshiro256 generator = { .state = { 1, 2, 3, 4 } };
+    bool valid = true;
+    for(u64 expected : XOSHIRO_REFERENCE) {
+        valid &= generator.next() == expected;
+    }
+
+    generator = { .state = { 1, 2, 3, 4 } };
+    generator.jump();
+    for(u64 expected : XOSHIRO_JUMP_REFERENCE) {
+        valid &= generator.next() == expected;
+    }
+    return valid;
+}
+
+struct RandomQuality {
+    f64 mean;
+    f64 variance;
+    f64 chi_square;
+    f64 serial_correlation;
+    bool in_range;
+};
+
+// Moments against U(0, 1)'s 1/2 and 1/12, chi-square over equal bins, and lag-1 correlation, for values in [0, 1).
+[[nodiscard]] static RandomQuality measure_random_quality(const f32* values, size_t count) {
+    u64 bins[RANDOM_HISTOGRAM_BINS] = {};
+    f64 sum = 0.0;
+    f64 sum_squares = 0.0;
+    f64 sum_products = 0.0;
+    bool in_range = true;
+    for(size_t i = 0; i < count; ++i) {
+        f64 value = values[i];
+        in_range &= value >= 0.0 && value < 1.0;
+        ++bins[static_cast<u32>(value * RANDOM_HISTOGRAM_BINS) & (RANDOM_HISTOGRAM_BINS - 1)];
+        sum += value;
+        sum_squares += value * value;
+        sum_products += i > 0 ? (value - 0.5) * (values[i - 1] - 0.5) : 0.0;
+    }
+
+    f64 mean = sum / count;
+    f64 variance = sum_squares / count - mean * mean;
+    f64 expected = static_cast<f64>(count) / RANDOM_HISTOGRAM_BINS;
+    f64 chi_square = 0.0;
+    for(u64 bin : bins) {
+        chi_square += (bin - expected) * (bin - expected) / expected;
+    }
+    return { mean, variance, chi_square, sum_products / (count - 1) / (1.0 / 12.0), in_range };
+}
+
+// With 255 degrees of freedom chi-square is ~255 +- 22.6. The moments and correlation get a few standard errors of
+// slack for the sample size.
+[[nodiscard]] static bool random_quality_passes(const RandomQuality& quality, size_t count) {
+    f64 tolerance = 5.0 / sqrt(static_cast<f64>(count));
+    return quality.in_range && fabs(quality.mean - 0.5) < tolerance * 0.29 && fabs(quality.variance - 1.0 / 12.0) < tolerance * 0.075 &&
+           quality.chi_square < 255.0 + 4.0 * 22.6 && quality.chi_square > 255.0 - 4.0 * 22.6 && fabs(quality.serial_correlation) < tolerance;
+}
+
+static void bench_random() {
+    Bench::print_suite("random");
+
+    size_t max_count = 0;
+    for(size_t count : RANDOM_BENCH_SIZES) {
+        max_count = count > max_count ? count : max_count;
+    }
+
+    OL::Buffer* storage = OL::Buffer::allocate(OL::reserve_size<f32>(max_count) * 2 + (OL::reserve_size<InstanceData>(MAX_ENTITIES) + OL::reserve_size<Entity>(MAX_ENTITIES)) * 2);
+    assert(storage);
+    f32* expected = storage->reserve<f32>(max_count);
+    f32* actual = storage->reserve<f32>(max_count);
+
+    bool reference = verify_xoshiro_reference();
+
+    // Streams split from one seed must not repeat each other.
+    OL::Random::Xoshiro256 generator = OL::Random::Xoshiro256::seeded(1);
+    OL::Random::Stream first = OL::Random::split_stream(&generator);
+    OL::Random::Stream second = OL::Random::split_stream(&generator);
+    static constexpr size_t STREAM_CHECK_COUNT = 1 << 20;
+    OL::Random::fill_f32_scalar(&first, expected, STREAM_CHECK_COUNT, 0.0f, 1.0f);
+    OL::Random::fill_f32_scalar(&second, actual, STREAM_CHECK_COUNT, 0.0f, 1.0f);
+    f64 cross = 0.0;
+    for(size_t i = 0; i < STREAM_CHECK_COUNT; ++i) {
+        cross += (expected[i] - 0.5) * (actual[i] - 0.5);
+    }
+    f64 cross_correlation = cross / STREAM_CHECK_COUNT / (1.0 / 12.0);
+    bool independent = fabs(cross_correlation) < 5.0 / sqrt(static_cast<f64>(STREAM_CHECK_COUNT));
+
+    // The odd count runs every tail path, and every kernel must produce the scalar kernel's exact floats.
+    static constexpr size_t VERIFY_COUNT = 4'000'003;
+    OL::Random::Stream verify_stream = OL::Random::split_stream(&generator);
+    OL::Random::Stream stream = verify_stream;
+    OL::Random::fill_f32_scalar(&stream, expected, VERIFY_COUNT, 0.0f, 1.0f);
+    RandomQuality quality = measure_random_quality(expected, VERIFY_COUNT);
+    bool quality_passes = random_quality_passes(quality, VERIFY_COUNT);
+    printf("reference outputs: %s, split streams uncorrelated (%.5f): %s\n", reference ? "yes" : "NO", cross_correlation, independent ? "yes" : "NO");
+    printf("mean %.6f, variance %.6f (1/12 = %.6f), chi-square %.1f over %u bins, lag-1 correlation %.5f: %s\n", quality.mean, quality.variance, 1.0 / 12.0,
+           quality.chi_square, RANDOM_HISTOGRAM_BINS, quality.serial_correlation, quality_passes ? "yes" : "NO");
+
+    // The per-call path init_entities used to take, for comparison.
+    printf("\n%8s %12s %12s %12s %8s\n", "kernel", "floats", "best us", "Mfloats/s", "valid");
+    for(size_t count : RANDOM_BENCH_SIZES) {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<f32> distribution(-1.0f, 1.0f);
+        Bench::Measurement measurement = Bench::measure([&]() {
+            for(size_t i = 0; i < count; ++i) {
+                actual[i] = distribution(random);
+            }
+        });
+        Bench::do_not_optimize(actual[count - 1]);
+        printf("%8s %12zu %12.1f %12.1f %8s\n", "mt19937", count, measurement.best_ns * 1e-3, count / (measurement.best_ns * 1e-3), "-");
+    }
+
+    for(s32 level_index = 0; level_index < static_cast<s32>(OL::SIMD::Level::MAX_COUNT); ++level_index) {
+        OL::SIMD::Level level = static_cast<OL::SIMD::Level>(level_index);
+        const char* level_name = OL::SIMD::level_to_string(level);
+        if(!OL::SIMD::supported(level)) {
+            printf("%8s unsupported on this CPU\n", level_name);
+            continue;
+        }
+
+        OL::Random::FillF32Kernel kernel = OL::Random::fill_f32_kernel(level);
+        stream = verify_stream;
+        kernel(&stream, actual, VERIFY_COUNT, 0.0f, 1.0f);
+        bool valid = memcmp(expected, actual, sizeof(f32) * VERIFY_COUNT) == 0 && quality_passes && reference && independent;
+
+        for(size_t count : RANDOM_BENCH_SIZES) {
+            Bench::Measurement measurement = Bench::measure([&]() {
+                kernel(&stream, actual, count, -1.0f, 1.0f);
+            });
+            Bench::do_not_optimize(actual[count - 1]);
+            printf("%8s %12zu %12.1f %12.1f %8s\n", level_name, count, measurement.best_ns * 1e-3, count / (measurement.best_ns * 1e-3), valid ? "yes" : "NO");
+        }
+    }
+
+    // The client's spawn, which has to come out identical whether or not it runs on jobs.
+    bench_job_system.init();
+    Simulation simulations[2];
+    for(Simulation& simulation : simulations) {
+        simulation = {
+            .instances = storage->reserve<InstanceData>(MAX_ENTITIES),
+            .entities = storage->reserve<Entity>(MAX_ENTITIES),
+            .count = MAX_ENTITIES
+        };
+    }
+    init_entities(&simulations[0], DEFAULT_SIMULATION_SEED);
+    init_entities(&simulations[1], DEFAULT_SIMULATION_SEED, &bench_job_system);
+    bool deterministic = memcmp(simulations[0].instances, simulations[1].instances, sizeof(InstanceData) * MAX_ENTITIES) == 0 &&
+                         memcmp(simulations[0].entities, simulations[1].entities, sizeof(Entity) * MAX_ENTITIES) == 0;
+    init_entities(&simulations[1], DEFAULT_SIMULATION_SEED + 1, &bench_job_system);
+    bool seeded = memcmp(simulations[0].instances, simulations[1].instances, sizeof(InstanceData) * MAX_ENTITIES) != 0;
+
+    printf("\n%12s %9s %12s %14s\n", "entities", "threads", "best ms", "deterministic");
+    for(OL::JobSystem* jobs : { static_cast<OL::JobSystem*>(nullptr), &bench_job_system }) {
+        Bench::Measurement measurement = Bench::measure([&]() {
+            init_entities(&simulations[1], DEFAULT_SIMULATION_SEED, jobs);
+        });
+        printf("%12zu %9u %12.3f %14s\n", MAX_ENTITIES, jobs ? jobs->thread_count() : 1, measurement.best_ns * 1e-6, deterministic && seeded ? "yes" : "NO");
+    }
+    bench_job_system.shutdown();
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "bench.h"
+
+#include <orshlib/session.h>
+#include <orshlib/memory.h>
+#include <algorithm>
+#include <random>
+
+static constexpr size_t SESSION_BENCH_SAMPLES = 1'000'000;
+static constexpr f64 SESSION_PERCENTILES[] = { 0.5, 0.9, 0.99, 0.999, 1.0 };
+
+// Relative width of a bucket, which bounds how far a reported percentile can sit above the exact one.
+static constexpr f64 SESSION_HISTOGRAM_MAX_ERROR = 1.0 / OL::DurationHistogram::SUB_BUCKET_COUNT;
+
+// Every value lands in a bucket that contains it, buckets tile the range without gaps, and none is wider than the
+// promised relative error.
+[[nodiscard]] static bool verify_histogram_buckets() {
+    using OL::DurationHistogram;
+    for(u32 i = 0; i + 1 < DurationHistogram::BUCKET_COUNT; ++i) {
+        u64 lowest = DurationHistogram::bucket_lowest(i);
+        u64 highest = DurationHistogram::bucket_highest(i);
+        if(highest + 1 != DurationHistogram::bucket_lowest(i + 1) || DurationHistogram::bucket_index(lowest) != i || DurationHistogram::bucket_index(highest) != i) {
+            return false;
+        }
+        if(static_cast<f64>(highest - lowest) > static_cast<f64>(lowest) * SESSION_HISTOGRAM_MAX_ERROR) {
+            return false;
+        }
+    }
+    return DurationHistogram::bucket_index(DurationHistogram::MAX_VALUE * 4) == DurationHistogram::BUCKET_COUNT - 1;
+}
+
+// Mostly steady 60 Hz frames with jitter, plus rare hitches of up to a quarter second, in nanoseconds.
+static void fill_frame_times(u64* samples, size_t count) {
+    std::mt19937 random(13);
+    std::normal_distribution<f64> jitter(16.6e6, 0.4e6);
+    std::uniform_real_distribution<f64> hitch(20e6, 250e6);
+    std::uniform_int_distribution<u32> roll(0, 999);
+    for(size_t i = 0; i < count; ++i) {
+        f64 value = roll(random) < 3 ? hitch(random) : jitter(random);
+        samples[i] = static_cast<u64>(value > 0.0 ? value : 0.0);
+    }
+}
+
+static void bench_session() {
+    Bench::print_suite("session");
+
+    OL::Buffer* storage = OL::Buffer::allocate(sizeof(u64) * SESSION_BENCH_SAMPLES * 2);
+    assert(storage);
+    u64* samples = storage->reserve<u64>(SESSION_BENCH_SAMPLES);
+    u64* sorted = storage->reserve<u64>(SESSION_BENCH_SAMPLES);
+    fill_frame_times(samples, SESSION_BENCH_SAMPLES);
+    memcpy(sorted, samples, sizeof(u64) * SESSION_BENCH_SAMPLES);
+    std::sort(sorted, sorted + SESSION_BENCH_SAMPLES);
+
+    // Large enough that the bench's stack frame shouldn't hold it.
+    static OL::DurationHistogram histogram;
+    for(size_t i = 0; i < SESSION_BENCH_SAMPLES; ++i) {
+        histogram.record(OL::Time::Duration(static_cast<s64>(samples[i])));
+    }
+
+    // Reported percentiles must be at or above the exact nearest-rank value and within one bucket of it.
+    bool buckets = verify_histogram_buckets();
+    bool percentiles = histogram.count == SESSION_BENCH_SAMPLES && histogram.max == sorted[SESSION_BENCH_SAMPLES - 1] && histogram.min == sorted[0];
+    printf("%10s %14s %14s %10s\n", "percentile", "exact ms", "reported ms", "error");
+    for(f64 share : SESSION_PERCENTILES) {
+        size_t rank = static_cast<size_t>(share * SESSION_BENCH_SAMPLES + 0.5);
+        rank = rank < 1 ? 1 : rank;
+        f64 exact = static_cast<f64>(sorted[rank - 1]);
+        f64 reported = static_cast<f64>(histogram.percentile(share).count());
+        f64 error = (reported - exact) / exact;
+        percentiles &= error >= 0.0 && error <= SESSION_HISTOGRAM_MAX_ERROR;
+        printf("%9.1f%% %14.4f %14.4f %9.2f%%\n", share * 100.0, exact * 1e-6, reported * 1e-6, error * 100.0);
+    }
+
+    OL::Session session = {};
+    for(u32 frame_ticks : { 1u, 0u, 1u, 3u, 1u, 2u }) {
+        session.record_frame_ticks(frame_ticks);
+    }
+    bool catch_up = session.get_stats().catch_up_frames == 2 && session.get_stats().max_ticks_per_frame == 3;
+
+    // Recording sits on the frame loop, polling on whatever wants live numbers, e.g. once a frame for the title.
+    size_t index = 0;
+    Bench::Measurement record = Bench::measure([&]() {
+        for(size_t i = 0; i < SESSION_BENCH_SAMPLES; ++i) {
+            histogram.record(OL::Time::Duration(static_cast<s64>(samples[index])));
+            index = index + 1 < SESSION_BENCH_SAMPLES ? index + 1 : 0;
+        }
+    });
+    session.frame_times = histogram;
+    session.tick_times = histogram;
+    OL::SessionStats stats = {};
+    Bench::Measurement poll = Bench::measure([&]() {
+        stats = session.get_stats();
+    });
+    Bench::do_not_optimize(histogram.count);
+    Bench::do_not_optimize(stats);
+
+    printf("\nrecord: %.2f ns, get_stats: %.2f us, histogram: %zu bytes\n", record.best_ns / SESSION_BENCH_SAMPLES, poll.best_ns * 1e-3, sizeof(OL::DurationHistogram));
+    printf("valid buckets: %s, percentiles within %.2f%%: %s, catch-up frames counted: %s\n", buckets ? "yes" : "NO", SESSION_HISTOGRAM_MAX_ERROR * 100.0,
+           percentiles ? "yes" : "NO", catch_up ? "yes" : "NO");
+    printf("\n");
+    OL::Session::print_histogram("Frame Time", histogram);
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "bench.h"
+#include "simulation.h"
+
+#include <orshlib/memory.h>
+
+static constexpr size_t SIMULATION_BENCH_SIZES[] = {
+    10'000,
+    100'000,
+    MAX_ENTITIES,
+    1'000'000,
+    5'000'000,
+    10'000'000
+};
+
+static constexpr u32 SIMULATION_VERIFY_TICKS = 64;
+
+// Position is read and written, velocity is only read.
+static constexpr size_t SIMULATION_TICK_BYTES_PER_ENTITY = sizeof(InstanceData) * 2 + sizeof(Entity);
+
+// Every kernel must leave positions bit-identical to the scalar path after the same number of ticks.
+static bool verify_simulation_kernel(OL::SIMD::AddF32Kernel kernel, const Simulation* initial, InstanceData* expected, InstanceData* actual, size_t count) {
+    memcpy(expected, initial->instances, sizeof(InstanceData) * count);
+    memcpy(actual, initial->instances, sizeof(InstanceData) * count);
+
+    for(u32 tick = 0; tick < SIMULATION_VERIFY_TICKS; ++tick) {
+        integrate_positions(expected, initial->entities, count, OL::SIMD::add_f32_scalar);
+        integrate_positions(actual, initial->entities, count, kernel);
+    }
+
+    return memcmp(expected, actual, sizeof(InstanceData) * count) == 0;
+}
+
+static void bench_simulation() {
+    Bench::print_suite("simulation_tick");
+
+    size_t max_count = 0;
+    for(size_t count : SIMULATION_BENCH_SIZES) {
+        max_count = count > max_count ? count : max_count;
+    }
+
+    OL::Buffer* storage = OL::Buffer::allocate((sizeof(InstanceData) + sizeof(Entity)) * max_count);
+    assert(storage);
+
+    Simulation simulation = {
+        .instances = storage->reserve<InstanceData>(max_count),
+        .entities = storage->reserve<Entity>(max_count),
+        .count = max_count
+    };
+    init_entities(&simulation);
+
+    // Odd count so every kernel runs its remainder path.
+    static constexpr size_t VERIFY_COUNT = 100'003;
+    OL::Buffer* verify_storage = OL::Buffer::allocate(sizeof(InstanceData) * VERIFY_COUNT * 2);
+    assert(verify_storage);
+    InstanceData* expected = verify_storage->reserve<InstanceData>(VERIFY_COUNT);
+    InstanceData* actual = verify_storage->reserve<InstanceData>(VERIFY_COUNT);
+
+    printf("%8s %12s %12s %12s %14s %12s\n", "kernel", "entities", "best us", "ns/entity", "Mentities/s", "GB/s");
+    for(s32 level_index = 0; level_index < static_cast<s32>(OL::SIMD::Level::MAX_COUNT); ++level_index) {
+        OL::SIMD::Level level = static_cast<OL::SIMD::Level>(level_index);
+        const char* level_name = OL::SIMD::level_to_string(level);
+        if(!OL::SIMD::supported(level)) {
+            printf("%8s unsupported on this CPU\n", level_name);
+            continue;
+        }
+
+        OL::SIMD::AddF32Kernel kernel = OL::SIMD::add_f32_kernel(level);
+        if(!verify_simulation_kernel(kernel, &simulation, expected, actual, VERIFY_COUNT)) {
+            printf("%8s MISMATCH against scalar results\n", level_name);
+            continue;
+        }
+
+        for(size_t count : SIMULATION_BENCH_SIZES) {
+            Bench::Measurement measurement = Bench::measure([&]() {
+                integrate_positions(simulation.instances, simulation.entities, count, kernel);
+            });
+            Bench::do_not_optimize(simulation.instances[count - 1]);
+
+            f64 ns_per_entity = measurement.best_ns / static_cast<f64>(count);
+            f64 entities_per_second = static_cast<f64>(count) / (measurement.best_ns * 1e-9);
+            f64 bytes_per_second = entities_per_second * static_cast<f64>(SIMULATION_TICK_BYTES_PER_ENTITY);
+            printf("%8s %12zu %12.1f %12.3f %14.1f %12.2f\n", level_name, count, measurement.best_ns * 1e-3, ns_per_entity, entities_per_second * 1e-6, bytes_per_second * 1e-9);
+        }
+    }
+
+    printf("dispatch selects: %s\n", OL::SIMD::level_to_string(OL::SIMD::best_level()));
+
+    // The last tick of a frame also produces the instance upload. Compare a tick followed by a full memcpy
+    // against the tick copying each chunk out while it is still cached.
+    OL::Buffer* upload_storage = OL::Buffer::allocate(sizeof(InstanceData) * max_count);
+    assert(upload_storage);
+    InstanceData* upload = upload_storage->reserve<InstanceData>(max_count);
+
+    printf("\n%12s %18s %18s %10s\n", "entities", "tick+memcpy us", "tick->upload us", "saved");
+    for(size_t count : SIMULATION_BENCH_SIZES) {
+        simulation.count = count;
+        Bench::Measurement separate = Bench::measure([&]() {
+            simulation_tick(&simulation);
+            memcpy(upload, simulation.instances, sizeof(InstanceData) * count);
+        });
+        Bench::Measurement fused = Bench::measure([&]() {
+            simulation_tick(&simulation, nullptr, upload);
+        });
+        Bench::do_not_optimize(upload[count - 1]);
+
+        printf("%12zu %18.1f %18.1f %9.0f%%\n", count, separate.best_ns * 1e-3, fused.best_ns * 1e-3, (1.0 - fused.best_ns / separate.best_ns) * 100.0);
+    }
+}
\ No newline at end of file
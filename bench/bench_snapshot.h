@@ -0,0 +1,242 @@
+#pragma once
+
+#include "bench.h"
+#include "bench_jobs.h"
+#include "bench_assets.h"
+#include "snapshot.h"
+
+#include <orshlib/memory.h>
+#include <cstring>
+
+static constexpr const char* BENCH_SNAPSHOT_PATH = BENCH_OUTPUT_DIRECTORY "bench_world.snapshot";
+static constexpr const char* BENCH_REPLAY_PATH = BENCH_OUTPUT_DIRECTORY "bench_replay.snapshot";
+
+static constexpr size_t SNAPSHOT_BENCH_SIZES[] = {
+    MAX_ENTITIES,
+    1'000'000,
+    5'000'000,
+    10'000'000
+};
+
+// Tick counts of a recorded session: mostly one tick a frame, with idle frames and catch-up bursts mixed in.
+static constexpr u32 SNAPSHOT_REPLAY_FRAMES = 240;
+static constexpr u32 SNAPSHOT_REPLAY_PATTERN[] = { 1, 0, 1, 2, 1, 1, 0, 4, 1, 3 };
+
+// Records a session on one copy of the world, then replays it on the mapping itself and on a restored copy, with and
+// without jobs. Every path has to reach the recorded checksum, and the stored arrays must be the ones written.
+[[nodiscard]] static bool verify_snapshot_replay(OL::Buffer* storage) {
+    OL::BufferScope scope(storage);
+    size_t count = MAX_ENTITIES;
+    WorldBounds bounds = { .min = { -1.0f, -1.0f }, .max = { 1.0f, 1.0f }, .edge = WorldEdge::BOUNCE };
+    Simulation recorded = {
+        .instances = storage->reserve<InstanceData>(count, OL::CACHE_LINE_SIZE),
+        .entities = storage->reserve<Entity>(count, OL::CACHE_LINE_SIZE),
+        .count = count,
+        .bounds = bounds,
+        .previous_instances = storage->reserve<InstanceData>(count, OL::CACHE_LINE_SIZE)
+    };
+    InstanceData* initial = storage->reserve<InstanceData>(count);
+    InstanceData* render_output = storage->reserve<InstanceData>(count);
+    init_entities(&recorded, DEFAULT_SIMULATION_SEED, &bench_job_system, SPAWN_SPEED * 4.0f);
+    memcpy(initial, recorded.instances, sizeof(InstanceData) * count);
+    u64 initial_checksum = simulation_checksum(&recorded);
+
+    SnapshotWriter writer;
+    if(!begin_snapshot(BENCH_REPLAY_PATH, &recorded, 0, &writer)) {
+        return false;
+    }
+    for(u32 frame = 0; frame < SNAPSHOT_REPLAY_FRAMES; ++frame) {
+        u32 ticks = SNAPSHOT_REPLAY_PATTERN[frame % OL::array_count(SNAPSHOT_REPLAY_PATTERN)];
+        for(u32 tick = 0; tick < ticks; ++tick) {
+            simulation_tick(&recorded, &bench_job_system);
+        }
+        append_replay_frame(&writer, ticks, 0.5f);
+    }
+    if(!end_snapshot(&writer, &recorded)) {
+        return false;
+    }
+
+    Snapshot snapshot;
+    if(!open_snapshot(BENCH_REPLAY_PATH, &snapshot)) {
+        return false;
+    }
+    bool stored = memcmp(snapshot.instances, initial, sizeof(InstanceData) * count) == 0 && snapshot.header->entity_count == count &&
+                  snapshot.header->edge == static_cast<u32>(WorldEdge::BOUNCE) && snapshot.header->replay_frame_count == SNAPSHOT_REPLAY_FRAMES;
+
+    // Restored into separate storage, ticked on the job system and interpolated every frame like the client.
+    Simulation restored = {
+        .instances = storage->reserve<InstanceData>(count, OL::CACHE_LINE_SIZE),
+        .entities = storage->reserve<Entity>(count, OL::CACHE_LINE_SIZE),
+        .count = count,
+        .previous_instances = storage->reserve<InstanceData>(count, OL::CACHE_LINE_SIZE)
+    };
+    bool restore_valid = restore_snapshot(&snapshot, &restored, count, &bench_job_system) && simulation_checksum(&restored) == initial_checksum &&
+                         replay_snapshot(&snapshot, &restored, &bench_job_system, render_output);
+
+    // Ticked in place on the copy-on-write mapping, single threaded. The restore above left the mapping untouched.
+    Simulation attached = {};
+    attach_snapshot(&snapshot, &attached);
+    bool attach_valid = simulation_checksum(&attached) == initial_checksum && replay_snapshot(&snapshot, &attached);
+    close_snapshot(&snapshot);
+
+    // The file never sees writes through a copy-on-write mapping, so it replays from the start again.
+    bool reopen_valid = open_snapshot(BENCH_REPLAY_PATH, &snapshot) && memcmp(snapshot.instances, initial, sizeof(InstanceData) * count) == 0;
+    if(snapshot.header) {
+        close_snapshot(&snapshot);
+    }
+
+    printf("%u frames, %llu ticks replayed: restored + jobs: %s, attached in place: %s, arrays stored intact: %s, file unchanged by replay: %s\n",
+           SNAPSHOT_REPLAY_FRAMES, static_cast<unsigned long long>(writer.header.replay_ticks), restore_valid ? "yes" : "NO", attach_valid ? "yes" : "NO",
+           stored ? "yes" : "NO", reopen_valid ? "yes" : "NO");
+    return stored && restore_valid && attach_valid && reopen_valid;
+}
+
+// A file that is not a snapshot, one cut short, one from another version and one whose entity offset only fits after
+// wrapping around must all be turned away.
+[[nodiscard]] static bool verify_snapshot_rejects(const Simulation* simulation) {
+    SnapshotHeader header = make_snapshot_header(simulation, 0);
+    size_t wrapping_size = SNAPSHOT_DATA_ALIGNMENT * 2;
+    OL::Buffer* scratch = OL::Buffer::allocate(wrapping_size);
+    assert(scratch);
+    SnapshotHeader* written = scratch->reserve<SnapshotHeader>();
+
+    bool rejected = true;
+    for(u32 variant = 0; variant < 4; ++variant) {
+        *written = header;
+        written->magic = variant == 0 ? 0 : header.magic;
+        written->version = variant == 1 ? SNAPSHOT_VERSION + 1 : header.version;
+        // variant 2 keeps a valid header for a file that ends right after it.
+        size_t size = sizeof(SnapshotHeader);
+        if(variant == 3) {
+            size = wrapping_size;
+            written->entity_count = SNAPSHOT_DATA_ALIGNMENT / sizeof(Entity);
+            written->instances_offset = SNAPSHOT_DATA_ALIGNMENT;
+            written->entities_offset = 0 - SNAPSHOT_DATA_ALIGNMENT;
+            written->replay_offset = wrapping_size;
+            written->replay_frame_count = 0;
+            written->file_size = wrapping_size;
+        }
+        if(OL::File::write_to_file(BENCH_SNAPSHOT_PATH, scratch, 0, size) != size) {
+            rejected = false;
+            break;
+        }
+
+        // The rejections are expected, keep them out of the report.
+        Snapshot snapshot;
+        OL::Logger::LogLevel level = OL::Logger::logger_level;
+        OL::Logger::logger_level = OL::Logger::LEVEL_SILENT;
+        bool opened = open_snapshot(BENCH_SNAPSHOT_PATH, &snapshot);
+        OL::Logger::logger_level = level;
+        if(opened) {
+            close_snapshot(&snapshot);
+        }
+        rejected &= !opened;
+    }
+
+    OL::Buffer::release(scratch);
+    return rejected;
+}
+
+static void bench_snapshot() {
+    Bench::print_suite("snapshot");
+    if(!Bench::prepare_output_directory()) {
+        return;
+    }
+
+    size_t max_count = 0;
+    for(size_t count : SNAPSHOT_BENCH_SIZES) {
+        max_count = count > max_count ? count : max_count;
+    }
+
+    // Source world, restore target, and room for the eight arrays the replay check takes at MAX_ENTITIES.
+    size_t world_size = OL::reserve_size<InstanceData>(max_count, OL::CACHE_LINE_SIZE) + OL::reserve_size<Entity>(max_count, OL::CACHE_LINE_SIZE);
+    OL::Buffer* storage = OL::Buffer::allocate(world_size * 2 + OL::reserve_size<InstanceData>(MAX_ENTITIES, OL::CACHE_LINE_SIZE) * 8);
+    assert(storage);
+
+    bench_job_system.init();
+    bool replay_valid = verify_snapshot_replay(storage);
+
+    Simulation source = {
+        .instances = storage->reserve<InstanceData>(max_count, OL::CACHE_LINE_SIZE),
+        .entities = storage->reserve<Entity>(max_count, OL::CACHE_LINE_SIZE),
+        .count = max_count,
+        .bounds = { .min = { -1.0f, -1.0f }, .max = { 1.0f, 1.0f }, .edge = WorldEdge::WRAP }
+    };
+    Simulation target = source;
+    target.instances = storage->reserve<InstanceData>(max_count, OL::CACHE_LINE_SIZE);
+    target.entities = storage->reserve<Entity>(max_count, OL::CACHE_LINE_SIZE);
+    init_entities(&source, DEFAULT_SIMULATION_SEED, &bench_job_system);
+    bool rejects_valid = verify_snapshot_rejects(&source);
+    printf("bad magic, version, truncation and wrapping offsets rejected: %s\n", rejects_valid ? "yes" : "NO");
+
+    auto report = [](const char* name, const char* cache, size_t count, Bench::Measurement measurement, size_t bytes) {
+        f64 mb_per_second = static_cast<f64>(bytes) / OL::MB(1) / (measurement.best_ns * 1e-9);
+        printf("%24s %6s %12zu %12.3f %12.3f %10.1f\n", name, cache, count, measurement.best_ns * 1e-6, measurement.mean_ns * 1e-6, mb_per_second);
+    };
+
+    printf("\n%24s %6s %12s %12s %12s %10s\n", "path", "cache", "entities", "best ms", "mean ms", "MB/s");
+    bool round_trips = true;
+    for(size_t count : SNAPSHOT_BENCH_SIZES) {
+        source.count = count;
+        target.count = count;
+        size_t bytes = (sizeof(InstanceData) + sizeof(Entity)) * count;
+
+        report("init_entities (jobs)", "-", count, Bench::measure([&]() {
+            init_entities(&source, DEFAULT_SIMULATION_SEED, &bench_job_system);
+        }), bytes);
+
+        // One write up front, a path that can't be written would otherwise fail, and log, for every sample.
+        if(!write_snapshot(BENCH_SNAPSHOT_PATH, &source, 0)) {
+            printf("Skipped, unable to write %s.\n", BENCH_SNAPSHOT_PATH);
+            round_trips = false;
+            break;
+        }
+        bool written = true;
+        report("write_snapshot", "warm", count, Bench::measure([&]() {
+            written &= write_snapshot(BENCH_SNAPSHOT_PATH, &source, 0);
+        }), bytes);
+        round_trips &= written;
+
+        // Mapping alone reads nothing, so the zero-copy rows include a tick to pay for the faults it takes.
+        bool loaded = true;
+        auto attach_and_tick = [&]() {
+            Snapshot snapshot;
+            if(!open_snapshot(BENCH_SNAPSHOT_PATH, &snapshot)) {
+                loaded = false;
+                return;
+            }
+            Simulation attached = {};
+            attach_snapshot(&snapshot, &attached);
+            simulation_tick(&attached, &bench_job_system);
+            Bench::do_not_optimize(attached.instances[count - 1]);
+            close_snapshot(&snapshot);
+        };
+        auto restore = [&](OL::JobSystem* jobs) {
+            Snapshot snapshot;
+            loaded &= open_snapshot(BENCH_SNAPSHOT_PATH, &snapshot) && restore_snapshot(&snapshot, &target, count, jobs);
+            if(snapshot.header) {
+                close_snapshot(&snapshot);
+            }
+        };
+
+        report("attach + first tick", "warm", count, Bench::measure(attach_and_tick), bytes);
+        report("restore", "warm", count, Bench::measure([&]() {
+            restore(nullptr);
+        }), bytes);
+        report("restore (jobs)", "warm", count, Bench::measure([&]() {
+            restore(&bench_job_system);
+        }), bytes);
+        // The cold rows include the eviction itself, treat them as an upper bound.
+        report("restore (jobs)", "cold", count, Bench::measure([&]() {
+            evict_from_page_cache(BENCH_SNAPSHOT_PATH);
+            restore(&bench_job_system);
+        }), bytes);
+
+        round_trips &= loaded && memcmp(source.instances, target.instances, sizeof(InstanceData) * count) == 0 &&
+                       memcmp(source.entities, target.entities, sizeof(Entity) * count) == 0;
+    }
+    bench_job_system.shutdown();
+
+    printf("replay deterministic: %s, round trips exact: %s\n", replay_valid ? "yes" : "NO", round_trips && rejects_valid ? "yes" : "NO");
+    OL::Buffer::release(storage);
+}
\ No newline at end of file
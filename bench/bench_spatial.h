@@ -0,0 +1,219 @@
+#pragma once
+
+#include "bench.h"
+#include "bench_jobs.h"
+#include "simulation.h"
+#include "spatial_grid.h"
+
+#include <orshlib/memory.h>
+#include <cmath>
+#include <random>
+
+static constexpr size_t SPATIAL_BENCH_SIZES[] = {
+    MAX_ENTITIES,
+    1'000'000,
+    5'000'000
+};
+
+static constexpr f32 SPATIAL_BENCH_ENTITIES_PER_CELL = 8.0f;
+static constexpr u32 SPATIAL_BENCH_QUERIES = 4096;
+static constexpr u32 SPATIAL_VERIFY_QUERIES = 256;
+static constexpr WorldBounds SPATIAL_BENCH_BOUNDS = { .min = { -1.0f, -1.0f }, .max = { 1.0f, 1.0f }, .edge = WorldEdge::WRAP };
+
+// Every entity appears exactly once, in the cell its position maps to, and cells keep ascending entity order.
+[[nodiscard]] static bool verify_spatial_grid(const SpatialGrid* grid, const InstanceData* instances, size_t count, u8* seen) {
+    memset(seen, 0, count);
+    if(grid->cell_start[0] != 0 || grid->cell_start[grid->cell_count] != count) {
+        return false;
+    }
+
+    for(u32 cell = 0; cell < grid->cell_count; ++cell) {
+        for(u32 slot = grid->cell_start[cell]; slot < grid->cell_start[cell + 1]; ++slot) {
+            u32 entity_index = grid->entity_indices[slot];
+            bool ordered = slot == grid->cell_start[cell] || grid->entity_indices[slot - 1] < entity_index;
+            if(entity_index >= count || seen[entity_index] || !ordered || grid->cell_of(instances[entity_index].position) != cell ||
+               memcmp(&grid->positions[slot], &instances[entity_index].position, sizeof(Vector2)) != 0) {
+                return false;
+            }
+            seen[entity_index] = 1;
+        }
+    }
+
+    return true;
+}
+
+[[nodiscard]] static u32 nearest_brute_force(const InstanceData* instances, size_t count, Vector2 point, f32 max_distance, u32 exclude) {
+    u32 best = SPATIAL_GRID_NOT_FOUND;
+    f32 best_distance_squared = max_distance * max_distance;
+    for(size_t i = 0; i < count; ++i) {
+        f32 dx = instances[i].position.x - point.x;
+        f32 dy = instances[i].position.y - point.y;
+        f32 distance_squared = dx * dx + dy * dy;
+        if(i != exclude && (distance_squared < best_distance_squared || (distance_squared == best_distance_squared && i < best))) {
+            best = static_cast<u32>(i);
+            best_distance_squared = distance_squared;
+        }
+    }
+    return best;
+}
+
+// Radius and nearest queries against a linear scan. Radius results come out in cell order, so they are compared as sets.
+[[nodiscard]] static bool verify_spatial_queries(const SpatialGrid* grid, const InstanceData* instances, size_t count, u8* seen) {
+    std::mt19937 random(99);
+    std::uniform_real_distribution<f32> coordinate(-1.1f, 1.1f);
+    static u32 results[1 << 16];
+
+    for(u32 query = 0; query < SPATIAL_VERIFY_QUERIES; ++query) {
+        Vector2 center = { coordinate(random), coordinate(random) };
+        f32 radius = grid->cell_size * (1.0f + (query % 5));
+        u32 found = query_radius(grid, center, radius, results, static_cast<u32>(OL::array_count(results)));
+        if(found > OL::array_count(results)) {
+            return false;
+        }
+
+        memset(seen, 0, count);
+        for(u32 i = 0; i < found; ++i) {
+            seen[results[i]] = 1;
+        }
+        u32 expected = 0;
+        for(size_t i = 0; i < count; ++i) {
+            f32 dx = instances[i].position.x - center.x;
+            f32 dy = instances[i].position.y - center.y;
+            if(dx * dx + dy * dy <= radius * radius) {
+                ++expected;
+                if(!seen[i]) {
+                    return false;
+                }
+            }
+        }
+        if(expected != found) {
+            return false;
+        }
+
+        Vector2 range_max = { center.x + radius, center.y + radius * 0.5f };
+        found = query_range(grid, center, range_max, results, static_cast<u32>(OL::array_count(results)));
+        expected = 0;
+        for(size_t i = 0; i < count; ++i) {
+            Vector2 position = instances[i].position;
+            expected += position.x >= center.x && position.x <= range_max.x && position.y >= center.y && position.y <= range_max.y;
+        }
+        if(expected != found) {
+            return false;
+        }
+
+        u32 exclude = query % 2 ? static_cast<u32>(random() % count) : SPATIAL_GRID_NOT_FOUND;
+        Vector2 point = exclude == SPATIAL_GRID_NOT_FOUND ? center : instances[exclude].position;
+        f32 max_distance = query % 3 ? 0.05f : 10.0f;
+        if(query_nearest(grid, point, max_distance, exclude) != nearest_brute_force(instances, count, point, max_distance, exclude)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Every edge mode has to keep fast entities inside the bounds over many ticks.
+[[nodiscard]] static bool verify_world_bounds(WorldEdge edge) {
+    static constexpr size_t COUNT = 10'000;
+    static InstanceData instances[COUNT];
+    static Entity entities[COUNT];
+    Simulation simulation = {
+        .instances = instances,
+        .entities = entities,
+        .count = COUNT,
+        .bounds = { .min = { -1.0f, -1.0f }, .max = { 1.0f, 1.0f }, .edge = edge }
+    };
+    init_entities(&simulation);
+    for(size_t i = 0; i < COUNT; ++i) {
+        entities[i].velocity.x *= 1000.0f;
+        entities[i].velocity.y *= 1000.0f;
+    }
+
+    for(u32 tick = 0; tick < 1000; ++tick) {
+        simulation_tick(&simulation);
+        for(size_t i = 0; i < COUNT; ++i) {
+            Vector2 position = instances[i].position;
+            if(position.x < -1.0f || position.x > 1.0f || position.y < -1.0f || position.y > 1.0f) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static void bench_spatial() {
+    Bench::print_suite("spatial");
+
+    printf("bounds wrap: %s, bounce: %s\n", verify_world_bounds(WorldEdge::WRAP) ? "yes" : "NO", verify_world_bounds(WorldEdge::BOUNCE) ? "yes" : "NO");
+
+    size_t max_count = 0;
+    for(size_t count : SPATIAL_BENCH_SIZES) {
+        max_count = count > max_count ? count : max_count;
+    }
+
+    f32 smallest_cell = (SPATIAL_BENCH_BOUNDS.max.x - SPATIAL_BENCH_BOUNDS.min.x) / sqrtf(static_cast<f32>(max_count) / SPATIAL_BENCH_ENTITIES_PER_CELL);
+    OL::Buffer* storage = OL::Buffer::allocate((sizeof(InstanceData) + sizeof(Entity) + 1) * max_count +
+                                               spatial_grid_memory_size(SPATIAL_BENCH_BOUNDS.min, SPATIAL_BENCH_BOUNDS.max, smallest_cell, max_count));
+    assert(storage);
+    Simulation simulation = {
+        .instances = storage->reserve<InstanceData>(max_count),
+        .entities = storage->reserve<Entity>(max_count),
+        .count = max_count,
+        .bounds = SPATIAL_BENCH_BOUNDS
+    };
+    init_entities(&simulation);
+    u8* seen = storage->reserve(max_count);
+    size_t grid_offset = storage->allocated;
+
+    bench_job_system.init();
+    printf("%10s %10s %9s %14s %14s %14s %14s %8s\n", "entities", "cells", "threads", "rebuild ms", "Mentities/s", "radius q/s", "nearest q/s", "valid");
+    for(size_t count : SPATIAL_BENCH_SIZES) {
+        f32 cell_size = (SPATIAL_BENCH_BOUNDS.max.x - SPATIAL_BENCH_BOUNDS.min.x) / sqrtf(static_cast<f32>(count) / SPATIAL_BENCH_ENTITIES_PER_CELL);
+        storage->allocated = grid_offset;
+        SpatialGrid grid;
+        bool initialized = init_spatial_grid(&grid, SPATIAL_BENCH_BOUNDS.min, SPATIAL_BENCH_BOUNDS.max, cell_size, count, storage);
+        assert(initialized);
+
+        for(OL::JobSystem* jobs : { static_cast<OL::JobSystem*>(nullptr), &bench_job_system }) {
+            Bench::Measurement rebuild = Bench::measure([&]() {
+                rebuild_spatial_grid(&grid, &simulation.instances[0].position, sizeof(InstanceData), count, jobs);
+            });
+
+            // Only the first row per size pays for the linear-scan checks, the grid is deterministic across thread counts.
+            bool valid = verify_spatial_grid(&grid, simulation.instances, count, seen);
+            if(!jobs && count == MAX_ENTITIES) {
+                valid = valid && verify_spatial_queries(&grid, simulation.instances, count, seen);
+            }
+
+            std::mt19937 random(7);
+            std::uniform_real_distribution<f32> coordinate(-1.0f, 1.0f);
+            Vector2 centers[SPATIAL_BENCH_QUERIES];
+            for(Vector2& center : centers) {
+                center = { coordinate(random), coordinate(random) };
+            }
+
+            u64 hits = 0;
+            Bench::Measurement radius = Bench::measure([&]() {
+                for(const Vector2& center : centers) {
+                    for_each_in_radius(&grid, center, cell_size * 2.0f, [&](u32, Vector2) {
+                        ++hits;
+                    });
+                }
+                Bench::do_not_optimize(hits);
+            });
+
+            Bench::Measurement nearest = Bench::measure([&]() {
+                for(const Vector2& center : centers) {
+                    hits += query_nearest(&grid, center, 1.0f);
+                }
+                Bench::do_not_optimize(hits);
+            });
+
+            u32 threads = jobs ? jobs->thread_count() : 1;
+            printf("%10zu %10u %9u %14.3f %14.1f %14.0f %14.0f %8s\n", count, grid.cell_count, threads, rebuild.best_ns * 1e-6, count / (rebuild.best_ns * 1e-3),
+                   SPATIAL_BENCH_QUERIES / (radius.best_ns * 1e-9), SPATIAL_BENCH_QUERIES / (nearest.best_ns * 1e-9), valid ? "yes" : "NO");
+        }
+    }
+    bench_job_system.shutdown();
+}
\ No newline at end of file
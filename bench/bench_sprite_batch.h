@@ -0,0 +1,243 @@
+#pragma once
+
+#include "bench.h"
+#include "bench_jobs.h"
+#include "sprite_batch.h"
+
+#include <orshlib/memory.h>
+#include <orshlib/random.h>
+#include <algorithm>
+
+static constexpr u32 SPRITE_BATCH_BENCH_SPRITES = 1'000'000;
+static constexpr u32 SPRITE_BATCH_BENCH_MAX_RUNS = 4096;
+static constexpr u32 SPRITE_BATCH_VERIFY_SPRITES = 200'000;
+
+// Key mixes a frame can submit. A scene spreads sprites over layers, pipelines and textures with a depth each, like
+// a game drawing its world, UI and effects. The client case is what main submits: one layer and pipeline, a handful
+// of textures and no depth.
+struct SpriteKeyMix {
+    const char* name;
+    u32 layers;
+    u32 pipelines;
+    u32 textures;
+    bool depth;
+};
+
+static constexpr SpriteKeyMix SPRITE_KEY_MIXES[] = {
+    { "scene", 4, 4, 64, true },
+    { "client", 1, 1, 5, false },
+    { "one state", 1, 1, 1, false }
+};
+
+static void generate_sprite_keys(SpriteKeyMix mix, SpriteKey* keys, u32 count, u64 seed) {
+    OL::Random::Xoshiro256 random = OL::Random::Xoshiro256::seeded(seed);
+    for(u32 i = 0; i < count; ++i) {
+        u64 bits = random.next();
+        f32 depth = mix.depth ? static_cast<f32>(bits >> 40) / static_cast<f32>(1 << 24) * 2.0f - 1.0f : 0.0f;
+        keys[i] = make_sprite_key(static_cast<u32>(bits % mix.layers), static_cast<u32>((bits >> 8) % mix.pipelines),
+                                  static_cast<u32>((bits >> 16) % mix.textures), depth);
+    }
+}
+
+static void fill_sprite_batch(SpriteBatch* batch, const SpriteKey* keys, u32 count) {
+    begin_sprite_batch(batch);
+    u32 first = reserve_sprites(batch, count);
+    memcpy(batch->keys + first, keys, sizeof(SpriteKey) * count);
+    for(u32 i = 0; i < count; ++i) {
+        batch->sprites[first + i] = i;
+    }
+}
+
+// Draw calls a renderer going through the sprites in submission order would make: one per change of state.
+[[nodiscard]] static u32 unsorted_state_changes(const SpriteKey* keys, u32 count) {
+    u32 changes = count > 0;
+    for(u32 i = 1; i < count; ++i) {
+        changes += sprite_key_state(keys[i]) != sprite_key_state(keys[i - 1]);
+    }
+    return changes;
+}
+
+// Runs tile the batch in order, each holds one state, neighbours differ, and groups split exactly where the layer or
+// pipeline changes.
+[[nodiscard]] static bool sprite_runs_valid(const SpriteBatch* batch) {
+    u32 next = 0;
+    for(u32 run_index = 0; run_index < batch->run_count; ++run_index) {
+        const SpriteRun& run = batch->runs[run_index];
+        if(run.first != next || run.count == 0 || sprite_key_texture(batch->keys[run.first]) != run.texture) {
+            return false;
+        }
+        u32 state = sprite_key_state(batch->keys[run.first]);
+        for(u32 i = run.first; i < run.first + run.count; ++i) {
+            if(sprite_key_state(batch->keys[i]) != state) {
+                return false;
+            }
+        }
+        if(run_index > 0 && sprite_key_state(batch->keys[run.first - 1]) == state) {
+            return false;
+        }
+        next += run.count;
+    }
+
+    u32 next_run = 0;
+    for(u32 group_index = 0; group_index < batch->group_count; ++group_index) {
+        const SpriteDrawGroup& group = batch->groups[group_index];
+        if(group.first_run != next_run || group.run_count == 0) {
+            return false;
+        }
+        for(u32 run_index = group.first_run; run_index < group.first_run + group.run_count; ++run_index) {
+            SpriteKey key = batch->keys[batch->runs[run_index].first];
+            if(sprite_key_layer(key) != group.layer || sprite_key_pipeline(key) != group.pipeline) {
+                return false;
+            }
+        }
+        if(group_index > 0 && batch->groups[group_index - 1].layer == group.layer && batch->groups[group_index - 1].pipeline == group.pipeline) {
+            return false;
+        }
+        next_run += group.run_count;
+    }
+    return next == batch->count && next_run == batch->run_count;
+}
+
+// Every mix sorted with and without jobs has to match std::stable_sort exactly, sprites included, skip the digits it
+// can and split into valid runs. Depth keys also have to order like the floats they came from.
+[[nodiscard]] static bool verify_sprite_batch(SpriteBatch* batch, OL::Buffer* storage) {
+    OL::BufferScope scope(storage);
+    u32 count = SPRITE_BATCH_VERIFY_SPRITES;
+    SpriteKey* keys = storage->reserve<SpriteKey>(count);
+    u32* expected = storage->reserve<u32>(count);
+
+    bool sorted = true;
+    bool passes_skipped = true;
+    bool runs_valid = true;
+    for(const SpriteKeyMix& mix : SPRITE_KEY_MIXES) {
+        generate_sprite_keys(mix, keys, count, DEFAULT_SIMULATION_SEED);
+        for(u32 i = 0; i < count; ++i) {
+            expected[i] = i;
+        }
+        std::stable_sort(expected, expected + count, [keys](u32 a, u32 b) {
+            return keys[a] < keys[b];
+        });
+
+        for(OL::JobSystem* jobs : { static_cast<OL::JobSystem*>(nullptr), &bench_job_system }) {
+            fill_sprite_batch(batch, keys, count);
+            runs_valid &= end_sprite_batch(batch, jobs) && sprite_runs_valid(batch);
+            for(u32 i = 0; i < count; ++i) {
+                sorted &= batch->sprites[i] == expected[i] && batch->keys[i] == keys[expected[i]];
+            }
+            // Textures fit in one digit outside the scene, and a single state leaves only depth, which is constant.
+            passes_skipped &= mix.depth || batch->sort_passes == (mix.textures > 1 ? 1u : 0u);
+        }
+    }
+
+    // Reserving past capacity stops there and a full batch turns single sprites away.
+    begin_sprite_batch(batch);
+    reserve_sprites(batch, batch->capacity + 1);
+    bool capped = batch->count == batch->capacity && !submit_sprite(batch, 0, 0);
+    begin_sprite_batch(batch);
+    capped &= submit_sprite(batch, make_sprite_key(1, 0, 0, 0.0f), 0) && submit_sprite(batch, make_sprite_key(0, 0, 0, 0.0f), 1);
+    capped &= end_sprite_batch(batch) && batch->sprites[0] == 1 && batch->group_count == 2;
+
+    f32 depths[] = { -1e30f, -2.0f, -0.5f, -0.0f, 0.0f, 1e-30f, 0.25f, 3.0f, 1e30f };
+    bool depth_ordered = true;
+    for(u32 i = 1; i < OL::array_count(depths); ++i) {
+        depth_ordered &= make_sprite_key(0, 0, 0, depths[i - 1]) <= make_sprite_key(0, 0, 0, depths[i]);
+    }
+
+    printf("%u sprites per mix: matches std::stable_sort: %s, constant digits skipped: %s, runs and groups minimal: %s, depth ordered: %s, capacity kept: %s\n", count,
+           sorted ? "yes" : "NO", passes_skipped ? "yes" : "NO", runs_valid ? "yes" : "NO", depth_ordered ? "yes" : "NO", capped ? "yes" : "NO");
+    return sorted && passes_skipped && runs_valid && depth_ordered && capped;
+}
+
+static void bench_sprite_batch() {
+    Bench::print_suite("sprite_batch");
+
+    u32 count = SPRITE_BATCH_BENCH_SPRITES;
+    OL::Buffer* storage = OL::Buffer::allocate(sprite_batch_memory_size(count, SPRITE_BATCH_BENCH_MAX_RUNS) + OL::reserve_size<SpriteKey>(count) * 2 +
+                                               OL::reserve_size<u32>(count) + OL::reserve_size<InstanceData>(count) * 2 + OL::MB(8));
+    assert(storage);
+    SpriteBatch batch;
+    bool batch_ready = init_sprite_batch(&batch, count, SPRITE_BATCH_BENCH_MAX_RUNS, storage);
+    assert(batch_ready);
+
+    bench_job_system.init();
+    bool valid = verify_sprite_batch(&batch, storage);
+
+    SpriteKey* keys = storage->reserve<SpriteKey>(count);
+    SpriteKey* std_keys = storage->reserve<SpriteKey>(count);
+    InstanceData* instances = storage->reserve<InstanceData>(count);
+    InstanceData* sorted = storage->reserve<InstanceData>(count);
+    for(u32 i = 0; i < count; ++i) {
+        instances[i].position = { static_cast<f32>(i), 0.0f };
+    }
+
+    // Every sample refills the batch from the same submitted keys, only the step itself is timed.
+    auto measure_step = [&](auto&& step) {
+        f64 best_ns = 1e300;
+        f64 total_ns = 0.0;
+        Bench::Measurement measurement = Bench::measure([&]() {
+            fill_sprite_batch(&batch, keys, count);
+            OL::Time::Stamp start = OL::Time::Clock::now();
+            step();
+            f64 elapsed_ns = Bench::to_nanoseconds(OL::Time::Clock::now() - start);
+            best_ns = elapsed_ns < best_ns ? elapsed_ns : best_ns;
+            total_ns += elapsed_ns;
+        });
+        return Bench::Measurement{ .best_ns = best_ns, .mean_ns = total_ns / static_cast<f64>(measurement.samples + 1), .samples = measurement.samples };
+    };
+    auto report = [count](const char* mix, const char* path, u32 passes, Bench::Measurement measurement) {
+        printf("%10s %24s %8u %10.3f %10.3f %12.1f\n", mix, path, passes, measurement.best_ns * 1e-6, measurement.mean_ns * 1e-6,
+               static_cast<f64>(count) / (measurement.best_ns * 1e-9) * 1e-6);
+    };
+
+    printf("\n%10s %24s %8s %10s %10s %12s\n", "mix", "path", "passes", "best ms", "mean ms", "Msprites/s");
+    for(const SpriteKeyMix& mix : SPRITE_KEY_MIXES) {
+        generate_sprite_keys(mix, keys, count, DEFAULT_SIMULATION_SEED + 1);
+
+        report(mix.name, "std::sort", 0, Bench::measure([&]() {
+            memcpy(std_keys, keys, sizeof(SpriteKey) * count);
+            std::sort(std_keys, std_keys + count);
+        }));
+        // Passes are read after each measurement, argument order would leave them unspecified.
+        Bench::Measurement serial = measure_step([&]() {
+            batch.sort_passes = sort_sprite_keys(batch.keys, batch.sprites, batch.scratch_keys, batch.scratch_sprites, batch.histograms, batch.max_chunks, batch.count);
+        });
+        report(mix.name, "radix sort", batch.sort_passes, serial);
+        Bench::Measurement parallel = measure_step([&]() {
+            batch.sort_passes = sort_sprite_keys(batch.keys, batch.sprites, batch.scratch_keys, batch.scratch_sprites, batch.histograms, batch.max_chunks,
+                                                 batch.count, &bench_job_system);
+        });
+        report(mix.name, "radix sort (jobs)", batch.sort_passes, parallel);
+
+        // The batch is left sorted by the last sample, so these run on the real thing.
+        bool built = true;
+        Bench::Measurement build = Bench::measure([&]() {
+            built &= build_sprite_runs(&batch);
+        });
+        valid &= built && sprite_runs_valid(&batch);
+        report(mix.name, "build runs", batch.sort_passes, build);
+        report(mix.name, "gather instances (jobs)", batch.sort_passes, Bench::measure([&]() {
+            gather_sprites(&batch, instances, sorted, &bench_job_system);
+            Bench::do_not_optimize(sorted[count - 1]);
+        }));
+        Bench::Measurement whole = measure_step([&]() {
+            built &= end_sprite_batch(&batch, &bench_job_system);
+        });
+        report(mix.name, "end_sprite_batch (jobs)", batch.sort_passes, whole);
+        valid &= built && std::is_sorted(batch.keys, batch.keys + count);
+    }
+
+    // A state change is a pipeline bind or, without batching, a separate draw. Sorted, every group binds once and
+    // issues one multi-draw with a command per run.
+    printf("\n%10s %12s %18s %14s %14s\n", "mix", "sprites", "unsorted changes", "sorted binds", "draw commands");
+    for(const SpriteKeyMix& mix : SPRITE_KEY_MIXES) {
+        generate_sprite_keys(mix, keys, count, DEFAULT_SIMULATION_SEED + 1);
+        fill_sprite_batch(&batch, keys, count);
+        valid &= end_sprite_batch(&batch, &bench_job_system);
+        printf("%10s %12u %18u %14u %14u\n", mix.name, count, unsorted_state_changes(keys, count), batch.group_count, batch.run_count);
+        valid &= batch.run_count <= mix.layers * mix.pipelines * mix.textures && batch.group_count <= mix.layers * mix.pipelines;
+    }
+    bench_job_system.shutdown();
+
+    printf("valid: %s\n", valid ? "yes" : "NO");
+    OL::Buffer::release(storage);
+}
\ No newline at end of file
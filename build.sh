@@ -0,0 +1,57 @@
+#!/usr/bin/env bash
+
+# Linux build for the headless targets. The windowed client is still built with build.bat.
+# Usage: ./build.sh [-r] [target...]
+
+compiler="${CXX:-g++}"
+compiler_options="-std=c++20 -Wall -Wextra -Wno-missing-field-initializers -pthread"
+debug_options="-O0 -g"
+release_options="-O2"
+# stb_image is header-only, point STB_DIR at it if it isn't in the distro location.
+includes="-Iexternal -Isrc -isystem ${STB_DIR:-/usr/include/stb}"
+output_directory="build"
+
+declare -A targets=(
+    [bench]="bench/bench.cpp"
+    [cooker]="tools/cooker.cpp"
+)
+
+build_options="$debug_options"
+if [ "$1" == "-r" ]; then
+    echo "Release configuration"
+    build_options="$release_options"
+    shift
+else
+    echo "Debug configuration"
+fi
+
+selected_targets=("$@")
+if [ ${#selected_targets[@]} -eq 0 ]; then
+    selected_targets=("${!targets[@]}")
+fi
+
+mkdir -p "$output_directory"
+
+build_result=0
+for target in "${selected_targets[@]}"; do
+    source_file="${targets[$target]}"
+    if [ -z "$source_file" ]; then
+        echo "Unknown target: $target"
+        build_result=1
+        continue
+    fi
+
+    echo "Building $target..."
+    echo "[$compiler_options $build_options]"
+    if ! $compiler $compiler_options $build_options $includes "$source_file" -o "$output_directory/$target"; then
+        build_result=1
+    fi
+done
+
+if [ $build_result -eq 0 ]; then
+    echo "Build successful."
+else
+    echo "Build failed."
+fi
+
+exit $build_result
@@ -4,8 +4,11 @@
 #include "orshlib/random.h"
 #include "orshlib/util.h"
 #include "orshlib/math.h"
+#include "orshlib/simd.h"
 #include "orshlib/log.h"
 #include "orshlib/memory.h"
 #include "orshlib/time.h"
 #include "orshlib/session.h"
-#include "orshlib/file.h"
\ No newline at end of file
+#include "orshlib/file.h"
+#include "orshlib/jobs.h"
+#include "orshlib/profiler.h"
\ No newline at end of file
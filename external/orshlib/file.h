@@ -2,21 +2,181 @@
 
 #include "memory.h"
 #include "util.h"
+#include "jobs.h"
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include <thread>
 
 #ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
+#endif
 #include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 namespace OL {
 
+    // fopen_s/strerror_s only exist on MSVC, everything else goes through plain fopen.
+    [[nodiscard]] static FILE* open_file_stream(const char* path, const char* mode, const char* caller) {
+        FILE* stream = nullptr;
+        char error_string[128];
+#ifdef _WIN32
+        s32 result = fopen_s(&stream, path, mode);
+        if(result != 0) {
+            strerror_s(error_string, 128, result);
+#else
+        stream = fopen(path, mode);
+        if(!stream) {
+            snprintf(error_string, 128, "%s", strerror(errno));
+#endif
+            Logger::log(Logger::LEVEL_ERROR, "[%s] Unable to open %s...%s\n", caller, path, error_string);
+            return nullptr;
+        }
+
+        return stream;
+    }
+
+    // View of a whole file mapped into the address space. Nothing is copied until pages are touched. A copy-on-write
+    // mapping can also be written, each page is copied the first time it is and the file itself never changes.
+    struct MappedFile {
+        u8* data;
+        size_t size;
+#ifdef _WIN32
+        HANDLE file;
+        HANDLE mapping;
+#endif
+
+        [[nodiscard]] static bool map(const char* path, MappedFile* mapped, bool copy_on_write = false) {
+            *mapped = {};
+#ifdef _WIN32
+            mapped->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if(mapped->file == INVALID_HANDLE_VALUE) {
+                Logger::log(Logger::LEVEL_ERROR, "[MappedFile::map()] Unable to open %s.", path);
+                return false;
+            }
+
+            LARGE_INTEGER file_size;
+            if(!GetFileSizeEx(mapped->file, &file_size) || file_size.QuadPart == 0) {
+                CloseHandle(mapped->file);
+                Logger::log(Logger::LEVEL_ERROR, "[MappedFile::map()] %s is empty or its size is unavailable.", path);
+                return false;
+            }
+
+            mapped->mapping = CreateFileMappingA(mapped->file, nullptr, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+            void* view = mapped->mapping ? MapViewOfFile(mapped->mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if(!view) {
+                if(mapped->mapping) {
+                    CloseHandle(mapped->mapping);
+                }
+                CloseHandle(mapped->file);
+                Logger::log(Logger::LEVEL_ERROR, "[MappedFile::map()] Unable to map %s.", path);
+                return false;
+            }
+
+            mapped->data = static_cast<u8*>(view);
+            mapped->size = static_cast<size_t>(file_size.QuadPart);
+#else
+            s32 descriptor = open(path, O_RDONLY);
+            if(descriptor < 0) {
+                Logger::log(Logger::LEVEL_ERROR, "[MappedFile::map()] Unable to open %s...%s", path, strerror(errno));
+                return false;
+            }
+
+            struct stat file_stat;
+            if(fstat(descriptor, &file_stat) != 0 || file_stat.st_size == 0) {
+                close(descriptor);
+                Logger::log(Logger::LEVEL_ERROR, "[MappedFile::map()] %s is empty or its size is unavailable.", path);
+                return false;
+            }
+
+            s32 protection = copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ;
+            void* view = mmap(nullptr, static_cast<size_t>(file_stat.st_size), protection, MAP_PRIVATE, descriptor, 0);
+            close(descriptor);
+            if(view == MAP_FAILED) {
+                Logger::log(Logger::LEVEL_ERROR, "[MappedFile::map()] Unable to map %s...%s", path, strerror(errno));
+                return false;
+            }
+
+            // Callers stream through the mapping front to back. The advice values aren't flags, so each is its own call.
+            madvise(view, static_cast<size_t>(file_stat.st_size), MADV_SEQUENTIAL);
+            madvise(view, static_cast<size_t>(file_stat.st_size), MADV_WILLNEED);
+
+            mapped->data = static_cast<u8*>(view);
+            mapped->size = static_cast<size_t>(file_stat.st_size);
+#endif
+            return true;
+        }
+
+        void unmap() {
+            if(!data) {
+                return;
+            }
+#ifdef _WIN32
+            UnmapViewOfFile(data);
+            CloseHandle(mapping);
+            CloseHandle(file);
+#else
+            munmap(data, size);
+#endif
+            *this = {};
+        }
+    };
+
+    // Size of the file behind an open stream, without seeking through it.
+    [[nodiscard]] static bool stream_size(FILE* stream, size_t* size) {
+#ifdef _WIN32
+        struct _stat64 file_stat;
+        if(_fstat64(_fileno(stream), &file_stat) != 0) {
+            return false;
+        }
+#else
+        struct stat file_stat;
+        if(fstat(fileno(stream), &file_stat) != 0) {
+            return false;
+        }
+#endif
+        *size = static_cast<size_t>(file_stat.st_size);
+        return true;
+    }
+
+    // A whole file's bytes, read-only. Large files are mapped so nothing is copied, small ones are read into memory
+    // where one read beats the cost of setting up and tearing down a mapping. data is null when the file couldn't
+    // be loaded.
+    struct FileView {
+        const u8* data;
+        size_t size;
+        MappedFile mapping;
+        // Set when the bytes were read into a heap allocation the view owns.
+        u8* allocation;
+
+        [[nodiscard]] bool mapped() const {
+            return mapping.data != nullptr;
+        }
+
+        // Unmaps or frees whatever backs the view. Bytes read into a caller's buffer stay where they are.
+        void release() {
+            mapping.unmap();
+            free(allocation);
+            *this = {};
+        }
+    };
+
     struct File {
 #ifdef _WIN32
         static constexpr size_t MAX_FILENAME_LENGTH = MAX_PATH;
 #else
         static constexpr size_t MAX_FILENAME_LENGTH = 256;
 #endif
+        // Files from this size up are mapped by view(). Below it a plain read is cheaper than the mapping's
+        // syscalls, page faults and unmap, the two break even around here (see bench_file.h).
+        static constexpr size_t MAPPED_FILE_MIN_SIZE = KB(256);
 
         char name[MAX_FILENAME_LENGTH];
         Buffer* buffer;
@@ -29,56 +189,109 @@ namespace OL {
             return buffer->allocated;
         };
 
+        // Copies the whole file into a slice of buffer. Nothing stays reserved in buffer when it fails.
         [[nodiscard]] static File* load(const char* path, Buffer* buffer = memory.temporary) {
             if(!buffer) {
                 Logger::log(Logger::LEVEL_ERROR, "[File::load()] Invalid buffer provided, no space to load file.");
                 return nullptr;
             }
 
-            File* handle = buffer->reserve<File>();
-            FILE* stream;
+            FILE* stream = open_file_stream(path, "rb", "File::load()");
+            if(!stream) {
+                return nullptr;
+            }
+
+            Buffer::Marker marker = buffer->mark();
+            File* handle = nullptr;
+            size_t file_size = 0;
+            const char* error = nullptr;
+            if(!stream_size(stream, &file_size) || file_size == 0) {
+                error = "is empty or its size is unavailable";
+            } else if(buffer->bytes_remaining() < sizeof(File) + sizeof(Buffer) + file_size + alignof(File) + alignof(Buffer)) {
+                error = "doesn't fit in the buffer";
+            } else {
+                handle = buffer->reserve<File>();
+                Buffer* contents = handle ? Buffer::slice(buffer, file_size) : nullptr;
+                if(!contents) {
+                    error = "doesn't fit in the buffer";
+                } else {
+                    snprintf(handle->name, MAX_FILENAME_LENGTH, "%s", path);
+                    handle->buffer = contents;
+                    contents->allocated = fread(contents->data, sizeof(u8), file_size, stream);
+                    if(contents->allocated != file_size) {
+                        error = "failed to read all file data";
+                    }
+                }
+            }
+            fclose(stream);
 
-            s32 result = fopen_s(&stream, path, "rb");
-            if(result != 0) {
-                char error_string[128];
-                strerror_s(error_string, 128, result);
-                Logger::log(Logger::LEVEL_ERROR, "[File::load()] Unable to open %s...%s\n", path, error_string);
+            if(error) {
+                Logger::log(Logger::LEVEL_ERROR, "[File::load()] %s %s.", path, error);
+                buffer->rewind(marker);
                 return nullptr;
             }
 
-            memcpy_s(handle->name, MAX_FILENAME_LENGTH, path, string_length(path) + 1);
+            return handle;
+        }
 
-            fseek(stream, 0, SEEK_END);
-            size_t file_size = ftell(stream);
-            rewind(stream);
+        // Fills view with the file's bytes: mapped from MAPPED_FILE_MIN_SIZE up, otherwise read into buffer, or into a
+        // heap allocation the view owns when buffer is null. A file that can't be mapped is read instead.
+        [[nodiscard]] static bool view(const char* path, FileView* view, Buffer* buffer = nullptr) {
+            *view = {};
+#ifdef _WIN32
+            struct _stat64 file_stat;
+            bool found = _stat64(path, &file_stat) == 0;
+#else
+            struct stat file_stat;
+            bool found = stat(path, &file_stat) == 0;
+#endif
+            if(!found || file_stat.st_size <= 0) {
+                Logger::log(Logger::LEVEL_ERROR, "[File::view()] %s is missing or empty.", path);
+                return false;
+            }
 
-            handle->buffer = Buffer::slice(buffer, file_size);
-            if(!handle->buffer->data) {
-                return nullptr;
+            size_t file_size = static_cast<size_t>(file_stat.st_size);
+            if(file_size >= MAPPED_FILE_MIN_SIZE && MappedFile::map(path, &view->mapping)) {
+                view->data = view->mapping.data;
+                view->size = view->mapping.size;
+                return true;
             }
 
-            size_t bytes_read = fread_s(handle->buffer->data, handle->buffer->capacity, sizeof(u8), handle->buffer->capacity, stream);
-            if(bytes_read != handle->buffer->capacity) {
-                Logger::log(Logger::LEVEL_ERROR, "[File::load()] Failed to read all file data.");
-                return nullptr;
+            FILE* stream = open_file_stream(path, "rb", "File::view()");
+            if(!stream) {
+                return false;
             }
 
-            handle->buffer->allocated = bytes_read;
+            Buffer::Marker marker = buffer ? buffer->mark() : Buffer::Marker{};
+            u8* destination = nullptr;
+            if(buffer) {
+                destination = buffer->bytes_remaining() >= file_size ? buffer->reserve(file_size) : nullptr;
+            } else {
+                view->allocation = static_cast<u8*>(malloc(file_size));
+                destination = view->allocation;
+            }
 
+            size_t bytes_read = destination ? fread(destination, sizeof(u8), file_size, stream) : 0;
             fclose(stream);
+            if(bytes_read != file_size) {
+                Logger::log(Logger::LEVEL_ERROR, "[File::view()] Unable to read %zu bytes of %s.", file_size, path);
+                if(buffer) {
+                    buffer->rewind(marker);
+                }
+                view->release();
+                return false;
+            }
 
-            return handle;
+            view->data = destination;
+            view->size = file_size;
+            return true;
         }
 
         static size_t write_to_file(const char* path, Buffer* buffer, size_t offset, size_t bytes) {
             size_t bytes_written = 0;
 
-            FILE* stream;
-            s32 result = fopen_s(&stream, path, "wb");
-            if(result != 0) {
-                char error_string[128];
-                strerror_s(error_string, 128, result);
-                Logger::log(Logger::LEVEL_ERROR, "[File::load()] Unable to open %s...%s\n", path, error_string);
+            FILE* stream = open_file_stream(path, "wb", "File::write_to_file()");
+            if(!stream) {
                 return 0;
             }
 
@@ -88,4 +301,82 @@ namespace OL {
             return bytes_written;
         }
     };
+
+    static constexpr u32 MAX_FILE_READ_BATCH = 256;
+    // Smallest page on every target, touching one byte per this many faults a whole mapping in.
+    static constexpr size_t FILE_PAGE_SIZE = KB(4);
+
+    // Reads a set of files on the job system, one job per file, into views that own their bytes. Each index is
+    // pushed to completed as soon as its file is in, so the consumer can start on it while the rest are still being
+    // read. A failed read is still pushed, with a null view. Blocking reads on the pool rather than io_uring or
+    // overlapped I/O: the files are few and mostly mapped, so the syscalls are cheap next to the page faults, which
+    // the worker touching the mapping also takes off the consumer's thread.
+    struct FileReadBatch {
+        const char* const* paths;
+        FileView* views;
+        u32 count;
+        u32 received;
+        JobCounter counter;
+        Job jobs[MAX_FILE_READ_BATCH];
+        MPSCQueue<u32, MAX_FILE_READ_BATCH> completed;
+    };
+
+    static void read_file_job(void* context, size_t begin, size_t end) {
+        FileReadBatch* batch = static_cast<FileReadBatch*>(context);
+        for(size_t file_index = begin; file_index < end; ++file_index) {
+            FileView* view = &batch->views[file_index];
+            if(File::view(batch->paths[file_index], view)) {
+                // Faults the pages in here rather than on whichever thread reads them first.
+                volatile u8 touched = 0;
+                for(size_t offset = 0; offset < view->size; offset += FILE_PAGE_SIZE) {
+                    touched = touched ^ view->data[offset];
+                }
+            }
+            bool queued = batch->completed.push(static_cast<u32>(file_index));
+            assert(queued);
+        }
+    }
+
+    // paths and views must stay valid until every index has come out of the batch.
+    [[nodiscard, maybe_unused]] static bool start_file_read_batch(FileReadBatch* batch, JobSystem* job_system, const char* const* paths, FileView* views, u32 count) {
+        if(count > MAX_FILE_READ_BATCH) {
+            Logger::log(Logger::LEVEL_ERROR, "[start_file_read_batch()] %u files requested, the limit is %u.", count, MAX_FILE_READ_BATCH);
+            return false;
+        }
+
+        assert(batch->counter.done());
+        batch->paths = paths;
+        batch->views = views;
+        batch->count = count;
+        batch->received = 0;
+        batch->completed.reset();
+
+        for(u32 file_index = 0; file_index < count; ++file_index) {
+            views[file_index] = {};
+            batch->jobs[file_index] = {
+                .function = read_file_job,
+                .context = batch,
+                .begin = file_index,
+                .end = file_index + 1
+            };
+        }
+        job_system->submit(batch->jobs, count, &batch->counter);
+
+        return true;
+    }
+
+    // Hands out the next finished file, helping with queued jobs while none is ready. Returns false once every file
+    // of the batch has been handed out.
+    [[nodiscard, maybe_unused]] static bool next_file_read(FileReadBatch* batch, JobSystem* job_system, u32* file_index) {
+        while(batch->received < batch->count) {
+            if(batch->completed.pop(file_index)) {
+                ++batch->received;
+                return true;
+            }
+            if(!job_system->try_run_job()) {
+                std::this_thread::yield();
+            }
+        }
+        return false;
+    }
 }
\ No newline at end of file
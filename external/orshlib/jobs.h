@@ -0,0 +1,408 @@
+#pragma once
+
+#include "types.h"
+#include "log.h"
+#include "memory.h"
+#include "simd.h"
+#include <atomic>
+#include <thread>
+#include <type_traits>
+
+namespace OL {
+
+    struct JobCounter {
+        std::atomic<u32> pending = 0;
+        // Set by submit_background(), so wait() on this counter knows it may run background jobs.
+        bool background = false;
+
+        [[nodiscard]] bool done() {
+            return pending.load(std::memory_order_acquire) == 0;
+        }
+    };
+
+    // A unit of work over [begin, end). The memory is owned by whoever submitted it and must stay valid
+    // until its counter reaches zero; the system only passes pointers around.
+    struct Job {
+        void (*function)(void* context, size_t begin, size_t end);
+        void* context;
+        size_t begin;
+        size_t end;
+        JobCounter* counter;
+    };
+
+    // Chase-Lev work-stealing deque. The owning thread pushes and pops at the bottom, other threads steal from the top.
+    struct JobDeque {
+        static constexpr s64 CAPACITY = 256;
+        static constexpr s64 MASK = CAPACITY - 1;
+        static_assert((CAPACITY & MASK) == 0, "JobDeque capacity must be a power of two");
+
+        alignas(CACHE_LINE_SIZE) std::atomic<s64> top = 0;
+        alignas(CACHE_LINE_SIZE) std::atomic<s64> bottom = 0;
+        alignas(CACHE_LINE_SIZE) std::atomic<Job*> slots[CAPACITY] = {};
+
+        [[nodiscard]] bool push(Job* job) {
+            s64 b = bottom.load(std::memory_order_relaxed);
+            s64 t = top.load(std::memory_order_acquire);
+            if(b - t >= CAPACITY) {
+                return false;
+            }
+
+            slots[b & MASK].store(job, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_release);
+            return true;
+        }
+
+        [[nodiscard]] Job* pop() {
+            s64 b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            s64 t = top.load(std::memory_order_relaxed);
+
+            if(t > b) {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            Job* job = slots[b & MASK].load(std::memory_order_relaxed);
+            if(t == b) {
+                // Last job left, race any thieves for it.
+                if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    job = nullptr;
+                }
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+
+            return job;
+        }
+
+        [[nodiscard]] Job* steal() {
+            s64 t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            s64 b = bottom.load(std::memory_order_acquire);
+            if(t >= b) {
+                return nullptr;
+            }
+
+            Job* job = slots[t & MASK].load(std::memory_order_relaxed);
+            if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr;
+            }
+
+            return job;
+        }
+    };
+
+    // Bounded multi-producer, single-consumer queue (Vyukov's sequenced ring) for handing results from jobs
+    // back to one thread. Each cell's sequence says whose turn it is: producers claim a cell by bumping the tail,
+    // and the consumer only reads a cell once the producer that claimed it has published its value.
+    template<typename T, u32 CAPACITY>
+    struct MPSCQueue {
+        static constexpr u32 MASK = CAPACITY - 1;
+        static_assert(CAPACITY >= 2 && (CAPACITY & MASK) == 0, "MPSCQueue capacity must be a power of two");
+
+        struct Cell {
+            std::atomic<u32> sequence;
+            T value;
+        };
+
+        alignas(CACHE_LINE_SIZE) std::atomic<u32> tail = 0;
+        alignas(CACHE_LINE_SIZE) u32 head = 0;
+        alignas(CACHE_LINE_SIZE) Cell cells[CAPACITY];
+
+        // Must run before the first push, and only while no producer is active.
+        void reset() {
+            for(u32 i = 0; i < CAPACITY; ++i) {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+            tail.store(0, std::memory_order_relaxed);
+            head = 0;
+        }
+
+        // Returns false when the queue is full.
+        [[nodiscard]] bool push(T value) {
+            u32 position = tail.load(std::memory_order_relaxed);
+            for(;;) {
+                Cell* cell = &cells[position & MASK];
+                s32 difference = static_cast<s32>(cell->sequence.load(std::memory_order_acquire) - position);
+                if(difference == 0) {
+                    if(tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        cell->value = value;
+                        cell->sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if(difference < 0) {
+                    return false;
+                } else {
+                    position = tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Consumer only. Reads the oldest published value without removing it.
+        [[nodiscard]] bool peek(T* value) {
+            Cell* cell = &cells[head & MASK];
+            if(cell->sequence.load(std::memory_order_acquire) != head + 1) {
+                return false;
+            }
+
+            *value = cell->value;
+            return true;
+        }
+
+        // Consumer only.
+        [[nodiscard]] bool pop(T* value) {
+            if(!peek(value)) {
+                return false;
+            }
+
+            cells[head & MASK].sequence.store(head + CAPACITY, std::memory_order_release);
+            ++head;
+            return true;
+        }
+    };
+
+    // Fixed pool of workers, each with its own deque. The thread that calls init() owns deque 0 and takes
+    // part in the work whenever it waits on a counter. Threads that are neither run their jobs inline.
+    //
+    // Background jobs (streaming decodes and the like) go to a separate queue that workers only take from when their
+    // deques are empty. wait() leaves them alone unless it waits on their own counter, so a frame's parallel_for never
+    // picks up a whole decode. try_run_job() takes them, for a thread that has to push them along itself.
+    struct JobSystem {
+        static constexpr u32 MAX_WORKERS = 63;
+        static constexpr u32 MAX_JOBS_PER_PARALLEL_FOR = JobDeque::CAPACITY;
+        static constexpr u32 SPINS_BEFORE_SLEEP = 256;
+        static constexpr u32 NOT_A_WORKER = ~0u;
+
+        JobDeque deques[MAX_WORKERS + 1];
+        // Only ever stolen from, pushes are serialized by background_lock.
+        JobDeque background;
+        std::atomic_flag background_lock;
+        std::thread threads[MAX_WORKERS];
+        u32 worker_count = 0;
+        std::atomic<bool> running = false;
+        std::atomic<u32> work_epoch = 0;
+
+        [[nodiscard]] static u32& thread_index() {
+            thread_local u32 index = NOT_A_WORKER;
+            return index;
+        }
+
+        [[nodiscard]] static u32 default_worker_count() {
+            u32 hardware_threads = std::thread::hardware_concurrency();
+            return hardware_threads > 1 ? hardware_threads - 1 : 0;
+        }
+
+        void init(u32 workers = default_worker_count()) {
+            assert(!running.load());
+            if(workers > MAX_WORKERS) {
+                Logger::log(Logger::LEVEL_ERROR, "[JobSystem::init()] %u workers requested, clamping to %u.", workers, MAX_WORKERS);
+                workers = MAX_WORKERS;
+            }
+
+            worker_count = workers;
+            running.store(true);
+            thread_index() = 0;
+
+            for(u32 i = 0; i < worker_count; ++i) {
+                threads[i] = std::thread([this, i]() {
+                    worker_main(i + 1);
+                });
+            }
+        }
+
+        void shutdown() {
+            if(!running.exchange(false)) {
+                return;
+            }
+
+            wake_workers();
+            for(u32 i = 0; i < worker_count; ++i) {
+                threads[i].join();
+            }
+            worker_count = 0;
+            thread_index() = NOT_A_WORKER;
+        }
+
+        [[nodiscard]] u32 thread_count() {
+            return worker_count + 1;
+        }
+
+        // Queues jobs on the calling thread's deque. Jobs that don't fit, or come from a thread outside the pool, run inline.
+        void submit(Job* jobs, u32 count, JobCounter* counter) {
+            counter->pending.fetch_add(count, std::memory_order_relaxed);
+
+            u32 index = thread_index();
+            for(u32 i = 0; i < count; ++i) {
+                jobs[i].counter = counter;
+                if(index == NOT_A_WORKER || !running.load(std::memory_order_relaxed) || !deques[index].push(&jobs[i])) {
+                    execute(&jobs[i]);
+                }
+            }
+
+            wake_workers();
+        }
+
+        // Queues jobs on the background queue. Any thread may call this. Jobs that don't fit, or come while the pool
+        // isn't running, run inline.
+        void submit_background(Job* jobs, u32 count, JobCounter* counter) {
+            counter->background = true;
+            counter->pending.fetch_add(count, std::memory_order_relaxed);
+
+            for(u32 i = 0; i < count; ++i) {
+                jobs[i].counter = counter;
+                bool queued = false;
+                if(running.load(std::memory_order_relaxed)) {
+                    while(background_lock.test_and_set(std::memory_order_acquire)) {
+                        pause();
+                    }
+                    queued = background.push(&jobs[i]);
+                    background_lock.clear(std::memory_order_release);
+                }
+                if(!queued) {
+                    execute(&jobs[i]);
+                }
+            }
+
+            wake_workers();
+        }
+
+        // Runs queued jobs on the calling thread until the counter drains. Background jobs only when the counter is
+        // one of theirs.
+        void wait(JobCounter* counter) {
+            u32 spins = 0;
+            while(!counter->done()) {
+                Job* job = find_job(thread_index());
+                if(!job && counter->background && thread_index() != NOT_A_WORKER) {
+                    job = background.steal();
+                }
+                if(job) {
+                    execute(job);
+                    spins = 0;
+                } else if(++spins < SPINS_BEFORE_SLEEP) {
+                    pause();
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        // Runs at most one queued job on the calling thread without blocking. Lets a thread that never waits, such as
+        // the main loop on a machine without workers, still make progress on background jobs it submitted.
+        [[nodiscard]] bool try_run_job() {
+            Job* job = find_job(thread_index());
+            if(!job && thread_index() != NOT_A_WORKER) {
+                job = background.steal();
+            }
+            if(!job) {
+                return false;
+            }
+
+            execute(job);
+            return true;
+        }
+
+        // Splits [begin, end) into jobs of `grain` items and blocks until all of them ran.
+        // When the range needs more than MAX_JOBS_PER_PARALLEL_FOR jobs the grain grows in whole multiples,
+        // so chunk boundaries keep whatever alignment the caller chose.
+        template<typename Body>
+        void parallel_for(size_t begin, size_t end, size_t grain, Body&& body) {
+            if(end <= begin) {
+                return;
+            }
+
+            assert(grain > 0);
+            size_t range = end - begin;
+            size_t job_count = (range + grain - 1) / grain;
+            if(job_count > MAX_JOBS_PER_PARALLEL_FOR) {
+                size_t multiple = (job_count + MAX_JOBS_PER_PARALLEL_FOR - 1) / MAX_JOBS_PER_PARALLEL_FOR;
+                grain *= multiple;
+                job_count = (range + grain - 1) / grain;
+            }
+
+            if(job_count == 1 || worker_count == 0) {
+                body(begin, end);
+                return;
+            }
+
+            using BodyType = std::remove_reference_t<Body>;
+            Job jobs[MAX_JOBS_PER_PARALLEL_FOR];
+            for(size_t i = 0; i < job_count; ++i) {
+                size_t job_begin = begin + i * grain;
+                size_t job_end = job_begin + grain < end ? job_begin + grain : end;
+                jobs[i] = {
+                    .function = [](void* context, size_t job_begin, size_t job_end) {
+                        (*static_cast<BodyType*>(context))(job_begin, job_end);
+                    },
+                    .context = const_cast<void*>(static_cast<const void*>(&body)),
+                    .begin = job_begin,
+                    .end = job_end
+                };
+            }
+
+            JobCounter counter;
+            submit(jobs, static_cast<u32>(job_count), &counter);
+            wait(&counter);
+        }
+
+        static void execute(Job* job) {
+            JobCounter* counter = job->counter;
+            job->function(job->context, job->begin, job->end);
+            counter->pending.fetch_sub(1, std::memory_order_release);
+        }
+
+        static void pause() {
+#if OL_SIMD_X86
+            _mm_pause();
+#endif
+        }
+
+        [[nodiscard]] Job* find_job(u32 index) {
+            if(index == NOT_A_WORKER) {
+                return nullptr;
+            }
+
+            Job* job = deques[index].pop();
+            if(job) {
+                return job;
+            }
+
+            u32 thread_total = thread_count();
+            for(u32 offset = 1; offset < thread_total; ++offset) {
+                job = deques[(index + offset) % thread_total].steal();
+                if(job) {
+                    return job;
+                }
+            }
+
+            return nullptr;
+        }
+
+        void wake_workers() {
+            work_epoch.fetch_add(1, std::memory_order_release);
+            work_epoch.notify_all();
+        }
+
+        void worker_main(u32 index) {
+            thread_index() = index;
+
+            u32 spins = 0;
+            while(running.load(std::memory_order_relaxed)) {
+                // Read the epoch before looking for work so a submit that lands in between still wakes us.
+                u32 epoch = work_epoch.load(std::memory_order_acquire);
+                Job* job = find_job(index);
+                if(!job) {
+                    job = background.steal();
+                }
+                if(job) {
+                    execute(job);
+                    spins = 0;
+                } else if(++spins < SPINS_BEFORE_SLEEP) {
+                    pause();
+                } else {
+                    work_epoch.wait(epoch, std::memory_order_acquire);
+                    spins = 0;
+                }
+            }
+        }
+    };
+}
\ No newline at end of file
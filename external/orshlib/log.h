@@ -1,6 +1,15 @@
 #pragma once
 
+#include "types.h"
+#include <atomic>
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 
 namespace OL {
     namespace Logger {
@@ -29,15 +38,413 @@ namespace OL {
             }
         };
 
+        // Formats and prints to stream on the calling thread. What log() does until start_async(), after stop_async()
+        // and for errors.
+        template<typename... Args>
+        static void log_sync(FILE* stream, LogLevel message_level, const char* format, Args... args) {
+            char buffer[MAX_LOG_MESSAGE_LENGTH];
+            snprintf(buffer, MAX_LOG_MESSAGE_LENGTH, "%s%s\n", log_level_to_string(message_level), format);
+            fprintf(stream, buffer, args...);
+        }
+
+        // What a caller does when its ring is full: DROP counts the message and moves on, BLOCK waits for the writer.
+        enum class OverflowPolicy {
+            DROP,
+            BLOCK
+        };
+
+        struct LogRecord;
+        using FormatRecord = s32 (*)(const LogRecord* record, char* output, size_t capacity);
+
+        // Header of one message in a ring, followed by its raw arguments. Formatting waits for the writer thread, which
+        // is why format must be a string literal. A null format marks padding up to the end of the ring.
+        struct LogRecord {
+            u32 size;
+            u32 level;
+            s64 timestamp;
+            const char* format;
+            FormatRecord format_record;
+        };
+
+        static constexpr size_t LOG_RECORD_ALIGNMENT = alignof(LogRecord);
+
+        // Strings are copied into the record, callers' buffers are often gone by the time it is formatted. Everything
+        // else is stored as its bytes.
+        template<typename T>
+        static constexpr bool IS_LOG_STRING = std::is_same_v<T, const char*> || std::is_same_v<T, char*>;
+
+        template<typename T>
+        [[nodiscard]] static size_t log_argument_size(T value) {
+            if constexpr(IS_LOG_STRING<T>) {
+                return sizeof(u32) + strlen(value ? value : "(null)") + 1;
+            } else {
+                static_assert(std::is_trivially_copyable_v<T>, "Log arguments are copied as raw bytes");
+                return sizeof(T);
+            }
+        }
+
+        template<typename T>
+        static void write_log_argument(u8** cursor, T value) {
+            if constexpr(IS_LOG_STRING<T>) {
+                const char* string = value ? value : "(null)";
+                u32 length = static_cast<u32>(strlen(string) + 1);
+                memcpy(*cursor, &length, sizeof(u32));
+                memcpy(*cursor + sizeof(u32), string, length);
+                *cursor += sizeof(u32) + length;
+            } else {
+                memcpy(*cursor, &value, sizeof(T));
+                *cursor += sizeof(T);
+            }
+        }
+
+        template<typename T>
+        [[nodiscard]] static T read_log_argument(const u8** cursor) {
+            if constexpr(IS_LOG_STRING<T>) {
+                u32 length;
+                memcpy(&length, *cursor, sizeof(u32));
+                T string = const_cast<T>(reinterpret_cast<const char*>(*cursor + sizeof(u32)));
+                *cursor += sizeof(u32) + length;
+                return string;
+            } else {
+                T value;
+                memcpy(&value, *cursor, sizeof(T));
+                *cursor += sizeof(T);
+                return value;
+            }
+        }
+
+        template<typename... Args>
+        static s32 format_log_record(const LogRecord* record, char* output, size_t capacity) {
+            [[maybe_unused]] const u8* cursor = reinterpret_cast<const u8*>(record + 1);
+            // Braced initialization reads the arguments in order.
+            std::tuple<Args...> arguments{ read_log_argument<Args>(&cursor)... };
+            return std::apply([&](auto... values) { return snprintf(output, capacity, record->format, values...); }, arguments);
+        }
+
+        // One producer thread's ring. read and write count bytes ever consumed and produced, on their own lines.
+        // flushed trails read: it only moves once the records before it have been written out and flushed.
+        struct LogRing {
+            alignas(64) std::atomic<u64> read;
+            std::atomic<u64> flushed;
+            alignas(64) std::atomic<u64> write;
+            u8* data;
+        };
+
+        // log() from any thread pushes a record into that thread's ring: a format pointer, the raw arguments and a
+        // timestamp, with no locks and no formatting. One writer thread merges the rings in timestamp order, formats
+        // and writes in batches, so a slow stdout stalls the writer instead of the caller.
+        struct AsyncLogger {
+            static constexpr size_t DEFAULT_RING_BYTES = 1 << 16;
+            static constexpr u32 DEFAULT_MAX_THREADS = 64;
+            static constexpr size_t BATCH_BYTES = 1 << 16;
+            // Longest formatted message, anything past it is cut.
+            static constexpr size_t MAX_FORMATTED_LENGTH = 4096;
+            static constexpr std::chrono::milliseconds IDLE_INTERVAL = std::chrono::milliseconds(1);
+            static constexpr u32 NOT_REGISTERED = ~0u;
+
+            LogRing* rings = nullptr;
+            u8* ring_storage = nullptr;
+            char* batch = nullptr;
+            size_t ring_bytes = 0;
+            u32 max_threads = 0;
+            OverflowPolicy policy = OverflowPolicy::DROP;
+            // Where log() prints, synchronously too while async is running. Back to stdout after stop_async(), since
+            // the caller may close its stream then.
+            FILE* output = stdout;
+            std::atomic<u32> thread_count = 0;
+            std::atomic<u64> dropped = 0;
+            std::atomic<bool> running = false;
+            std::atomic<bool> stopping = false;
+            // Threads inside push(), stop_async() waits for them before it frees the rings.
+            std::atomic<u32> producers = 0;
+            // Bumped by every start so threads registered with an earlier run register again.
+            u32 generation = 0;
+            bool exit_hook_registered = false;
+            std::thread writer;
+
+            [[nodiscard]] static s64 timestamp() {
+                return std::chrono::steady_clock::now().time_since_epoch().count();
+            }
+
+            // The calling thread's ring, registering it on first use. nullptr once every slot is taken.
+            [[nodiscard]] LogRing* current_ring() {
+                struct Registration {
+                    u32 generation;
+                    u32 slot;
+                };
+                thread_local Registration registration = { 0, NOT_REGISTERED };
+
+                if(registration.generation != generation) {
+                    u32 slot = thread_count.fetch_add(1, std::memory_order_relaxed);
+                    registration = { generation, slot < max_threads ? slot : NOT_REGISTERED };
+                }
+
+                return registration.slot == NOT_REGISTERED ? nullptr : &rings[registration.slot];
+            }
+
+            // False when the message can't go through a ring, the caller prints it itself then.
+            template<typename... Args>
+            [[nodiscard]] bool push(LogLevel level, const char* format, Args... args) {
+                LogRing* ring = current_ring();
+                if(!ring) {
+                    return false;
+                }
+
+                size_t payload = (static_cast<size_t>(0) + ... + log_argument_size(args));
+                size_t size = (sizeof(LogRecord) + payload + LOG_RECORD_ALIGNMENT - 1) & ~(LOG_RECORD_ALIGNMENT - 1);
+                if(size > ring_bytes / 4) {
+                    return false;
+                }
+
+                // Records never wrap, a record that doesn't fit before the end starts over at the front.
+                u64 write = ring->write.load(std::memory_order_relaxed);
+                size_t offset = write & (ring_bytes - 1);
+                size_t padding = offset + size > ring_bytes ? ring_bytes - offset : 0;
+                while(write + padding + size - ring->read.load(std::memory_order_acquire) > ring_bytes) {
+                    if(policy == OverflowPolicy::DROP) {
+                        dropped.fetch_add(1, std::memory_order_relaxed);
+                        return true;
+                    }
+                    std::this_thread::yield();
+                }
+
+                // Less than a header of space left needs no marker, the writer skips it on its own.
+                if(padding >= sizeof(LogRecord)) {
+                    LogRecord* marker = reinterpret_cast<LogRecord*>(ring->data + offset);
+                    marker->size = static_cast<u32>(padding);
+                    marker->format = nullptr;
+                }
+                write += padding;
+
+                LogRecord* record = reinterpret_cast<LogRecord*>(ring->data + (write & (ring_bytes - 1)));
+                *record = {
+                    .size = static_cast<u32>(size),
+                    .level = static_cast<u32>(level),
+                    .timestamp = timestamp(),
+                    .format = format,
+                    .format_record = format_log_record<Args...>
+                };
+                [[maybe_unused]] u8* cursor = reinterpret_cast<u8*>(record + 1);
+                (write_log_argument(&cursor, args), ...);
+
+                ring->write.store(write + size, std::memory_order_release);
+                return true;
+            }
+
+            // The ring's next record, skipping padding, or nullptr when it is empty.
+            [[nodiscard]] const LogRecord* peek(LogRing* ring) {
+                u64 read = ring->read.load(std::memory_order_relaxed);
+                u64 write = ring->write.load(std::memory_order_acquire);
+                while(read < write) {
+                    size_t offset = read & (ring_bytes - 1);
+                    const LogRecord* record = reinterpret_cast<const LogRecord*>(ring->data + offset);
+                    if(ring_bytes - offset < sizeof(LogRecord) || !record->format) {
+                        read += ring_bytes - offset;
+                        ring->read.store(read, std::memory_order_release);
+                        continue;
+                    }
+                    return record;
+                }
+                return nullptr;
+            }
+
+            // Everything consumed so far is in the batch, so once it is out every ring is flushed up to its read.
+            void write_batch(size_t* length) {
+                if(*length > 0) {
+                    fwrite(batch, 1, *length, output);
+                    fflush(output);
+                    *length = 0;
+                }
+
+                u32 ring_count = thread_count.load(std::memory_order_acquire);
+                ring_count = ring_count < max_threads ? ring_count : max_threads;
+                for(u32 i = 0; i < ring_count; ++i) {
+                    rings[i].flushed.store(rings[i].read.load(std::memory_order_relaxed), std::memory_order_release);
+                }
+            }
+
+            // Formats and writes everything in the rings, oldest first across threads. False if there was nothing.
+            bool write_pending() {
+                size_t length = 0;
+                bool wrote = false;
+                for(;;) {
+                    u32 ring_count = thread_count.load(std::memory_order_acquire);
+                    ring_count = ring_count < max_threads ? ring_count : max_threads;
+
+                    LogRing* oldest_ring = nullptr;
+                    const LogRecord* oldest = nullptr;
+                    for(u32 i = 0; i < ring_count; ++i) {
+                        const LogRecord* record = peek(&rings[i]);
+                        if(record && (!oldest || record->timestamp < oldest->timestamp)) {
+                            oldest = record;
+                            oldest_ring = &rings[i];
+                        }
+                    }
+                    if(!oldest) {
+                        break;
+                    }
+
+                    if(BATCH_BYTES - length < MAX_FORMATTED_LENGTH) {
+                        write_batch(&length);
+                    }
+
+                    // Same layout as log_sync: level prefix, message, newline.
+                    char* line = batch + length;
+                    s32 prefix = snprintf(line, MAX_FORMATTED_LENGTH, "%s", log_level_to_string(oldest->level));
+                    s32 message = oldest->format_record(oldest, line + prefix, MAX_FORMATTED_LENGTH - prefix - 1);
+                    size_t message_length = message < 0 ? 0 : static_cast<size_t>(message);
+                    message_length = message_length < MAX_FORMATTED_LENGTH - prefix - 2 ? message_length : MAX_FORMATTED_LENGTH - prefix - 2;
+                    line[prefix + message_length] = '\n';
+                    length += prefix + message_length + 1;
+
+                    oldest_ring->read.store(oldest_ring->read.load(std::memory_order_relaxed) + oldest->size, std::memory_order_release);
+                    wrote = true;
+                }
+                write_batch(&length);
+                return wrote;
+            }
+
+            void run_writer() {
+                while(!stopping.load(std::memory_order_acquire)) {
+                    if(!write_pending()) {
+                        std::this_thread::sleep_for(IDLE_INTERVAL);
+                    }
+                }
+                write_pending();
+            }
+        };
+
+        static AsyncLogger async_logger;
+
+        // Blocks until everything logged before the call has been written and flushed to the output.
+        [[maybe_unused]] static void flush() {
+            if(!async_logger.running.load(std::memory_order_acquire)) {
+                fflush(async_logger.output);
+                return;
+            }
+
+            u32 ring_count = async_logger.thread_count.load(std::memory_order_acquire);
+            ring_count = ring_count < async_logger.max_threads ? ring_count : async_logger.max_threads;
+            for(u32 i = 0; i < ring_count; ++i) {
+                LogRing* ring = &async_logger.rings[i];
+                u64 written = ring->write.load(std::memory_order_acquire);
+                while(ring->flushed.load(std::memory_order_acquire) < written) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        // Writes out what is left and stops the writer. Anything logged after this is printed synchronously. Threads
+        // already inside push() finish first, the rings are only freed once none is left.
+        [[maybe_unused]] static void stop_async() {
+            if(!async_logger.running.load(std::memory_order_acquire)) {
+                return;
+            }
+
+            // Sequentially consistent, pairs with log(): a producer either sees running cleared or is counted here.
+            async_logger.running.store(false, std::memory_order_seq_cst);
+            while(async_logger.producers.load(std::memory_order_seq_cst) > 0) {
+                std::this_thread::yield();
+            }
+            async_logger.stopping.store(true, std::memory_order_release);
+            async_logger.writer.join();
+
+            u64 dropped = async_logger.dropped.load(std::memory_order_relaxed);
+            if(dropped > 0) {
+                fprintf(async_logger.output, "%s[Logger::stop_async()] Dropped %llu messages on full rings.\n", log_level_to_string(LEVEL_ERROR), static_cast<unsigned long long>(dropped));
+            }
+            fflush(async_logger.output);
+            async_logger.output = stdout;
+
+            free(async_logger.ring_storage);
+            delete[] async_logger.rings;
+            free(async_logger.batch);
+            async_logger.ring_storage = nullptr;
+            async_logger.rings = nullptr;
+            async_logger.batch = nullptr;
+        }
+
+        // Moves log() onto the writer thread. ring_bytes per producer thread must be a power of two. Registers an exit
+        // hook so messages still in the rings are written when the program exits without calling stop_async().
+        [[nodiscard, maybe_unused]] static bool start_async(OverflowPolicy policy = OverflowPolicy::DROP, FILE* output = stdout, size_t ring_bytes = AsyncLogger::DEFAULT_RING_BYTES,
+                                              u32 max_threads = AsyncLogger::DEFAULT_MAX_THREADS) {
+            if(async_logger.running.load(std::memory_order_acquire)) {
+                return true;
+            }
+            if(ring_bytes < 4 * sizeof(LogRecord) || (ring_bytes & (ring_bytes - 1)) != 0) {
+                log_sync(stdout, LEVEL_ERROR, "[Logger::start_async()] Ring size %zu is not a power of two.", ring_bytes);
+                return false;
+            }
+
+            // malloc's alignment covers records, the rings' cache line alignment needs aligned new.
+            async_logger.rings = new(std::nothrow) LogRing[max_threads];
+            async_logger.ring_storage = static_cast<u8*>(malloc(ring_bytes * max_threads));
+            async_logger.batch = static_cast<char*>(malloc(AsyncLogger::BATCH_BYTES));
+            if(!async_logger.rings || !async_logger.ring_storage || !async_logger.batch) {
+                delete[] async_logger.rings;
+                free(async_logger.ring_storage);
+                free(async_logger.batch);
+                log_sync(stdout, LEVEL_ERROR, "[Logger::start_async()] Unable to allocate %zu byte rings for %u threads.", ring_bytes, max_threads);
+                return false;
+            }
+
+            // Touched up front so a thread's first messages don't pay for page faults.
+            memset(async_logger.ring_storage, 0, ring_bytes * max_threads);
+            for(u32 i = 0; i < max_threads; ++i) {
+                async_logger.rings[i].read.store(0, std::memory_order_relaxed);
+                async_logger.rings[i].write.store(0, std::memory_order_relaxed);
+                async_logger.rings[i].flushed.store(0, std::memory_order_relaxed);
+                async_logger.rings[i].data = async_logger.ring_storage + ring_bytes * i;
+            }
+
+            // Whatever was printed synchronously goes out before the writer starts.
+            fflush(async_logger.output);
+            async_logger.ring_bytes = ring_bytes;
+            async_logger.max_threads = max_threads;
+            async_logger.policy = policy;
+            async_logger.output = output;
+            async_logger.thread_count.store(0, std::memory_order_relaxed);
+            async_logger.dropped.store(0, std::memory_order_relaxed);
+            async_logger.stopping.store(false, std::memory_order_relaxed);
+            ++async_logger.generation;
+
+            async_logger.writer = std::thread([]() { async_logger.run_writer(); });
+            async_logger.running.store(true, std::memory_order_release);
+
+            if(!async_logger.exit_hook_registered) {
+                async_logger.exit_hook_registered = std::atexit([]() { stop_async(); }) == 0;
+            }
+            return true;
+        }
+
         template<typename... Args>
         static void log(LogLevel message_level, const char* format, Args... args) {
             if(message_level < logger_level) {
                 return;
             }
 
-            char buffer[MAX_LOG_MESSAGE_LENGTH];
-            snprintf(buffer, MAX_LOG_MESSAGE_LENGTH, "%s%s\n", log_level_to_string(message_level), format);
-            printf(buffer, args...);
+            if(async_logger.running.load(std::memory_order_acquire)) {
+                // Counted before running is checked again, so stop_async() can't free the rings under the push.
+                async_logger.producers.fetch_add(1, std::memory_order_seq_cst);
+                bool pushed = false;
+                if(async_logger.running.load(std::memory_order_seq_cst)) {
+                    // Errors are usually followed by an assert, which aborts without running the exit hook. They skip
+                    // the ring and are printed here, after everything queued before them.
+                    if(message_level >= LEVEL_ERROR) {
+                        flush();
+                    } else {
+                        pushed = async_logger.push(message_level, format, args...);
+                    }
+                }
+                async_logger.producers.fetch_sub(1, std::memory_order_release);
+                if(pushed) {
+                    return;
+                }
+            }
+            log_sync(async_logger.output, message_level, format, args...);
+            if(message_level >= LEVEL_ERROR) {
+                fflush(async_logger.output);
+            }
         }
 
         template<typename... Args>
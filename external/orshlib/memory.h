@@ -2,9 +2,19 @@
 
 #include "types.h"
 #include "log.h"
+#include <cstdint>
 #include <cstdlib>
 #include <cassert>
 
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
 namespace OL {
 
     template<typename T>
@@ -24,10 +34,41 @@ namespace OL {
         return gigabytes * MB(1024);
     }
 
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    // Rounds value up to a multiple of alignment, which must be a power of two.
+    [[nodiscard]] static constexpr size_t align_up(size_t value, size_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Bytes reserve<T>(element_count) can take at most, padding included. For sizing buffers up front.
+    template<typename T>
+    [[nodiscard]] static constexpr size_t reserve_size(size_t element_count, size_t alignment = alignof(T)) {
+        return sizeof(T) * element_count + alignment - 1;
+    }
+
+    // Buffers are linear arenas: reserve bumps allocated, mark/rewind and reset hand memory back in LIFO order.
+    //
+    // allocate() mallocs the whole capacity up front. allocate_virtual() only reserves address space and commits it
+    // in COMMIT_GRANULARITY steps as allocated grows, so an arena can be sized for the worst case and only cost what
+    // is actually used. Committed memory is kept across rewinds, a frame arena stops committing once it has seen its
+    // busiest frame. high_water is the most the arena ever had allocated, which is what to size capacities from.
     struct Buffer {
+        static constexpr size_t COMMIT_GRANULARITY = KB(64);
+        static constexpr size_t HUGE_PAGE_SIZE = MB(2);
+
+        struct Marker {
+            size_t allocated;
+        };
+
         u8* data;
         size_t allocated;
         size_t capacity;
+        // Bytes backed by memory. Equal to capacity for everything but virtual arenas.
+        size_t committed;
+        size_t high_water;
+        bool is_virtual;
+        bool huge_pages;
 
         [[nodiscard]] u8 operator[](size_t index) {
             return data[index];
@@ -37,24 +78,55 @@ namespace OL {
             return capacity - allocated;
         }
 
+        // Commits [committed, bytes) of a virtual arena, rounded up to the commit granularity.
+        [[nodiscard]] bool commit(size_t bytes) {
+            if(bytes <= committed) {
+                return true;
+            }
+
+            size_t granularity = huge_pages ? HUGE_PAGE_SIZE : COMMIT_GRANULARITY;
+            size_t new_committed = align_up(bytes, granularity);
+            new_committed = new_committed < capacity ? new_committed : capacity;
+#ifdef _WIN32
+            bool committed_range = VirtualAlloc(data + committed, new_committed - committed, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+            bool committed_range = mprotect(data + committed, new_committed - committed, PROT_READ | PROT_WRITE) == 0;
+#endif
+            if(!committed_range) {
+                Logger::log(Logger::LEVEL_ERROR, "[Buffer::commit()] Unable to commit %zu bytes of a %zu byte arena.", new_committed, capacity);
+                return false;
+            }
+
+            committed = new_committed;
+            return true;
+        }
+
+        // element_count Ts aligned to alignment, which defaults to alignof(T) and must be a power of two.
         template<typename T = u8>
-        [[nodiscard]] T* reserve(size_t element_count) {
+        [[nodiscard]] T* reserve(size_t element_count, size_t alignment = alignof(T)) {
             assert(element_count > 0);
             if(element_count == 0) {
                 Logger::log(Logger::LEVEL_ERROR, "[Buffer::reserve()] Attempt to allocate 0 elements.");
                 return nullptr;
             }
 
+            // Aligned by address rather than offset, so slices and malloc'd data are aligned too.
+            size_t address = reinterpret_cast<uintptr_t>(data) + allocated;
+            size_t offset = allocated + (align_up(address, alignment) - address);
             size_t elements_size = sizeof(T) * element_count;
-            size_t remaining_capacity = capacity - allocated;
-            assert(elements_size <= remaining_capacity);
-            if(elements_size > remaining_capacity) {
+            assert(offset <= capacity && elements_size <= capacity - offset);
+            if(offset > capacity || elements_size > capacity - offset) {
                 Logger::log(Logger::LEVEL_ERROR, "[Buffer::reserve()] Not enough capacity to allocate %zu elements.", element_count);
                 return nullptr;
             }
 
-            T* pointer = reinterpret_cast<T*>(data + allocated);
-            allocated += elements_size;
+            if(is_virtual && !commit(offset + elements_size)) {
+                return nullptr;
+            }
+
+            T* pointer = reinterpret_cast<T*>(data + offset);
+            allocated = offset + elements_size;
+            high_water = allocated > high_water ? allocated : high_water;
 
             return pointer;
         }
@@ -64,6 +136,25 @@ namespace OL {
             return reserve<T>(1);
         }
 
+        [[nodiscard]] Marker mark() const {
+            return { allocated };
+        }
+
+        // Frees everything reserved since marker was taken.
+        void rewind(Marker marker) {
+            assert(marker.allocated <= allocated);
+            allocated = marker.allocated;
+        }
+
+        void reset() {
+            allocated = 0;
+        }
+
+        void log_stats(const char* name) const {
+            Logger::log("%s: %.2f MB allocated, %.2f MB high water, %.2f MB committed of %.2f MB", name, static_cast<f64>(allocated) / MB(1),
+                        static_cast<f64>(high_water) / MB(1), static_cast<f64>(committed) / MB(1), static_cast<f64>(capacity) / MB(1));
+        }
+
         [[nodiscard]] static Buffer* allocate(size_t bytes) {
             assert(bytes > 0);
             if(bytes == 0) {
@@ -84,13 +175,81 @@ namespace OL {
                 return nullptr;
             }
 
-            buffer->data = reinterpret_cast<u8*>(data);
-            buffer->capacity = bytes;
-            buffer->allocated = 0;
+            *buffer = {
+                .data = reinterpret_cast<u8*>(data),
+                .allocated = 0,
+                .capacity = bytes,
+                .committed = bytes
+            };
 
             return buffer;
         }
 
+        // Reserves bytes of address space and commits none of it yet. huge_pages asks for transparent huge pages
+        // on Linux, which cuts TLB misses over big arrays. Windows only has locked large pages, which can't be
+        // committed on demand, so it is ignored there.
+        [[nodiscard]] static Buffer* allocate_virtual(size_t bytes, bool huge_pages = false) {
+            assert(bytes > 0);
+            if(bytes == 0) {
+                Logger::log(Logger::LEVEL_ERROR, "[Buffer::allocate_virtual()] Attempt to reserve 0 bytes.");
+                return nullptr;
+            }
+
+            Buffer* buffer = reinterpret_cast<Buffer*>(malloc(sizeof(Buffer)));
+            if(!buffer) {
+                Logger::log(Logger::LEVEL_ERROR, "[Buffer::allocate_virtual()] Failed to allocate memory for Buffer struct.");
+                return nullptr;
+            }
+
+            bytes = align_up(bytes, huge_pages ? HUGE_PAGE_SIZE : COMMIT_GRANULARITY);
+#ifdef _WIN32
+            huge_pages = false;
+            void* data = VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS);
+#else
+            void* data = mmap(nullptr, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            data = data == MAP_FAILED ? nullptr : data;
+#endif
+            if(!data) {
+                Logger::log(Logger::LEVEL_ERROR, "[Buffer::allocate_virtual()] Failed to reserve %zu bytes of address space.", bytes);
+                free(buffer);
+                return nullptr;
+            }
+#if defined(MADV_HUGEPAGE)
+            if(huge_pages) {
+                madvise(data, bytes, MADV_HUGEPAGE);
+            }
+#endif
+
+            *buffer = {
+                .data = reinterpret_cast<u8*>(data),
+                .allocated = 0,
+                .capacity = bytes,
+                .committed = 0,
+                .is_virtual = true,
+                .huge_pages = huge_pages
+            };
+
+            return buffer;
+        }
+
+        // Returns a buffer from allocate() or allocate_virtual() to the system. Slices go with their parent.
+        static void release(Buffer* buffer) {
+            if(!buffer) {
+                return;
+            }
+
+            if(buffer->is_virtual) {
+#ifdef _WIN32
+                VirtualFree(buffer->data, 0, MEM_RELEASE);
+#else
+                munmap(buffer->data, buffer->capacity);
+#endif
+            } else {
+                free(buffer->data);
+            }
+            free(buffer);
+        }
+
         [[nodiscard]] static Buffer* slice(Buffer* parent, size_t capacity) {
             assert(parent);
             assert(capacity > 0);
@@ -101,28 +260,54 @@ namespace OL {
                 return nullptr;
             }
 
-            slice->data = parent->reserve(capacity);
-            assert(slice->data);
-            if(!slice->data) {
+            u8* data = parent->reserve(capacity);
+            assert(data);
+            if(!data) {
                 return nullptr;
             }
 
-            slice->capacity = capacity;
-            slice->allocated = 0;
+            *slice = {
+                .data = data,
+                .allocated = 0,
+                .capacity = capacity,
+                .committed = capacity
+            };
             return slice;
         }
     };
 
+    // Rewinds buffer to where it was on construction, e.g. a frame's worth of temporary allocations.
+    struct BufferScope {
+        Buffer* buffer;
+        Buffer::Marker marker;
+
+        explicit BufferScope(Buffer* scope_buffer) : buffer(scope_buffer), marker(scope_buffer->mark()) {}
+
+        ~BufferScope() {
+            buffer->rewind(marker);
+        }
+
+        BufferScope(const BufferScope&) = delete;
+        BufferScope& operator=(const BufferScope&) = delete;
+    };
+
+    // Both arenas reserve far more address space than they will commit: persistent holds everything that lives as
+    // long as the program, temporary is for loads and scratch that a BufferScope hands back.
     struct Memory {
-        static constexpr size_t DEFAULT_PERSISTENT_MEMORY_SIZE = MB(10);
-        static constexpr size_t DEFAULT_TEMPORARY_MEMORY_SIZE = MB(10);
+        static constexpr size_t DEFAULT_PERSISTENT_MEMORY_SIZE = GB(4);
+        static constexpr size_t DEFAULT_TEMPORARY_MEMORY_SIZE = GB(1);
 
         Buffer* persistent;
         Buffer* temporary;
+
+        void log_stats() const {
+            persistent->log_stats("Persistent Memory");
+            temporary->log_stats("Temporary Memory");
+        }
     };
 
     static Memory memory = {
-        .persistent = Buffer::allocate(Memory::DEFAULT_PERSISTENT_MEMORY_SIZE),
-        .temporary = Buffer::allocate(Memory::DEFAULT_TEMPORARY_MEMORY_SIZE)
+        .persistent = Buffer::allocate_virtual(Memory::DEFAULT_PERSISTENT_MEMORY_SIZE),
+        .temporary = Buffer::allocate_virtual(Memory::DEFAULT_TEMPORARY_MEMORY_SIZE)
     };
 }
\ No newline at end of file
@@ -0,0 +1,250 @@
+#pragma once
+
+#include "types.h"
+#include "log.h"
+#include "memory.h"
+#include "file.h"
+#include "simd.h"
+#include "time.h"
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// OL_PROFILE_ZONE("name") times the rest of the enclosing scope. Define OL_PROFILER_DISABLED to compile every zone out.
+#define OL_PROFILE_CONCAT_INNER(a, b) a##b
+#define OL_PROFILE_CONCAT(a, b) OL_PROFILE_CONCAT_INNER(a, b)
+#if defined(OL_PROFILER_DISABLED)
+#define OL_PROFILE_ZONE(name) ((void)0)
+#else
+#define OL_PROFILE_ZONE(name) OL::ProfileZone OL_PROFILE_CONCAT(profile_zone_, __COUNTER__)(name)
+#endif
+
+namespace OL {
+
+    // Zone names must be string literals, or at least outlive the profiler: only the pointer is recorded.
+    struct ProfileRecord {
+        const char* name;
+        u64 begin;
+        u64 end;
+    };
+
+    // One thread's ring of finished zones. Only the owning thread writes records, so recording is a plain store
+    // followed by a release of the new count. Once the ring is full the oldest records are overwritten, which keeps
+    // the last few frames around for a capture at any moment.
+    struct ProfileThread {
+        alignas(CACHE_LINE_SIZE) std::atomic<u64> written;
+        ProfileRecord* records;
+        const char* name;
+    };
+
+    struct Profiler {
+        static constexpr u32 DEFAULT_MAX_THREADS = 64;
+        static constexpr u32 DEFAULT_RECORDS_PER_THREAD = 1 << 16;
+        static constexpr u32 NOT_REGISTERED = ~0u;
+        // Longest trace event, for zone names up to 64 characters.
+        static constexpr size_t MAX_TRACE_EVENT_LENGTH = 192;
+        static constexpr Time::Duration MIN_CALIBRATION_TIME = Time::Milliseconds(10);
+
+        Buffer* storage = nullptr;
+        ProfileThread* threads = nullptr;
+        u32 max_threads = 0;
+        u32 record_mask = 0;
+        std::atomic<u32> thread_count = 0;
+        std::atomic<u32> dropped_threads = 0;
+        std::atomic<bool> enabled = false;
+        // Bumped by every init() so threads registered with an earlier profiler register again.
+        u32 generation = 0;
+        u64 start_ticks = 0;
+        Time::Stamp start_time = {};
+
+        // Invariant TSC on x86, which every CPU this runs on has: constant rate and synchronized across cores.
+        [[nodiscard]] static u64 ticks() {
+#if OL_SIMD_X86
+            return __rdtsc();
+#else
+            return static_cast<u64>(std::chrono::duration_cast<Time::Nanoseconds>(Time::Clock::now().time_since_epoch()).count());
+#endif
+        }
+
+        [[nodiscard]] bool init(u32 records_per_thread = DEFAULT_RECORDS_PER_THREAD, u32 threads_supported = DEFAULT_MAX_THREADS) {
+            assert(!threads && records_per_thread > 0 && (records_per_thread & (records_per_thread - 1)) == 0);
+
+            storage = Buffer::allocate(reserve_size<ProfileThread>(threads_supported) + reserve_size<ProfileRecord>(records_per_thread) * threads_supported);
+            if(!storage) {
+                Logger::log(Logger::LEVEL_ERROR, "[Profiler::init()] Unable to allocate %u records for %u threads.", records_per_thread, threads_supported);
+                return false;
+            }
+
+            // ProfileThread is cache line aligned so two threads' counts never share a line.
+            threads = storage->reserve<ProfileThread>(threads_supported);
+            for(u32 i = 0; i < threads_supported; ++i) {
+                threads[i].written.store(0, std::memory_order_relaxed);
+                threads[i].records = storage->reserve<ProfileRecord>(records_per_thread);
+                threads[i].name = nullptr;
+            }
+
+            max_threads = threads_supported;
+            record_mask = records_per_thread - 1;
+            thread_count.store(0, std::memory_order_relaxed);
+            dropped_threads.store(0, std::memory_order_relaxed);
+            ++generation;
+            start_ticks = ticks();
+            start_time = Time::Clock::now();
+            enabled.store(true, std::memory_order_release);
+            return true;
+        }
+
+        // No zone may be open on any thread, they would record into freed rings.
+        void shutdown() {
+            enabled.store(false, std::memory_order_relaxed);
+            Buffer::release(storage);
+            storage = nullptr;
+            threads = nullptr;
+        }
+
+        void set_enabled(bool value) {
+            enabled.store(value && threads != nullptr, std::memory_order_relaxed);
+        }
+
+        // The calling thread's ring, registering it on first use. nullptr once every slot is taken.
+        [[nodiscard]] ProfileThread* current_thread() {
+            struct Registration {
+                u32 generation;
+                u32 slot;
+            };
+            thread_local Registration registration = { 0, NOT_REGISTERED };
+
+            if(registration.generation != generation) {
+                u32 slot = thread_count.fetch_add(1, std::memory_order_relaxed);
+                if(slot >= max_threads) {
+                    dropped_threads.fetch_add(1, std::memory_order_relaxed);
+                    slot = NOT_REGISTERED;
+                }
+                registration = { generation, slot };
+            }
+
+            return registration.slot == NOT_REGISTERED ? nullptr : &threads[registration.slot];
+        }
+
+        // Names the calling thread in captures. name must outlive the profiler.
+        void set_thread_name(const char* name) {
+            ProfileThread* thread = current_thread();
+            if(thread) {
+                thread->name = name;
+            }
+        }
+
+        void record(const char* name, u64 begin, u64 end) {
+            ProfileThread* thread = current_thread();
+            if(!thread) {
+                return;
+            }
+
+            u64 index = thread->written.load(std::memory_order_relaxed);
+            thread->records[index & record_mask] = { name, begin, end };
+            thread->written.store(index + 1, std::memory_order_release);
+        }
+
+        // Upper bound of the bytes write_chrome_trace produces with every thread slot in use, for sizing its buffer once.
+        [[nodiscard]] size_t chrome_trace_size() {
+            return 64 + static_cast<size_t>(max_threads) * MAX_TRACE_EVENT_LENGTH * (static_cast<size_t>(record_mask) + 2);
+        }
+
+        // Appends a Chrome trace (chrome://tracing, ui.perfetto.dev) of every thread's ring to buffer and returns the
+        // bytes written. Safe while other threads record: records overwritten during the copy are left out.
+        [[nodiscard]] size_t write_chrome_trace(Buffer* buffer) {
+            if(!threads) {
+                return 0;
+            }
+
+            // Ticks to microseconds from the ticks and clock time elapsed since init, over a window long enough for
+            // the clock's resolution not to matter.
+            Time::Stamp calibration_end = Time::Clock::now();
+            while(calibration_end - start_time < MIN_CALIBRATION_TIME) {
+                std::this_thread::yield();
+                calibration_end = Time::Clock::now();
+            }
+            u64 calibration_ticks = ticks();
+            f64 elapsed_us = std::chrono::duration<f64, std::micro>(calibration_end - start_time).count();
+            f64 us_per_tick = elapsed_us / static_cast<f64>(calibration_ticks - start_ticks);
+
+            size_t start = buffer->allocated;
+            auto append = [buffer](const char* format, auto... args) {
+                size_t remaining = buffer->bytes_remaining();
+                s32 length = snprintf(reinterpret_cast<char*>(buffer->data + buffer->allocated), remaining, format, args...);
+                if(length > 0 && static_cast<size_t>(length) < remaining) {
+                    buffer->allocated += static_cast<size_t>(length);
+                }
+            };
+
+            append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+            bool first = true;
+            u32 thread_total = thread_count.load(std::memory_order_acquire);
+            thread_total = thread_total < max_threads ? thread_total : max_threads;
+            for(u32 thread_index = 0; thread_index < thread_total; ++thread_index) {
+                ProfileThread* thread = &threads[thread_index];
+                char fallback_name[32];
+                snprintf(fallback_name, sizeof(fallback_name), "Thread %u", thread_index);
+                append("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", first ? "" : ",", thread_index,
+                       thread->name ? thread->name : fallback_name);
+                first = false;
+
+                u64 capacity = static_cast<u64>(record_mask) + 1;
+                u64 written = thread->written.load(std::memory_order_acquire);
+                u64 oldest = written > capacity ? written - capacity : 0;
+                for(u64 index = oldest; index < written; ++index) {
+                    ProfileRecord record = thread->records[index & record_mask];
+
+                    // The owner may have lapped the ring while this copy ran, anything it could have touched is dropped.
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    u64 now_written = thread->written.load(std::memory_order_relaxed);
+                    if(now_written + 1 > capacity && index < now_written + 1 - capacity) {
+                        continue;
+                    }
+
+                    f64 begin_us = static_cast<f64>(static_cast<s64>(record.begin - start_ticks)) * us_per_tick;
+                    f64 duration_us = static_cast<f64>(record.end - record.begin) * us_per_tick;
+                    append(",{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", record.name, thread_index, begin_us, duration_us);
+                }
+            }
+            append("]}");
+
+            return buffer->allocated - start;
+        }
+
+        // Writes a capture of every thread's ring to path. trace must have chrome_trace_size() bytes left.
+        [[nodiscard]] bool save_chrome_trace(const char* path, Buffer* trace) {
+            size_t offset = trace->allocated;
+            size_t bytes = write_chrome_trace(trace);
+            bool saved = bytes > 0 && File::write_to_file(path, trace, offset, bytes) == bytes;
+            trace->allocated = offset;
+            if(!saved) {
+                Logger::log(Logger::LEVEL_ERROR, "[Profiler::save_chrome_trace()] Unable to write %zu bytes to %s.", bytes, path);
+            }
+            return saved;
+        }
+    };
+
+    static Profiler profiler;
+
+    // Times its scope into the calling thread's ring when the profiler is enabled. Costs one relaxed load otherwise.
+    struct ProfileZone {
+        const char* name;
+        u64 begin;
+
+        explicit ProfileZone(const char* zone_name) : name(profiler.enabled.load(std::memory_order_relaxed) ? zone_name : nullptr), begin(name ? Profiler::ticks() : 0) {}
+
+        ~ProfileZone() {
+            if(name) {
+                profiler.record(name, begin, Profiler::ticks());
+            }
+        }
+
+        ProfileZone(const ProfileZone&) = delete;
+        ProfileZone& operator=(const ProfileZone&) = delete;
+    };
+}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "types.h"
+#include "simd.h"
 #include <random>
 
 namespace OL {
@@ -24,5 +25,246 @@ namespace OL {
             return distribution(seed());
         }
 
+        [[nodiscard]] static constexpr u64 rotl(u64 value, s32 bits) {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        // SplitMix64, only used to spread a seed over the xoshiro state so similar seeds give unrelated streams.
+        [[nodiscard]] static constexpr u64 splitmix64(u64* state) {
+            u64 z = (*state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        // xoshiro256** (Blackman & Vigna): 256 bits of state, period 2^256 - 1, and every output bit passes BigCrush.
+        // Same seed, same sequence, on every platform. Also a standard uniform random bit generator, so it works with
+        // the <random> distributions where a bulk fill doesn't fit.
+        struct Xoshiro256 {
+            using result_type = u64;
+
+            u64 state[4];
+
+            [[nodiscard]] static constexpr Xoshiro256 seeded(u64 seed) {
+                Xoshiro256 generator = {};
+                for(u64& word : generator.state) {
+                    word = splitmix64(&seed);
+                }
+                return generator;
+            }
+
+            [[nodiscard]] static constexpr u64 min() {
+                return 0;
+            }
+
+            [[nodiscard]] static constexpr u64 max() {
+                return ~0ull;
+            }
+
+            constexpr u64 operator()() {
+                return next();
+            }
+
+            constexpr u64 next() {
+                u64 result = rotl(state[1] * 5, 7) * 9;
+                u64 t = state[1] << 17;
+                state[2] ^= state[0];
+                state[3] ^= state[1];
+                state[1] ^= state[2];
+                state[0] ^= state[3];
+                state[2] ^= t;
+                state[3] = rotl(state[3], 45);
+                return result;
+            }
+
+            // Advances by 2^128 outputs. Sequences started 2^128 apart never overlap in practice, which is what gives
+            // each worker or chunk its own stream from one seed.
+            constexpr void jump() {
+                constexpr u64 JUMP[] = { 0x180EC6D33CFD0ABAull, 0xD5A61266F0C9392Cull, 0xA9582618E03FC9AAull, 0x39ABDC4529B1661Cull };
+                u64 jumped[4] = {};
+                for(u64 word : JUMP) {
+                    for(s32 bit = 0; bit < 64; ++bit) {
+                        if(word & (1ull << bit)) {
+                            for(s32 i = 0; i < 4; ++i) {
+                                jumped[i] ^= state[i];
+                            }
+                        }
+                        (void)next();
+                    }
+                }
+                for(s32 i = 0; i < 4; ++i) {
+                    state[i] = jumped[i];
+                }
+            }
+
+            // Top 24 bits as a float in [0, 1), every value exactly representable.
+            [[nodiscard]] f32 next_f32() {
+                return static_cast<f32>(next() >> 40) * 0x1.0p-24f;
+            }
+
+            [[nodiscard]] f32 next_f32(f32 min, f32 max) {
+                return min + next_f32() * (max - min);
+            }
+        };
+
+        // STREAM_LANES interleaved xoshiro256** generators, each jumped 2^128 past the previous one, stored lane-wise so
+        // a SIMD kernel steps all of them at once. This is the state fill_f32 consumes.
+        static constexpr u32 STREAM_LANES = 4;
+
+        struct Stream {
+            alignas(32) u64 state[4][STREAM_LANES];
+        };
+
+        // Hands out the next STREAM_LANES jumps of generator as a stream, leaving generator past them, so repeated
+        // calls give streams that never overlap each other or generator's own outputs.
+        [[nodiscard]] static Stream split_stream(Xoshiro256* generator) {
+            Stream stream;
+            for(u32 lane = 0; lane < STREAM_LANES; ++lane) {
+                generator->jump();
+                for(u32 word = 0; word < 4; ++word) {
+                    stream.state[word][lane] = generator->state[word];
+                }
+            }
+            generator->jump();
+            return stream;
+        }
+
+        // Fills output with count uniform floats between min and max, consuming the stream. Each lane's 64-bit output
+        // gives two floats from bits 8-31 and 40-63, written lane by lane, and every kernel does the same integer
+        // steps and the same convert, multiply and add per value, so the output depends only on the stream, not on the
+        // CPU. Values land in [min, max), though rounding may produce max itself when the range is wide.
+        using FillF32Kernel = void (*)(Stream* stream, f32* output, size_t count, f32 min, f32 max);
+
+        static constexpr u32 FILL_F32_BLOCK = STREAM_LANES * 2;
+
+        static void fill_f32_scalar(Stream* stream, f32* output, size_t count, f32 min, f32 max) {
+            f32 scale = (max - min) * 0x1.0p-24f;
+            u64 (&s)[4][STREAM_LANES] = stream->state;
+            for(size_t i = 0; i < count; i += FILL_F32_BLOCK) {
+                f32 block[FILL_F32_BLOCK];
+                for(u32 lane = 0; lane < STREAM_LANES; ++lane) {
+                    u64 result = rotl(s[1][lane] * 5, 7) * 9;
+                    u64 t = s[1][lane] << 17;
+                    s[2][lane] ^= s[0][lane];
+                    s[3][lane] ^= s[1][lane];
+                    s[1][lane] ^= s[2][lane];
+                    s[0][lane] ^= s[3][lane];
+                    s[2][lane] ^= t;
+                    s[3][lane] = rotl(s[3][lane], 45);
+
+                    block[lane * 2] = static_cast<f32>(static_cast<s32>((result & 0xFFFFFFFFull) >> 8)) * scale + min;
+                    block[lane * 2 + 1] = static_cast<f32>(static_cast<s32>(result >> 40)) * scale + min;
+                }
+
+                size_t remaining = count - i < FILL_F32_BLOCK ? count - i : FILL_F32_BLOCK;
+                for(size_t j = 0; j < remaining; ++j) {
+                    output[i + j] = block[j];
+                }
+            }
+        }
+
+#if OL_SIMD_X86
+        // No 64-bit multiply or rotate below AVX-512, so the scrambler's * 5 and * 9 become shift and add.
+        OL_TARGET_SSE2 static inline __m128i rotl_sse2(__m128i value, s32 bits) {
+            return _mm_or_si128(_mm_slli_epi64(value, bits), _mm_srli_epi64(value, 64 - bits));
+        }
+
+        OL_TARGET_SSE2 static void fill_f32_sse2(Stream* stream, f32* output, size_t count, f32 min, f32 max) {
+            __m128 scale = _mm_set1_ps((max - min) * 0x1.0p-24f);
+            __m128 offset = _mm_set1_ps(min);
+            __m128i s[4][2];
+            for(u32 word = 0; word < 4; ++word) {
+                s[word][0] = _mm_load_si128(reinterpret_cast<const __m128i*>(&stream->state[word][0]));
+                s[word][1] = _mm_load_si128(reinterpret_cast<const __m128i*>(&stream->state[word][2]));
+            }
+
+            size_t i = 0;
+            for(; i + FILL_F32_BLOCK <= count; i += FILL_F32_BLOCK) {
+                for(u32 half = 0; half < 2; ++half) {
+                    __m128i times5 = _mm_add_epi64(_mm_slli_epi64(s[1][half], 2), s[1][half]);
+                    __m128i rotated = rotl_sse2(times5, 7);
+                    __m128i result = _mm_add_epi64(_mm_slli_epi64(rotated, 3), rotated);
+                    __m128i t = _mm_slli_epi64(s[1][half], 17);
+                    s[2][half] = _mm_xor_si128(s[2][half], s[0][half]);
+                    s[3][half] = _mm_xor_si128(s[3][half], s[1][half]);
+                    s[1][half] = _mm_xor_si128(s[1][half], s[2][half]);
+                    s[0][half] = _mm_xor_si128(s[0][half], s[3][half]);
+                    s[2][half] = _mm_xor_si128(s[2][half], t);
+                    s[3][half] = rotl_sse2(s[3][half], 45);
+
+                    __m128 values = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(result, 8)), scale), offset);
+                    _mm_storeu_ps(output + i + half * 4, values);
+                }
+            }
+
+            for(u32 word = 0; word < 4; ++word) {
+                _mm_store_si128(reinterpret_cast<__m128i*>(&stream->state[word][0]), s[word][0]);
+                _mm_store_si128(reinterpret_cast<__m128i*>(&stream->state[word][2]), s[word][1]);
+            }
+            fill_f32_scalar(stream, output + i, count - i, min, max);
+        }
+
+        OL_TARGET_AVX2 static inline __m256i rotl_avx2(__m256i value, s32 bits) {
+            return _mm256_or_si256(_mm256_slli_epi64(value, bits), _mm256_srli_epi64(value, 64 - bits));
+        }
+
+        OL_TARGET_AVX2 static void fill_f32_avx2(Stream* stream, f32* output, size_t count, f32 min, f32 max) {
+            __m256 scale = _mm256_set1_ps((max - min) * 0x1.0p-24f);
+            __m256 offset = _mm256_set1_ps(min);
+            __m256i s0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(stream->state[0]));
+            __m256i s1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(stream->state[1]));
+            __m256i s2 = _mm256_load_si256(reinterpret_cast<const __m256i*>(stream->state[2]));
+            __m256i s3 = _mm256_load_si256(reinterpret_cast<const __m256i*>(stream->state[3]));
+
+            size_t i = 0;
+            for(; i + FILL_F32_BLOCK <= count; i += FILL_F32_BLOCK) {
+                __m256i times5 = _mm256_add_epi64(_mm256_slli_epi64(s1, 2), s1);
+                __m256i rotated = rotl_avx2(times5, 7);
+                __m256i result = _mm256_add_epi64(_mm256_slli_epi64(rotated, 3), rotated);
+                __m256i t = _mm256_slli_epi64(s1, 17);
+                s2 = _mm256_xor_si256(s2, s0);
+                s3 = _mm256_xor_si256(s3, s1);
+                s1 = _mm256_xor_si256(s1, s2);
+                s0 = _mm256_xor_si256(s0, s3);
+                s2 = _mm256_xor_si256(s2, t);
+                s3 = rotl_avx2(s3, 45);
+
+                __m256 values = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(result, 8)), scale), offset);
+                _mm256_storeu_ps(output + i, values);
+            }
+
+            _mm256_store_si256(reinterpret_cast<__m256i*>(stream->state[0]), s0);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(stream->state[1]), s1);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(stream->state[2]), s2);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(stream->state[3]), s3);
+            fill_f32_scalar(stream, output + i, count - i, min, max);
+        }
+#endif
+
+        [[nodiscard]] static FillF32Kernel fill_f32_kernel(SIMD::Level level) {
+#if OL_SIMD_X86
+            switch(level) {
+                case SIMD::Level::SSE2: {
+                    return fill_f32_sse2;
+                } break;
+                case SIMD::Level::AVX2:
+                case SIMD::Level::AVX512: {
+                    return fill_f32_avx2;
+                } break;
+                default: {
+                    return fill_f32_scalar;
+                }
+            }
+#else
+            (void)level;
+            return fill_f32_scalar;
+#endif
+        }
+
+        // Resolved once on first use from the best level the CPU reports.
+        [[maybe_unused]] static void fill_f32(Stream* stream, f32* output, size_t count, f32 min, f32 max) {
+            static const FillF32Kernel kernel = fill_f32_kernel(SIMD::best_level());
+            kernel(stream, output, count, min, max);
+        }
     }
 }
\ No newline at end of file
@@ -2,6 +2,9 @@
 
 #include "types.h"
 #include "time.h"
+#include "log.h"
+#include <bit>
+#include <cstring>
 
 namespace OL {
 
@@ -14,12 +17,136 @@ namespace OL {
         Timer timer = { .interval = MEASUREMENT_INTERVAL };
     };
 
+    // Counts of durations in log-linear buckets, HDR histogram style: every power of two of nanoseconds is split into
+    // SUB_BUCKET_COUNT equal buckets, so any recorded value is known to within 1/SUB_BUCKET_COUNT (~3%) of itself
+    // from 1 ns up to MAX_VALUE. Recording is a bit scan and an increment, with no allocation.
+    struct DurationHistogram {
+        static constexpr u32 SUB_BUCKET_BITS = 5;
+        static constexpr u32 SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+        // ~68 s, anything longer lands in the last bucket. max still holds the exact value.
+        static constexpr u32 MAX_VALUE_BITS = 36;
+        static constexpr u64 MAX_VALUE = (1ull << MAX_VALUE_BITS) - 1;
+        static constexpr u32 BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+        u64 counts[BUCKET_COUNT] = {};
+        u64 count = 0;
+        u64 total = 0;
+        u64 min = ~0ull;
+        u64 max = 0;
+
+        // Values below SUB_BUCKET_COUNT get a bucket each. Above that, the top SUB_BUCKET_BITS + 1 bits pick the bucket.
+        [[nodiscard]] static constexpr u32 bucket_index(u64 value) {
+            value = value < MAX_VALUE ? value : MAX_VALUE;
+            u32 width = static_cast<u32>(std::bit_width(value));
+            if(width <= SUB_BUCKET_BITS) {
+                return static_cast<u32>(value);
+            }
+            u32 shift = width - SUB_BUCKET_BITS - 1;
+            return (shift + 1) * SUB_BUCKET_COUNT + static_cast<u32>((value >> shift) & (SUB_BUCKET_COUNT - 1));
+        }
+
+        // The smallest and largest values that land in bucket index.
+        [[nodiscard]] static constexpr u64 bucket_lowest(u32 index) {
+            if(index < SUB_BUCKET_COUNT) {
+                return index;
+            }
+            u32 shift = index / SUB_BUCKET_COUNT - 1;
+            return static_cast<u64>(SUB_BUCKET_COUNT + index % SUB_BUCKET_COUNT) << shift;
+        }
+
+        [[nodiscard]] static constexpr u64 bucket_highest(u32 index) {
+            return index + 1 < BUCKET_COUNT ? bucket_lowest(index + 1) - 1 : MAX_VALUE;
+        }
+
+        void record(Time::Duration duration) {
+            u64 value = duration.count() > 0 ? static_cast<u64>(duration.count()) : 0;
+            ++counts[bucket_index(value)];
+            ++count;
+            total += value;
+            min = value < min ? value : min;
+            max = value > max ? value : max;
+        }
+
+        void reset() {
+            *this = {};
+        }
+
+        // The value at or below which the given share (0-1) of recorded durations fall, as the highest value of its
+        // bucket so the error is always an overestimate, and never past the true max.
+        [[nodiscard]] Time::Duration percentile(f64 share) const {
+            if(count == 0) {
+                return Time::Duration::zero();
+            }
+
+            u64 rank = static_cast<u64>(share * static_cast<f64>(count) + 0.5);
+            rank = rank < 1 ? 1 : (rank > count ? count : rank);
+            u64 seen = 0;
+            for(u32 i = 0; i < BUCKET_COUNT; ++i) {
+                seen += counts[i];
+                if(seen >= rank) {
+                    u64 value = bucket_highest(i);
+                    return Time::Duration(static_cast<s64>(value < max ? value : max));
+                }
+            }
+            return Time::Duration(static_cast<s64>(max));
+        }
+
+        [[nodiscard]] Time::Duration mean() const {
+            return Time::Duration(count ? static_cast<s64>(total / count) : 0);
+        }
+    };
+
+    struct DurationPercentiles {
+        u64 count;
+        Time::Duration mean;
+        Time::Duration p50;
+        Time::Duration p90;
+        Time::Duration p99;
+        Time::Duration p999;
+        Time::Duration max;
+    };
+
+    [[nodiscard]] static DurationPercentiles get_percentiles(const DurationHistogram& histogram) {
+        return {
+            .count = histogram.count,
+            .mean = histogram.mean(),
+            .p50 = histogram.percentile(0.5),
+            .p90 = histogram.percentile(0.9),
+            .p99 = histogram.percentile(0.99),
+            .p999 = histogram.percentile(0.999),
+            .max = Time::Duration(static_cast<s64>(histogram.max))
+        };
+    }
+
+    [[nodiscard]] static f64 to_milliseconds(Time::Duration duration) {
+        return std::chrono::duration<f64, std::milli>(duration).count();
+    }
+
+    // Live view of a session's timing, cheap enough to poll every frame.
+    struct SessionStats {
+        DurationPercentiles frame_times;
+        DurationPercentiles tick_times;
+        // Frames whose accumulator loop ran more than one tick to catch up, and the most ticks a single frame ran.
+        u64 catch_up_frames;
+        u32 max_ticks_per_frame;
+        // Ticks skipped because a frame fell further behind than it was allowed to catch up.
+        u64 dropped_ticks;
+    };
+
     struct Session {
+        // Characters in the longest bar of the debug_print histogram dump.
+        static constexpr u32 HISTOGRAM_DUMP_WIDTH = 50;
+
         u64 frames = 0;
         u64 ticks = 0;
         Time::Stamp start = Time::Clock::now();
         FPS fps = {};
         bool display_fps = false;
+        DurationHistogram frame_times = {};
+        DurationHistogram tick_times = {};
+        u64 catch_up_frames = 0;
+        u32 max_ticks_per_frame = 0;
+        u64 dropped_ticks = 0;
 
         [[nodiscard]] Time::Duration get_running_time() {
             return Time::Clock::now() - start;
@@ -29,11 +156,25 @@ namespace OL {
             ++ticks;
         }
 
-        void render(Time::Duration delta_time) {
+        // How long one simulation tick took to run, as opposed to the fixed step it advanced by.
+        void record_tick_time(Time::Duration tick_time) {
+            tick_times.record(tick_time);
+        }
+
+        // How many ticks this frame's accumulator loop ran. More than one means the simulation fell behind.
+        void record_frame_ticks(u32 frame_ticks, u64 frame_dropped_ticks = 0) {
+            catch_up_frames += frame_ticks > 1;
+            dropped_ticks += frame_dropped_ticks;
+            max_ticks_per_frame = frame_ticks > max_ticks_per_frame ? frame_ticks : max_ticks_per_frame;
+        }
+
+        // frame_time is the wall time since the previous frame.
+        void render(Time::Duration frame_time) {
             ++frames;
             ++fps.frames;
+            frame_times.record(frame_time);
 
-            fps.timer.accumulate(delta_time);
+            fps.timer.accumulate(frame_time);
             if(fps.timer.ready()) {
                 Time::Stamp now = Time::Clock::now();
                 f64 measurement_delta = std::chrono::duration_cast<std::chrono::duration<f64, std::chrono::seconds::period>>(now - fps.measurement_start_time).count();
@@ -44,6 +185,51 @@ namespace OL {
             }
         }
 
+        [[nodiscard]] SessionStats get_stats() const {
+            return {
+                .frame_times = get_percentiles(frame_times),
+                .tick_times = get_percentiles(tick_times),
+                .catch_up_frames = catch_up_frames,
+                .max_ticks_per_frame = max_ticks_per_frame,
+                .dropped_ticks = dropped_ticks
+            };
+        }
+
+        static void print_percentiles(const char* name, const DurationPercentiles& percentiles) {
+            Logger::log("%s (%llu): mean %.3f ms, p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms", name,
+                        static_cast<unsigned long long>(percentiles.count), to_milliseconds(percentiles.mean), to_milliseconds(percentiles.p50),
+                        to_milliseconds(percentiles.p90), to_milliseconds(percentiles.p99), to_milliseconds(percentiles.p999), to_milliseconds(percentiles.max));
+        }
+
+        // One row per power of two of nanoseconds that has any counts, with a bar scaled to the fullest row.
+        static void print_histogram(const char* name, const DurationHistogram& histogram) {
+            static constexpr u32 ROW_COUNT = DurationHistogram::BUCKET_COUNT / DurationHistogram::SUB_BUCKET_COUNT;
+            u64 rows[ROW_COUNT] = {};
+            u64 fullest = 0;
+            for(u32 i = 0; i < DurationHistogram::BUCKET_COUNT; ++i) {
+                u32 row = i / DurationHistogram::SUB_BUCKET_COUNT;
+                rows[row] += histogram.counts[i];
+                fullest = rows[row] > fullest ? rows[row] : fullest;
+            }
+
+            Logger::log("%s histogram:", name);
+            for(u32 row = 0; row < ROW_COUNT; ++row) {
+                if(rows[row] == 0) {
+                    continue;
+                }
+
+                char bar[HISTOGRAM_DUMP_WIDTH + 1];
+                u32 length = static_cast<u32>((rows[row] * HISTOGRAM_DUMP_WIDTH + fullest - 1) / fullest);
+                memset(bar, '#', length);
+                bar[length] = '\0';
+
+                u32 first = row * DurationHistogram::SUB_BUCKET_COUNT;
+                u32 last = first + DurationHistogram::SUB_BUCKET_COUNT - 1;
+                Logger::log("  %10.4f - %10.4f ms %10llu %s", to_milliseconds(Time::Duration(static_cast<s64>(DurationHistogram::bucket_lowest(first)))),
+                            to_milliseconds(Time::Duration(static_cast<s64>(DurationHistogram::bucket_highest(last)))), static_cast<unsigned long long>(rows[row]), bar);
+            }
+        }
+
         void debug_print() {
             Logger::log("Session Info:");
 
@@ -55,6 +241,14 @@ namespace OL {
             Logger::log("Elapsed Time: %02d:%02d:%05.2f", hours, minutes, seconds);
             Logger::log("Total Frames: %zd", frames);
             Logger::log("Average FPS: %00007.2f", static_cast<f64>(frames / elapsed_time_seconds));
+
+            SessionStats stats = get_stats();
+            print_percentiles("Frame Time", stats.frame_times);
+            print_percentiles("Tick Time", stats.tick_times);
+            Logger::log("Catch-up Frames: %llu (most ticks in one frame: %u)", static_cast<unsigned long long>(stats.catch_up_frames), stats.max_ticks_per_frame);
+            Logger::log("Dropped Ticks: %llu", static_cast<unsigned long long>(stats.dropped_ticks));
+            print_histogram("Frame Time", frame_times);
+            print_histogram("Tick Time", tick_times);
         }
     };
 }
\ No newline at end of file
@@ -0,0 +1,259 @@
+#pragma once
+
+#include "types.h"
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define OL_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define OL_SIMD_X86 0
+#endif
+
+// MSVC emits any intrinsic without per-function flags, GCC/Clang need the target spelled out.
+#if OL_SIMD_X86 && !defined(_MSC_VER)
+#define OL_TARGET_SSE2 __attribute__((target("sse2")))
+#define OL_TARGET_AVX2 __attribute__((target("avx2")))
+#define OL_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define OL_TARGET_SSE2
+#define OL_TARGET_AVX2
+#define OL_TARGET_AVX512
+#endif
+
+namespace OL {
+
+    namespace SIMD {
+
+        enum class Level {
+            SCALAR,
+            SSE2,
+            AVX2,
+            AVX512,
+            MAX_COUNT
+        };
+
+        [[nodiscard, maybe_unused]] static const char* level_to_string(Level level) {
+            switch(level) {
+                case Level::SCALAR: {
+                    return "scalar";
+                } break;
+                case Level::SSE2: {
+                    return "sse2";
+                } break;
+                case Level::AVX2: {
+                    return "avx2";
+                } break;
+                case Level::AVX512: {
+                    return "avx512";
+                } break;
+                default: {
+                    return "";
+                }
+            }
+        }
+
+        [[nodiscard]] static bool supported(Level level) {
+#if OL_SIMD_X86
+#if defined(_MSC_VER)
+            s32 registers[4];
+            __cpuid(registers, 1);
+            bool sse2 = registers[3] & (1 << 26);
+            bool osxsave = registers[2] & (1 << 27);
+            u64 xcr0 = osxsave ? _xgetbv(0) : 0;
+            __cpuidex(registers, 7, 0);
+            bool avx2 = osxsave && (xcr0 & 0x6) == 0x6 && (registers[1] & (1 << 5));
+            bool avx512 = osxsave && (xcr0 & 0xE6) == 0xE6 && (registers[1] & (1 << 16));
+#else
+            __builtin_cpu_init();
+            bool sse2 = __builtin_cpu_supports("sse2");
+            bool avx2 = __builtin_cpu_supports("avx2");
+            bool avx512 = __builtin_cpu_supports("avx512f");
+#endif
+            switch(level) {
+                case Level::SCALAR: {
+                    return true;
+                } break;
+                case Level::SSE2: {
+                    return sse2;
+                } break;
+                case Level::AVX2: {
+                    return avx2;
+                } break;
+                case Level::AVX512: {
+                    return avx512;
+                } break;
+                default: {
+                    return false;
+                }
+            }
+#else
+            return level == Level::SCALAR;
+#endif
+        }
+
+        [[nodiscard]] static Level best_level() {
+            for(s32 level = static_cast<s32>(Level::MAX_COUNT) - 1; level > 0; --level) {
+                if(supported(static_cast<Level>(level))) {
+                    return static_cast<Level>(level);
+                }
+            }
+            return Level::SCALAR;
+        }
+
+        // destination[i] = a[i] + b[i]. destination may alias a for an in-place update.
+        // Every path performs the same single IEEE add per lane, so results are bit-identical across levels.
+        using AddF32Kernel = void (*)(f32* destination, const f32* a, const f32* b, size_t count);
+
+        static void add_f32_scalar(f32* destination, const f32* a, const f32* b, size_t count) {
+            for(size_t i = 0; i < count; ++i) {
+                destination[i] = a[i] + b[i];
+            }
+        }
+
+#if OL_SIMD_X86
+        OL_TARGET_SSE2 static void add_f32_sse2(f32* destination, const f32* a, const f32* b, size_t count) {
+            size_t i = 0;
+            for(; i + 8 <= count; i += 8) {
+                __m128 sum0 = _mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+                __m128 sum1 = _mm_add_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+                _mm_storeu_ps(destination + i, sum0);
+                _mm_storeu_ps(destination + i + 4, sum1);
+            }
+            add_f32_scalar(destination + i, a + i, b + i, count - i);
+        }
+
+        OL_TARGET_AVX2 static void add_f32_avx2(f32* destination, const f32* a, const f32* b, size_t count) {
+            size_t i = 0;
+            for(; i + 16 <= count; i += 16) {
+                __m256 sum0 = _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+                __m256 sum1 = _mm256_add_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+                _mm256_storeu_ps(destination + i, sum0);
+                _mm256_storeu_ps(destination + i + 8, sum1);
+            }
+            add_f32_scalar(destination + i, a + i, b + i, count - i);
+        }
+
+        OL_TARGET_AVX512 static void add_f32_avx512(f32* destination, const f32* a, const f32* b, size_t count) {
+            size_t i = 0;
+            for(; i + 32 <= count; i += 32) {
+                __m512 sum0 = _mm512_add_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+                __m512 sum1 = _mm512_add_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+                _mm512_storeu_ps(destination + i, sum0);
+                _mm512_storeu_ps(destination + i + 16, sum1);
+            }
+            for(; i < count; i += 16) {
+                __mmask16 mask = count - i >= 16 ? static_cast<__mmask16>(0xFFFF) : static_cast<__mmask16>((1u << (count - i)) - 1);
+                __m512 sum = _mm512_add_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+                _mm512_mask_storeu_ps(destination + i, mask, sum);
+            }
+        }
+#endif
+
+        [[nodiscard]] static AddF32Kernel add_f32_kernel(Level level) {
+#if OL_SIMD_X86
+            switch(level) {
+                case Level::SSE2: {
+                    return add_f32_sse2;
+                } break;
+                case Level::AVX2: {
+                    return add_f32_avx2;
+                } break;
+                case Level::AVX512: {
+                    return add_f32_avx512;
+                } break;
+                default: {
+                    return add_f32_scalar;
+                }
+            }
+#else
+            (void)level;
+            return add_f32_scalar;
+#endif
+        }
+
+        // Resolved once on first use from the best level the CPU reports.
+        [[maybe_unused]] static void add_f32(f32* destination, const f32* a, const f32* b, size_t count) {
+            static const AddF32Kernel kernel = add_f32_kernel(best_level());
+            kernel(destination, a, b, count);
+        }
+
+        // destination[i] = a[i] + (b[i] - a[i]) * t, or b[i] itself when the two are more than max_step apart, so values
+        // that teleported (an entity wrapping around the world) snap instead of sweeping across. Every path does the
+        // same subtract, multiply and add per lane with no fused multiply-add, so results are bit-identical across levels.
+        using LerpF32Kernel = void (*)(f32* destination, const f32* a, const f32* b, f32 t, f32 max_step, size_t count);
+
+        static void lerp_f32_scalar(f32* destination, const f32* a, const f32* b, f32 t, f32 max_step, size_t count) {
+            for(size_t i = 0; i < count; ++i) {
+                f32 delta = b[i] - a[i];
+                f32 interpolated = a[i] + delta * t;
+                destination[i] = delta > max_step || delta < -max_step ? b[i] : interpolated;
+            }
+        }
+
+#if OL_SIMD_X86
+        OL_TARGET_SSE2 static void lerp_f32_sse2(f32* destination, const f32* a, const f32* b, f32 t, f32 max_step, size_t count) {
+            __m128 factor = _mm_set1_ps(t);
+            __m128 limit = _mm_set1_ps(max_step);
+            __m128 sign = _mm_set1_ps(-0.0f);
+            size_t i = 0;
+            for(; i + 4 <= count; i += 4) {
+                __m128 from = _mm_loadu_ps(a + i);
+                __m128 to = _mm_loadu_ps(b + i);
+                __m128 delta = _mm_sub_ps(to, from);
+                __m128 interpolated = _mm_add_ps(from, _mm_mul_ps(delta, factor));
+                __m128 snap = _mm_cmpgt_ps(_mm_andnot_ps(sign, delta), limit);
+                _mm_storeu_ps(destination + i, _mm_or_ps(_mm_and_ps(snap, to), _mm_andnot_ps(snap, interpolated)));
+            }
+            lerp_f32_scalar(destination + i, a + i, b + i, t, max_step, count - i);
+        }
+
+        OL_TARGET_AVX2 static void lerp_f32_avx2(f32* destination, const f32* a, const f32* b, f32 t, f32 max_step, size_t count) {
+            __m256 factor = _mm256_set1_ps(t);
+            __m256 limit = _mm256_set1_ps(max_step);
+            __m256 sign = _mm256_set1_ps(-0.0f);
+            size_t i = 0;
+            for(; i + 8 <= count; i += 8) {
+                __m256 from = _mm256_loadu_ps(a + i);
+                __m256 to = _mm256_loadu_ps(b + i);
+                __m256 delta = _mm256_sub_ps(to, from);
+                __m256 interpolated = _mm256_add_ps(from, _mm256_mul_ps(delta, factor));
+                __m256 snap = _mm256_cmp_ps(_mm256_andnot_ps(sign, delta), limit, _CMP_GT_OQ);
+                _mm256_storeu_ps(destination + i, _mm256_blendv_ps(interpolated, to, snap));
+            }
+            lerp_f32_scalar(destination + i, a + i, b + i, t, max_step, count - i);
+        }
+#endif
+
+        [[nodiscard]] static LerpF32Kernel lerp_f32_kernel(Level level) {
+#if OL_SIMD_X86
+            switch(level) {
+                case Level::SSE2: {
+                    return lerp_f32_sse2;
+                } break;
+                // avx512f implies FMA, which the compiler may fuse the multiply and add into, so AVX-512 CPUs share the
+                // AVX2 kernel to stay bit-identical.
+                case Level::AVX2:
+                case Level::AVX512: {
+                    return lerp_f32_avx2;
+                } break;
+                default: {
+                    return lerp_f32_scalar;
+                }
+            }
+#else
+            (void)level;
+            return lerp_f32_scalar;
+#endif
+        }
+
+        // Resolved once on first use from the best level the CPU reports.
+        [[maybe_unused]] static void lerp_f32(f32* destination, const f32* a, const f32* b, f32 t, f32 max_step, size_t count) {
+            static const LerpF32Kernel kernel = lerp_f32_kernel(best_level());
+            kernel(destination, a, b, t, max_step, count);
+        }
+    }
+}
\ No newline at end of file
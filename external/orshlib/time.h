@@ -47,4 +47,39 @@ namespace OL {
         }
     };
 
+    // Fixed-rate update driven by variable frame times. advance() returns how many steps the frame should run, at
+    // most max_steps_per_frame: after a stall the backlog past that is dropped, so the game slows down for a moment
+    // instead of running step after step while each one makes the next frame later still. What is left over, as a
+    // fraction of a step, is how far rendering should interpolate from the previous state to the current one.
+    struct FixedTimestep {
+        static constexpr u32 DEFAULT_MAX_STEPS_PER_FRAME = 4;
+
+        Time::Duration step;
+        u32 max_steps_per_frame = DEFAULT_MAX_STEPS_PER_FRAME;
+        Time::Duration accumulator = Time::Duration::zero();
+        u64 steps = 0;
+        u64 dropped_steps = 0;
+
+        [[nodiscard]] static constexpr Time::Duration from_rate(u32 steps_per_second) {
+            return Time::Duration(Time::Seconds(1)) / steps_per_second;
+        }
+
+        [[nodiscard]] u32 advance(Time::Duration frame_time) {
+            accumulator += frame_time;
+            u64 due = static_cast<u64>(accumulator / step);
+            u32 run = due < max_steps_per_frame ? static_cast<u32>(due) : max_steps_per_frame;
+
+            // The dropped backlog keeps its phase within the step, so interpolation doesn't jump.
+            dropped_steps += due - run;
+            accumulator -= step * static_cast<s64>(due);
+            steps += run;
+            return run;
+        }
+
+        // In [0, 1): how far past the last step the current time is.
+        [[nodiscard]] f32 alpha() const {
+            return static_cast<f32>(static_cast<f64>(accumulator.count()) / static_cast<f64>(step.count()));
+        }
+    };
+
 }
\ No newline at end of file
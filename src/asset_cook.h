@@ -0,0 +1,227 @@
+#pragma once
+
+#include "atlas.h"
+#include "asset_pack.h"
+#include "mipmaps.h"
+#include "block_compression.h"
+
+#include <orshlib/types.h>
+#include <orshlib/file.h>
+#include <orshlib/memory.h>
+#include <orshlib/util.h>
+#include <orshlib/jobs.h>
+#include <orshlib/profiler.h>
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ASSERT(x)
+//#define STBI_ONLY_PNG
+#include <stb_image.h>
+
+// Decoding and atlas building shared by the runtime fallback in textures.h, the offline cooker and the benchmark.
+
+static const char* ASSETS_DIRECTORY = "assets/";
+
+static const char* image_paths[] = {
+    "athano.bmp",
+    "azen.png",
+    "azen2.png",
+    "azen3.png",
+    "pepe.png"
+};
+
+static constexpr size_t MAX_TEXTURES_COUNT = OL::array_count(image_paths);
+
+// pixels is either stb's decode or a malloc'd buffer that replaced it, both are released with free_images.
+// level_count > 1 means pixels holds that many mip levels back to back.
+struct ImageData {
+    u8* pixels;
+    u32 size;
+    u32 width;
+    u32 height;
+    u32 level_count;
+};
+
+[[nodiscard]] static bool decode_image(const char* directory, const char* name, ImageData* data) {
+    char path[OL::File::MAX_FILENAME_LENGTH];
+    snprintf(path, OL::File::MAX_FILENAME_LENGTH, "%s%s", directory, name);
+
+    s32 width, height;
+    data->pixels = stbi_load(path, &width, &height, nullptr, 4);
+    if(!data->pixels) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[decode_image()] Unable to decode %s...%s", path, stbi_failure_reason());
+        *data = {};
+        return false;
+    }
+
+    data->width = static_cast<u32>(width);
+    data->height = static_cast<u32>(height);
+    data->size = data->width * data->height * 4;
+    data->level_count = 1;
+
+    return true;
+}
+
+// Reads only the image header, so atlas rects can be packed before anything is decoded.
+[[nodiscard, maybe_unused]] static bool read_image_size(const char* directory, const char* name, AtlasRect* rect) {
+    char path[OL::File::MAX_FILENAME_LENGTH];
+    snprintf(path, OL::File::MAX_FILENAME_LENGTH, "%s%s", directory, name);
+
+    s32 width, height, channels;
+    if(!stbi_info(path, &width, &height, &channels)) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[read_image_size()] Unable to read %s...%s", path, stbi_failure_reason());
+        return false;
+    }
+
+    *rect = { .width = static_cast<u32>(width), .height = static_cast<u32>(height) };
+    return true;
+}
+
+[[nodiscard]] static bool decode_images(const char* directory, const char* const* names, u32 count, ImageData* images, AtlasRect* rects) {
+    for(u32 image_index = 0; image_index < count; ++image_index) {
+        ImageData* data = &images[image_index];
+        if(!decode_image(directory, names[image_index], data)) {
+            for(u32 i = 0; i < image_index; ++i) {
+                stbi_image_free(images[i].pixels);
+            }
+            return false;
+        }
+
+        rects[image_index] = { .width = data->width, .height = data->height };
+    }
+
+    return true;
+}
+
+static void free_images(ImageData* images, u32 count) {
+    for(u32 image_index = 0; image_index < count; ++image_index) {
+        stbi_image_free(images[image_index].pixels);
+        images[image_index].pixels = nullptr;
+    }
+}
+
+static constexpr u32 MAX_IMAGE_DECODE_BATCH = 1024;
+
+// Decodes a set of images on the job system's background queue, one job per image. Each index is pushed to
+// `completed` as soon as its image is done, so the consumer can start using images while the rest are still decoding.
+// A failed decode is still pushed, with null pixels. `prepare`, when set before the batch starts, runs on the worker
+// after each successful decode to do any further per-image work off the consumer's thread.
+struct ImageDecodeBatch {
+    const char* directory;
+    const char* const* names;
+    ImageData* images;
+    u32 count;
+    void (*prepare)(void* context, u32 image_index, ImageData* image);
+    void* prepare_context;
+    OL::JobCounter counter;
+    OL::Job jobs[MAX_IMAGE_DECODE_BATCH];
+    OL::MPSCQueue<u32, MAX_IMAGE_DECODE_BATCH> completed;
+};
+
+static void decode_image_job(void* context, size_t begin, size_t end) {
+    OL_PROFILE_ZONE("decode_image_job");
+    ImageDecodeBatch* batch = static_cast<ImageDecodeBatch*>(context);
+    for(size_t image_index = begin; image_index < end; ++image_index) {
+        ImageData* image = &batch->images[image_index];
+        if(decode_image(batch->directory, batch->names[image_index], image) && batch->prepare) {
+            batch->prepare(batch->prepare_context, static_cast<u32>(image_index), image);
+        }
+        bool queued = batch->completed.push(static_cast<u32>(image_index));
+        assert(queued);
+    }
+}
+
+[[nodiscard, maybe_unused]] static bool start_image_decode_batch(ImageDecodeBatch* batch, OL::JobSystem* job_system, const char* directory, const char* const* names, ImageData* images, u32 count) {
+    if(count > MAX_IMAGE_DECODE_BATCH) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[start_image_decode_batch()] %u images requested, the limit is %u.", count, MAX_IMAGE_DECODE_BATCH);
+        return false;
+    }
+
+    assert(batch->counter.done());
+    batch->directory = directory;
+    batch->names = names;
+    batch->images = images;
+    batch->count = count;
+    batch->completed.reset();
+
+    for(u32 image_index = 0; image_index < count; ++image_index) {
+        images[image_index] = {};
+        batch->jobs[image_index] = {
+            .function = decode_image_job,
+            .context = batch,
+            .begin = image_index,
+            .end = image_index + 1
+        };
+    }
+    // Background, so a frame's parallel_for never ends up running a decode while it waits.
+    job_system->submit_background(batch->jobs, count, &batch->counter);
+
+    return true;
+}
+
+// Clears the page and blits every image into its packed rect.
+static void build_atlas_page(u8* page, AtlasLayout layout, const ImageData* images, const AtlasRect* rects, u32 count, u32 padding) {
+    memset(page, 0, static_cast<size_t>(layout.width) * layout.height * ASSET_PACK_BYTES_PER_TEXEL);
+    for(u32 image_index = 0; image_index < count; ++image_index) {
+        blit_atlas_rect(page, layout.width, images[image_index].pixels, rects[image_index], padding);
+    }
+}
+
+// Scratch cook_asset_pack needs: the mip generator's f32 levels, plus the RGBA8 chain to compress from when the pack
+// is block compressed.
+[[nodiscard]] static size_t cook_scratch_size(AtlasLayout layout, BlockFormat format) {
+    size_t size = mip_scratch_size(layout.width, layout.height);
+    if(format != BlockFormat::RGBA8) {
+        size += mip_chain_size(layout.width, layout.height, mip_level_count(layout.width, layout.height));
+    }
+    return size;
+}
+
+// Lays out the whole pack in `out` (header, sprite table, then the page and its mip chain) and returns the number of
+// bytes to write, or 0 on failure. RGBA8 levels are written in place. Block formats build the chain in scratch and
+// compress each level into the pack, spread over jobs when it is set. scratch must hold cook_scratch_size bytes.
+[[nodiscard]] static size_t cook_asset_pack(const ImageData* images, const char* const* names, const AtlasRect* rects, u32 count, AtlasLayout layout, u32 padding, OL::Buffer* out, OL::Buffer* scratch,
+                                            BlockFormat format = BlockFormat::RGBA8, OL::JobSystem* jobs = nullptr) {
+    AssetPackHeader header = make_asset_pack_header(layout, count, padding, format);
+
+    if(out->bytes_remaining() < header.file_size) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[cook_asset_pack()] Pack needs %llu bytes, buffer has %zu.", static_cast<unsigned long long>(header.file_size), out->bytes_remaining());
+        return 0;
+    }
+
+    size_t scratch_size = cook_scratch_size(layout, format);
+    if(scratch->bytes_remaining() < scratch_size) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[cook_asset_pack()] Cooking needs %zu bytes of scratch, buffer has %zu.", scratch_size, scratch->bytes_remaining());
+        return 0;
+    }
+
+    u8* pack = out->reserve(header.file_size);
+    memset(pack, 0, header.file_size);
+    memcpy(pack, &header, sizeof(header));
+
+    AssetPackSprite* sprites = reinterpret_cast<AssetPackSprite*>(pack + header.sprites_offset);
+    for(u32 i = 0; i < count; ++i) {
+        snprintf(sprites[i].name, ASSET_PACK_NAME_LENGTH, "%s", names[i]);
+        sprites[i].rect = rects[i];
+    }
+
+    f32* mip_scratch = scratch->reserve<f32>(mip_scratch_size(layout.width, layout.height) / sizeof(f32));
+    u8* chain = format == BlockFormat::RGBA8 ? nullptr : scratch->reserve(mip_chain_size(layout.width, layout.height, header.level_count));
+    u8* levels[ASSET_PACK_MAX_LEVELS];
+    size_t chain_offset = 0;
+    for(u32 level = 0; level < header.level_count; ++level) {
+        levels[level] = chain ? chain + chain_offset : pack + header.levels[level].offset;
+        chain_offset += static_cast<size_t>(header.levels[level].width) * header.levels[level].height * ASSET_PACK_BYTES_PER_TEXEL;
+    }
+
+    build_atlas_page(levels[0], layout, images, rects, count, padding);
+    generate_mipmaps(levels, layout.width, layout.height, header.level_count, MIPMAP_SRGB, mip_scratch);
+
+    if(chain) {
+        for(u32 level = 0; level < header.level_count; ++level) {
+            const AssetPackLevel& level_info = header.levels[level];
+            [[maybe_unused]] size_t written = compress_image(format, levels[level], level_info.width, level_info.height, pack + level_info.offset, jobs);
+            assert(written == level_info.size);
+        }
+    }
+
+    return header.file_size;
+}
\ No newline at end of file
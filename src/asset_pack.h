@@ -0,0 +1,173 @@
+#pragma once
+
+#include "atlas.h"
+#include "mipmaps.h"
+#include "block_compression.h"
+
+#include <orshlib/types.h>
+#include <orshlib/file.h>
+#include <cstring>
+
+// Binary sprite pack written by the cooker (tools/cooker.cpp) and memory-mapped at startup.
+//
+//   AssetPackHeader
+//   AssetPackSprite[sprite_count]
+//   level 0 texels, level 1 texels, ...   (each level starts on an ASSET_PACK_DATA_ALIGNMENT boundary)
+//
+// Texels are the finished atlas page: already decoded, packed, padded, mipmapped and, unless format is RGBA8, block
+// compressed, so loading is a straight copy into a transfer buffer. Everything is stored little-endian, and any change to the layout must
+// bump ASSET_PACK_VERSION.
+
+static constexpr const char* ASSET_PACK_PATH = "assets/sprites.pack";
+
+static constexpr u32 ASSET_PACK_MAGIC = 0x4B504C4F; // "OLPK"
+static constexpr u32 ASSET_PACK_VERSION = 2;
+static constexpr u32 ASSET_PACK_MAX_LEVELS = MAX_MIP_LEVELS;
+static constexpr u32 ASSET_PACK_NAME_LENGTH = 64;
+static constexpr u64 ASSET_PACK_DATA_ALIGNMENT = 4096;
+static constexpr u32 ASSET_PACK_BYTES_PER_TEXEL = MIP_BYTES_PER_TEXEL;
+
+struct AssetPackLevel {
+    u64 offset;
+    u64 size;
+    u32 width;
+    u32 height;
+};
+
+struct AssetPackSprite {
+    char name[ASSET_PACK_NAME_LENGTH];
+    AtlasRect rect;
+};
+
+struct AssetPackHeader {
+    u32 magic;
+    u32 version;
+    u32 page_width;
+    u32 page_height;
+    u32 padding;
+    u32 level_count;
+    u32 sprite_count;
+    BlockFormat format;
+    u64 sprites_offset;
+    u64 file_size;
+    AssetPackLevel levels[ASSET_PACK_MAX_LEVELS];
+};
+
+struct AssetPack {
+    OL::MappedFile file;
+    const AssetPackHeader* header;
+    const AssetPackSprite* sprites;
+
+    [[nodiscard]] const u8* level_texels(u32 level) {
+        return file.data + header->levels[level].offset;
+    }
+
+    // Bytes of every level packed back to back, which is how they are laid out in the transfer buffer.
+    [[nodiscard]] u64 texel_size() {
+        u64 size = 0;
+        for(u32 level = 0; level < header->level_count; ++level) {
+            size += header->levels[level].size;
+        }
+        return size;
+    }
+};
+
+[[nodiscard]] static u64 align_asset_pack_offset(u64 offset) {
+    return (offset + ASSET_PACK_DATA_ALIGNMENT - 1) & ~(ASSET_PACK_DATA_ALIGNMENT - 1);
+}
+
+// Fills in the header for a full mip chain of the page, including every offset and the total file size.
+[[nodiscard]] static AssetPackHeader make_asset_pack_header(AtlasLayout layout, u32 sprite_count, u32 padding, BlockFormat format = BlockFormat::RGBA8) {
+    AssetPackHeader header = {
+        .magic = ASSET_PACK_MAGIC,
+        .version = ASSET_PACK_VERSION,
+        .page_width = layout.width,
+        .page_height = layout.height,
+        .padding = padding,
+        .level_count = mip_level_count(layout.width, layout.height),
+        .sprite_count = sprite_count,
+        .format = format,
+        .sprites_offset = sizeof(AssetPackHeader)
+    };
+
+    u64 offset = header.sprites_offset + sizeof(AssetPackSprite) * sprite_count;
+    u32 level_width = layout.width;
+    u32 level_height = layout.height;
+    for(u32 level = 0; level < header.level_count; ++level) {
+        offset = align_asset_pack_offset(offset);
+        header.levels[level] = {
+            .offset = offset,
+            .size = block_format_level_size(format, level_width, level_height),
+            .width = level_width,
+            .height = level_height
+        };
+        offset += header.levels[level].size;
+        level_width = level_width > 1 ? level_width / 2 : 1;
+        level_height = level_height > 1 ? level_height / 2 : 1;
+    }
+    header.file_size = offset;
+
+    return header;
+}
+
+static void close_asset_pack(AssetPack* pack) {
+    pack->file.unmap();
+    *pack = {};
+}
+
+// Maps the pack and checks every offset in the header against the file before anything reads through it.
+[[nodiscard, maybe_unused]] static bool open_asset_pack(const char* path, AssetPack* pack) {
+    *pack = {};
+    if(!OL::MappedFile::map(path, &pack->file)) {
+        return false;
+    }
+
+    const AssetPackHeader* header = reinterpret_cast<const AssetPackHeader*>(pack->file.data);
+    const char* error = nullptr;
+    if(pack->file.size < sizeof(AssetPackHeader) || header->magic != ASSET_PACK_MAGIC) {
+        error = "not an asset pack";
+    } else if(header->version != ASSET_PACK_VERSION) {
+        error = "version mismatch, re-run the cooker";
+    } else if(header->file_size != pack->file.size) {
+        error = "truncated";
+    } else if(static_cast<u32>(header->format) >= static_cast<u32>(BlockFormat::MAX_COUNT)) {
+        error = "unknown texel format";
+    } else if(header->level_count == 0 || header->level_count > ASSET_PACK_MAX_LEVELS) {
+        error = "invalid level count";
+    } else if(header->sprites_offset + static_cast<u64>(header->sprite_count) * sizeof(AssetPackSprite) > pack->file.size) {
+        error = "sprite table out of bounds";
+    } else {
+        for(u32 level = 0; level < header->level_count && !error; ++level) {
+            const AssetPackLevel& level_info = header->levels[level];
+            u64 expected_size = block_format_level_size(header->format, level_info.width, level_info.height);
+            if(level_info.size != expected_size || level_info.offset + level_info.size > pack->file.size) {
+                error = "level data out of bounds";
+            }
+        }
+    }
+
+    if(error) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[open_asset_pack()] %s: %s.", path, error);
+        close_asset_pack(pack);
+        return false;
+    }
+
+    pack->header = header;
+    pack->sprites = reinterpret_cast<const AssetPackSprite*>(pack->file.data + header->sprites_offset);
+    return true;
+}
+
+// True when the pack holds exactly these images in this order, so sprite ids line up with image_paths.
+[[nodiscard, maybe_unused]] static bool asset_pack_matches(AssetPack* pack, const char* const* names, u32 count) {
+    if(pack->header->sprite_count != count) {
+        return false;
+    }
+
+    for(u32 i = 0; i < count; ++i) {
+        if(strncmp(pack->sprites[i].name, names[i], ASSET_PACK_NAME_LENGTH) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <orshlib/types.h>
+#include <orshlib/memory.h>
+#include <algorithm>
+#include <cstring>
+
+// Skyline bottom-left rectangle packer for the texture atlas. Kept free of SDL and stb so it can be driven
+// from the benchmark with synthetic sprite sets.
+
+static constexpr u32 DEFAULT_ATLAS_PADDING = 2;
+static constexpr u32 MAX_ATLAS_PAGE_SIZE = 8192;
+
+struct AtlasRect {
+    u32 x;
+    u32 y;
+    u32 width;
+    u32 height;
+};
+
+struct AtlasLayout {
+    u32 width;
+    u32 height;
+    u64 used_area;
+
+    [[nodiscard]] bool packed() {
+        return width > 0;
+    }
+
+    [[nodiscard]] f64 efficiency() {
+        return width > 0 ? static_cast<f64>(used_area) / (static_cast<f64>(width) * height) : 0.0;
+    }
+};
+
+struct SkylinePacker {
+    struct Node {
+        u32 x;
+        u32 y;
+        u32 width;
+    };
+
+    Node* nodes;
+    u32 node_count;
+    u32 node_capacity;
+    u32 width;
+    u32 height;
+
+    void reset(u32 page_width, u32 page_height) {
+        width = page_width;
+        height = page_height;
+        nodes[0] = { .x = 0, .y = 0, .width = page_width };
+        node_count = 1;
+    }
+
+    // Lowest y at which a rect of rect_width fits when its left edge sits on node index, or ~0u if it doesn't fit.
+    [[nodiscard]] u32 fit(u32 index, u32 rect_width, u32 rect_height) {
+        u32 x = nodes[index].x;
+        if(x + rect_width > width) {
+            return ~0u;
+        }
+
+        u32 y = 0;
+        u32 width_left = rect_width;
+        for(u32 i = index; width_left > 0; ++i) {
+            y = nodes[i].y > y ? nodes[i].y : y;
+            if(y + rect_height > height) {
+                return ~0u;
+            }
+            width_left = nodes[i].width >= width_left ? 0 : width_left - nodes[i].width;
+        }
+
+        return y;
+    }
+
+    [[nodiscard]] bool insert(u32 rect_width, u32 rect_height, u32* out_x, u32* out_y) {
+        u32 best_index = ~0u;
+        u32 best_top = ~0u;
+        u32 best_node_width = ~0u;
+        for(u32 i = 0; i < node_count; ++i) {
+            u32 y = fit(i, rect_width, rect_height);
+            if(y == ~0u) {
+                continue;
+            }
+
+            u32 top = y + rect_height;
+            if(top < best_top || (top == best_top && nodes[i].width < best_node_width)) {
+                best_index = i;
+                best_top = top;
+                best_node_width = nodes[i].width;
+            }
+        }
+
+        if(best_index == ~0u || node_count + 1 > node_capacity) {
+            return false;
+        }
+
+        *out_x = nodes[best_index].x;
+        *out_y = best_top - rect_height;
+
+        // The new rect becomes a skyline segment and shadows whatever it covers to its right.
+        memmove(&nodes[best_index + 1], &nodes[best_index], sizeof(Node) * (node_count - best_index));
+        ++node_count;
+        nodes[best_index] = { .x = *out_x, .y = best_top, .width = rect_width };
+
+        u32 right = *out_x + rect_width;
+        u32 i = best_index + 1;
+        while(i < node_count && nodes[i].x < right) {
+            u32 node_right = nodes[i].x + nodes[i].width;
+            if(node_right <= right) {
+                memmove(&nodes[i], &nodes[i + 1], sizeof(Node) * (node_count - i - 1));
+                --node_count;
+                continue;
+            }
+
+            nodes[i].width = node_right - right;
+            nodes[i].x = right;
+            break;
+        }
+
+        for(u32 j = 0; j + 1 < node_count;) {
+            if(nodes[j].y == nodes[j + 1].y) {
+                nodes[j].width += nodes[j + 1].width;
+                memmove(&nodes[j + 1], &nodes[j + 2], sizeof(Node) * (node_count - j - 2));
+                --node_count;
+            } else {
+                ++j;
+            }
+        }
+
+        return true;
+    }
+};
+
+[[nodiscard]] static u32 next_power_of_two(u32 value) {
+    u32 result = 1;
+    while(result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+// Packs rects (width and height filled in by the caller, x and y written back) into the smallest power-of-two
+// page that holds them all, tallest first. Every rect gets `padding` texels of border on each side, and the
+// returned x/y point at the rect itself, inside that border. With an `alignment` above 1 each padded slot is
+// rounded up to a multiple of it, so every slot also starts on a multiple of it. Returns an empty layout when
+// nothing up to max_page_size fits.
+[[nodiscard]] static AtlasLayout pack_atlas(AtlasRect* rects, u32 count, u32 padding, u32 max_page_size, OL::Buffer* scratch, u32 alignment = 1) {
+    AtlasLayout layout = {};
+    if(count == 0) {
+        return layout;
+    }
+
+    u32* order = scratch->reserve<u32>(count);
+    SkylinePacker packer = {
+        .nodes = scratch->reserve<SkylinePacker::Node>(count + 1),
+        .node_capacity = count + 1
+    };
+    if(!order || !packer.nodes) {
+        return layout;
+    }
+
+    auto slot_size = [padding, alignment](u32 size) {
+        return (size + padding * 2 + alignment - 1) / alignment * alignment;
+    };
+
+    u64 padded_area = 0;
+    u32 widest = 0;
+    u32 tallest = 0;
+    for(u32 i = 0; i < count; ++i) {
+        order[i] = i;
+        u32 padded_width = slot_size(rects[i].width);
+        u32 padded_height = slot_size(rects[i].height);
+        padded_area += static_cast<u64>(padded_width) * padded_height;
+        widest = padded_width > widest ? padded_width : widest;
+        tallest = padded_height > tallest ? padded_height : tallest;
+        layout.used_area += static_cast<u64>(rects[i].width) * rects[i].height;
+    }
+
+    std::sort(order, order + count, [rects](u32 a, u32 b) {
+        if(rects[a].height != rects[b].height) {
+            return rects[a].height > rects[b].height;
+        }
+        return rects[a].width > rects[b].width;
+    });
+
+    // Walk power-of-two pages in order of area (s x s, 2s x s, 2s x 2s, ...) starting from the smallest that could hold the total.
+    u32 page_width = next_power_of_two(widest);
+    u32 page_height = next_power_of_two(tallest);
+    while(static_cast<u64>(page_width) * page_height < padded_area) {
+        if(page_width <= page_height) {
+            page_width <<= 1;
+        } else {
+            page_height <<= 1;
+        }
+    }
+
+    while(page_width <= max_page_size && page_height <= max_page_size) {
+        packer.reset(page_width, page_height);
+
+        bool fits = true;
+        for(u32 i = 0; i < count && fits; ++i) {
+            AtlasRect* rect = &rects[order[i]];
+            u32 x, y;
+            fits = packer.insert(slot_size(rect->width), slot_size(rect->height), &x, &y);
+            if(fits) {
+                rect->x = x + padding;
+                rect->y = y + padding;
+            }
+        }
+
+        if(fits) {
+            layout.width = page_width;
+            layout.height = page_height;
+            return layout;
+        }
+
+        if(page_width <= page_height) {
+            page_width <<= 1;
+        } else {
+            page_height <<= 1;
+        }
+    }
+
+    OL::Logger::log(OL::Logger::LEVEL_ERROR, "[pack_atlas()] %u rects do not fit in a %ux%u page.", count, max_page_size, max_page_size);
+    return {};
+}
+
+// Copies an RGBA8 image into its atlas rect and extrudes its edge texels into the padding, so bilinear
+// filtering at the sprite border samples the sprite itself instead of its neighbours.
+[[maybe_unused]] static void blit_atlas_rect(u8* page, u32 page_width, const u8* pixels, AtlasRect rect, u32 padding) {
+    static constexpr u32 BYTES_PER_TEXEL = 4;
+    size_t page_pitch = static_cast<size_t>(page_width) * BYTES_PER_TEXEL;
+    size_t row_bytes = static_cast<size_t>(rect.width) * BYTES_PER_TEXEL;
+
+    for(u32 row = 0; row < rect.height + padding * 2; ++row) {
+        u32 source_row = row < padding ? 0 : (row - padding >= rect.height ? rect.height - 1 : row - padding);
+        const u8* source = pixels + source_row * row_bytes;
+        u8* destination = page + (rect.y - padding + row) * page_pitch + (rect.x - padding) * BYTES_PER_TEXEL;
+
+        for(u32 i = 0; i < padding; ++i) {
+            memcpy(destination + i * BYTES_PER_TEXEL, source, BYTES_PER_TEXEL);
+        }
+        memcpy(destination + padding * BYTES_PER_TEXEL, source, row_bytes);
+        for(u32 i = 0; i < padding; ++i) {
+            memcpy(destination + (padding + rect.width + i) * BYTES_PER_TEXEL, source + row_bytes - BYTES_PER_TEXEL, BYTES_PER_TEXEL);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,792 @@
+#pragma once
+
+#include "mipmaps.h"
+
+#include <orshlib/types.h>
+#include <orshlib/simd.h>
+#include <orshlib/jobs.h>
+#include <orshlib/profiler.h>
+#include <cassert>
+#include <cstring>
+#include <cmath>
+
+// CPU block compression of RGBA8 images into the BCn formats GPUs sample directly, so the cooker can store the atlas
+// page at 4 or 8 bits per texel instead of 32. Kept free of SDL so the benchmark can drive it headless.
+//
+// BC1 (8 bytes per 4x4 block) is for opaque pages, BC3 and BC7 (16 bytes) keep alpha. Every encoder fits its
+// endpoints along the block's principal axis, picks indices, then refits the endpoints to those indices by least
+// squares and keeps whichever came out closer. BC3's alpha tries both of its modes. BC7 only writes mode 6, one
+// RGBA subset with 4-bit indices, and tries all four p-bit pairs. Picking indices is the inner loop and the only part
+// that runs through a SIMD kernel. Texels and palettes hold whole numbers in f32, so every squared error is exact and
+// all kernels choose the same indices.
+
+enum class BlockFormat : u32 {
+    RGBA8,
+    BC1,
+    BC3,
+    BC7,
+    MAX_COUNT
+};
+
+static constexpr u32 BLOCK_DIMENSION = 4;
+static constexpr u32 BLOCK_TEXELS = BLOCK_DIMENSION * BLOCK_DIMENSION;
+// Blocks per job when an image is spread over the job system, rounded to whole block rows.
+static constexpr u32 BLOCK_COMPRESSION_JOB_BLOCKS = 1024;
+
+[[nodiscard, maybe_unused]] static const char* block_format_to_string(BlockFormat format) {
+    switch(format) {
+        case BlockFormat::RGBA8: {
+            return "RGBA8";
+        } break;
+        case BlockFormat::BC1: {
+            return "BC1";
+        } break;
+        case BlockFormat::BC3: {
+            return "BC3";
+        } break;
+        case BlockFormat::BC7: {
+            return "BC7";
+        } break;
+        default: {
+            return "";
+        }
+    }
+}
+
+[[nodiscard]] static u32 block_format_block_size(BlockFormat format) {
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+// Bytes of one mip level. Block formats round up to whole blocks, so the 2x2 and 1x1 levels still take a block each.
+[[nodiscard]] static size_t block_format_level_size(BlockFormat format, u32 width, u32 height) {
+    if(format == BlockFormat::RGBA8) {
+        return static_cast<size_t>(width) * height * MIP_BYTES_PER_TEXEL;
+    }
+    size_t blocks_x = (width + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+    size_t blocks_y = (height + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+    return blocks_x * blocks_y * block_format_block_size(format);
+}
+
+// BC1 when no texel has any transparency, BC7 otherwise.
+[[nodiscard, maybe_unused]] static BlockFormat choose_block_format(const u8* pixels, size_t texel_count) {
+    for(size_t i = 0; i < texel_count; ++i) {
+        if(pixels[i * 4 + 3] != 255) {
+            return BlockFormat::BC7;
+        }
+    }
+    return BlockFormat::BC1;
+}
+
+// 16 texels, or up to 16 palette entries, one channel after another so a kernel loads each channel as whole registers.
+struct alignas(32) BlockChannels {
+    f32 values[4][BLOCK_TEXELS];
+};
+
+// Writes the closest of the first palette_size entries for each texel to indices and returns the summed squared error.
+// Ties go to the lower index.
+using BlockIndexKernel = u32 (*)(const BlockChannels* texels, const BlockChannels* palette, u32 palette_size, u8* indices);
+
+static u32 select_block_indices_scalar(const BlockChannels* texels, const BlockChannels* palette, u32 palette_size, u8* indices) {
+    u32 total = 0;
+    for(u32 texel = 0; texel < BLOCK_TEXELS; ++texel) {
+        f32 best_error = 3.0e38f;
+        u32 best_index = 0;
+        for(u32 entry = 0; entry < palette_size; ++entry) {
+            f32 error = 0.0f;
+            for(u32 channel = 0; channel < 4; ++channel) {
+                f32 difference = texels->values[channel][texel] - palette->values[channel][entry];
+                error += difference * difference;
+            }
+            if(error < best_error) {
+                best_error = error;
+                best_index = entry;
+            }
+        }
+        indices[texel] = static_cast<u8>(best_index);
+        total += static_cast<u32>(best_error);
+    }
+    return total;
+}
+
+#if OL_SIMD_X86
+// Four texels per register, every palette entry broadcast against them.
+OL_TARGET_SSE2 static u32 select_block_indices_sse2(const BlockChannels* texels, const BlockChannels* palette, u32 palette_size, u8* indices) {
+    u32 total = 0;
+    for(u32 group = 0; group < BLOCK_TEXELS; group += 4) {
+        __m128 channels[4];
+        for(u32 channel = 0; channel < 4; ++channel) {
+            channels[channel] = _mm_loadu_ps(&texels->values[channel][group]);
+        }
+
+        __m128 best_error = _mm_set1_ps(3.0e38f);
+        __m128i best_index = _mm_setzero_si128();
+        for(u32 entry = 0; entry < palette_size; ++entry) {
+            __m128 error = _mm_setzero_ps();
+            for(u32 channel = 0; channel < 4; ++channel) {
+                __m128 difference = _mm_sub_ps(channels[channel], _mm_set1_ps(palette->values[channel][entry]));
+                error = _mm_add_ps(error, _mm_mul_ps(difference, difference));
+            }
+            __m128i closer = _mm_castps_si128(_mm_cmplt_ps(error, best_error));
+            best_error = _mm_min_ps(error, best_error);
+            best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(static_cast<s32>(entry))), _mm_andnot_si128(closer, best_index));
+        }
+
+        alignas(16) u32 group_indices[4];
+        alignas(16) f32 group_errors[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(group_indices), best_index);
+        _mm_store_ps(group_errors, best_error);
+        for(u32 i = 0; i < 4; ++i) {
+            indices[group + i] = static_cast<u8>(group_indices[i]);
+            total += static_cast<u32>(group_errors[i]);
+        }
+    }
+    return total;
+}
+
+// Eight texels per register, so a block is two of them.
+OL_TARGET_AVX2 static u32 select_block_indices_avx2(const BlockChannels* texels, const BlockChannels* palette, u32 palette_size, u8* indices) {
+    u32 total = 0;
+    for(u32 group = 0; group < BLOCK_TEXELS; group += 8) {
+        __m256 channels[4];
+        for(u32 channel = 0; channel < 4; ++channel) {
+            channels[channel] = _mm256_loadu_ps(&texels->values[channel][group]);
+        }
+
+        __m256 best_error = _mm256_set1_ps(3.0e38f);
+        __m256i best_index = _mm256_setzero_si256();
+        for(u32 entry = 0; entry < palette_size; ++entry) {
+            __m256 error = _mm256_setzero_ps();
+            for(u32 channel = 0; channel < 4; ++channel) {
+                __m256 difference = _mm256_sub_ps(channels[channel], _mm256_set1_ps(palette->values[channel][entry]));
+                error = _mm256_add_ps(error, _mm256_mul_ps(difference, difference));
+            }
+            __m256 closer = _mm256_cmp_ps(error, best_error, _CMP_LT_OQ);
+            best_error = _mm256_min_ps(error, best_error);
+            best_index = _mm256_blendv_epi8(best_index, _mm256_set1_epi32(static_cast<s32>(entry)), _mm256_castps_si256(closer));
+        }
+
+        alignas(32) u32 group_indices[8];
+        alignas(32) f32 group_errors[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(group_indices), best_index);
+        _mm256_store_ps(group_errors, best_error);
+        for(u32 i = 0; i < 8; ++i) {
+            indices[group + i] = static_cast<u8>(group_indices[i]);
+            total += static_cast<u32>(group_errors[i]);
+        }
+    }
+    return total;
+}
+#endif
+
+[[nodiscard]] static BlockIndexKernel select_block_indices_kernel(OL::SIMD::Level level) {
+#if OL_SIMD_X86
+    switch(level) {
+        case OL::SIMD::Level::SSE2: {
+            return select_block_indices_sse2;
+        } break;
+        // A block is only two AVX2 registers wide, AVX-512 has nothing to add.
+        case OL::SIMD::Level::AVX2:
+        case OL::SIMD::Level::AVX512: {
+            return select_block_indices_avx2;
+        } break;
+        default: {
+            return select_block_indices_scalar;
+        }
+    }
+#else
+    (void)level;
+    return select_block_indices_scalar;
+#endif
+}
+
+// Resolved once on first use from the best level the CPU reports.
+static u32 select_block_indices(const BlockChannels* texels, const BlockChannels* palette, u32 palette_size, u8* indices) {
+    static const BlockIndexKernel kernel = select_block_indices_kernel(OL::SIMD::best_level());
+    return kernel(texels, palette, palette_size, indices);
+}
+
+[[nodiscard]] static f32 clamp_unorm8(f32 value) {
+    return value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value);
+}
+
+// Mean of the first channel_count channels and the dominant eigenvector of their covariance, by power iteration
+// seeded with the row of the widest channel. The axis is unit length, or zero when the block is flat.
+static void block_principal_axis(const BlockChannels* texels, u32 channel_count, f32* mean, f32* axis) {
+    for(u32 channel = 0; channel < channel_count; ++channel) {
+        f32 sum = 0.0f;
+        for(u32 texel = 0; texel < BLOCK_TEXELS; ++texel) {
+            sum += texels->values[channel][texel];
+        }
+        mean[channel] = sum / BLOCK_TEXELS;
+    }
+
+    f32 covariance[4][4] = {};
+    for(u32 texel = 0; texel < BLOCK_TEXELS; ++texel) {
+        for(u32 a = 0; a < channel_count; ++a) {
+            f32 offset = texels->values[a][texel] - mean[a];
+            for(u32 b = 0; b < channel_count; ++b) {
+                covariance[a][b] += offset * (texels->values[b][texel] - mean[b]);
+            }
+        }
+    }
+
+    u32 widest = 0;
+    for(u32 channel = 1; channel < channel_count; ++channel) {
+        widest = covariance[channel][channel] > covariance[widest][widest] ? channel : widest;
+    }
+    for(u32 channel = 0; channel < 4; ++channel) {
+        axis[channel] = channel < channel_count ? covariance[widest][channel] : 0.0f;
+    }
+
+    for(u32 iteration = 0; iteration < 8; ++iteration) {
+        f32 next[4] = {};
+        f32 largest = 0.0f;
+        for(u32 a = 0; a < channel_count; ++a) {
+            for(u32 b = 0; b < channel_count; ++b) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            largest = fabsf(next[a]) > largest ? fabsf(next[a]) : largest;
+        }
+        if(largest < 1.0e-6f) {
+            break;
+        }
+        for(u32 channel = 0; channel < channel_count; ++channel) {
+            axis[channel] = next[channel] / largest;
+        }
+    }
+
+    f32 length = 0.0f;
+    for(u32 channel = 0; channel < channel_count; ++channel) {
+        length += axis[channel] * axis[channel];
+    }
+    length = sqrtf(length);
+    for(u32 channel = 0; channel < channel_count; ++channel) {
+        axis[channel] = length > 1.0e-6f ? axis[channel] / length : 0.0f;
+    }
+}
+
+// Endpoints at the extremes of the block's projection onto its principal axis.
+static void fit_block_endpoints(const BlockChannels* texels, u32 channel_count, f32* endpoint0, f32* endpoint1) {
+    f32 mean[4], axis[4];
+    block_principal_axis(texels, channel_count, mean, axis);
+
+    f32 lowest = 0.0f, highest = 0.0f;
+    for(u32 texel = 0; texel < BLOCK_TEXELS; ++texel) {
+        f32 projection = 0.0f;
+        for(u32 channel = 0; channel < channel_count; ++channel) {
+            projection += (texels->values[channel][texel] - mean[channel]) * axis[channel];
+        }
+        lowest = projection < lowest ? projection : lowest;
+        highest = projection > highest ? projection : highest;
+    }
+
+    for(u32 channel = 0; channel < channel_count; ++channel) {
+        endpoint0[channel] = clamp_unorm8(mean[channel] + axis[channel] * highest);
+        endpoint1[channel] = clamp_unorm8(mean[channel] + axis[channel] * lowest);
+    }
+}
+
+// Least-squares endpoints for fixed indices, where weights[i] is palette entry i's share of the second endpoint. False
+// when every texel has the same weight, which leaves the endpoints undetermined.
+[[nodiscard]] static bool refine_block_endpoints(const BlockChannels* texels, u32 channel_count, const u8* indices, const f32* weights, f32* endpoint0, f32* endpoint1) {
+    f32 aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    f32 ax[4] = {}, bx[4] = {};
+    for(u32 texel = 0; texel < BLOCK_TEXELS; ++texel) {
+        f32 b = weights[indices[texel]];
+        f32 a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for(u32 channel = 0; channel < channel_count; ++channel) {
+            ax[channel] += a * texels->values[channel][texel];
+            bx[channel] += b * texels->values[channel][texel];
+        }
+    }
+
+    f32 determinant = aa * bb - ab * ab;
+    if(fabsf(determinant) < 1.0e-4f) {
+        return false;
+    }
+
+    for(u32 channel = 0; channel < channel_count; ++channel) {
+        endpoint0[channel] = clamp_unorm8((bb * ax[channel] - ab * bx[channel]) / determinant);
+        endpoint1[channel] = clamp_unorm8((aa * bx[channel] - ab * ax[channel]) / determinant);
+    }
+    return true;
+}
+
+// Gathers the 4x4 block at (block_x, block_y). Blocks past the image edge repeat its last row and column.
+static void load_block(const u8* pixels, u32 width, u32 height, u32 block_x, u32 block_y, BlockChannels* texels) {
+    for(u32 y = 0; y < BLOCK_DIMENSION; ++y) {
+        u32 source_y = block_y * BLOCK_DIMENSION + y < height ? block_y * BLOCK_DIMENSION + y : height - 1;
+        for(u32 x = 0; x < BLOCK_DIMENSION; ++x) {
+            u32 source_x = block_x * BLOCK_DIMENSION + x < width ? block_x * BLOCK_DIMENSION + x : width - 1;
+            const u8* texel = pixels + (static_cast<size_t>(source_y) * width + source_x) * 4;
+            for(u32 channel = 0; channel < 4; ++channel) {
+                texels->values[channel][y * BLOCK_DIMENSION + x] = texel[channel];
+            }
+        }
+    }
+}
+
+// Writes a decoded block back, skipping the texels that fall past the image edge.
+static void store_block(const u8* block_texels, u32 width, u32 height, u32 block_x, u32 block_y, u8* pixels) {
+    for(u32 y = 0; y < BLOCK_DIMENSION && block_y * BLOCK_DIMENSION + y < height; ++y) {
+        for(u32 x = 0; x < BLOCK_DIMENSION && block_x * BLOCK_DIMENSION + x < width; ++x) {
+            size_t offset = (static_cast<size_t>(block_y * BLOCK_DIMENSION + y) * width + block_x * BLOCK_DIMENSION + x) * 4;
+            memcpy(pixels + offset, block_texels + (y * BLOCK_DIMENSION + x) * 4, 4);
+        }
+    }
+}
+
+//
+// BC1 and the color half of BC3.
+//
+
+[[nodiscard]] static u16 pack_rgb565(const f32* color) {
+    u32 r = static_cast<u32>(clamp_unorm8(color[0]) * (31.0f / 255.0f) + 0.5f);
+    u32 g = static_cast<u32>(clamp_unorm8(color[1]) * (63.0f / 255.0f) + 0.5f);
+    u32 b = static_cast<u32>(clamp_unorm8(color[2]) * (31.0f / 255.0f) + 0.5f);
+    return static_cast<u16>((r << 11) | (g << 5) | b);
+}
+
+static void unpack_rgb565(u16 packed, u32* color) {
+    u32 r = packed >> 11;
+    u32 g = (packed >> 5) & 0x3F;
+    u32 b = packed & 0x1F;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// RGBA of all four entries as the decoder reads them. Three-color mode, with transparent black as the last entry,
+// applies when color0 <= color1 and the block allows it.
+static void color_block_palette(u16 color0, u16 color1, bool allow_three_color, u8 (*palette)[4]) {
+    u32 endpoint0[3], endpoint1[3];
+    unpack_rgb565(color0, endpoint0);
+    unpack_rgb565(color1, endpoint1);
+    bool four_color = color0 > color1 || !allow_three_color;
+    for(u32 channel = 0; channel < 3; ++channel) {
+        palette[0][channel] = static_cast<u8>(endpoint0[channel]);
+        palette[1][channel] = static_cast<u8>(endpoint1[channel]);
+        palette[2][channel] = static_cast<u8>(four_color ? (endpoint0[channel] * 2 + endpoint1[channel]) / 3 : (endpoint0[channel] + endpoint1[channel]) / 2);
+        palette[3][channel] = static_cast<u8>(four_color ? (endpoint0[channel] + endpoint1[channel] * 2) / 3 : 0);
+    }
+    palette[0][3] = palette[1][3] = palette[2][3] = 255;
+    palette[3][3] = four_color ? 255 : 0;
+}
+
+// Quantizes both endpoints and picks indices against the four-color palette they decode to.
+static u32 evaluate_color_endpoints(const BlockChannels* colors, const f32* endpoint0, const f32* endpoint1, BlockIndexKernel kernel, u16* color0, u16* color1, u8* indices) {
+    *color0 = pack_rgb565(endpoint0);
+    *color1 = pack_rgb565(endpoint1);
+    u8 entries[4][4];
+    color_block_palette(*color0, *color1, false, entries);
+
+    BlockChannels palette = {};
+    for(u32 entry = 0; entry < 4; ++entry) {
+        for(u32 channel = 0; channel < 3; ++channel) {
+            palette.values[channel][entry] = entries[entry][channel];
+        }
+    }
+    return kernel(colors, &palette, 4, indices);
+}
+
+// Always four-color mode: BC3 requires it, and opaque BC1 has no use for the three-color mode's transparent black.
+// Only the color channels of texels count, alpha is ignored.
+static void encode_color_block(const BlockChannels* texels, BlockIndexKernel kernel, u8* output) {
+    static constexpr f32 COLOR_WEIGHTS[] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    BlockChannels colors = *texels;
+    memset(colors.values[3], 0, sizeof(colors.values[3]));
+
+    f32 endpoint0[4], endpoint1[4];
+    fit_block_endpoints(&colors, 3, endpoint0, endpoint1);
+    u16 color0, color1;
+    u8 indices[BLOCK_TEXELS];
+    u32 error = evaluate_color_endpoints(&colors, endpoint0, endpoint1, kernel, &color0, &color1, indices);
+
+    for(u32 pass = 0; pass < 2 && error > 0; ++pass) {
+        if(!refine_block_endpoints(&colors, 3, indices, COLOR_WEIGHTS, endpoint0, endpoint1)) {
+            break;
+        }
+        u16 refined0, refined1;
+        u8 refined_indices[BLOCK_TEXELS];
+        u32 refined_error = evaluate_color_endpoints(&colors, endpoint0, endpoint1, kernel, &refined0, &refined1, refined_indices);
+        if(refined_error >= error) {
+            break;
+        }
+        error = refined_error;
+        color0 = refined0;
+        color1 = refined1;
+        memcpy(indices, refined_indices, sizeof(indices));
+    }
+
+    // Four-color mode needs color0 > color1. Equal endpoints decode as three-color mode, where index 0 is still color0.
+    if(color0 < color1) {
+        static constexpr u8 SWAPPED[] = { 1, 0, 3, 2 };
+        u16 swap = color0;
+        color0 = color1;
+        color1 = swap;
+        for(u8& index : indices) {
+            index = SWAPPED[index];
+        }
+    } else if(color0 == color1) {
+        memset(indices, 0, sizeof(indices));
+    }
+
+    u32 index_bits = 0;
+    for(u32 texel = 0; texel < BLOCK_TEXELS; ++texel) {
+        index_bits |= static_cast<u32>(indices[texel]) << (texel * 2);
+    }
+    memcpy(output, &color0, 2);
+    memcpy(output + 2, &color1, 2);
+    memcpy(output + 4, &index_bits, 4);
+}
+
+static void decode_color_block(const u8* block, bool allow_three_color, u8* texels) {
+    u16 color0, color1;
+    u32 index_bits;
+    memcpy(&color0, block, 2);
+    memcpy(&color1, block + 2, 2);
+    memcpy(&index_bits, block + 4, 4);
+
+    u8 palette[4][4];
+    color_block_palette(color0, color1, allow_three_color, palette);
+    for(u32 texel = 0; texel < BLOCK_TEXELS; ++texel) {
+        memcpy(texels + texel * 4, palette[(index_bits >> (texel * 2)) & 0x3], 4);
+    }
+}
+
+//
+// The alpha half of BC3.
+//
+
+// Eight-value mode interpolates six steps when alpha0 > alpha1. Otherwise four, plus an exact 0 and 255.
+static void alpha_block_palette(u32 alpha0, u32 alpha1, u8* palette) {
+    palette[0] = static_cast<u8>(alpha0);
+    palette[1] = static_cast<u8>(alpha1);
+    if(alpha0 > alpha1) {
+        for(u32 i = 1; i < 7; ++i) {
+            palette[i + 1] = static_cast<u8>(((7 - i) * alpha0 + i * alpha1) / 7);
+        }
+    } else {
+        for(u32 i = 1; i < 5; ++i) {
+            palette[i + 1] = static_cast<u8>(((5 - i) * alpha0 + i * alpha1) / 5);
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static u32 evaluate_alpha_endpoints(const BlockChannels* alphas, u32 alpha0, u32 alpha1, BlockIndexKernel kernel, u8* indices) {
+    u8 entries[8];
+    alpha_block_palette(alpha0, alpha1, entries);
+    BlockChannels palette = {};
+    for(u32 entry = 0; entry < 8; ++entry) {
+        palette.values[0][entry] = entries[entry];
+    }
+    return kernel(alphas, &palette, 8, indices);
+}
+
+static void encode_alpha_block(const BlockChannels* texels, BlockIndexKernel kernel, u8* output) {
+    BlockChannels alphas = {};
+    memcpy(alphas.values[0], texels->values[3], sizeof(alphas.values[0]));
+
+    u32 lowest = 255, highest = 0;
+    u32 inner_lowest = 255, inner_highest = 0;
+    for(u32 texel = 0; texel < BLOCK_TEXELS; ++texel) {
+        u32 alpha = static_cast<u32>(alphas.values[0][texel]);
+        lowest = alpha < lowest ? alpha : lowest;
+        highest = alpha > highest ? alpha : highest;
+        if(alpha != 0 && alpha != 255) {
+            inner_lowest = alpha < inner_lowest ? alpha : inner_lowest;
+            inner_highest = alpha > inner_highest ? alpha : inner_highest;
+        }
+    }
+    if(inner_lowest > inner_highest) {
+        inner_lowest = inner_highest = 0;
+    }
+
+    // Sprite edges mix fully clear and fully opaque texels with a ramp in between, which the six-value mode's exact
+    // 0 and 255 handle better. Both modes are tried.
+    u8 indices[BLOCK_TEXELS];
+    u32 alpha0 = highest, alpha1 = lowest;
+    u32 error = evaluate_alpha_endpoints(&alphas, alpha0, alpha1, kernel, indices);
+    if(error > 0) {
+        u8 six_value_indices[BLOCK_TEXELS];
+        u32 six_value_error = evaluate_alpha_endpoints(&alphas, inner_lowest, inner_highest, kernel, six_value_indices);
+        if(six_value_error < error) {
+            alpha0 = inner_lowest;
+            alpha1 = inner_highest;
+            memcpy(indices, six_value_indices, sizeof(indices));
+        }
+    }
+
+    u64 index_bits = 0;
+    for(u32 texel = 0; texel < BLOCK_TEXELS; ++texel) {
+        index_bits |= static_cast<u64>(indices[texel]) << (texel * 3);
+    }
+    output[0] = static_cast<u8>(alpha0);
+    output[1] = static_cast<u8>(alpha1);
+    memcpy(output + 2, &index_bits, 6);
+}
+
+static void decode_alpha_block(const u8* block, u8* texels) {
+    u8 palette[8];
+    alpha_block_palette(block[0], block[1], palette);
+    u64 index_bits = 0;
+    memcpy(&index_bits, block + 2, 6);
+    for(u32 texel = 0; texel < BLOCK_TEXELS; ++texel) {
+        texels[texel * 4 + 3] = palette[(index_bits >> (texel * 3)) & 0x7];
+    }
+}
+
+//
+// BC7 mode 6.
+//
+
+static constexpr u32 BC7_MODE6_WEIGHTS[] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Seven bits per channel per endpoint, and one p-bit per endpoint appended below all four channels.
+struct Bc7Endpoints {
+    u8 quantized[2][4];
+    u8 p_bits[2];
+};
+
+[[nodiscard]] static u32 bc7_endpoint_value(const Bc7Endpoints* endpoints, u32 endpoint, u32 channel) {
+    return (static_cast<u32>(endpoints->quantized[endpoint][channel]) << 1) | endpoints->p_bits[endpoint];
+}
+
+static void bc7_mode6_palette(const Bc7Endpoints* endpoints, u8 (*palette)[4]) {
+    for(u32 channel = 0; channel < 4; ++channel) {
+        u32 value0 = bc7_endpoint_value(endpoints, 0, channel);
+        u32 value1 = bc7_endpoint_value(endpoints, 1, channel);
+        for(u32 entry = 0; entry < 16; ++entry) {
+            palette[entry][channel] = static_cast<u8>(((64 - BC7_MODE6_WEIGHTS[entry]) * value0 + BC7_MODE6_WEIGHTS[entry] * value1 + 32) >> 6);
+        }
+    }
+}
+
+// Tries every p-bit pair for the two endpoints and keeps the closest, writing its indices.
+static u32 evaluate_bc7_endpoints(const BlockChannels* texels, const f32* endpoint0, const f32* endpoint1, BlockIndexKernel kernel, Bc7Endpoints* best, u8* indices) {
+    u32 best_error = ~0u;
+    for(u32 p_bits = 0; p_bits < 4; ++p_bits) {
+        Bc7Endpoints endpoints = { .p_bits = { static_cast<u8>(p_bits & 1), static_cast<u8>(p_bits >> 1) } };
+        for(u32 channel = 0; channel < 4; ++channel) {
+            f32 quantized0 = (endpoint0[channel] - endpoints.p_bits[0]) * 0.5f + 0.5f;
+            f32 quantized1 = (endpoint1[channel] - endpoints.p_bits[1]) * 0.5f + 0.5f;
+            endpoints.quantized[0][channel] = static_cast<u8>(quantized0 < 0.0f ? 0.0f : (quantized0 > 127.0f ? 127.0f : quantized0));
+            endpoints.quantized[1][channel] = static_cast<u8>(quantized1 < 0.0f ? 0.0f : (quantized1 > 127.0f ? 127.0f : quantized1));
+        }
+
+        u8 entries[16][4];
+        bc7_mode6_palette(&endpoints, entries);
+        BlockChannels palette;
+        for(u32 entry = 0; entry < 16; ++entry) {
+            for(u32 channel = 0; channel < 4; ++channel) {
+                palette.values[channel][entry] = entries[entry][channel];
+            }
+        }
+
+        u8 candidate_indices[BLOCK_TEXELS];
+        u32 error = kernel(texels, &palette, 16, candidate_indices);
+        if(error < best_error) {
+            best_error = error;
+            *best = endpoints;
+            memcpy(indices, candidate_indices, BLOCK_TEXELS);
+        }
+    }
+    return best_error;
+}
+
+// Appends bits to a 128-bit block from its least significant bit up.
+struct BlockBitWriter {
+    u8* bytes;
+    u32 position;
+
+    void write(u32 value, u32 count) {
+        for(u32 bit = 0; bit < count; ++bit, ++position) {
+            bytes[position >> 3] |= static_cast<u8>(((value >> bit) & 1) << (position & 7));
+        }
+    }
+};
+
+[[nodiscard]] static u32 read_block_bits(const u8* bytes, u32* position, u32 count) {
+    u32 value = 0;
+    for(u32 bit = 0; bit < count; ++bit, ++*position) {
+        value |= static_cast<u32>((bytes[*position >> 3] >> (*position & 7)) & 1) << bit;
+    }
+    return value;
+}
+
+static void encode_bc7_block(const BlockChannels* texels, BlockIndexKernel kernel, u8* output) {
+    static constexpr f32 MODE6_WEIGHTS[] = { 0.0f / 64.0f, 4.0f / 64.0f, 9.0f / 64.0f, 13.0f / 64.0f, 17.0f / 64.0f, 21.0f / 64.0f, 26.0f / 64.0f, 30.0f / 64.0f,
+                                             34.0f / 64.0f, 38.0f / 64.0f, 43.0f / 64.0f, 47.0f / 64.0f, 51.0f / 64.0f, 55.0f / 64.0f, 60.0f / 64.0f, 64.0f / 64.0f };
+    f32 endpoint0[4], endpoint1[4];
+    fit_block_endpoints(texels, 4, endpoint0, endpoint1);
+    Bc7Endpoints endpoints;
+    u8 indices[BLOCK_TEXELS];
+    u32 error = evaluate_bc7_endpoints(texels, endpoint0, endpoint1, kernel, &endpoints, indices);
+
+    for(u32 pass = 0; pass < 2 && error > 0; ++pass) {
+        if(!refine_block_endpoints(texels, 4, indices, MODE6_WEIGHTS, endpoint0, endpoint1)) {
+            break;
+        }
+        Bc7Endpoints refined;
+        u8 refined_indices[BLOCK_TEXELS];
+        u32 refined_error = evaluate_bc7_endpoints(texels, endpoint0, endpoint1, kernel, &refined, refined_indices);
+        if(refined_error >= error) {
+            break;
+        }
+        error = refined_error;
+        endpoints = refined;
+        memcpy(indices, refined_indices, sizeof(indices));
+    }
+
+    // The first index is stored with its top bit implied zero, so swap the endpoints when it would be set.
+    if(indices[0] & 0x8) {
+        Bc7Endpoints swapped = {
+            .quantized = {
+                { endpoints.quantized[1][0], endpoints.quantized[1][1], endpoints.quantized[1][2], endpoints.quantized[1][3] },
+                { endpoints.quantized[0][0], endpoints.quantized[0][1], endpoints.quantized[0][2], endpoints.quantized[0][3] }
+            },
+            .p_bits = { endpoints.p_bits[1], endpoints.p_bits[0] }
+        };
+        endpoints = swapped;
+        for(u8& index : indices) {
+            index = static_cast<u8>(15 - index);
+        }
+    }
+
+    memset(output, 0, 16);
+    BlockBitWriter writer = { .bytes = output };
+    writer.write(1u << 6, 7);
+    for(u32 channel = 0; channel < 4; ++channel) {
+        writer.write(endpoints.quantized[0][channel], 7);
+        writer.write(endpoints.quantized[1][channel], 7);
+    }
+    writer.write(endpoints.p_bits[0], 1);
+    writer.write(endpoints.p_bits[1], 1);
+    writer.write(indices[0], 3);
+    for(u32 texel = 1; texel < BLOCK_TEXELS; ++texel) {
+        writer.write(indices[texel], 4);
+    }
+}
+
+// Only mode 6, the one the encoder writes, is decoded. Any other block comes out transparent black.
+static void decode_bc7_block(const u8* block, u8* texels) {
+    if((block[0] & 0x7F) != (1u << 6)) {
+        memset(texels, 0, BLOCK_TEXELS * 4);
+        return;
+    }
+
+    u32 position = 7;
+    Bc7Endpoints endpoints;
+    for(u32 channel = 0; channel < 4; ++channel) {
+        endpoints.quantized[0][channel] = static_cast<u8>(read_block_bits(block, &position, 7));
+        endpoints.quantized[1][channel] = static_cast<u8>(read_block_bits(block, &position, 7));
+    }
+    endpoints.p_bits[0] = static_cast<u8>(read_block_bits(block, &position, 1));
+    endpoints.p_bits[1] = static_cast<u8>(read_block_bits(block, &position, 1));
+
+    u8 palette[16][4];
+    bc7_mode6_palette(&endpoints, palette);
+    for(u32 texel = 0; texel < BLOCK_TEXELS; ++texel) {
+        u32 index = read_block_bits(block, &position, texel == 0 ? 3 : 4);
+        memcpy(texels + texel * 4, palette[index], 4);
+    }
+}
+
+//
+// Whole images.
+//
+
+static void encode_block(BlockFormat format, const BlockChannels* texels, BlockIndexKernel kernel, u8* output) {
+    switch(format) {
+        case BlockFormat::BC1: {
+            encode_color_block(texels, kernel, output);
+        } break;
+        case BlockFormat::BC3: {
+            encode_alpha_block(texels, kernel, output);
+            encode_color_block(texels, kernel, output + 8);
+        } break;
+        case BlockFormat::BC7: {
+            encode_bc7_block(texels, kernel, output);
+        } break;
+        default: {
+            assert(false);
+        }
+    }
+}
+
+static void decode_block(BlockFormat format, const u8* block, u8* texels) {
+    switch(format) {
+        case BlockFormat::BC1: {
+            decode_color_block(block, true, texels);
+        } break;
+        case BlockFormat::BC3: {
+            decode_color_block(block + 8, false, texels);
+            decode_alpha_block(block, texels);
+        } break;
+        case BlockFormat::BC7: {
+            decode_bc7_block(block, texels);
+        } break;
+        default: {
+            assert(false);
+        }
+    }
+}
+
+// Compresses a width x height RGBA8 image into output, which must hold block_format_level_size(format, width, height)
+// bytes, and returns that size. Rows of blocks are spread over jobs when it is set. RGBA8 is a plain copy.
+static size_t compress_image(BlockFormat format, const u8* pixels, u32 width, u32 height, u8* output, OL::JobSystem* jobs = nullptr, BlockIndexKernel kernel = select_block_indices) {
+    OL_PROFILE_ZONE("compress_image");
+    size_t size = block_format_level_size(format, width, height);
+    if(format == BlockFormat::RGBA8) {
+        memcpy(output, pixels, size);
+        return size;
+    }
+
+    u32 blocks_x = (width + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+    u32 blocks_y = (height + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+    u32 block_size = block_format_block_size(format);
+    auto compress_rows = [&](size_t begin, size_t end) {
+        BlockChannels texels;
+        for(size_t block_y = begin; block_y < end; ++block_y) {
+            u8* row = output + block_y * blocks_x * block_size;
+            for(u32 block_x = 0; block_x < blocks_x; ++block_x) {
+                load_block(pixels, width, height, block_x, static_cast<u32>(block_y), &texels);
+                encode_block(format, &texels, kernel, row + block_x * block_size);
+            }
+        }
+    };
+
+    if(jobs) {
+        size_t grain = BLOCK_COMPRESSION_JOB_BLOCKS / blocks_x > 0 ? BLOCK_COMPRESSION_JOB_BLOCKS / blocks_x : 1;
+        jobs->parallel_for(0, blocks_y, grain, compress_rows);
+    } else {
+        compress_rows(0, blocks_y);
+    }
+    return size;
+}
+
+// The reverse, for checking the encoder and for GPUs that can't sample the format. pixels receives width x height
+// RGBA8 texels.
+[[maybe_unused]] static void decompress_image(BlockFormat format, const u8* blocks, u32 width, u32 height, u8* pixels) {
+    OL_PROFILE_ZONE("decompress_image");
+    if(format == BlockFormat::RGBA8) {
+        memcpy(pixels, blocks, block_format_level_size(format, width, height));
+        return;
+    }
+
+    u32 blocks_x = (width + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+    u32 blocks_y = (height + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+    u32 block_size = block_format_block_size(format);
+    u8 texels[BLOCK_TEXELS * 4];
+    for(u32 block_y = 0; block_y < blocks_y; ++block_y) {
+        for(u32 block_x = 0; block_x < blocks_x; ++block_x) {
+            decode_block(format, blocks + (static_cast<size_t>(block_y) * blocks_x + block_x) * block_size, texels);
+            store_block(texels, width, height, block_x, block_y, pixels);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,253 @@
+#pragma once
+
+#include "simulation.h"
+#include "instance_format.h"
+
+#include <orshlib/types.h>
+#include <orshlib/memory.h>
+#include <orshlib/simd.h>
+#include <orshlib/jobs.h>
+#include <orshlib/log.h>
+#include <orshlib/profiler.h>
+#include <cassert>
+#include <cstring>
+
+// Visibility culling for the instance stream. Every instance is a quad centered on its position, so it is visible
+// when its position lies inside the view grown by the quad's half size. Visible instances are compacted into one
+// contiguous stream per range, which is what gets uploaded and drawn, so instances outside the view cost neither
+// upload bytes nor vertex work.
+
+// Instances per cull job. Ranges are split on their own, so a chunk never spans two ranges.
+static constexpr u32 CULL_CHUNK_INSTANCES = 16 * 1024;
+
+struct ViewBounds {
+    Vector2 min;
+    Vector2 max;
+};
+
+// A run of instances drawn with the same quad. extent is that quad's half size. cull_instances fills in where the
+// range's visible instances start in the compacted stream and how many there are.
+struct CullRange {
+    u32 begin;
+    u32 end;
+    Vector2 extent;
+    u32 first_visible;
+    u32 visible_count;
+};
+
+// Copies every instance whose position lies inside [min, max] to output, in order, and returns how many it copied.
+// output must have room for count instances: the kernels store unconditionally and only advance past visible ones.
+// Since they never write past the instance they are reading, output may also be the input.
+using CullKernel = u32 (*)(const InstanceData* instances, size_t count, Vector2 min, Vector2 max, InstanceData* output);
+
+static u32 cull_instances_scalar(const InstanceData* instances, size_t count, Vector2 min, Vector2 max, InstanceData* output) {
+    u32 visible = 0;
+    for(size_t i = 0; i < count; ++i) {
+        Vector2 position = instances[i].position;
+        output[visible] = instances[i];
+        // Non-short-circuit so the compare stays branch free, visibility is close to random per instance.
+        visible += (position.x >= min.x) & (position.x <= max.x) & (position.y >= min.y) & (position.y <= max.y);
+    }
+    return visible;
+}
+
+#if OL_SIMD_X86
+// Two instances per vector: each one is visible when both of its lanes pass.
+OL_TARGET_SSE2 static u32 cull_instances_sse2(const InstanceData* instances, size_t count, Vector2 min, Vector2 max, InstanceData* output) {
+    __m128 low = _mm_setr_ps(min.x, min.y, min.x, min.y);
+    __m128 high = _mm_setr_ps(max.x, max.y, max.x, max.y);
+    u32 visible = 0;
+    size_t i = 0;
+    for(; i + 2 <= count; i += 2) {
+        __m128 positions = _mm_loadu_ps(&instances[i].position.x);
+        u32 lanes = static_cast<u32>(_mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(positions, low), _mm_cmple_ps(positions, high))));
+        _mm_storel_pi(reinterpret_cast<__m64*>(output + visible), positions);
+        visible += (lanes & 0x3) == 0x3;
+        _mm_storeh_pi(reinterpret_cast<__m64*>(output + visible), positions);
+        visible += (lanes & 0xC) == 0xC;
+    }
+    return visible + cull_instances_scalar(instances + i, count - i, min, max, output + visible);
+}
+
+// Lane permutations that move the visible instances of a 4-instance block to the front, indexed by visibility mask.
+struct CullPackTable {
+    alignas(32) u32 lanes[16][8];
+    u32 counts[16];
+
+    constexpr CullPackTable() : lanes{}, counts{} {
+        for(u32 mask = 0; mask < 16; ++mask) {
+            u32 count = 0;
+            for(u32 instance = 0; instance < 4; ++instance) {
+                if(mask & (1u << instance)) {
+                    lanes[mask][count * 2] = instance * 2;
+                    lanes[mask][count * 2 + 1] = instance * 2 + 1;
+                    ++count;
+                }
+            }
+            counts[mask] = count;
+        }
+    }
+};
+
+static constexpr CullPackTable CULL_PACK_TABLE;
+
+OL_TARGET_AVX2 static u32 cull_instances_avx2(const InstanceData* instances, size_t count, Vector2 min, Vector2 max, InstanceData* output) {
+    __m256 low = _mm256_setr_ps(min.x, min.y, min.x, min.y, min.x, min.y, min.x, min.y);
+    __m256 high = _mm256_setr_ps(max.x, max.y, max.x, max.y, max.x, max.y, max.x, max.y);
+    u32 visible = 0;
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4) {
+        __m256 positions = _mm256_loadu_ps(&instances[i].position.x);
+        __m256 inside = _mm256_and_ps(_mm256_cmp_ps(positions, low, _CMP_GE_OQ), _mm256_cmp_ps(positions, high, _CMP_LE_OQ));
+        u32 lanes = static_cast<u32>(_mm256_movemask_ps(inside));
+
+        // Both lanes of an instance have to pass, then squeeze bits 0, 2, 4, 6 down to a 4-bit instance mask.
+        u32 mask = lanes & (lanes >> 1) & 0x55;
+        mask = (mask | (mask >> 1)) & 0x33;
+        mask = (mask | (mask >> 2)) & 0x0F;
+
+        __m256i permutation = _mm256_load_si256(reinterpret_cast<const __m256i*>(CULL_PACK_TABLE.lanes[mask]));
+        _mm256_storeu_ps(&output[visible].position.x, _mm256_permutevar8x32_ps(positions, permutation));
+        visible += CULL_PACK_TABLE.counts[mask];
+    }
+    return visible + cull_instances_scalar(instances + i, count - i, min, max, output + visible);
+}
+#endif
+
+[[nodiscard]] static CullKernel cull_kernel(OL::SIMD::Level level) {
+#if OL_SIMD_X86
+    switch(level) {
+        case OL::SIMD::Level::SSE2: {
+            return cull_instances_sse2;
+        } break;
+        case OL::SIMD::Level::AVX2:
+        case OL::SIMD::Level::AVX512: {
+            return cull_instances_avx2;
+        } break;
+        default: {
+            return cull_instances_scalar;
+        }
+    }
+#else
+    (void)level;
+    return cull_instances_scalar;
+#endif
+}
+
+struct CullChunk {
+    u32 begin;
+    u32 end;
+    u32 range;
+    u32 visible;
+    u32 offset;
+};
+
+// Scratch for the parallel path: every chunk compacts into its own slice of visible, then the slices are
+// copied to their final offsets, encoded to format on the way. The destination is usually a mapped transfer
+// buffer, which should only ever be written front to back and never read.
+struct InstanceCuller {
+    CullKernel kernel;
+    InstanceEncodeKernel encode;
+    InstanceFormat format;
+    InstanceData* visible;
+    CullChunk* chunks;
+    u32 capacity;
+    u32 max_chunks;
+};
+
+[[nodiscard]] static u32 instance_culler_max_chunks(u32 capacity, u32 max_ranges) {
+    return (capacity + CULL_CHUNK_INSTANCES - 1) / CULL_CHUNK_INSTANCES + max_ranges;
+}
+
+[[nodiscard]] static size_t instance_culler_memory_size(u32 capacity, u32 max_ranges) {
+    return OL::reserve_size<InstanceData>(capacity) + OL::reserve_size<CullChunk>(instance_culler_max_chunks(capacity, max_ranges));
+}
+
+[[nodiscard]] static bool init_instance_culler(InstanceCuller* culler, u32 capacity, u32 max_ranges, OL::Buffer* memory, InstanceFormat format = InstanceFormat::FULL) {
+    if(memory->bytes_remaining() < instance_culler_memory_size(capacity, max_ranges)) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[init_instance_culler()] Culling %u instances needs %zu bytes, buffer has %zu.", capacity, instance_culler_memory_size(capacity, max_ranges), memory->bytes_remaining());
+        return false;
+    }
+
+    u32 max_chunks = instance_culler_max_chunks(capacity, max_ranges);
+    *culler = {
+        .kernel = cull_kernel(OL::SIMD::best_level()),
+        .encode = instance_encode_kernel(OL::SIMD::best_level()),
+        .format = format,
+        .visible = memory->reserve<InstanceData>(capacity),
+        .chunks = memory->reserve<CullChunk>(max_chunks),
+        .capacity = capacity,
+        .max_chunks = max_chunks
+    };
+    return true;
+}
+
+// Compacts the visible instances of every range into destination, range after range, in the culler's instance
+// format, and returns the total. Each range's first_visible/visible_count are updated to match. destination needs
+// room for the visible total only.
+static u32 cull_instances(InstanceCuller* culler, const InstanceData* instances, CullRange* ranges, u32 range_count, ViewBounds view,
+                          void* destination, OL::JobSystem* jobs = nullptr) {
+    OL_PROFILE_ZONE("cull_instances");
+    u32 chunk_count = 0;
+    for(u32 range_index = 0; range_index < range_count; ++range_index) {
+        const CullRange& range = ranges[range_index];
+        assert(range.begin <= range.end && range.end <= culler->capacity);
+        for(u32 begin = range.begin; begin < range.end; begin += CULL_CHUNK_INSTANCES) {
+            assert(chunk_count < culler->max_chunks);
+            culler->chunks[chunk_count++] = {
+                .begin = begin,
+                .end = range.end - begin > CULL_CHUNK_INSTANCES ? begin + CULL_CHUNK_INSTANCES : range.end,
+                .range = range_index
+            };
+        }
+    }
+
+    auto cull_chunks = [culler, instances, ranges, view](size_t first, size_t last) {
+        OL_PROFILE_ZONE("cull_chunks");
+        for(size_t chunk_index = first; chunk_index < last; ++chunk_index) {
+            CullChunk* chunk = &culler->chunks[chunk_index];
+            Vector2 extent = ranges[chunk->range].extent;
+            Vector2 min = { view.min.x - extent.x, view.min.y - extent.y };
+            Vector2 max = { view.max.x + extent.x, view.max.y + extent.y };
+            chunk->visible = culler->kernel(instances + chunk->begin, chunk->end - chunk->begin, min, max, culler->visible + chunk->begin);
+        }
+    };
+
+    auto copy_chunks = [culler, destination](size_t first, size_t last) {
+        OL_PROFILE_ZONE("write_chunks");
+        u32 stride = instance_stride(culler->format);
+        for(size_t chunk_index = first; chunk_index < last; ++chunk_index) {
+            const CullChunk& chunk = culler->chunks[chunk_index];
+            write_instances(culler->format, culler->encode, culler->visible + chunk.begin, chunk.visible, static_cast<u8*>(destination) + static_cast<size_t>(chunk.offset) * stride);
+        }
+    };
+
+    if(jobs) {
+        jobs->parallel_for(0, chunk_count, 1, cull_chunks);
+    } else {
+        cull_chunks(0, chunk_count);
+    }
+
+    u32 total = 0;
+    for(u32 range_index = 0; range_index < range_count; ++range_index) {
+        ranges[range_index].visible_count = 0;
+    }
+    for(u32 chunk_index = 0; chunk_index < chunk_count; ++chunk_index) {
+        CullChunk* chunk = &culler->chunks[chunk_index];
+        chunk->offset = total;
+        ranges[chunk->range].visible_count += chunk->visible;
+        total += chunk->visible;
+    }
+    for(u32 range_index = 0, first_visible = 0; range_index < range_count; ++range_index) {
+        ranges[range_index].first_visible = first_visible;
+        first_visible += ranges[range_index].visible_count;
+    }
+
+    if(jobs) {
+        jobs->parallel_for(0, chunk_count, 1, copy_chunks);
+    } else {
+        copy_chunks(0, chunk_count);
+    }
+
+    return total;
+}
\ No newline at end of file
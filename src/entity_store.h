@@ -0,0 +1,161 @@
+#pragma once
+
+#include "simulation.h"
+
+#include <orshlib/types.h>
+#include <orshlib/memory.h>
+#include <orshlib/profiler.h>
+#include <cassert>
+
+// Generational handle to an entity. It stays valid until the entity is despawned, after which every lookup through
+// it fails, even once its slot has been handed to a new entity.
+struct EntityHandle {
+    u32 slot;
+    u32 generation;
+};
+
+static constexpr u32 INVALID_ENTITY_INDEX = ~0u;
+
+// Sparse set over a Simulation's arrays. Live entities stay packed at [0, count) of instances, entities and
+// previous_instances, so every per-entity loop (the tick, interpolation, culling, uploads) runs over them exactly as
+// it would over flat arrays. Slots give entities a stable identity: slot_dense maps a live slot to its entity's
+// current index and dense_slots maps back. Despawning moves the last entity into the hole, so order isn't kept.
+//
+// Everything is reserved up front for capacity entities and the simulation's arrays must have room for as many.
+// Spawning and despawning never allocate.
+struct EntityStore {
+    // Per slot: the dense index while alive, the next free slot while free.
+    u32* slot_dense;
+    u32* slot_generation;
+    u32* dense_slots;
+    u32 capacity;
+    // Head of the list of despawned slots, reused before any fresh one.
+    u32 free_head;
+    // Slots from here up were never handed out, so init doesn't have to build a free list of all of them.
+    u32 fresh_slot;
+};
+
+[[nodiscard]] static size_t entity_store_memory_size(u32 capacity) {
+    return OL::reserve_size<u32>(capacity) * 3;
+}
+
+// Gives the simulation's first live_count entities slots 0..live_count-1. Every handle from before is invalidated.
+static void reset_entity_store(EntityStore* store, Simulation* simulation, u32 live_count) {
+    assert(live_count <= store->capacity);
+    for(u32 slot = 0; slot < store->fresh_slot; ++slot) {
+        ++store->slot_generation[slot];
+    }
+    for(u32 index = 0; index < live_count; ++index) {
+        store->slot_dense[index] = index;
+        store->dense_slots[index] = index;
+    }
+    store->free_head = INVALID_ENTITY_INDEX;
+    store->fresh_slot = live_count > store->fresh_slot ? live_count : store->fresh_slot;
+    // Slots below the old high-water mark but past live_count go back on the free list.
+    for(u32 slot = store->fresh_slot; slot-- > live_count;) {
+        store->slot_dense[slot] = store->free_head;
+        store->free_head = slot;
+    }
+    simulation->count = live_count;
+}
+
+[[nodiscard]] static bool init_entity_store(EntityStore* store, Simulation* simulation, u32 capacity, OL::Buffer* buffer) {
+    if(buffer->bytes_remaining() < entity_store_memory_size(capacity)) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[init_entity_store()] Not enough memory for %u entities.", capacity);
+        return false;
+    }
+
+    *store = {
+        .slot_dense = buffer->reserve<u32>(capacity),
+        .slot_generation = buffer->reserve<u32>(capacity),
+        .dense_slots = buffer->reserve<u32>(capacity),
+        .capacity = capacity,
+        .free_head = INVALID_ENTITY_INDEX
+    };
+    assert(store->slot_dense && store->slot_generation && store->dense_slots);
+    memset(store->slot_generation, 0, sizeof(u32) * capacity);
+    reset_entity_store(store, simulation, static_cast<u32>(simulation->count));
+    return true;
+}
+
+// Dense index of the handle's entity, or INVALID_ENTITY_INDEX once it has been despawned.
+[[nodiscard]] static u32 entity_index(const EntityStore* store, EntityHandle handle) {
+    if(handle.slot >= store->fresh_slot || store->slot_generation[handle.slot] != handle.generation) {
+        return INVALID_ENTITY_INDEX;
+    }
+    return store->slot_dense[handle.slot];
+}
+
+[[nodiscard, maybe_unused]] static bool entity_alive(const EntityStore* store, EntityHandle handle) {
+    return entity_index(store, handle) != INVALID_ENTITY_INDEX;
+}
+
+// Handle of the entity currently at a dense index below the simulation's count.
+[[nodiscard]] static EntityHandle entity_handle(const EntityStore* store, u32 index) {
+    u32 slot = store->dense_slots[index];
+    return { .slot = slot, .generation = store->slot_generation[slot] };
+}
+
+// Appends up to count entities at the end of the packed range and returns the index of the first one: they occupy
+// [first, simulation->count) and their components are left for the caller to fill. handles, when set, receives one
+// handle per spawned entity. Stops at capacity.
+static u32 spawn_entities(EntityStore* store, Simulation* simulation, u32 count, EntityHandle* handles = nullptr) {
+    OL_PROFILE_ZONE("spawn_entities");
+    u32 first = static_cast<u32>(simulation->count);
+    u32 available = store->capacity - first;
+    count = count < available ? count : available;
+
+    for(u32 i = 0; i < count; ++i) {
+        u32 slot = store->free_head;
+        if(slot != INVALID_ENTITY_INDEX) {
+            store->free_head = store->slot_dense[slot];
+        } else {
+            slot = store->fresh_slot++;
+        }
+
+        store->slot_dense[slot] = first + i;
+        store->dense_slots[first + i] = slot;
+        if(handles) {
+            handles[i] = { .slot = slot, .generation = store->slot_generation[slot] };
+        }
+    }
+
+    simulation->count = first + count;
+    return first;
+}
+
+// Despawns every live entity among handles, skipping stale ones, and returns how many went. Each hole is filled by
+// the last entity, components and all, so the range stays packed. A grid on the simulation is stale until the next
+// tick rebuilds it.
+static u32 despawn_entities(EntityStore* store, Simulation* simulation, const EntityHandle* handles, u32 count) {
+    OL_PROFILE_ZONE("despawn_entities");
+    u32 despawned = 0;
+    u32 last = static_cast<u32>(simulation->count);
+    for(u32 i = 0; i < count; ++i) {
+        u32 index = entity_index(store, handles[i]);
+        if(index == INVALID_ENTITY_INDEX) {
+            continue;
+        }
+
+        --last;
+        if(index != last) {
+            simulation->instances[index] = simulation->instances[last];
+            simulation->entities[index] = simulation->entities[last];
+            if(simulation->previous_instances) {
+                simulation->previous_instances[index] = simulation->previous_instances[last];
+            }
+            u32 moved_slot = store->dense_slots[last];
+            store->dense_slots[index] = moved_slot;
+            store->slot_dense[moved_slot] = index;
+        }
+
+        u32 slot = handles[i].slot;
+        ++store->slot_generation[slot];
+        store->slot_dense[slot] = store->free_head;
+        store->free_head = slot;
+        ++despawned;
+    }
+
+    simulation->count = last;
+    return despawned;
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "simulation.h"
+
+#include <orshlib/types.h>
+#include <orshlib/simd.h>
+#include <cstring>
+
+// How instances are laid out in the GPU instance buffer. FULL is InstanceData as the simulation writes it.
+// COMPACT stores each position as two snorm16 values, read by the vertex shader through SHORT2_NORM as the same
+// [-1, 1] float it would get from FULL, so the shader is shared and only the vertex attribute format changes.
+//
+// snorm16 has a uniform step of 1/32767 over [-1, 1]. Rounding to nearest is off by at most half a step, plus up to
+// 2^-9 of a step from rounding the f32 product first, which is COMPACT_POSITION_MAX_ERROR: ~0.015 of a pixel at 1920
+// wide. Positions outside [-1, 1] clamp to the edge. That never happens in a world wrapped to the view, but quads
+// straddling the edge of a larger world would be pulled inward.
+//
+// The stream only carries what the renderer reads today. The sprite comes from the draw command's range and the
+// shader has no per-instance scale or tint, so those would be added to both layouts together once they exist.
+enum class InstanceFormat {
+    FULL,
+    COMPACT
+};
+
+struct CompactInstanceData {
+    s16 position[2];
+};
+
+static constexpr f32 COMPACT_POSITION_SCALE = 32767.0f;
+static constexpr f32 COMPACT_POSITION_MAX_ERROR = (0.5f + 1.0f / 512.0f) / COMPACT_POSITION_SCALE;
+
+static_assert(sizeof(CompactInstanceData) == sizeof(s16) * 2, "CompactInstanceData must stay a packed snorm16 pair for the encode kernels");
+
+[[nodiscard]] static constexpr u32 instance_stride(InstanceFormat format) {
+    return format == InstanceFormat::COMPACT ? sizeof(CompactInstanceData) : sizeof(InstanceData);
+}
+
+// The GPU's snorm16 decode: c / 32767, with -32768 also mapping to -1.
+[[nodiscard]] static f32 decode_compact_position(s16 value) {
+    f32 decoded = static_cast<f32>(value) / COMPACT_POSITION_SCALE;
+    return decoded < -1.0f ? -1.0f : decoded;
+}
+
+// Packs count instances into output. Every kernel clamps, scales and rounds to nearest even the same way, so all
+// of them produce identical output.
+using InstanceEncodeKernel = void (*)(const InstanceData* instances, size_t count, CompactInstanceData* output);
+
+static void encode_instances_scalar(const InstanceData* instances, size_t count, CompactInstanceData* output) {
+    // Adding and removing 1.5 * 2^23 pushes the fraction out of the mantissa, which rounds to nearest even like
+    // cvtps2dq without a libm call. Only valid for |value| < 2^22, and scaled positions stay within 32767.
+    static constexpr f32 ROUNDING_MAGIC = 12582912.0f;
+    const f32* source = &instances[0].position.x;
+    s16* destination = &output[0].position[0];
+    for(size_t i = 0; i < count * 2; ++i) {
+        f32 value = source[i] < -1.0f ? -1.0f : (source[i] > 1.0f ? 1.0f : source[i]);
+        destination[i] = static_cast<s16>((value * COMPACT_POSITION_SCALE + ROUNDING_MAGIC) - ROUNDING_MAGIC);
+    }
+}
+
+#if OL_SIMD_X86
+OL_TARGET_SSE2 static void encode_instances_sse2(const InstanceData* instances, size_t count, CompactInstanceData* output) {
+    const f32* source = &instances[0].position.x;
+    s16* destination = &output[0].position[0];
+    __m128 low = _mm_set1_ps(-1.0f);
+    __m128 high = _mm_set1_ps(1.0f);
+    __m128 scale = _mm_set1_ps(COMPACT_POSITION_SCALE);
+
+    size_t i = 0;
+    for(; i + 8 <= count * 2; i += 8) {
+        __m128 a = _mm_mul_ps(_mm_max_ps(_mm_min_ps(_mm_loadu_ps(source + i), high), low), scale);
+        __m128 b = _mm_mul_ps(_mm_max_ps(_mm_min_ps(_mm_loadu_ps(source + i + 4), high), low), scale);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+    }
+    encode_instances_scalar(instances + i / 2, count - i / 2, output + i / 2);
+}
+
+OL_TARGET_AVX2 static void encode_instances_avx2(const InstanceData* instances, size_t count, CompactInstanceData* output) {
+    const f32* source = &instances[0].position.x;
+    s16* destination = &output[0].position[0];
+    __m256 low = _mm256_set1_ps(-1.0f);
+    __m256 high = _mm256_set1_ps(1.0f);
+    __m256 scale = _mm256_set1_ps(COMPACT_POSITION_SCALE);
+
+    size_t i = 0;
+    for(; i + 16 <= count * 2; i += 16) {
+        __m256 a = _mm256_mul_ps(_mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(source + i), high), low), scale);
+        __m256 b = _mm256_mul_ps(_mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(source + i + 8), high), low), scale);
+
+        // The pack works per 128-bit lane, which leaves the middle two quarters swapped.
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    encode_instances_scalar(instances + i / 2, count - i / 2, output + i / 2);
+}
+#endif
+
+[[nodiscard]] static InstanceEncodeKernel instance_encode_kernel(OL::SIMD::Level level) {
+#if OL_SIMD_X86
+    switch(level) {
+        case OL::SIMD::Level::SSE2: {
+            return encode_instances_sse2;
+        } break;
+        case OL::SIMD::Level::AVX2:
+        case OL::SIMD::Level::AVX512: {
+            return encode_instances_avx2;
+        } break;
+        default: {
+            return encode_instances_scalar;
+        }
+    }
+#else
+    (void)level;
+    return encode_instances_scalar;
+#endif
+}
+
+// Writes count instances to destination in the given format. destination is addressed in that format's stride.
+static void write_instances(InstanceFormat format, InstanceEncodeKernel encode, const InstanceData* instances, size_t count, void* destination) {
+    if(format == InstanceFormat::COMPACT) {
+        encode(instances, count, static_cast<CompactInstanceData*>(destination));
+    } else {
+        memcpy(destination, instances, sizeof(InstanceData) * count);
+    }
+}
\ No newline at end of file
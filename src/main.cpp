@@ -1,5 +1,10 @@
 #include "shaders.h"
 #include "textures.h"
+#include "simulation.h"
+#include "entity_store.h"
+#include "culling.h"
+#include "sprite_batch.h"
+#include "snapshot.h"
 
 #include <orshlib.h>
 #include <SDL3/SDL.h>
@@ -33,19 +38,58 @@ static constexpr u16 indices[] = {
     0, 1, 2, 0, 2, 3
 };
 
-static constexpr size_t MAX_ENTITIES = 500000;
-
-struct InstanceData {
-    Vector2 position;
-    //f32 scaling;
+// Roughly 8 entities per cell over the visible [-1, 1] world.
+static constexpr f32 ENTITY_GRID_CELL_SIZE = 0.008f;
+static SpatialGrid entity_grid;
+
+// Fixed so every run spawns the same world.
+static constexpr u64 SIMULATION_SEED = DEFAULT_SIMULATION_SEED;
+
+// The simulation ticks at its own rate and every rendered frame interpolates between the last two ticks, so motion
+// stays smooth at any refresh rate. A frame runs at most MAX_TICKS_PER_FRAME ticks, past that the backlog is dropped.
+static constexpr u32 SIMULATION_RATE = 30;
+static constexpr u32 MAX_TICKS_PER_FRAME = 4;
+static constexpr bool INTERPOLATE_INSTANCES = true;
+
+// The world starts with INITIAL_ENTITIES and grows or shrinks at runtime, up to MAX_ENTITIES: = spawns a batch of
+// ENTITY_CHURN_BATCH entities and - despawns as many picked at random.
+static constexpr u32 INITIAL_ENTITIES = MAX_ENTITIES / 2;
+static constexpr u32 ENTITY_CHURN_BATCH = 25000;
+static EntityStore entity_store;
+static OL::Random::Xoshiro256 churn_random = OL::Random::Xoshiro256::seeded(DEFAULT_SIMULATION_SEED + 1);
+
+// Entity arrays live in memory.persistent, see main().
+static Simulation simulation = {
+    .count = INITIAL_ENTITIES,
+    .bounds = { .min = { -1.0f, -1.0f }, .max = { 1.0f, 1.0f }, .edge = WorldEdge::WRAP },
+    .grid = &entity_grid
 };
 
-struct Entity {
-    Vector2 velocity;
-};
+// COMPACT halves the per-frame instance upload, see instance_format.h for the precision it trades for it.
+static constexpr InstanceFormat INSTANCE_FORMAT = InstanceFormat::COMPACT;
+
+// The ortho projection maps exactly this rectangle to the screen.
+static constexpr ViewBounds VIEW_BOUNDS = { .min = { -1.0f, -1.0f }, .max = { 1.0f, 1.0f } };
+static InstanceCuller instance_culler;
+
+// Sprites are submitted every frame under a sort key and drawn in key order. Everything is on one layer with one
+// pipeline for now, so a frame has at most one run per texture and one draw group.
+static constexpr u32 SPRITE_LAYER = 0;
+static constexpr u32 SPRITE_PIPELINE = 0;
+static constexpr u32 MAX_SPRITE_RUNS = MAX_TEXTURES_COUNT;
+static SpriteBatch sprite_batch;
 
-static InstanceData instances[MAX_ENTITIES];
-static Entity entities[MAX_ENTITIES];
+static JobSystem job_system;
+
+// Zones kept per thread. At a few dozen zones per frame this is the last several seconds of frames.
+static constexpr u32 PROFILER_RECORDS_PER_THREAD = 1 << 14;
+static constexpr const char* PROFILE_CAPTURE_PATH = "profile.json";
+
+// F5 saves the world and F9 loads it back. F6 starts and stops a recording: a snapshot followed by every frame's tick
+// count, which replay_snapshot() (and the bench) can run again tick for tick.
+static constexpr const char* SNAPSHOT_PATH = "world.snapshot";
+static constexpr const char* REPLAY_PATH = "replay.snapshot";
+static TextureStreamer texture_streamer;
 
 static SDL_GPUDevice* device = nullptr;
 
@@ -96,7 +140,129 @@ void upload_gpu_data(T* data, u32 size, GPUBuffer* buffer_info) {
     //SDL_ReleaseGPUTransferBuffer(device, transfer_buffer);
 }
 
-Vertex* calculate_texture_vertices(TextureAtlas texture_atlas) {
+// Refreshes a buffer created by upload_gpu_data from inside the frame's copy pass. Both the transfer buffer and
+// the destination are cycled, so frames still in flight keep reading their own copy.
+template<typename T>
+void record_gpu_upload(SDL_GPUCopyPass* copy_pass, T* data, u32 size, GPUBuffer* buffer_info) {
+    assert(buffer_info->buffer && buffer_info->transfer_buffer);
+
+    void* transfer_destination = SDL_MapGPUTransferBuffer(device, buffer_info->transfer_buffer, true);
+    memcpy_s(transfer_destination, size, data, size);
+    SDL_UnmapGPUTransferBuffer(device, buffer_info->transfer_buffer);
+
+    SDL_GPUTransferBufferLocation transfer_buffer_location = {
+        .transfer_buffer = buffer_info->transfer_buffer
+    };
+
+    SDL_GPUBufferRegion buffer_region = {
+        .buffer = buffer_info->buffer,
+        .size = size
+    };
+
+    SDL_UploadToGPUBuffer(copy_pass, &transfer_buffer_location, &buffer_region, true);
+}
+
+// Per-frame streaming uploads. One transfer buffer is split into UPLOAD_RING_DEPTH regions used round-robin,
+// and each region remembers the fence of the frame that last read it. A frame only waits when the GPU is still
+// UPLOAD_RING_DEPTH frames behind, instead of syncing on every map. The copy is recorded into the frame's own
+// command buffer rather than a separate submit.
+static constexpr u32 UPLOAD_RING_DEPTH = 3;
+
+struct UploadRing {
+    SDL_GPUTransferBuffer* transfer_buffer;
+    SDL_GPUFence* fences[UPLOAD_RING_DEPTH];
+    u32 region_size;
+    u32 frame;
+    bool mapped;
+};
+
+static void create_upload_ring(UploadRing* ring, u32 region_size) {
+    SDL_GPUTransferBufferCreateInfo transfer_buffer_info = {
+        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+        .size = region_size * UPLOAD_RING_DEPTH
+    };
+
+    *ring = {
+        .transfer_buffer = SDL_CreateGPUTransferBuffer(device, &transfer_buffer_info),
+        .region_size = region_size
+    };
+    assert(ring->transfer_buffer);
+}
+
+[[nodiscard]] static u32 upload_ring_region(UploadRing* ring) {
+    return ring->frame % UPLOAD_RING_DEPTH;
+}
+
+// Returns this frame's region for the caller to fill directly, e.g. as the output of the simulation tick.
+[[nodiscard]] static u8* begin_upload(UploadRing* ring) {
+    assert(!ring->mapped);
+
+    u32 region = upload_ring_region(ring);
+    SDL_GPUFence*& fence = ring->fences[region];
+    if(fence) {
+        SDL_WaitForGPUFences(device, true, &fence, 1);
+        SDL_ReleaseGPUFence(device, fence);
+        fence = nullptr;
+    }
+
+    // No cycle: the fence above guarantees nothing in flight still reads this region.
+    u8* mapped = static_cast<u8*>(SDL_MapGPUTransferBuffer(device, ring->transfer_buffer, false));
+    assert(mapped);
+    ring->mapped = true;
+
+    return mapped + region * ring->region_size;
+}
+
+static void end_upload(UploadRing* ring, SDL_GPUCopyPass* copy_pass, GPUBuffer* destination, u32 size) {
+    assert(ring->mapped);
+    assert(size <= ring->region_size);
+
+    SDL_UnmapGPUTransferBuffer(device, ring->transfer_buffer);
+    ring->mapped = false;
+
+    SDL_GPUTransferBufferLocation transfer_buffer_location = {
+        .transfer_buffer = ring->transfer_buffer,
+        .offset = upload_ring_region(ring) * ring->region_size
+    };
+
+    SDL_GPUBufferRegion buffer_region = {
+        .buffer = destination->buffer,
+        .size = size
+    };
+
+    // Cycle the destination so the previous frame's draw can keep reading its copy.
+    if(size > 0) {
+        SDL_UploadToGPUBuffer(copy_pass, &transfer_buffer_location, &buffer_region, true);
+    }
+}
+
+// Takes ownership of the fence for the command buffer that consumed this frame's region and moves to the next one.
+static void finish_upload_frame(UploadRing* ring, SDL_GPUFence* fence) {
+    u32 region = upload_ring_region(ring);
+    assert(!ring->fences[region]);
+    ring->fences[region] = fence;
+    ++ring->frame;
+}
+
+static void release_upload_ring(UploadRing* ring) {
+    for(u32 i = 0; i < UPLOAD_RING_DEPTH; ++i) {
+        if(ring->fences[i]) {
+            SDL_WaitForGPUFences(device, true, &ring->fences[i], 1);
+            SDL_ReleaseGPUFence(device, ring->fences[i]);
+        }
+    }
+    SDL_ReleaseGPUTransferBuffer(device, ring->transfer_buffer);
+    *ring = {};
+}
+
+// Size of a sprite's quad in clip space: a fixed height, with the width following the texture's aspect ratio.
+static Vector2 sprite_quad_scale(const Texture* texture) {
+    f32 texture_aspect_ratio = static_cast<f32>(texture->width) / texture->height;
+    f32 resolution_aspect_ratio = static_cast<f32>(resolution.width) / resolution.height;
+    return { 0.4f * texture_aspect_ratio / resolution_aspect_ratio, 0.4f };
+}
+
+void calculate_texture_vertices(TextureAtlas texture_atlas, Vertex* buffer) {
     static constexpr Vertex normalized_quad_vertices[] = {
         { { -0.5f, -0.5f }, { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 1.0f } }, // Bottom-left
         { { 0.5f, -0.5f }, { 1.0f, 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } },  // Bottom-right
@@ -106,36 +272,175 @@ Vertex* calculate_texture_vertices(TextureAtlas texture_atlas) {
 
     size_t quad_vertices_size = sizeof(normalized_quad_vertices);
 
-    Vertex* buffer = memory.persistent->reserve<Vertex>(texture_atlas.count * 4);
     for(u32 texture_index = 0; texture_index < texture_atlas.count; ++texture_index) {
         Vertex* quad_vertices = buffer + (texture_index * 4);
         memcpy_s(quad_vertices, quad_vertices_size, normalized_quad_vertices, quad_vertices_size);
         Texture* texture = &texture_atlas.textures[texture_index];
-        f32 texture_aspect_ratio = static_cast<f32>(texture->width) / texture->height;
-        f32 resolution_aspect_ratio = static_cast<f32>(resolution.width) / resolution.height;
+        Vector2 scale = sprite_quad_scale(texture);
 
         for(u32 i = 0; i < 4; ++i) {
-            quad_vertices[i].position.x *= texture_aspect_ratio / resolution_aspect_ratio;
-            quad_vertices[i].position.x *= 0.4f;
-            quad_vertices[i].position.y *= 0.4f;
+            quad_vertices[i].position.x *= scale.x;
+            quad_vertices[i].position.y *= scale.y;
+
+            // Remap the unit quad's UVs onto this sprite's rect in the atlas page.
+            Vector2 uv = quad_vertices[i].texture_coords;
+            quad_vertices[i].texture_coords = {
+                texture->uv_min.x + uv.x * (texture->uv_max.x - texture->uv_min.x),
+                texture->uv_min.y + uv.y * (texture->uv_max.y - texture->uv_min.y)
+            };
         }
     }
-
-    return buffer;
 }
 
-void init_entities() {
-    for(size_t i = 0; i < MAX_ENTITIES; ++i) {
-        Entity* entity = &entities[i];
-        entity->velocity = { Random::F32(-0.00015f, 0.00015f), Random::F32(-0.00015f, 0.00015f) };
-        instances[i] = {
-            .position = { Random::F32(-1.0f, 1.0f), Random::F32(-1.0f, 1.0f) },
-            //.scaling = Random::F32(0.1f, 0.5f)
+// Submits every entity under its sprite's key, sorts the batch and gathers the instances into sorted in draw order.
+// Each run becomes one range, culled against its sprite's quad. The sprite comes from the entity's slot, so it stays
+// with the entity wherever despawns move it in the packed arrays. Until the first cull every instance counts as visible.
+static u32 build_sprite_ranges(TextureAtlas texture_atlas, const InstanceData* instances, u32 instance_count, InstanceData* sorted, CullRange* ranges) {
+    OL_PROFILE_ZONE("build_sprite_ranges");
+    begin_sprite_batch(&sprite_batch);
+    u32 first = reserve_sprites(&sprite_batch, instance_count);
+    u32 texture_count = texture_atlas.count;
+    job_system.parallel_for(0, sprite_batch.count - first, SPRITE_SORT_CHUNK_SPRITES, [first, texture_count](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; ++i) {
+            u32 texture_index = entity_store.dense_slots[i] % texture_count;
+            sprite_batch.keys[first + i] = make_sprite_key(SPRITE_LAYER, SPRITE_PIPELINE, texture_index, 0.0f);
+            sprite_batch.sprites[first + i] = static_cast<u32>(i);
+        }
+    });
+
+    bool batched = end_sprite_batch(&sprite_batch, &job_system);
+    assert(batched);
+    gather_sprites(&sprite_batch, instances, sorted, &job_system);
+
+    for(u32 run_index = 0; run_index < sprite_batch.run_count; ++run_index) {
+        const SpriteRun& run = sprite_batch.runs[run_index];
+        Vector2 scale = sprite_quad_scale(&texture_atlas.textures[run.texture]);
+        ranges[run_index] = {
+            .begin = run.first,
+            .end = run.first + run.count,
+            .extent = { scale.x * 0.5f, scale.y * 0.5f },
+            .first_visible = run.first,
+            .visible_count = run.count
         };
     }
+
+    return sprite_batch.run_count;
+}
+
+// One pipeline bind and one multi-draw call, over commands [first_command, first_command + command_count).
+struct SpriteDrawCall {
+    u32 pipeline;
+    u32 first_command;
+    u32 command_count;
+};
+
+// One indirect command per run with anything visible, drawing its part of the compacted stream with that sprite's
+// quad. The runs of a draw group share one multi-draw call. Every sprite lives on the atlas page, so a texture change
+// is just another vertex_offset and never a new sampler binding. Returns the command count.
+static u32 build_sprite_draw_commands(const SpriteBatch* batch, const CullRange* ranges, SDL_GPUIndexedIndirectDrawCommand* commands, SpriteDrawCall* calls,
+                                      u32* call_count) {
+    u32 draw_count = 0;
+    *call_count = 0;
+    for(u32 group_index = 0; group_index < batch->group_count; ++group_index) {
+        const SpriteDrawGroup& group = batch->groups[group_index];
+        u32 first_command = draw_count;
+        for(u32 run_index = group.first_run; run_index < group.first_run + group.run_count; ++run_index) {
+            if(ranges[run_index].visible_count == 0) {
+                continue;
+            }
+
+            commands[draw_count++] = {
+                .num_indices = 6,
+                .num_instances = ranges[run_index].visible_count,
+                .first_index = 0,
+                .vertex_offset = static_cast<s32>(batch->runs[run_index].texture * 4),
+                .first_instance = ranges[run_index].first_visible
+            };
+        }
+
+        if(draw_count > first_command) {
+            calls[(*call_count)++] = {
+                .pipeline = group.pipeline,
+                .first_command = first_command,
+                .command_count = draw_count - first_command
+            };
+        }
+    }
+
+    return draw_count;
+}
+
+// Saves what the profiler rings hold right now as a Chrome trace. The text buffer is sized for every thread slot
+// on first use and reused by later captures.
+static void save_profile_capture(Buffer** trace) {
+    if(!*trace) {
+        *trace = Buffer::allocate(profiler.chrome_trace_size());
+    }
+
+    if(*trace && profiler.save_chrome_trace(PROFILE_CAPTURE_PATH, *trace)) {
+        Logger::log("[save_profile_capture()] Saved %s, open it in ui.perfetto.dev or chrome://tracing.", PROFILE_CAPTURE_PATH);
+    }
+}
+
+static void save_world_snapshot(u64 tick) {
+    if(write_snapshot(SNAPSHOT_PATH, &simulation, tick)) {
+        Logger::log("[save_world_snapshot()] Saved %zu entities at tick %llu to %s.", simulation.count, static_cast<unsigned long long>(tick), SNAPSHOT_PATH);
+    }
+}
+
+[[nodiscard]] static bool load_world_snapshot() {
+    Snapshot snapshot;
+    if(!open_snapshot(SNAPSHOT_PATH, &snapshot)) {
+        return false;
+    }
+
+    bool restored = restore_snapshot(&snapshot, &simulation, MAX_ENTITIES, &job_system);
+    if(restored) {
+        reset_entity_store(&entity_store, &simulation, static_cast<u32>(simulation.count));
+        Logger::log("[load_world_snapshot()] Loaded the world from tick %llu of %s.", static_cast<unsigned long long>(snapshot.header->tick), SNAPSHOT_PATH);
+    }
+    close_snapshot(&snapshot);
+    return restored;
+}
+
+// Each batch draws its own seed, so every batch is a different set of entities.
+static void spawn_entity_batch(u32 count) {
+    u32 first = spawn_entities(&entity_store, &simulation, count);
+    spawn_random_entities(&simulation, first, simulation.count, churn_random.next(), &job_system, spawn_speed(SIMULATION_RATE));
+    rebuild_spatial_grid(&entity_grid, &simulation.instances[0].position, sizeof(InstanceData), simulation.count, &job_system);
+}
+
+// Picks are drawn with replacement, a repeat finds its handle already stale and is skipped.
+static void despawn_random_entities(u32 count) {
+    if(simulation.count == 0) {
+        return;
+    }
+
+    BufferScope handle_memory(memory.temporary);
+    EntityHandle* handles = memory.temporary->reserve<EntityHandle>(count);
+    assert(handles);
+    for(u32 i = 0; i < count; ++i) {
+        handles[i] = entity_handle(&entity_store, static_cast<u32>(churn_random.next() % simulation.count));
+    }
+    despawn_entities(&entity_store, &simulation, handles, count);
+    rebuild_spatial_grid(&entity_grid, &simulation.instances[0].position, sizeof(InstanceData), simulation.count, &job_system);
+}
+
+static void stop_replay_recording(SnapshotWriter* writer) {
+    u64 frames = writer->header.replay_frame_count;
+    u64 ticks = writer->header.replay_ticks;
+    if(end_snapshot(writer, &simulation)) {
+        Logger::log("[stop_replay_recording()] Recorded %llu frames, %llu ticks to %s.", static_cast<unsigned long long>(frames),
+                    static_cast<unsigned long long>(ticks), REPLAY_PATH);
+    }
 }
 
 int main() {
+    Time::Stamp startup_time = Time::Clock::now();
+    // Formatting and stdout move to a writer thread, so a log on the frame path costs a ring push.
+    if(!Logger::start_async()) {
+        Logger::log(Logger::LEVEL_ERROR, "[main()] Logging stays synchronous.");
+    }
     SDL_SetAppMetadata("SDL3 Test", "1.0", "com.savtech.test");
 
     SDL_Init(SDL_INIT_EVENTS);
@@ -152,20 +457,59 @@ int main() {
 
     SDL_SetGPUSwapchainParameters(device, window, SDL_GPU_SWAPCHAINCOMPOSITION_SDR, SDL_GPU_PRESENTMODE_VSYNC);
 
-    TextureAtlas texture_atlas = load_textures(device);
-    Vertex* texture_vertices = calculate_texture_vertices(texture_atlas);
+    job_system.init();
+
+    // Only job system threads record zones, and the main thread is one of them. Zones stay off if this fails.
+    if(profiler.init(PROFILER_RECORDS_PER_THREAD, job_system.thread_count())) {
+        profiler.set_thread_name("Main");
+    }
+    Buffer* profile_trace = nullptr;
+
+    // Read on the workers while the textures and world are set up, the shaders are created further down.
+    start_shader_reads(&job_system);
+
+    TextureAtlas texture_atlas = load_textures(device, &job_system, &texture_streamer);
+    Vertex* texture_vertices = memory.persistent->reserve<Vertex>(texture_atlas.count * 4);
+    calculate_texture_vertices(texture_atlas, texture_vertices);
 
     GPUBuffer vertex_buffer = {
         .usage = SDL_GPU_BUFFERUSAGE_VERTEX
     };
     upload_gpu_data(texture_vertices, sizeof(Vertex) * texture_atlas.count * 4, &vertex_buffer);
 
-    init_entities();
+    // Cache line aligned so tick chunks never share a line between jobs.
+    simulation.instances = memory.persistent->reserve<InstanceData>(MAX_ENTITIES, CACHE_LINE_SIZE);
+    simulation.entities = memory.persistent->reserve<Entity>(MAX_ENTITIES, CACHE_LINE_SIZE);
+    assert(simulation.instances && simulation.entities);
+    InstanceData* render_instances = nullptr;
+    if(INTERPOLATE_INSTANCES) {
+        simulation.previous_instances = memory.persistent->reserve<InstanceData>(MAX_ENTITIES, CACHE_LINE_SIZE);
+        render_instances = memory.persistent->reserve<InstanceData>(MAX_ENTITIES, CACHE_LINE_SIZE);
+        assert(simulation.previous_instances && render_instances);
+    }
+    // The frame's instances in sprite batch order, which is what gets culled.
+    InstanceData* sorted_instances = memory.persistent->reserve<InstanceData>(MAX_ENTITIES, CACHE_LINE_SIZE);
+    assert(sorted_instances);
+
+    bool store_ready = init_entity_store(&entity_store, &simulation, MAX_ENTITIES, memory.persistent);
+    assert(store_ready);
+
+    bool grid_ready = init_spatial_grid(&entity_grid, simulation.bounds.min, simulation.bounds.max, ENTITY_GRID_CELL_SIZE, MAX_ENTITIES, memory.persistent);
+    assert(grid_ready);
+
+    bool culler_ready = init_instance_culler(&instance_culler, MAX_ENTITIES, MAX_SPRITE_RUNS, memory.persistent, INSTANCE_FORMAT);
+    assert(culler_ready);
+
+    bool batch_ready = init_sprite_batch(&sprite_batch, MAX_ENTITIES, MAX_SPRITE_RUNS, memory.persistent);
+    assert(batch_ready);
+
+    init_entities(&simulation, SIMULATION_SEED, &job_system, spawn_speed(SIMULATION_RATE));
+    rebuild_spatial_grid(&entity_grid, &simulation.instances[0].position, sizeof(InstanceData), simulation.count, &job_system);
 
     GPUBuffer instance_buffer = {
         .usage = SDL_GPU_BUFFERUSAGE_VERTEX
     };
-    upload_gpu_data(instances, sizeof(instances), &instance_buffer);
+    upload_gpu_data(simulation.instances, sizeof(InstanceData) * MAX_ENTITIES, &instance_buffer);
 
     SDL_GPUBufferBinding vertex_buffer_bindings[] = {
         { .buffer = vertex_buffer.buffer },
@@ -181,14 +525,14 @@ int main() {
         .buffer = index_buffer.buffer
     };
 
-    load_shaders(device);
+    load_shaders(device, &job_system);
 
     SDL_GPUVertexBufferDescription vertex_buffer_descriptions[] = {
         { .slot = 0,
           .pitch = sizeof(Vertex),
           .input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX },
         { .slot = 1,
-          .pitch = sizeof(InstanceData),
+          .pitch = instance_stride(INSTANCE_FORMAT),
           .input_rate = SDL_GPU_VERTEXINPUTRATE_INSTANCE,
           .instance_step_rate = 1 }
     };
@@ -197,7 +541,7 @@ int main() {
         { .location = 0, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2 },
         { .location = 1, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4, .offset = offsetof(Vertex, color) },
         { .location = 2, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2, .offset = offsetof(Vertex, texture_coords) },
-        { .location = 3, .buffer_slot = 1, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2 },
+        { .location = 3, .buffer_slot = 1, .format = INSTANCE_FORMAT == InstanceFormat::COMPACT ? SDL_GPU_VERTEXELEMENTFORMAT_SHORT2_NORM : SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2 },
         //{ .location = 4, .buffer_slot = 1, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT, .offset = offsetof(InstanceData, scaling) },
     };
 
@@ -229,6 +573,8 @@ int main() {
             .num_color_targets = 1 }
     };
     SDL_GPUGraphicsPipeline* graphics_pipeline = SDL_CreateGPUGraphicsPipeline(device, &graphics_pipeline_info);
+    // Indexed by a sprite key's pipeline.
+    SDL_GPUGraphicsPipeline* sprite_pipelines[] = { graphics_pipeline };
 
     release_shaders(device);
 
@@ -236,46 +582,58 @@ int main() {
         .min_filter = SDL_GPU_FILTER_LINEAR,
         .mag_filter = SDL_GPU_FILTER_LINEAR,
         .mipmap_mode = SDL_GPU_SAMPLERMIPMAPMODE_LINEAR,
-        .address_mode_u = SDL_GPU_SAMPLERADDRESSMODE_REPEAT,
-        .address_mode_v = SDL_GPU_SAMPLERADDRESSMODE_REPEAT,
-        .address_mode_w = SDL_GPU_SAMPLERADDRESSMODE_REPEAT
+        .address_mode_u = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
+        .address_mode_v = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
+        .address_mode_w = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE
     };
 
     SDL_GPUSampler* texture_sampler = SDL_CreateGPUSampler(device, &texture_sampler_info);
     assert(texture_sampler);
 
     SDL_GPUTextureSamplerBinding texture_sampler_binding = {
-        .texture = texture_atlas.textures[0].handle,
+        .texture = texture_atlas.page,
         .sampler = texture_sampler
     };
 
-    SDL_GPUIndexedIndirectDrawCommand draw_command {
-        .num_indices = 6,
-        .num_instances = static_cast<u32>(OL::array_count(instances)),
-        .first_index = 0,
-        .vertex_offset = 8,
-        .first_instance = 0
-    };
+    CullRange sprite_ranges[MAX_SPRITE_RUNS];
+    u32 sprite_range_count = build_sprite_ranges(texture_atlas, simulation.instances, static_cast<u32>(simulation.count), sorted_instances, sprite_ranges);
+    SDL_GPUIndexedIndirectDrawCommand draw_commands[MAX_SPRITE_RUNS] = {};
+    SpriteDrawCall draw_calls[MAX_SPRITE_RUNS];
+    u32 draw_call_count = 0;
+    u32 draw_count = build_sprite_draw_commands(&sprite_batch, sprite_ranges, draw_commands, draw_calls, &draw_call_count);
 
+    // Sized for the most runs a frame can have, frames only upload the commands they use.
     GPUBuffer draw_buffer = {
         .usage = SDL_GPU_BUFFERUSAGE_INDIRECT
     };
-    upload_gpu_data(&draw_command, sizeof(draw_command), &draw_buffer);
+    upload_gpu_data(draw_commands, sizeof(SDL_GPUIndexedIndirectDrawCommand) * MAX_SPRITE_RUNS, &draw_buffer);
+
+    UploadRing instance_upload_ring;
+    create_upload_ring(&instance_upload_ring, sizeof(InstanceData) * MAX_ENTITIES);
+    // The startup upload is raw InstanceData and only sizes the buffer, the first frame streams the culled stream
+    // in INSTANCE_FORMAT before anything is drawn.
+    bool instances_dirty = true;
+    bool first_frame = true;
 
     bool running = true;
     bool render = true;
     SDL_Event event;
 
     Session session = {};
+    SnapshotWriter replay_writer = {};
     Time::Stamp current_time = Time::Clock::now();
-    Time::Duration accumulator = Time::Duration::zero();
-    Time::Duration delta_time = Time::Milliseconds(10);
+    FixedTimestep timestep = {
+        .step = FixedTimestep::from_rate(SIMULATION_RATE),
+        .max_steps_per_frame = MAX_TICKS_PER_FRAME
+    };
 
     while(running) {
+        OL_PROFILE_ZONE("frame");
+        // Anything a frame takes from memory.temporary is handed back at the end of it.
+        BufferScope frame_memory(memory.temporary);
         Time::Stamp new_time = Time::Clock::now();
         Time::Duration frame_time = new_time - current_time;
         current_time = new_time;
-        accumulator += frame_time;
 
         while(SDL_PollEvent(&event)) {
             switch(event.type) {
@@ -295,6 +653,50 @@ int main() {
                         case SDLK_ESCAPE: {
                             running = false;
                         } break;
+                        case SDLK_F1: {
+                            if(event.type == SDL_EventType::SDL_EVENT_KEY_DOWN) {
+                                save_profile_capture(&profile_trace);
+                            }
+                        } break;
+                        case SDLK_F5: {
+                            if(event.type == SDL_EventType::SDL_EVENT_KEY_DOWN) {
+                                save_world_snapshot(session.ticks);
+                            }
+                        } break;
+                        case SDLK_F6: {
+                            if(event.type == SDL_EventType::SDL_EVENT_KEY_DOWN) {
+                                if(replay_writer.stream) {
+                                    stop_replay_recording(&replay_writer);
+                                } else if(begin_snapshot(REPLAY_PATH, &simulation, session.ticks, &replay_writer)) {
+                                    Logger::log("[main()] Recording to %s, F6 again to stop.", REPLAY_PATH);
+                                }
+                            }
+                        } break;
+                        case SDLK_EQUALS:
+                        case SDLK_MINUS: {
+                            if(event.type == SDL_EventType::SDL_EVENT_KEY_DOWN) {
+                                // Spawns and despawns aren't in the replay log, so a recording ends here.
+                                if(replay_writer.stream) {
+                                    stop_replay_recording(&replay_writer);
+                                }
+                                if(keyboard_event->key == SDLK_EQUALS) {
+                                    spawn_entity_batch(ENTITY_CHURN_BATCH);
+                                } else {
+                                    despawn_random_entities(ENTITY_CHURN_BATCH);
+                                }
+                                instances_dirty = true;
+                                Logger::log("[main()] %zu entities alive.", simulation.count);
+                            }
+                        } break;
+                        case SDLK_F9: {
+                            if(event.type == SDL_EventType::SDL_EVENT_KEY_DOWN) {
+                                // A recording can't replay across a jump in the world, so it ends here.
+                                if(replay_writer.stream) {
+                                    stop_replay_recording(&replay_writer);
+                                }
+                                instances_dirty |= load_world_snapshot();
+                            }
+                        } break;
                         default:
                             break;
                     }
@@ -304,26 +706,72 @@ int main() {
             }
         }
 
-        while(accumulator >= delta_time) {
-            session.update(delta_time);
+        u64 dropped_before = timestep.dropped_steps;
+        u32 frame_ticks = timestep.advance(frame_time);
+        for(u32 tick = 0; tick < frame_ticks; ++tick) {
+            session.update(timestep.step);
 
-            for(size_t i = 0; i < MAX_ENTITIES; ++i) {
-                instances[i].position += entities[i].velocity;
+            Time::Stamp tick_start = Time::Clock::now();
+            simulation_tick(&simulation, &job_system);
+            session.record_tick_time(Time::Clock::now() - tick_start);
+        }
+        session.record_frame_ticks(frame_ticks, timestep.dropped_steps - dropped_before);
+        if(replay_writer.stream) {
+            append_replay_frame(&replay_writer, frame_ticks, timestep.alpha());
+        }
+        bool ticked = frame_ticks > 0;
+
+        // Only frames that changed the instances (or missed an upload while minimized) stream them to the GPU. With
+        // interpolation every frame moves them. The culling pass writes just the visible ones straight into the
+        // mapped upload region and rebuilds the draws.
+        instances_dirty |= ticked || INTERPOLATE_INSTANCES;
+        InstanceData* instance_upload = nullptr;
+        u32 visible_instances = 0;
+        if(render && instances_dirty) {
+            OL_PROFILE_ZONE("prepare_instances");
+            instance_upload = reinterpret_cast<InstanceData*>(begin_upload(&instance_upload_ring));
+            const InstanceData* frame_instances = simulation.instances;
+            if(INTERPOLATE_INSTANCES) {
+                interpolate_instances(&simulation, timestep.alpha(), render_instances, &job_system);
+                frame_instances = render_instances;
             }
-
-            accumulator -= delta_time;
+            sprite_range_count = build_sprite_ranges(texture_atlas, frame_instances, static_cast<u32>(simulation.count), sorted_instances, sprite_ranges);
+            visible_instances = cull_instances(&instance_culler, sorted_instances, sprite_ranges, sprite_range_count, VIEW_BOUNDS, instance_upload, &job_system);
+            draw_count = build_sprite_draw_commands(&sprite_batch, sprite_ranges, draw_commands, draw_calls, &draw_call_count);
         }
 
-        upload_gpu_data(instances, sizeof(instances), &instance_buffer);
-
         //Render
         if(render) {
             SDL_GPUCommandBuffer* command_buffer = SDL_AcquireGPUCommandBuffer(device);
 
+            bool stream_textures = texture_uploads_ready(&texture_streamer, &job_system);
+            if(instance_upload || stream_textures) {
+                OL_PROFILE_ZONE("copy_pass");
+                SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(command_buffer);
+                if(instance_upload) {
+                    end_upload(&instance_upload_ring, copy_pass, &instance_buffer, instance_stride(INSTANCE_FORMAT) * visible_instances);
+                    if(draw_count > 0) {
+                        record_gpu_upload(copy_pass, draw_commands, sizeof(SDL_GPUIndexedIndirectDrawCommand) * draw_count, &draw_buffer);
+                    }
+                    instances_dirty = false;
+                }
+
+                // Textures that just became resident swap their placeholder UVs for their own rect.
+                if(stream_textures && upload_streamed_textures(device, &texture_streamer, copy_pass)) {
+                    calculate_texture_vertices(texture_atlas, texture_vertices);
+                    record_gpu_upload(copy_pass, texture_vertices, sizeof(Vertex) * texture_atlas.count * 4, &vertex_buffer);
+                }
+                SDL_EndGPUCopyPass(copy_pass);
+            }
+
             SDL_GPUTexture* render_texture;
             u32 render_width, render_height;
-            if(!SDL_AcquireGPUSwapchainTexture(command_buffer, window, &render_texture, &render_width, &render_height)) {
-                Logger::log("uh oh swapchain is fucked");
+            {
+                // Blocks on vsync once the swapchain is full, so this is where presentation shows up.
+                OL_PROFILE_ZONE("acquire_swapchain");
+                if(!SDL_AcquireGPUSwapchainTexture(command_buffer, window, &render_texture, &render_width, &render_height)) {
+                    Logger::log("uh oh swapchain is fucked");
+                }
             }
             SDL_GPUColorTargetInfo render_target_info = {
                 .texture = render_texture,
@@ -332,34 +780,72 @@ int main() {
                 .store_op = SDL_GPU_STOREOP_STORE
             };
 
-            SDL_GPURenderPass* render_pass = SDL_BeginGPURenderPass(command_buffer, &render_target_info, 1, nullptr);
-            SDL_BindGPUGraphicsPipeline(render_pass, graphics_pipeline);
-            SDL_BindGPUVertexBuffers(render_pass, 0, vertex_buffer_bindings, static_cast<u32>(OL::array_count(vertex_buffer_bindings)));
-            SDL_BindGPUIndexBuffer(render_pass, &index_binding, SDL_GPU_INDEXELEMENTSIZE_16BIT);
-            SDL_BindGPUFragmentSamplers(render_pass, 0, &texture_sampler_binding, 1);
+            {
+                OL_PROFILE_ZONE("record_render_pass");
+                SDL_GPURenderPass* render_pass = SDL_BeginGPURenderPass(command_buffer, &render_target_info, 1, nullptr);
+                u32 bound_pipeline = 0;
+                SDL_BindGPUGraphicsPipeline(render_pass, sprite_pipelines[bound_pipeline]);
+                SDL_BindGPUVertexBuffers(render_pass, 0, vertex_buffer_bindings, static_cast<u32>(OL::array_count(vertex_buffer_bindings)));
+                SDL_BindGPUIndexBuffer(render_pass, &index_binding, SDL_GPU_INDEXELEMENTSIZE_16BIT);
+                SDL_BindGPUFragmentSamplers(render_pass, 0, &texture_sampler_binding, 1);
+
+                //Matrix4 projection = orthographic_projection(-1.0f, 1.0f, -1.0f, 1.0f, 0.1f, 100.0f);
+                SDL_PushGPUVertexUniformData(command_buffer, 0, &ORTHO, sizeof(Matrix4));
+
+                //SDL_DrawGPUIndexedPrimitives(render_pass, 6, static_cast<u32>(OL::array_count(instances)), 0, 8, 0);
+                // Commands are grouped by pipeline, so the pipeline only changes between calls.
+                for(u32 call_index = 0; call_index < draw_call_count; ++call_index) {
+                    const SpriteDrawCall& call = draw_calls[call_index];
+                    if(call.pipeline != bound_pipeline) {
+                        bound_pipeline = call.pipeline;
+                        SDL_BindGPUGraphicsPipeline(render_pass, sprite_pipelines[bound_pipeline]);
+                    }
+                    SDL_DrawGPUIndexedPrimitivesIndirect(render_pass, draw_buffer.buffer, call.first_command * sizeof(SDL_GPUIndexedIndirectDrawCommand), call.command_count);
+                }
 
-            //Matrix4 projection = orthographic_projection(-1.0f, 1.0f, -1.0f, 1.0f, 0.1f, 100.0f);
-            SDL_PushGPUVertexUniformData(command_buffer, 0, &ORTHO, sizeof(Matrix4));
+                SDL_EndGPURenderPass(render_pass);
+            }
 
-            //SDL_DrawGPUIndexedPrimitives(render_pass, 6, static_cast<u32>(OL::array_count(instances)), 0, 8, 0);
-            SDL_DrawGPUIndexedPrimitivesIndirect(render_pass, draw_buffer.buffer, 0, 1);
+            {
+                OL_PROFILE_ZONE("submit");
+                if(instance_upload) {
+                    finish_upload_frame(&instance_upload_ring, SDL_SubmitGPUCommandBufferAndAcquireFence(command_buffer));
+                } else {
+                    SDL_SubmitGPUCommandBuffer(command_buffer);
+                }
+            }
 
-            SDL_EndGPURenderPass(render_pass);
-            SDL_SubmitGPUCommandBuffer(command_buffer);
+            if(first_frame) {
+                f64 startup_ms = std::chrono::duration<f64, std::milli>(Time::Clock::now() - startup_time).count();
+                Logger::log("[main()] First frame submitted %.1f ms after startup.", startup_ms);
+                first_frame = false;
+            }
 
-            session.render(delta_time);
-            static char fps[32];
-            snprintf(fps, 32, "FPS: %f", session.fps.last_measurement);
+            session.render(frame_time);
+            SessionStats stats = session.get_stats();
+            static char fps[64];
+            snprintf(fps, 64, "FPS: %f p99: %.2f ms", session.fps.last_measurement, to_milliseconds(stats.frame_times.p99));
             SDL_SetWindowTitle(window, fps);
         }
     }
 
+    if(replay_writer.stream) {
+        stop_replay_recording(&replay_writer);
+    }
+
     SDL_ReleaseGPUTransferBuffer(device, vertex_buffer.transfer_buffer);
     SDL_ReleaseGPUTransferBuffer(device, instance_buffer.transfer_buffer);
     SDL_ReleaseGPUTransferBuffer(device, index_buffer.transfer_buffer);
     SDL_ReleaseGPUTransferBuffer(device, draw_buffer.transfer_buffer);
+    release_upload_ring(&instance_upload_ring);
+    stop_texture_streaming(device, &texture_streamer, &job_system);
+
+    job_system.shutdown();
+    profiler.shutdown();
 
     session.debug_print();
+    memory.log_stats();
+    Logger::stop_async();
 
     SDL_Quit();
     return 0;
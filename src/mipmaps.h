@@ -0,0 +1,301 @@
+#pragma once
+
+#include <orshlib/types.h>
+#include <orshlib/simd.h>
+#include <cassert>
+#include <cmath>
+
+// Mip chain generation for RGBA8 images, shared by the cooker and the streaming loader.
+//
+// Every level is filtered from the previous one in f32, in linear light with premultiplied alpha, and only
+// quantized back to RGBA8 on the way out: decoding sRGB first keeps dark edges from darkening, and weighting color
+// by alpha keeps the color of fully transparent texels from bleeding into their neighbours. Only the box filter's
+// inner loop cares about the SIMD level, and every level does the same IEEE operations in the same order, so all
+// kernels produce bit-identical output.
+
+static constexpr u32 MAX_MIP_LEVELS = 16;
+static constexpr u32 MIP_BYTES_PER_TEXEL = 4;
+static constexpr u32 SRGB_ENCODE_TABLE_SIZE = 16384;
+
+using MipmapFlags = u32;
+static constexpr MipmapFlags MIPMAP_LINEAR = 0;
+static constexpr MipmapFlags MIPMAP_SRGB = 1 << 0;          // Color channels are sRGB encoded, alpha is always linear.
+static constexpr MipmapFlags MIPMAP_PREMULTIPLIED = 1 << 1; // Color is already multiplied by alpha, and stays that way.
+
+[[nodiscard]] static u32 mip_level_count(u32 width, u32 height) {
+    u32 levels = 1;
+    while((width > 1 || height > 1) && levels < MAX_MIP_LEVELS) {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        ++levels;
+    }
+    return levels;
+}
+
+[[nodiscard]] static u32 mip_dimension(u32 size, u32 level) {
+    u32 dimension = size >> level;
+    return dimension > 0 ? dimension : 1;
+}
+
+// Bytes of RGBA8 for `level_count` levels stored back to back.
+[[nodiscard, maybe_unused]] static size_t mip_chain_size(u32 width, u32 height, u32 level_count) {
+    size_t size = 0;
+    for(u32 level = 0; level < level_count; ++level) {
+        size += static_cast<size_t>(mip_dimension(width, level)) * mip_dimension(height, level) * MIP_BYTES_PER_TEXEL;
+    }
+    return size;
+}
+
+// f32 working memory generate_mipmaps needs: level 0 and level 1, which every later level ping-pongs between.
+[[nodiscard]] static size_t mip_scratch_size(u32 width, u32 height) {
+    size_t texels = static_cast<size_t>(width) * height + static_cast<size_t>(mip_dimension(width, 1)) * mip_dimension(height, 1);
+    return texels * MIP_BYTES_PER_TEXEL * sizeof(f32);
+}
+
+[[nodiscard]] static f64 srgb_to_linear(f64 value) {
+    return value <= 0.04045 ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4);
+}
+
+[[nodiscard]] static f64 linear_to_srgb(f64 value) {
+    return value <= 0.0031308 ? value * 12.92 : 1.055 * pow(value, 1.0 / 2.4) - 0.055;
+}
+
+struct MipmapTables {
+    f32 unorm_to_float[256];
+    f32 srgb_to_float[256];
+    // Indexed by round(linear * (SRGB_ENCODE_TABLE_SIZE - 1)). Padded so 32-bit gathers of the last entries stay in bounds.
+    u8 float_to_srgb[SRGB_ENCODE_TABLE_SIZE + 3];
+};
+
+[[nodiscard]] static const MipmapTables& mipmap_tables() {
+    static const MipmapTables tables = []() {
+        MipmapTables result = {};
+        for(u32 i = 0; i < 256; ++i) {
+            result.unorm_to_float[i] = static_cast<f32>(i) * (1.0f / 255.0f);
+            result.srgb_to_float[i] = static_cast<f32>(srgb_to_linear(i / 255.0));
+        }
+        for(u32 i = 0; i < SRGB_ENCODE_TABLE_SIZE; ++i) {
+            f64 encoded = linear_to_srgb(static_cast<f64>(i) / (SRGB_ENCODE_TABLE_SIZE - 1));
+            result.float_to_srgb[i] = static_cast<u8>(encoded * 255.0 + 0.5);
+        }
+        return result;
+    }();
+    return tables;
+}
+
+// RGBA8 to linear premultiplied f32.
+using MipDecodeKernel = void (*)(const u8* source, size_t texel_count, f32* destination, MipmapFlags flags);
+// 2x2 box filter of one output row. source_width 1 reuses the single column.
+using MipDownsampleKernel = void (*)(const f32* row0, const f32* row1, u32 source_width, f32* destination);
+// Linear premultiplied f32 back to RGBA8.
+using MipEncodeKernel = void (*)(const f32* source, size_t texel_count, u8* destination, MipmapFlags flags);
+
+struct MipmapKernels {
+    MipDecodeKernel decode;
+    MipDownsampleKernel downsample_row;
+    MipEncodeKernel encode;
+};
+
+static void mip_decode_scalar(const u8* source, size_t texel_count, f32* destination, MipmapFlags flags) {
+    const MipmapTables& tables = mipmap_tables();
+    const f32* color_table = flags & MIPMAP_SRGB ? tables.srgb_to_float : tables.unorm_to_float;
+    bool premultiplied = flags & MIPMAP_PREMULTIPLIED;
+
+    for(size_t i = 0; i < texel_count; ++i) {
+        const u8* texel = source + i * 4;
+        f32* output = destination + i * 4;
+        f32 alpha = tables.unorm_to_float[texel[3]];
+        f32 scale = premultiplied ? 1.0f : alpha;
+        output[0] = color_table[texel[0]] * scale;
+        output[1] = color_table[texel[1]] * scale;
+        output[2] = color_table[texel[2]] * scale;
+        output[3] = alpha;
+    }
+}
+
+static void mip_downsample_row_scalar(const f32* row0, const f32* row1, u32 source_width, f32* destination) {
+    u32 width = source_width > 1 ? source_width / 2 : 1;
+    for(u32 x = 0; x < width; ++x) {
+        u32 x0 = x * 2;
+        u32 x1 = x0 + 1 < source_width ? x0 + 1 : x0;
+        for(u32 channel = 0; channel < 4; ++channel) {
+            f32 left = row0[x0 * 4 + channel] + row1[x0 * 4 + channel];
+            f32 right = row0[x1 * 4 + channel] + row1[x1 * 4 + channel];
+            destination[x * 4 + channel] = (left + right) * 0.25f;
+        }
+    }
+}
+
+static void mip_encode_scalar(const f32* source, size_t texel_count, u8* destination, MipmapFlags flags) {
+    const MipmapTables& tables = mipmap_tables();
+    bool srgb = flags & MIPMAP_SRGB;
+    bool premultiplied = flags & MIPMAP_PREMULTIPLIED;
+
+    for(size_t i = 0; i < texel_count; ++i) {
+        const f32* texel = source + i * 4;
+        u8* output = destination + i * 4;
+        f32 alpha = texel[3] < 0.0f ? 0.0f : (texel[3] > 1.0f ? 1.0f : texel[3]);
+        f32 divisor = premultiplied ? 1.0f : alpha;
+
+        for(u32 channel = 0; channel < 3; ++channel) {
+            f32 value = divisor > 0.0f ? texel[channel] / divisor : 0.0f;
+            value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+            output[channel] = srgb ? tables.float_to_srgb[static_cast<u32>(value * static_cast<f32>(SRGB_ENCODE_TABLE_SIZE - 1) + 0.5f)]
+                                   : static_cast<u8>(value * 255.0f + 0.5f);
+        }
+        output[3] = static_cast<u8>(alpha * 255.0f + 0.5f);
+    }
+}
+
+#if OL_SIMD_X86
+// One output texel is one register: (row0[x0] + row1[x0]) + (row0[x1] + row1[x1]), same order as the scalar path.
+OL_TARGET_SSE2 static void mip_downsample_row_sse2(const f32* row0, const f32* row1, u32 source_width, f32* destination) {
+    if(source_width < 2) {
+        mip_downsample_row_scalar(row0, row1, source_width, destination);
+        return;
+    }
+
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    u32 width = source_width / 2;
+    for(u32 x = 0; x < width; ++x) {
+        __m128 left = _mm_add_ps(_mm_loadu_ps(row0 + x * 8), _mm_loadu_ps(row1 + x * 8));
+        __m128 right = _mm_add_ps(_mm_loadu_ps(row0 + x * 8 + 4), _mm_loadu_ps(row1 + x * 8 + 4));
+        _mm_storeu_ps(destination + x * 4, _mm_mul_ps(_mm_add_ps(left, right), quarter));
+    }
+}
+
+// Two output texels per iteration. Each 256-bit load holds one source pair, the column sums are then split into
+// left and right halves across both pairs so a single add finishes both outputs.
+OL_TARGET_AVX2 static void mip_downsample_row_avx2(const f32* row0, const f32* row1, u32 source_width, f32* destination) {
+    if(source_width < 2) {
+        mip_downsample_row_scalar(row0, row1, source_width, destination);
+        return;
+    }
+
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    u32 width = source_width / 2;
+    u32 x = 0;
+    for(; x + 2 <= width; x += 2) {
+        __m256 columns0 = _mm256_add_ps(_mm256_loadu_ps(row0 + x * 8), _mm256_loadu_ps(row1 + x * 8));
+        __m256 columns1 = _mm256_add_ps(_mm256_loadu_ps(row0 + x * 8 + 8), _mm256_loadu_ps(row1 + x * 8 + 8));
+        __m256 left = _mm256_permute2f128_ps(columns0, columns1, 0x20);
+        __m256 right = _mm256_permute2f128_ps(columns0, columns1, 0x31);
+        _mm256_storeu_ps(destination + x * 4, _mm256_mul_ps(_mm256_add_ps(left, right), quarter));
+    }
+    if(x < width) {
+        mip_downsample_row_sse2(row0 + x * 8, row1 + x * 8, 2, destination + x * 4);
+    }
+}
+
+// Two texels per iteration, table lookups done with gathers.
+OL_TARGET_AVX2 static void mip_decode_avx2(const u8* source, size_t texel_count, f32* destination, MipmapFlags flags) {
+    const MipmapTables& tables = mipmap_tables();
+    const f32* color_table = flags & MIPMAP_SRGB ? tables.srgb_to_float : tables.unorm_to_float;
+    bool premultiplied = flags & MIPMAP_PREMULTIPLIED;
+    const __m256 ones = _mm256_set1_ps(1.0f);
+
+    size_t i = 0;
+    for(; i + 2 <= texel_count; i += 2) {
+        __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + i * 4)));
+        __m256 color = _mm256_i32gather_ps(color_table, indices, 4);
+        __m256 unorm = _mm256_i32gather_ps(tables.unorm_to_float, indices, 4);
+        __m256 alpha = _mm256_permute_ps(unorm, 0xFF);
+        __m256 scaled = _mm256_mul_ps(color, premultiplied ? ones : alpha);
+        _mm256_storeu_ps(destination + i * 4, _mm256_blend_ps(scaled, unorm, 0x88));
+    }
+    mip_decode_scalar(source + i * 4, texel_count - i, destination + i * 4, flags);
+}
+
+OL_TARGET_AVX2 static void mip_encode_avx2(const f32* source, size_t texel_count, u8* destination, MipmapFlags flags) {
+    const MipmapTables& tables = mipmap_tables();
+    bool srgb = flags & MIPMAP_SRGB;
+    bool premultiplied = flags & MIPMAP_PREMULTIPLIED;
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 ones = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 unorm_scale = _mm256_set1_ps(255.0f);
+    const __m256 color_scale = srgb ? _mm256_set1_ps(static_cast<f32>(SRGB_ENCODE_TABLE_SIZE - 1)) : unorm_scale;
+    const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+
+    size_t i = 0;
+    for(; i + 2 <= texel_count; i += 2) {
+        __m256 texels = _mm256_loadu_ps(source + i * 4);
+        __m256 alpha = _mm256_min_ps(_mm256_max_ps(_mm256_permute_ps(texels, 0xFF), zero), ones);
+        __m256 divisor = premultiplied ? ones : alpha;
+        __m256 valid = _mm256_cmp_ps(divisor, zero, _CMP_GT_OQ);
+        __m256 color = _mm256_and_ps(_mm256_div_ps(texels, divisor), valid);
+        color = _mm256_min_ps(_mm256_max_ps(color, zero), ones);
+
+        __m256i color_bytes = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(color, color_scale), half));
+        if(srgb) {
+            color_bytes = _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int*>(tables.float_to_srgb), color_bytes, 1), byte_mask);
+        }
+        __m256i alpha_bytes = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(alpha, unorm_scale), half));
+        __m256i bytes = _mm256_blend_epi32(color_bytes, alpha_bytes, 0x88);
+
+        __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(bytes), _mm256_extracti128_si256(bytes, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + i * 4), _mm_packus_epi16(words, words));
+    }
+    mip_encode_scalar(source + i * 4, texel_count - i, destination + i * 4, flags);
+}
+#endif
+
+[[nodiscard]] static MipmapKernels mipmap_kernels(OL::SIMD::Level level) {
+#if OL_SIMD_X86
+    switch(level) {
+        case OL::SIMD::Level::SSE2: {
+            return { mip_decode_scalar, mip_downsample_row_sse2, mip_encode_scalar };
+        } break;
+        case OL::SIMD::Level::AVX2:
+        case OL::SIMD::Level::AVX512: {
+            return { mip_decode_avx2, mip_downsample_row_avx2, mip_encode_avx2 };
+        } break;
+        default: {
+            return { mip_decode_scalar, mip_downsample_row_scalar, mip_encode_scalar };
+        }
+    }
+#else
+    (void)level;
+    return { mip_decode_scalar, mip_downsample_row_scalar, mip_encode_scalar };
+#endif
+}
+
+// Fills levels 1..level_count-1 from level 0, which the caller has already written to levels[0]. Each entry of
+// `levels` points at that level's tightly packed texels, so the chain can be written straight into a pack or a
+// transfer buffer. scratch must hold mip_scratch_size(width, height) bytes.
+static void generate_mipmaps(MipmapKernels kernels, u8* const* levels, u32 width, u32 height, u32 level_count, MipmapFlags flags, f32* scratch) {
+    assert(level_count >= 1 && level_count <= MAX_MIP_LEVELS);
+    if(level_count == 1) {
+        return;
+    }
+
+    f32* current = scratch;
+    f32* next = scratch + static_cast<size_t>(width) * height * 4;
+    kernels.decode(levels[0], static_cast<size_t>(width) * height, current, flags);
+
+    for(u32 level = 1; level < level_count; ++level) {
+        u32 source_width = mip_dimension(width, level - 1);
+        u32 source_height = mip_dimension(height, level - 1);
+        u32 level_width = mip_dimension(width, level);
+        u32 level_height = mip_dimension(height, level);
+
+        for(u32 y = 0; y < level_height; ++y) {
+            u32 y0 = y * 2;
+            u32 y1 = y0 + 1 < source_height ? y0 + 1 : y0;
+            const f32* row0 = current + static_cast<size_t>(y0) * source_width * 4;
+            const f32* row1 = current + static_cast<size_t>(y1) * source_width * 4;
+            kernels.downsample_row(row0, row1, source_width, next + static_cast<size_t>(y) * level_width * 4);
+        }
+        kernels.encode(next, static_cast<size_t>(level_width) * level_height, levels[level], flags);
+
+        f32* swap = current;
+        current = next;
+        next = swap;
+    }
+}
+
+// Same as above with the kernels for the best level the CPU reports, resolved once on first use.
+static void generate_mipmaps(u8* const* levels, u32 width, u32 height, u32 level_count, MipmapFlags flags, f32* scratch) {
+    static const MipmapKernels kernels = mipmap_kernels(OL::SIMD::best_level());
+    generate_mipmaps(kernels, levels, width, height, level_count, flags, scratch);
+}
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <orshlib/file.h>
+#include <orshlib/jobs.h>
+#include <orshlib/profiler.h>
 #include <SDL3/SDL_gpu.h>
 
 static const char* SHADER_DIRECTORY = "shaders/compiled/";
@@ -23,18 +25,30 @@ static ShaderData shader_data[] = {
       .samplers_count = 1 }
 };
 
-static SDL_GPUShader* shaders[OL::array_count(shader_data)];
+static constexpr u32 SHADER_COUNT = static_cast<u32>(OL::array_count(shader_data));
+static SDL_GPUShader* shaders[SHADER_COUNT];
 
-static SDL_GPUShader* load_shader(SDL_GPUDevice* device, ShaderData data) {
-    char path[OL::File::MAX_FILENAME_LENGTH];
-    snprintf(path, OL::File::MAX_FILENAME_LENGTH, "%s%s%s", SHADER_DIRECTORY, data.name, ".spv");
+// The SPIR-V blobs are read on the job system from start_shader_reads() until load_shaders() creates the shaders,
+// so the reads overlap whatever startup does in between.
+static char shader_paths[SHADER_COUNT][OL::File::MAX_FILENAME_LENGTH];
+static const char* shader_path_list[SHADER_COUNT];
+static OL::FileView shader_files[SHADER_COUNT];
+static OL::FileReadBatch shader_reads;
 
-    OL::File* file = OL::File::load(path);
-    assert(file);
+static void start_shader_reads(OL::JobSystem* job_system) {
+    for(u32 i = 0; i < SHADER_COUNT; ++i) {
+        snprintf(shader_paths[i], OL::File::MAX_FILENAME_LENGTH, "%s%s%s", SHADER_DIRECTORY, shader_data[i].name, ".spv");
+        shader_path_list[i] = shader_paths[i];
+    }
+
+    bool started = OL::start_file_read_batch(&shader_reads, job_system, shader_path_list, shader_files, SHADER_COUNT);
+    assert(started);
+}
 
+static SDL_GPUShader* load_shader(SDL_GPUDevice* device, ShaderData data, const OL::FileView* code) {
     SDL_GPUShaderCreateInfo shader_info = {
-        .code_size = file->size(),
-        .code = file->data(),
+        .code_size = code->size,
+        .code = code->data,
         .entrypoint = "main",
         .format = SDL_GPU_SHADERFORMAT_SPIRV,
         .stage = data.stage,
@@ -50,9 +64,14 @@ static SDL_GPUShader* load_shader(SDL_GPUDevice* device, ShaderData data) {
     return shader;
 };
 
-static void load_shaders(SDL_GPUDevice* device) {
-    for(u32 i = 0; i < OL::array_count(shader_data); ++i) {
-        shaders[i] = load_shader(device, shader_data[i]);
+// Creates each shader as soon as its file is in. The SPIR-V is only needed until then.
+static void load_shaders(SDL_GPUDevice* device, OL::JobSystem* job_system) {
+    OL_PROFILE_ZONE("load_shaders");
+    u32 shader_index;
+    while(OL::next_file_read(&shader_reads, job_system, &shader_index)) {
+        assert(shader_files[shader_index].data);
+        shaders[shader_index] = load_shader(device, shader_data[shader_index], &shader_files[shader_index]);
+        shader_files[shader_index].release();
     }
 };
 
@@ -0,0 +1,223 @@
+#pragma once
+
+#include "spatial_grid.h"
+
+#include <orshlib/types.h>
+#include <orshlib/math.h>
+#include <orshlib/random.h>
+#include <orshlib/memory.h>
+#include <orshlib/simd.h>
+#include <orshlib/jobs.h>
+#include <orshlib/profiler.h>
+#include <cassert>
+#include <cstring>
+
+using OL::Vector2;
+
+static constexpr size_t MAX_ENTITIES = 500000;
+
+// Entities per tick job. A multiple of a cache line's worth of instances, so with 64-byte aligned storage
+// no two jobs ever write the same line.
+static constexpr size_t SIMULATION_CHUNK_ENTITIES = 32 * 1024;
+
+struct InstanceData {
+    Vector2 position;
+    //f32 scaling;
+};
+
+struct Entity {
+    Vector2 velocity;
+};
+
+// The tick treats both arrays as flat f32 streams: x0 y0 x1 y1 ... += vx0 vy0 vx1 vy1 ...
+// Position and velocity already share a stride, so this is the SoA layout the SIMD kernels want
+// while still matching the instance vertex buffer the GPU reads.
+static_assert(sizeof(InstanceData) == sizeof(f32) * 2, "InstanceData must stay a packed f32 pair for integrate_positions");
+static_assert(sizeof(Entity) == sizeof(f32) * 2, "Entity must stay a packed f32 pair for integrate_positions");
+
+// What happens to an entity that crosses the world bounds. NONE lets it drift forever.
+enum class WorldEdge {
+    NONE,
+    WRAP,
+    BOUNCE
+};
+
+struct WorldBounds {
+    Vector2 min;
+    Vector2 max;
+    WorldEdge edge;
+};
+
+// Everything the fixed-step update touches. Kept free of SDL so it can be driven headlessly (see bench/).
+// When grid is set it is rebuilt at the end of every tick, so queries always see this tick's positions.
+// When previous_instances is set the tick writes the new positions there and swaps the two arrays, so after every
+// tick it holds the tick before for interpolate_instances.
+struct Simulation {
+    InstanceData* instances;
+    Entity* entities;
+    size_t count;
+    WorldBounds bounds;
+    SpatialGrid* grid;
+    InstanceData* previous_instances;
+};
+
+// Entities per spawn stream. Fixed rather than per job, so the spawned world depends only on the seed and the
+// entity count, never on how many threads filled it.
+static constexpr size_t SPAWN_CHUNK_ENTITIES = SIMULATION_CHUNK_ENTITIES;
+static constexpr u64 DEFAULT_SIMULATION_SEED = 0x5EED5EED5EED5EEDull;
+// Velocities are per tick, so the spawn speed has to come from the rate the world ticks at to keep it moving as fast.
+// SPAWN_SPEED is that speed at DEFAULT_TICK_RATE, callers ticking at another rate pass spawn_speed(their rate).
+static constexpr f32 SPAWN_SPEED_PER_SECOND = 0.015f;
+static constexpr u32 DEFAULT_TICK_RATE = 100;
+
+[[nodiscard]] static constexpr f32 spawn_speed(u32 tick_rate) {
+    return SPAWN_SPEED_PER_SECOND / static_cast<f32>(tick_rate);
+}
+
+static constexpr f32 SPAWN_SPEED = spawn_speed(DEFAULT_TICK_RATE);
+
+// Spreads entities [begin, end) uniformly over [-1, 1] with uniform velocities up to max_speed per axis per tick.
+// Every chunk of the range gets its own jump-ahead stream of the seed, so chunks fill in parallel and the result is
+// the same with or without jobs.
+static void spawn_random_entities(Simulation* simulation, size_t begin, size_t end, u64 seed, OL::JobSystem* jobs = nullptr, f32 max_speed = SPAWN_SPEED) {
+    OL_PROFILE_ZONE("spawn_random_entities");
+    if(end <= begin) {
+        return;
+    }
+    size_t chunk_count = (end - begin + SPAWN_CHUNK_ENTITIES - 1) / SPAWN_CHUNK_ENTITIES;
+
+    OL::BufferScope stream_memory(OL::memory.temporary);
+    OL::Random::Stream* streams = OL::memory.temporary->reserve<OL::Random::Stream>(chunk_count);
+    assert(streams);
+    OL::Random::Xoshiro256 generator = OL::Random::Xoshiro256::seeded(seed);
+    for(size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        streams[chunk] = OL::Random::split_stream(&generator);
+    }
+
+    auto spawn_chunks = [simulation, streams, begin, end, max_speed](size_t first_chunk, size_t last_chunk) {
+        for(size_t chunk = first_chunk; chunk < last_chunk; ++chunk) {
+            size_t chunk_begin = begin + chunk * SPAWN_CHUNK_ENTITIES;
+            size_t chunk_end = chunk_begin + SPAWN_CHUNK_ENTITIES < end ? chunk_begin + SPAWN_CHUNK_ENTITIES : end;
+            // Both structs are a bare Vector2, so x and y of a whole chunk are one flat run of floats.
+            OL::Random::fill_f32(&streams[chunk], &simulation->instances[chunk_begin].position.x, (chunk_end - chunk_begin) * 2, -1.0f, 1.0f);
+            OL::Random::fill_f32(&streams[chunk], &simulation->entities[chunk_begin].velocity.x, (chunk_end - chunk_begin) * 2, -max_speed, max_speed);
+            if(simulation->previous_instances) {
+                memcpy(simulation->previous_instances + chunk_begin, simulation->instances + chunk_begin, sizeof(InstanceData) * (chunk_end - chunk_begin));
+            }
+        }
+    };
+
+    if(jobs) {
+        jobs->parallel_for(0, chunk_count, 1, spawn_chunks);
+    } else {
+        spawn_chunks(0, chunk_count);
+    }
+}
+
+// Spawns the whole world: all count entities from the seed.
+static void init_entities(Simulation* simulation, u64 seed = DEFAULT_SIMULATION_SEED, OL::JobSystem* jobs = nullptr, f32 max_speed = SPAWN_SPEED) {
+    OL_PROFILE_ZONE("init_entities");
+    spawn_random_entities(simulation, 0, simulation->count, seed, jobs, max_speed);
+}
+
+// destination may be instances itself for an in-place update.
+static void integrate_positions(InstanceData* destination, const InstanceData* instances, const Entity* entities, size_t count,
+                                OL::SIMD::AddF32Kernel kernel = OL::SIMD::add_f32) {
+    const f32* positions = reinterpret_cast<const f32*>(instances);
+    const f32* velocities = reinterpret_cast<const f32*>(entities);
+    kernel(reinterpret_cast<f32*>(destination), positions, velocities, count * 2);
+}
+
+static void integrate_positions(InstanceData* instances, const Entity* entities, size_t count, OL::SIMD::AddF32Kernel kernel = OL::SIMD::add_f32) {
+    integrate_positions(instances, instances, entities, count, kernel);
+}
+
+// Assumes an entity moves less than the world's size per tick, so one correction always brings it back inside.
+static void apply_world_bounds(InstanceData* instances, Entity* entities, size_t count, WorldBounds bounds) {
+    switch(bounds.edge) {
+        case WorldEdge::WRAP: {
+            f32 width = bounds.max.x - bounds.min.x;
+            f32 height = bounds.max.y - bounds.min.y;
+            for(size_t i = 0; i < count; ++i) {
+                Vector2* position = &instances[i].position;
+                position->x += position->x < bounds.min.x ? width : (position->x >= bounds.max.x ? -width : 0.0f);
+                position->y += position->y < bounds.min.y ? height : (position->y >= bounds.max.y ? -height : 0.0f);
+            }
+        } break;
+        case WorldEdge::BOUNCE: {
+            for(size_t i = 0; i < count; ++i) {
+                Vector2* position = &instances[i].position;
+                Vector2* velocity = &entities[i].velocity;
+                if(position->x < bounds.min.x || position->x > bounds.max.x) {
+                    position->x = 2.0f * (position->x < bounds.min.x ? bounds.min.x : bounds.max.x) - position->x;
+                    velocity->x = -velocity->x;
+                }
+                if(position->y < bounds.min.y || position->y > bounds.max.y) {
+                    position->y = 2.0f * (position->y < bounds.min.y ? bounds.min.y : bounds.max.y) - position->y;
+                    velocity->y = -velocity->y;
+                }
+            }
+        } break;
+        default:
+            break;
+    }
+}
+
+static_assert(SIMULATION_CHUNK_ENTITIES % (OL::CACHE_LINE_SIZE / sizeof(InstanceData)) == 0, "Tick chunks must cover whole cache lines");
+
+// When upload_destination is set, each chunk is also copied there right after it is integrated, while it is
+// still in cache. That lets the tick write straight into a mapped GPU transfer region without a separate memcpy pass.
+static void simulation_tick(Simulation* simulation, OL::JobSystem* jobs = nullptr, InstanceData* upload_destination = nullptr) {
+    OL_PROFILE_ZONE("simulation_tick");
+    // With interpolation the new positions go over the tick before last, which nothing needs anymore.
+    InstanceData* next = simulation->previous_instances ? simulation->previous_instances : simulation->instances;
+    auto tick_chunk = [simulation, next, upload_destination](size_t begin, size_t end) {
+        OL_PROFILE_ZONE("tick_chunk");
+        integrate_positions(next + begin, simulation->instances + begin, simulation->entities + begin, end - begin);
+        apply_world_bounds(next + begin, simulation->entities + begin, end - begin, simulation->bounds);
+        if(upload_destination) {
+            memcpy(upload_destination + begin, next + begin, sizeof(InstanceData) * (end - begin));
+        }
+    };
+
+    if(!jobs) {
+        for(size_t begin = 0; begin < simulation->count; begin += SIMULATION_CHUNK_ENTITIES) {
+            size_t end = begin + SIMULATION_CHUNK_ENTITIES < simulation->count ? begin + SIMULATION_CHUNK_ENTITIES : simulation->count;
+            tick_chunk(begin, end);
+        }
+    } else {
+        jobs->parallel_for(0, simulation->count, SIMULATION_CHUNK_ENTITIES, tick_chunk);
+    }
+
+    if(simulation->previous_instances) {
+        simulation->previous_instances = simulation->instances;
+        simulation->instances = next;
+    }
+
+    if(simulation->grid) {
+        rebuild_spatial_grid(simulation->grid, &simulation->instances[0].position, sizeof(InstanceData), simulation->count, jobs);
+    }
+}
+
+// Positions alpha of the way from the previous tick to the current one, for rendering between ticks. In a wrapping
+// world, entities that moved more than half the world in one tick wrapped around an edge and are shown where they
+// landed. Other edge modes never teleport, so every step is interpolated.
+static void interpolate_instances(const Simulation* simulation, f32 alpha, InstanceData* output, OL::JobSystem* jobs = nullptr,
+                                  OL::SIMD::LerpF32Kernel kernel = OL::SIMD::lerp_f32) {
+    OL_PROFILE_ZONE("interpolate_instances");
+    assert(simulation->previous_instances);
+    Vector2 extent = { simulation->bounds.max.x - simulation->bounds.min.x, simulation->bounds.max.y - simulation->bounds.min.y };
+    f32 max_step = simulation->bounds.edge == WorldEdge::WRAP ? (extent.x < extent.y ? extent.x : extent.y) * 0.5f : INFINITY;
+
+    auto interpolate_chunk = [simulation, alpha, output, kernel, max_step](size_t begin, size_t end) {
+        const f32* previous = reinterpret_cast<const f32*>(simulation->previous_instances + begin);
+        const f32* current = reinterpret_cast<const f32*>(simulation->instances + begin);
+        kernel(reinterpret_cast<f32*>(output + begin), previous, current, alpha, max_step, (end - begin) * 2);
+    };
+
+    if(jobs) {
+        jobs->parallel_for(0, simulation->count, SIMULATION_CHUNK_ENTITIES, interpolate_chunk);
+    } else {
+        interpolate_chunk(0, simulation->count);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,299 @@
+#pragma once
+
+#include "simulation.h"
+
+#include <orshlib/types.h>
+#include <orshlib/file.h>
+#include <orshlib/jobs.h>
+#include <cstdio>
+#include <cstring>
+
+// Binary checkpoint of a Simulation, streamed out with plain writes and memory-mapped back in.
+//
+//   SnapshotHeader
+//   InstanceData[entity_count]    (on a SNAPSHOT_DATA_ALIGNMENT boundary)
+//   Entity[entity_count]          (on a SNAPSHOT_DATA_ALIGNMENT boundary)
+//   ReplayFrame[replay_frame_count]
+//
+// Both arrays start on a page, so a copy-on-write mapping of the file is already storage the tick can run on:
+// attach_snapshot() points a Simulation straight at it without copying. The optional replay log records how many
+// ticks each frame ran after the snapshot was taken and the checksum the world reached at the end, which makes any
+// recorded session a workload that replays identically. Everything is stored little-endian, and any change to the
+// layout must bump SNAPSHOT_VERSION.
+
+static constexpr u32 SNAPSHOT_MAGIC = 0x4E534C4F; // "OLSN"
+static constexpr u32 SNAPSHOT_VERSION = 1;
+static constexpr u64 SNAPSHOT_DATA_ALIGNMENT = 4096;
+
+struct ReplayFrame {
+    u32 ticks;
+    // Interpolation factor the frame rendered with, so a replay can render the same in-between states too.
+    f32 alpha;
+};
+
+struct SnapshotHeader {
+    u32 magic;
+    u32 version;
+    // Catches a struct that changed size without the version bump it needed.
+    u32 instance_size;
+    u32 entity_size;
+    u64 entity_count;
+    // The tick the snapshot was taken at, for the caller's bookkeeping.
+    u64 tick;
+    Vector2 bounds_min;
+    Vector2 bounds_max;
+    u32 edge;
+    u32 reserved;
+    u64 instances_offset;
+    u64 entities_offset;
+    u64 replay_offset;
+    u64 replay_frame_count;
+    u64 replay_ticks;
+    // simulation_checksum() after every replay frame has run, 0 without a replay log.
+    u64 final_checksum;
+    u64 file_size;
+};
+
+[[nodiscard]] static u64 align_snapshot_offset(u64 offset) {
+    return (offset + SNAPSHOT_DATA_ALIGNMENT - 1) & ~(SNAPSHOT_DATA_ALIGNMENT - 1);
+}
+
+// Fills in the header for the simulation's current state with no replay frames yet.
+[[nodiscard]] static SnapshotHeader make_snapshot_header(const Simulation* simulation, u64 tick) {
+    SnapshotHeader header = {
+        .magic = SNAPSHOT_MAGIC,
+        .version = SNAPSHOT_VERSION,
+        .instance_size = sizeof(InstanceData),
+        .entity_size = sizeof(Entity),
+        .entity_count = simulation->count,
+        .tick = tick,
+        .bounds_min = simulation->bounds.min,
+        .bounds_max = simulation->bounds.max,
+        .edge = static_cast<u32>(simulation->bounds.edge),
+        .instances_offset = align_snapshot_offset(sizeof(SnapshotHeader))
+    };
+    header.entities_offset = align_snapshot_offset(header.instances_offset + sizeof(InstanceData) * header.entity_count);
+    header.replay_offset = header.entities_offset + sizeof(Entity) * header.entity_count;
+    header.file_size = header.replay_offset;
+
+    return header;
+}
+
+// Order-dependent hash of every position and velocity. Only meant to tell two runs apart, not to resist tampering.
+[[nodiscard]] static u64 simulation_checksum(const Simulation* simulation) {
+    static constexpr u64 MULTIPLIER = 0x9E3779B97F4A7C15ull;
+    u64 hash = simulation->count;
+    auto mix = [&hash](const void* data, size_t count) {
+        const u64* words = static_cast<const u64*>(data);
+        for(size_t i = 0; i < count; ++i) {
+            hash = (hash ^ words[i]) * MULTIPLIER;
+            hash ^= hash >> 29;
+        }
+    };
+    // Both structs are a packed f32 pair, so one entity is exactly one u64 in each array.
+    mix(simulation->instances, simulation->count);
+    mix(simulation->entities, simulation->count);
+    return hash;
+}
+
+// Streams a snapshot to disk and, while it is open, appends a replay frame for every frame the caller runs after it.
+struct SnapshotWriter {
+    FILE* stream;
+    SnapshotHeader header;
+};
+
+[[nodiscard]] static bool write_snapshot_padding(FILE* stream, u64 bytes) {
+    static constexpr u8 ZEROES[SNAPSHOT_DATA_ALIGNMENT] = {};
+    assert(bytes <= sizeof(ZEROES));
+    return fwrite(ZEROES, 1, bytes, stream) == bytes;
+}
+
+// Writes the header and both arrays. The header is written again with the final counts by end_snapshot().
+[[nodiscard]] static bool begin_snapshot(const char* path, const Simulation* simulation, u64 tick, SnapshotWriter* writer) {
+    OL_PROFILE_ZONE("begin_snapshot");
+    *writer = {
+        .header = make_snapshot_header(simulation, tick)
+    };
+    writer->stream = OL::open_file_stream(path, "wb", "begin_snapshot()");
+    if(!writer->stream) {
+        return false;
+    }
+
+    const SnapshotHeader& header = writer->header;
+    size_t instance_bytes = sizeof(InstanceData) * header.entity_count;
+    size_t entity_bytes = sizeof(Entity) * header.entity_count;
+    bool written = fwrite(&header, sizeof(SnapshotHeader), 1, writer->stream) == 1 &&
+                   write_snapshot_padding(writer->stream, header.instances_offset - sizeof(SnapshotHeader)) &&
+                   fwrite(simulation->instances, 1, instance_bytes, writer->stream) == instance_bytes &&
+                   write_snapshot_padding(writer->stream, header.entities_offset - header.instances_offset - instance_bytes) &&
+                   fwrite(simulation->entities, 1, entity_bytes, writer->stream) == entity_bytes;
+    if(!written) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[begin_snapshot()] Unable to write %llu entities to %s.", static_cast<unsigned long long>(header.entity_count), path);
+        fclose(writer->stream);
+        writer->stream = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+// Records that a frame ran ticks ticks and rendered alpha of the way into the next one.
+static void append_replay_frame(SnapshotWriter* writer, u32 ticks, f32 alpha) {
+    ReplayFrame frame = { .ticks = ticks, .alpha = alpha };
+    writer->header.replay_frame_count += fwrite(&frame, sizeof(ReplayFrame), 1, writer->stream);
+    writer->header.replay_ticks += ticks;
+}
+
+// Seals the file. simulation is the state after the last appended frame, which a replay must reproduce.
+[[nodiscard]] static bool end_snapshot(SnapshotWriter* writer, const Simulation* simulation) {
+    OL_PROFILE_ZONE("end_snapshot");
+    SnapshotHeader& header = writer->header;
+    header.final_checksum = header.replay_frame_count > 0 ? simulation_checksum(simulation) : 0;
+    header.file_size = header.replay_offset + sizeof(ReplayFrame) * header.replay_frame_count;
+
+    bool written = !ferror(writer->stream) && fseek(writer->stream, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(SnapshotHeader), 1, writer->stream) == 1;
+    written &= fclose(writer->stream) == 0;
+    writer->stream = nullptr;
+    if(!written) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[end_snapshot()] Unable to finish the snapshot, the file is incomplete.");
+    }
+    return written;
+}
+
+// A snapshot without a replay log.
+[[nodiscard, maybe_unused]] static bool write_snapshot(const char* path, const Simulation* simulation, u64 tick) {
+    SnapshotWriter writer;
+    return begin_snapshot(path, simulation, tick, &writer) && end_snapshot(&writer, simulation);
+}
+
+// A mapped snapshot. The arrays are copy-on-write, writes to them stay private to this process.
+struct Snapshot {
+    OL::MappedFile file;
+    const SnapshotHeader* header;
+    InstanceData* instances;
+    Entity* entities;
+    const ReplayFrame* replay;
+};
+
+static void close_snapshot(Snapshot* snapshot) {
+    snapshot->file.unmap();
+    *snapshot = {};
+}
+
+// Whether count elements starting at offset end by limit. Header fields are untrusted, so nothing here can wrap.
+[[nodiscard]] static bool snapshot_section_fits(u64 offset, u64 count, u64 element_size, u64 limit) {
+    return offset <= limit && count <= (limit - offset) / element_size;
+}
+
+// Maps the snapshot and checks every offset in the header against the file before anything reads through it.
+[[nodiscard]] static bool open_snapshot(const char* path, Snapshot* snapshot) {
+    OL_PROFILE_ZONE("open_snapshot");
+    *snapshot = {};
+    if(!OL::MappedFile::map(path, &snapshot->file, true)) {
+        return false;
+    }
+
+    const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(snapshot->file.data);
+    const char* error = nullptr;
+    if(snapshot->file.size < sizeof(SnapshotHeader) || header->magic != SNAPSHOT_MAGIC) {
+        error = "not a snapshot";
+    } else if(header->version != SNAPSHOT_VERSION || header->instance_size != sizeof(InstanceData) || header->entity_size != sizeof(Entity)) {
+        error = "version mismatch";
+    } else if(header->file_size != snapshot->file.size) {
+        error = "truncated";
+    } else if(header->edge > static_cast<u32>(WorldEdge::BOUNCE)) {
+        error = "invalid world edge";
+    } else if(header->instances_offset % SNAPSHOT_DATA_ALIGNMENT != 0 || header->entities_offset % SNAPSHOT_DATA_ALIGNMENT != 0 ||
+              header->instances_offset < sizeof(SnapshotHeader) || header->replay_offset > snapshot->file.size ||
+              !snapshot_section_fits(header->instances_offset, header->entity_count, sizeof(InstanceData), header->entities_offset) ||
+              !snapshot_section_fits(header->entities_offset, header->entity_count, sizeof(Entity), header->replay_offset)) {
+        error = "entity data out of bounds";
+    } else if(!snapshot_section_fits(header->replay_offset, header->replay_frame_count, sizeof(ReplayFrame), snapshot->file.size) ||
+              header->replay_offset + sizeof(ReplayFrame) * header->replay_frame_count != snapshot->file.size) {
+        error = "replay log out of bounds";
+    }
+
+    if(error) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[open_snapshot()] %s: %s.", path, error);
+        close_snapshot(snapshot);
+        return false;
+    }
+
+    snapshot->header = header;
+    snapshot->instances = reinterpret_cast<InstanceData*>(snapshot->file.data + header->instances_offset);
+    snapshot->entities = reinterpret_cast<Entity*>(snapshot->file.data + header->entities_offset);
+    snapshot->replay = reinterpret_cast<const ReplayFrame*>(snapshot->file.data + header->replay_offset);
+    return true;
+}
+
+static void apply_snapshot_world(const Snapshot* snapshot, Simulation* simulation, OL::JobSystem* jobs) {
+    const SnapshotHeader* header = snapshot->header;
+    simulation->count = header->entity_count;
+    simulation->bounds = { .min = header->bounds_min, .max = header->bounds_max, .edge = static_cast<WorldEdge>(header->edge) };
+    if(simulation->previous_instances) {
+        memcpy(simulation->previous_instances, simulation->instances, sizeof(InstanceData) * simulation->count);
+    }
+    if(simulation->grid) {
+        rebuild_spatial_grid(simulation->grid, &simulation->instances[0].position, sizeof(InstanceData), simulation->count, jobs);
+    }
+}
+
+// Runs the simulation on the mapping itself: nothing is read until a tick touches it, and only the pages a tick
+// writes are copied. The snapshot must stay open for as long as the simulation uses it. previous_instances and
+// grid, when set, must have room for the snapshot's entity count.
+static void attach_snapshot(Snapshot* snapshot, Simulation* simulation, OL::JobSystem* jobs = nullptr) {
+    OL_PROFILE_ZONE("attach_snapshot");
+    simulation->instances = snapshot->instances;
+    simulation->entities = snapshot->entities;
+    apply_snapshot_world(snapshot, simulation, jobs);
+}
+
+// Copies the snapshot into the simulation's own storage, which must have room for capacity entities. The snapshot
+// can be closed right after.
+[[nodiscard, maybe_unused]] static bool restore_snapshot(const Snapshot* snapshot, Simulation* simulation, size_t capacity, OL::JobSystem* jobs = nullptr) {
+    OL_PROFILE_ZONE("restore_snapshot");
+    size_t count = snapshot->header->entity_count;
+    if(count > capacity) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[restore_snapshot()] Snapshot holds %zu entities, the simulation only has room for %zu.", count, capacity);
+        return false;
+    }
+
+    auto copy_chunk = [snapshot, simulation](size_t begin, size_t end) {
+        memcpy(simulation->instances + begin, snapshot->instances + begin, sizeof(InstanceData) * (end - begin));
+        memcpy(simulation->entities + begin, snapshot->entities + begin, sizeof(Entity) * (end - begin));
+    };
+    if(jobs) {
+        jobs->parallel_for(0, count, SIMULATION_CHUNK_ENTITIES, copy_chunk);
+    } else {
+        copy_chunk(0, count);
+    }
+
+    apply_snapshot_world(snapshot, simulation, jobs);
+    return true;
+}
+
+// Runs every recorded frame on a simulation holding the snapshot's state and reports whether it ended where the
+// recording did. With render_output set (and previous_instances on the simulation) each frame also interpolates,
+// so the replay costs what the recorded frames did minus the GPU.
+[[nodiscard, maybe_unused]] static bool replay_snapshot(const Snapshot* snapshot, Simulation* simulation, OL::JobSystem* jobs = nullptr,
+                                                        InstanceData* render_output = nullptr) {
+    OL_PROFILE_ZONE("replay_snapshot");
+    const SnapshotHeader* header = snapshot->header;
+    for(u64 frame = 0; frame < header->replay_frame_count; ++frame) {
+        for(u32 tick = 0; tick < snapshot->replay[frame].ticks; ++tick) {
+            simulation_tick(simulation, jobs);
+        }
+        if(render_output && simulation->previous_instances) {
+            interpolate_instances(simulation, snapshot->replay[frame].alpha, render_output, jobs);
+        }
+    }
+
+    u64 checksum = simulation_checksum(simulation);
+    if(header->replay_frame_count > 0 && checksum != header->final_checksum) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[replay_snapshot()] Diverged after %llu ticks: checksum %016llx, recorded %016llx.",
+                        static_cast<unsigned long long>(header->replay_ticks), static_cast<unsigned long long>(checksum),
+                        static_cast<unsigned long long>(header->final_checksum));
+        return false;
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <orshlib/types.h>
+#include <orshlib/math.h>
+#include <orshlib/memory.h>
+#include <orshlib/jobs.h>
+#include <orshlib/profiler.h>
+#include <cstring>
+
+using OL::Vector2;
+
+// Uniform grid over the world bounds, rebuilt from scratch from the instance positions every tick with a
+// counting sort. Entities in the same cell end up contiguous in entity_indices/positions, in ascending entity
+// order, so a query only touches the cells it overlaps and the rebuild is deterministic regardless of thread
+// count. Positions outside the grid are clamped into the edge cells.
+//
+// The sort runs in SPATIAL_GRID_PARTS fixed slices of the entity range, each with its own row of per-cell counts:
+//   1. count:   every part bins its slice and remembers each entity's cell
+//   2. offsets: per-cell totals are scanned into cell_start, then each part's row becomes its write cursors
+//   3. scatter: every part writes its slice to the cursors, in order
+
+static constexpr u32 SPATIAL_GRID_PARTS = 16;
+static constexpr u32 SPATIAL_GRID_CELL_GRAIN = 4096;
+static constexpr u32 SPATIAL_GRID_NOT_FOUND = ~0u;
+
+struct SpatialGrid {
+    Vector2 min;
+    Vector2 max;
+    f32 cell_size;
+    f32 inverse_cell_size;
+    u32 cells_x;
+    u32 cells_y;
+    u32 cell_count;
+    size_t capacity;
+    size_t count;
+
+    u32* cell_start;     // cell_count + 1 entries, cell c holds [cell_start[c], cell_start[c + 1])
+    u32* entity_indices; // Sorted by cell.
+    Vector2* positions;  // Copy of each sorted entity's position, so queries never chase entity_indices.
+    u32* entity_cells;
+    u32* part_counts;    // SPATIAL_GRID_PARTS rows of cell_count.
+
+    [[nodiscard]] u32 cell_x(f32 x) const {
+        f32 cell = (x - min.x) * inverse_cell_size;
+        return cell <= 0.0f ? 0 : (cell >= static_cast<f32>(cells_x - 1) ? cells_x - 1 : static_cast<u32>(cell));
+    }
+
+    [[nodiscard]] u32 cell_y(f32 y) const {
+        f32 cell = (y - min.y) * inverse_cell_size;
+        return cell <= 0.0f ? 0 : (cell >= static_cast<f32>(cells_y - 1) ? cells_y - 1 : static_cast<u32>(cell));
+    }
+
+    [[nodiscard]] u32 cell_of(Vector2 position) const {
+        return cell_y(position.y) * cells_x + cell_x(position.x);
+    }
+};
+
+[[nodiscard]] static u32 spatial_grid_cells(f32 extent, f32 cell_size) {
+    f32 cells = extent / cell_size;
+    u32 whole = static_cast<u32>(cells);
+    return static_cast<f32>(whole) < cells ? whole + 1 : (whole > 0 ? whole : 1);
+}
+
+// Bytes init_spatial_grid takes from its buffer.
+[[nodiscard]] static size_t spatial_grid_memory_size(Vector2 min, Vector2 max, f32 cell_size, size_t capacity) {
+    size_t cells = static_cast<size_t>(spatial_grid_cells(max.x - min.x, cell_size)) * spatial_grid_cells(max.y - min.y, cell_size);
+    return OL::reserve_size<u32>(cells + 1) + OL::reserve_size<u32>(capacity) + OL::reserve_size<Vector2>(capacity) + OL::reserve_size<u32>(capacity) +
+           OL::reserve_size<u32>(cells * SPATIAL_GRID_PARTS);
+}
+
+[[nodiscard]] static bool init_spatial_grid(SpatialGrid* grid, Vector2 min, Vector2 max, f32 cell_size, size_t capacity, OL::Buffer* memory) {
+    assert(cell_size > 0.0f && max.x > min.x && max.y > min.y);
+
+    *grid = {
+        .min = min,
+        .max = max,
+        .cell_size = cell_size,
+        .inverse_cell_size = 1.0f / cell_size,
+        .cells_x = spatial_grid_cells(max.x - min.x, cell_size),
+        .cells_y = spatial_grid_cells(max.y - min.y, cell_size),
+        .capacity = capacity
+    };
+    grid->cell_count = grid->cells_x * grid->cells_y;
+
+    if(memory->bytes_remaining() < spatial_grid_memory_size(min, max, cell_size, capacity)) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[init_spatial_grid()] %ux%u grid for %zu entities needs %zu bytes, buffer has %zu.", grid->cells_x, grid->cells_y, capacity, spatial_grid_memory_size(min, max, cell_size, capacity), memory->bytes_remaining());
+        return false;
+    }
+
+    grid->cell_start = memory->reserve<u32>(grid->cell_count + 1);
+    grid->entity_indices = memory->reserve<u32>(capacity);
+    grid->positions = memory->reserve<Vector2>(capacity);
+    grid->entity_cells = memory->reserve<u32>(capacity);
+    grid->part_counts = memory->reserve<u32>(static_cast<size_t>(grid->cell_count) * SPATIAL_GRID_PARTS);
+    memset(grid->cell_start, 0, sizeof(u32) * (grid->cell_count + 1));
+
+    return true;
+}
+
+// Runs body(begin, end) over [0, count) either on the job system or inline.
+template<typename Body>
+static void spatial_grid_for(OL::JobSystem* jobs, size_t count, size_t grain, Body&& body) {
+    if(jobs) {
+        jobs->parallel_for(0, count, grain, body);
+    } else {
+        body(0, count);
+    }
+}
+
+// `positions` is read with a stride of `stride` bytes so the grid can be built straight from InstanceData.
+static void rebuild_spatial_grid(SpatialGrid* grid, const Vector2* positions, size_t stride, size_t count, OL::JobSystem* jobs = nullptr) {
+    OL_PROFILE_ZONE("rebuild_spatial_grid");
+    assert(count <= grid->capacity);
+    grid->count = count;
+
+    const u8* position_bytes = reinterpret_cast<const u8*>(positions);
+    u32 cell_count = grid->cell_count;
+    size_t part_size = (count + SPATIAL_GRID_PARTS - 1) / SPATIAL_GRID_PARTS;
+    auto part_range = [count, part_size](size_t part, size_t* begin, size_t* end) {
+        *begin = part * part_size < count ? part * part_size : count;
+        *end = *begin + part_size < count ? *begin + part_size : count;
+    };
+
+    spatial_grid_for(jobs, SPATIAL_GRID_PARTS, 1, [&](size_t first_part, size_t last_part) {
+        for(size_t part = first_part; part < last_part; ++part) {
+            u32* counts = grid->part_counts + part * cell_count;
+            memset(counts, 0, sizeof(u32) * cell_count);
+
+            size_t begin, end;
+            part_range(part, &begin, &end);
+            for(size_t i = begin; i < end; ++i) {
+                u32 cell = grid->cell_of(*reinterpret_cast<const Vector2*>(position_bytes + i * stride));
+                grid->entity_cells[i] = cell;
+                ++counts[cell];
+            }
+        }
+    });
+
+    spatial_grid_for(jobs, cell_count, SPATIAL_GRID_CELL_GRAIN, [&](size_t begin, size_t end) {
+        for(size_t cell = begin; cell < end; ++cell) {
+            grid->cell_start[cell] = 0;
+        }
+        for(u32 part = 0; part < SPATIAL_GRID_PARTS; ++part) {
+            const u32* counts = grid->part_counts + static_cast<size_t>(part) * cell_count;
+            for(size_t cell = begin; cell < end; ++cell) {
+                grid->cell_start[cell] += counts[cell];
+            }
+        }
+    });
+
+    u32 total = 0;
+    for(u32 cell = 0; cell < cell_count; ++cell) {
+        u32 cell_total = grid->cell_start[cell];
+        grid->cell_start[cell] = total;
+        total += cell_total;
+    }
+    grid->cell_start[cell_count] = total;
+
+    // A cell range's rows stay in cache across all parts, so walking parts per cell is cheap.
+    spatial_grid_for(jobs, cell_count, SPATIAL_GRID_CELL_GRAIN, [&](size_t begin, size_t end) {
+        for(size_t cell = begin; cell < end; ++cell) {
+            u32 cursor = grid->cell_start[cell];
+            for(u32 part = 0; part < SPATIAL_GRID_PARTS; ++part) {
+                u32* count = &grid->part_counts[static_cast<size_t>(part) * cell_count + cell];
+                u32 part_total = *count;
+                *count = cursor;
+                cursor += part_total;
+            }
+        }
+    });
+
+    spatial_grid_for(jobs, SPATIAL_GRID_PARTS, 1, [&](size_t first_part, size_t last_part) {
+        for(size_t part = first_part; part < last_part; ++part) {
+            u32* cursors = grid->part_counts + part * cell_count;
+
+            size_t begin, end;
+            part_range(part, &begin, &end);
+            for(size_t i = begin; i < end; ++i) {
+                u32 slot = cursors[grid->entity_cells[i]]++;
+                grid->entity_indices[slot] = static_cast<u32>(i);
+                grid->positions[slot] = *reinterpret_cast<const Vector2*>(position_bytes + i * stride);
+            }
+        }
+    });
+}
+// Visits every entity inside [min, max] as visit(entity_index, position), cell by cell.
+template<typename Visitor>
+static void for_each_in_range(const SpatialGrid* grid, Vector2 min, Vector2 max, Visitor&& visit) {
+    u32 x0 = grid->cell_x(min.x), x1 = grid->cell_x(max.x);
+    u32 y0 = grid->cell_y(min.y), y1 = grid->cell_y(max.y);
+    for(u32 y = y0; y <= y1; ++y) {
+        for(u32 x = x0; x <= x1; ++x) {
+            u32 cell = y * grid->cells_x + x;
+            for(u32 slot = grid->cell_start[cell]; slot < grid->cell_start[cell + 1]; ++slot) {
+                Vector2 position = grid->positions[slot];
+                if(position.x >= min.x && position.x <= max.x && position.y >= min.y && position.y <= max.y) {
+                    visit(grid->entity_indices[slot], position);
+                }
+            }
+        }
+    }
+}
+
+template<typename Visitor>
+static void for_each_in_radius(const SpatialGrid* grid, Vector2 center, f32 radius, Visitor&& visit) {
+    f32 radius_squared = radius * radius;
+    for_each_in_range(grid, { center.x - radius, center.y - radius }, { center.x + radius, center.y + radius }, [&](u32 entity_index, Vector2 position) {
+        f32 dx = position.x - center.x;
+        f32 dy = position.y - center.y;
+        if(dx * dx + dy * dy <= radius_squared) {
+            visit(entity_index, position);
+        }
+    });
+}
+
+// Writes up to `capacity` entity indices and returns how many matched, which can be more than were written.
+[[nodiscard]] static u32 query_range(const SpatialGrid* grid, Vector2 min, Vector2 max, u32* results, u32 capacity) {
+    u32 found = 0;
+    for_each_in_range(grid, min, max, [&](u32 entity_index, Vector2) {
+        if(found < capacity) {
+            results[found] = entity_index;
+        }
+        ++found;
+    });
+    return found;
+}
+
+[[nodiscard]] static u32 query_radius(const SpatialGrid* grid, Vector2 center, f32 radius, u32* results, u32 capacity) {
+    u32 found = 0;
+    for_each_in_radius(grid, center, radius, [&](u32 entity_index, Vector2) {
+        if(found < capacity) {
+            results[found] = entity_index;
+        }
+        ++found;
+    });
+    return found;
+}
+
+// Closest entity to `point` within max_distance, skipping `exclude` (e.g. the querying entity itself), or
+// SPATIAL_GRID_NOT_FOUND. Searches square rings of cells outwards from the point's cell and stops once a ring
+// can't hold anything closer than the best so far: everything in ring r is at least (r - 1) cells away.
+[[nodiscard]] static u32 query_nearest(const SpatialGrid* grid, Vector2 point, f32 max_distance, u32 exclude = SPATIAL_GRID_NOT_FOUND) {
+    s64 center_x = grid->cell_x(point.x);
+    s64 center_y = grid->cell_y(point.y);
+    s64 max_ring = grid->cells_x > grid->cells_y ? grid->cells_x : grid->cells_y;
+
+    u32 best = SPATIAL_GRID_NOT_FOUND;
+    f32 best_distance_squared = max_distance * max_distance;
+    for(s64 ring = 0; ring <= max_ring; ++ring) {
+        f32 ring_distance = static_cast<f32>(ring - 1) * grid->cell_size;
+        if(ring > 1 && ring_distance * ring_distance > best_distance_squared) {
+            break;
+        }
+
+        s64 y_begin = center_y - ring > 0 ? center_y - ring : 0;
+        s64 y_end = center_y + ring < grid->cells_y - 1 ? center_y + ring : grid->cells_y - 1;
+        for(s64 y = y_begin; y <= y_end; ++y) {
+            // Rows strictly inside the ring only contribute their two edge cells.
+            bool edge_row = y == center_y - ring || y == center_y + ring;
+            s64 x_step = edge_row || ring == 0 ? 1 : ring * 2;
+            for(s64 x = center_x - ring; x <= center_x + ring; x += x_step) {
+                if(x < 0 || x >= grid->cells_x) {
+                    continue;
+                }
+
+                u32 cell = static_cast<u32>(y * grid->cells_x + x);
+                for(u32 slot = grid->cell_start[cell]; slot < grid->cell_start[cell + 1]; ++slot) {
+                    f32 dx = grid->positions[slot].x - point.x;
+                    f32 dy = grid->positions[slot].y - point.y;
+                    f32 distance_squared = dx * dx + dy * dy;
+                    u32 entity_index = grid->entity_indices[slot];
+                    if(distance_squared <= best_distance_squared && entity_index != exclude &&
+                       (distance_squared < best_distance_squared || entity_index < best)) {
+                        best = entity_index;
+                        best_distance_squared = distance_squared;
+                    }
+                }
+            }
+        }
+    }
+
+    return best;
+}
\ No newline at end of file
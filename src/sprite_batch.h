@@ -0,0 +1,350 @@
+#pragma once
+
+#include "simulation.h"
+
+#include <orshlib/types.h>
+#include <orshlib/memory.h>
+#include <orshlib/jobs.h>
+#include <orshlib/log.h>
+#include <orshlib/profiler.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+// Sort-key sprite batching. Every sprite is submitted as a 64-bit key plus the caller's index for it. The key orders
+// sprites by layer, pipeline, texture and depth, most significant first, so once the batch is sorted every run of
+// sprites sharing layer, pipeline and texture is contiguous. Each such run is one indirect draw, and consecutive runs
+// on the same layer and pipeline form a draw group: one pipeline bind and one multi-draw call. Kept free of SDL so
+// the bench can drive it, main turns runs into SDL_GPUIndexedIndirectDrawCommands.
+//
+//   63      56 55      48 47              32 31                               0
+//  [  layer   ][ pipeline ][     texture     ][              depth              ]
+using SpriteKey = u64;
+
+static constexpr u32 SPRITE_KEY_LAYER_SHIFT = 56;
+static constexpr u32 SPRITE_KEY_PIPELINE_SHIFT = 48;
+static constexpr u32 SPRITE_KEY_TEXTURE_SHIFT = 32;
+static constexpr u32 MAX_SPRITE_LAYERS = 1 << 8;
+static constexpr u32 MAX_SPRITE_PIPELINES = 1 << 8;
+static constexpr u32 MAX_SPRITE_TEXTURES = 1 << 16;
+
+// LSD radix sort over 8-bit digits. Digits that are the same in every key are skipped, so a batch whose keys only
+// differ in a handful of textures sorts in a single pass.
+static constexpr u32 SPRITE_SORT_RADIX_BITS = 8;
+static constexpr u32 SPRITE_SORT_BUCKETS = 1 << SPRITE_SORT_RADIX_BITS;
+static constexpr u32 SPRITE_SORT_DIGITS = sizeof(SpriteKey) * 8 / SPRITE_SORT_RADIX_BITS;
+// Sprites per sort job.
+static constexpr u32 SPRITE_SORT_CHUNK_SPRITES = 64 * 1024;
+
+// Flips a float's bits so that comparing them as unsigned integers orders them like the floats: negatives get every
+// bit flipped, positives just the sign.
+[[nodiscard]] static u32 sortable_depth(f32 depth) {
+    u32 bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return bits ^ ((bits >> 31) ? 0xFFFFFFFFu : 0x80000000u);
+}
+
+// Sprites with a lower depth sort first, so they are drawn first.
+[[nodiscard]] static SpriteKey make_sprite_key(u32 layer, u32 pipeline, u32 texture, f32 depth) {
+    assert(layer < MAX_SPRITE_LAYERS && pipeline < MAX_SPRITE_PIPELINES && texture < MAX_SPRITE_TEXTURES);
+    return (static_cast<SpriteKey>(layer) << SPRITE_KEY_LAYER_SHIFT) | (static_cast<SpriteKey>(pipeline) << SPRITE_KEY_PIPELINE_SHIFT) |
+           (static_cast<SpriteKey>(texture) << SPRITE_KEY_TEXTURE_SHIFT) | sortable_depth(depth);
+}
+
+[[nodiscard]] static u32 sprite_key_layer(SpriteKey key) {
+    return static_cast<u32>(key >> SPRITE_KEY_LAYER_SHIFT);
+}
+
+[[nodiscard]] static u32 sprite_key_pipeline(SpriteKey key) {
+    return static_cast<u32>(key >> SPRITE_KEY_PIPELINE_SHIFT) & (MAX_SPRITE_PIPELINES - 1);
+}
+
+[[nodiscard]] static u32 sprite_key_texture(SpriteKey key) {
+    return static_cast<u32>(key >> SPRITE_KEY_TEXTURE_SHIFT) & (MAX_SPRITE_TEXTURES - 1);
+}
+
+// Everything but depth: sprites with the same state can share a draw.
+[[nodiscard]] static u32 sprite_key_state(SpriteKey key) {
+    return static_cast<u32>(key >> SPRITE_KEY_TEXTURE_SHIFT);
+}
+
+// Per sort chunk, the count of every digit value, for every digit, and the bits where its keys differ from the first.
+struct SpriteSortHistogram {
+    u32 counts[SPRITE_SORT_DIGITS][SPRITE_SORT_BUCKETS];
+    SpriteKey differing;
+};
+
+// Sprites [first, first + count) of the sorted batch, all with the same layer, pipeline and texture.
+struct SpriteRun {
+    u32 texture;
+    u32 first;
+    u32 count;
+};
+
+// Consecutive runs on the same layer and pipeline.
+struct SpriteDrawGroup {
+    u32 layer;
+    u32 pipeline;
+    u32 first_run;
+    u32 run_count;
+};
+
+// keys and sprites hold the submitted sprites, and after end_sprite_batch() the same sprites in key order. The
+// scratch arrays are the other half of the sort's ping-pong. Everything is reserved up front.
+struct SpriteBatch {
+    SpriteKey* keys;
+    u32* sprites;
+    SpriteKey* scratch_keys;
+    u32* scratch_sprites;
+    SpriteSortHistogram* histograms;
+    SpriteRun* runs;
+    SpriteDrawGroup* groups;
+    u32 count;
+    u32 capacity;
+    u32 max_chunks;
+    u32 max_runs;
+    u32 run_count;
+    u32 group_count;
+    // Digits the last sort actually had to scatter.
+    u32 sort_passes;
+};
+
+[[nodiscard]] static u32 sprite_sort_max_chunks(u32 capacity) {
+    return (capacity + SPRITE_SORT_CHUNK_SPRITES - 1) / SPRITE_SORT_CHUNK_SPRITES;
+}
+
+[[nodiscard]] static size_t sprite_batch_memory_size(u32 capacity, u32 max_runs) {
+    return OL::reserve_size<SpriteKey>(capacity) * 2 + OL::reserve_size<u32>(capacity) * 2 +
+           OL::reserve_size<SpriteSortHistogram>(sprite_sort_max_chunks(capacity)) + OL::reserve_size<SpriteRun>(max_runs) +
+           OL::reserve_size<SpriteDrawGroup>(max_runs);
+}
+
+// max_runs bounds the distinct layer, pipeline and texture combinations a batch can draw.
+[[nodiscard]] static bool init_sprite_batch(SpriteBatch* batch, u32 capacity, u32 max_runs, OL::Buffer* memory) {
+    if(memory->bytes_remaining() < sprite_batch_memory_size(capacity, max_runs)) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[init_sprite_batch()] Batching %u sprites needs %zu bytes, buffer has %zu.", capacity, sprite_batch_memory_size(capacity, max_runs), memory->bytes_remaining());
+        return false;
+    }
+
+    u32 max_chunks = sprite_sort_max_chunks(capacity);
+    *batch = {
+        .keys = memory->reserve<SpriteKey>(capacity),
+        .sprites = memory->reserve<u32>(capacity),
+        .scratch_keys = memory->reserve<SpriteKey>(capacity),
+        .scratch_sprites = memory->reserve<u32>(capacity),
+        .histograms = memory->reserve<SpriteSortHistogram>(max_chunks),
+        .runs = memory->reserve<SpriteRun>(max_runs),
+        .groups = memory->reserve<SpriteDrawGroup>(max_runs),
+        .capacity = capacity,
+        .max_chunks = max_chunks,
+        .max_runs = max_runs
+    };
+    return true;
+}
+
+static void begin_sprite_batch(SpriteBatch* batch) {
+    batch->count = 0;
+    batch->run_count = 0;
+    batch->group_count = 0;
+}
+
+// Reserves count sprites for the caller to fill at keys[first..] and sprites[first..], e.g. from a parallel_for, and
+// returns first. Stops at capacity, the batch's count says how many were actually reserved.
+static u32 reserve_sprites(SpriteBatch* batch, u32 count) {
+    u32 first = batch->count;
+    u32 available = batch->capacity - first;
+    batch->count += count < available ? count : available;
+    return first;
+}
+
+[[nodiscard]] static bool submit_sprite(SpriteBatch* batch, SpriteKey key, u32 sprite) {
+    if(batch->count == batch->capacity) {
+        return false;
+    }
+    batch->keys[batch->count] = key;
+    batch->sprites[batch->count] = sprite;
+    ++batch->count;
+    return true;
+}
+
+// Stable sort of count keys, carrying sprites along, and returns how many digits it scattered. A first sweep finds
+// the bits that differ anywhere in the batch, digits without any are skipped. Each pass counts its digit per chunk,
+// turns the counts into every chunk's offset per digit value (value-major, then chunk, which is what keeps it stable)
+// and scatters the chunks in parallel. The result always ends up in keys and sprites.
+static u32 sort_sprite_keys(SpriteKey* keys, u32* sprites, SpriteKey* scratch_keys, u32* scratch_sprites, SpriteSortHistogram* histograms,
+                            u32 max_chunks, u32 count, OL::JobSystem* jobs = nullptr) {
+    OL_PROFILE_ZONE("sort_sprite_keys");
+    if(count < 2) {
+        return 0;
+    }
+
+    // Without jobs the whole batch is one chunk. Reordering a chunk doesn't change its counts, so then every digit is
+    // counted up front in one sweep.
+    u32 chunk_count = 1;
+    if(jobs) {
+        chunk_count = (count + SPRITE_SORT_CHUNK_SPRITES - 1) / SPRITE_SORT_CHUNK_SPRITES;
+        chunk_count = chunk_count < max_chunks ? chunk_count : max_chunks;
+    }
+    auto chunk_begin = [count, chunk_count](size_t chunk) {
+        return static_cast<u32>(static_cast<u64>(count) * chunk / chunk_count);
+    };
+    auto for_each_chunk = [jobs, chunk_count](auto&& body) {
+        if(jobs) {
+            jobs->parallel_for(0, chunk_count, 1, body);
+        } else {
+            body(0, chunk_count);
+        }
+    };
+
+    SpriteKey first_key = keys[0];
+    for_each_chunk([&](size_t first, size_t last) {
+        for(size_t chunk = first; chunk < last; ++chunk) {
+            SpriteKey differing = 0;
+            for(u32 i = chunk_begin(chunk), end = chunk_begin(chunk + 1); i < end; ++i) {
+                differing |= keys[i] ^ first_key;
+            }
+            histograms[chunk].differing = differing;
+        }
+    });
+
+    SpriteKey differing = 0;
+    for(u32 chunk = 0; chunk < chunk_count; ++chunk) {
+        differing |= histograms[chunk].differing;
+    }
+    u32 digits[SPRITE_SORT_DIGITS];
+    u32 digit_count = 0;
+    for(u32 digit = 0; digit < SPRITE_SORT_DIGITS; ++digit) {
+        if((differing >> (digit * SPRITE_SORT_RADIX_BITS)) & (SPRITE_SORT_BUCKETS - 1)) {
+            digits[digit_count++] = digit;
+        }
+    }
+
+    auto count_digits = [&](const SpriteKey* source, u32 first_digit, u32 last_digit) {
+        for_each_chunk([&](size_t first, size_t last) {
+            for(size_t chunk = first; chunk < last; ++chunk) {
+                SpriteSortHistogram* histogram = &histograms[chunk];
+                for(u32 digit = first_digit; digit < last_digit; ++digit) {
+                    memset(histogram->counts[digits[digit]], 0, sizeof(u32) * SPRITE_SORT_BUCKETS);
+                }
+                for(u32 i = chunk_begin(chunk), end = chunk_begin(chunk + 1); i < end; ++i) {
+                    SpriteKey key = source[i];
+                    for(u32 digit = first_digit; digit < last_digit; ++digit) {
+                        ++histogram->counts[digits[digit]][(key >> (digits[digit] * SPRITE_SORT_RADIX_BITS)) & (SPRITE_SORT_BUCKETS - 1)];
+                    }
+                }
+            }
+        });
+    };
+    if(chunk_count == 1) {
+        count_digits(keys, 0, digit_count);
+    }
+
+    SpriteKey* source_keys = keys;
+    u32* source_sprites = sprites;
+    SpriteKey* destination_keys = scratch_keys;
+    u32* destination_sprites = scratch_sprites;
+    for(u32 pass = 0; pass < digit_count; ++pass) {
+        u32 digit = digits[pass];
+        u32 shift = digit * SPRITE_SORT_RADIX_BITS;
+        if(chunk_count > 1) {
+            count_digits(source_keys, pass, pass + 1);
+        }
+
+        u32 offset = 0;
+        for(u32 bucket = 0; bucket < SPRITE_SORT_BUCKETS; ++bucket) {
+            for(u32 chunk = 0; chunk < chunk_count; ++chunk) {
+                u32* counts = histograms[chunk].counts[digit];
+                u32 bucket_count = counts[bucket];
+                counts[bucket] = offset;
+                offset += bucket_count;
+            }
+        }
+
+        for_each_chunk([&](size_t first, size_t last) {
+            for(size_t chunk = first; chunk < last; ++chunk) {
+                // A local copy, so the stores below can't alias the offsets.
+                u32 offsets[SPRITE_SORT_BUCKETS];
+                memcpy(offsets, histograms[chunk].counts[digit], sizeof(offsets));
+                for(u32 i = chunk_begin(chunk), end = chunk_begin(chunk + 1); i < end; ++i) {
+                    SpriteKey key = source_keys[i];
+                    u32 destination = offsets[(key >> shift) & (SPRITE_SORT_BUCKETS - 1)]++;
+                    destination_keys[destination] = key;
+                    destination_sprites[destination] = source_sprites[i];
+                }
+            }
+        });
+
+        std::swap(source_keys, destination_keys);
+        std::swap(source_sprites, destination_sprites);
+    }
+
+    if(source_keys != keys) {
+        memcpy(keys, source_keys, sizeof(SpriteKey) * count);
+        memcpy(sprites, source_sprites, sizeof(u32) * count);
+    }
+    return digit_count;
+}
+
+// Splits the sorted batch into runs and groups. Each run's end is found by binary search on its state, so this costs
+// a few probes per run instead of a pass over every sprite.
+[[nodiscard]] static bool build_sprite_runs(SpriteBatch* batch) {
+    OL_PROFILE_ZONE("build_sprite_runs");
+    batch->run_count = 0;
+    batch->group_count = 0;
+    const SpriteKey* keys = batch->keys;
+    for(u32 first = 0; first < batch->count;) {
+        if(batch->run_count == batch->max_runs) {
+            OL::Logger::log(OL::Logger::LEVEL_ERROR, "[build_sprite_runs()] More than %u runs, the sprites from %u on are dropped.", batch->max_runs, first);
+            return false;
+        }
+
+        SpriteKey key = keys[first];
+        SpriteKey last_of_state = (static_cast<SpriteKey>(sprite_key_state(key)) << SPRITE_KEY_TEXTURE_SHIFT) | 0xFFFFFFFFull;
+        u32 end = static_cast<u32>(std::upper_bound(keys + first, keys + batch->count, last_of_state) - keys);
+
+        SpriteDrawGroup* group = batch->group_count > 0 ? &batch->groups[batch->group_count - 1] : nullptr;
+        if(!group || group->layer != sprite_key_layer(key) || group->pipeline != sprite_key_pipeline(key)) {
+            group = &batch->groups[batch->group_count++];
+            *group = {
+                .layer = sprite_key_layer(key),
+                .pipeline = sprite_key_pipeline(key),
+                .first_run = batch->run_count
+            };
+        }
+        ++group->run_count;
+
+        batch->runs[batch->run_count++] = {
+            .texture = sprite_key_texture(key),
+            .first = first,
+            .count = end - first
+        };
+        first = end;
+    }
+    return true;
+}
+
+// Sorts what was submitted since begin_sprite_batch() and builds its runs and groups.
+[[nodiscard]] static bool end_sprite_batch(SpriteBatch* batch, OL::JobSystem* jobs = nullptr) {
+    OL_PROFILE_ZONE("end_sprite_batch");
+    batch->sort_passes = sort_sprite_keys(batch->keys, batch->sprites, batch->scratch_keys, batch->scratch_sprites, batch->histograms, batch->max_chunks,
+                                          batch->count, jobs);
+    return build_sprite_runs(batch);
+}
+
+// Copies the caller's per-sprite data into draw order: output[i] = source[sprites[i]].
+template<typename T>
+static void gather_sprites(const SpriteBatch* batch, const T* source, T* output, OL::JobSystem* jobs = nullptr) {
+    OL_PROFILE_ZONE("gather_sprites");
+    auto gather = [batch, source, output](size_t begin, size_t end) {
+        const u32* sprites = batch->sprites;
+        for(size_t i = begin; i < end; ++i) {
+            output[i] = source[sprites[i]];
+        }
+    };
+
+    if(jobs) {
+        jobs->parallel_for(0, batch->count, SPRITE_SORT_CHUNK_SPRITES, gather);
+    } else {
+        gather(0, batch->count);
+    }
+}
\ No newline at end of file
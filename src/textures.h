@@ -1,137 +1,495 @@
 #pragma once
 
+#include "atlas.h"
+#include "asset_pack.h"
+#include "asset_cook.h"
+#include "mipmaps.h"
+
 #include <orshlib/file.h>
+#include <orshlib/math.h>
+#include <orshlib/jobs.h>
+#include <orshlib/time.h>
+#include <orshlib/profiler.h>
 #include <SDL3/SDL_gpu.h>
-#define STB_IMAGE_IMPLEMENTATION
-#define STBI_ASSERT(x)
-//#define STBI_ONLY_PNG
-#include <stb_image.h>
-
-static const char* ASSETS_DIRECTORY = "assets/";
-
-static const char* image_paths[] = {
-    "athano.bmp",
-    "azen.png",
-    "azen2.png",
-    "azen3.png",
-    "pepe.png"
-};
-
-static constexpr size_t MAX_TEXTURES_COUNT = OL::array_count(image_paths);
-
-struct ImageData {
-    u8* pixels;
-    u32 size;
-    u32 width;
-    u32 height;
-};
 
+// One sprite inside the atlas page. handle is the shared page texture.
 struct Texture {
     size_t id;
     SDL_GPUTexture* handle;
     u32 width;
     u32 height;
+    AtlasRect rect;
+    OL::Vector2 uv_min;
+    OL::Vector2 uv_max;
 };
 
+// Every image in image_paths packed into a single page, so one sampler binding covers all sprites.
 struct TextureAtlas {
     Texture* textures;
     u32 count;
+    SDL_GPUTexture* page;
+    u32 page_width;
+    u32 page_height;
+    u32 level_count;
 };
 
-static TextureAtlas load_textures(SDL_GPUDevice* device) {
-    TextureAtlas atlas = {
-        .textures = OL::memory.persistent->reserve<Texture>(MAX_TEXTURES_COUNT),
-        .count = MAX_TEXTURES_COUNT
+[[nodiscard]] static SDL_GPUTextureFormat gpu_texture_format(BlockFormat format) {
+    switch(format) {
+        case BlockFormat::BC1: {
+            return SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM;
+        } break;
+        case BlockFormat::BC3: {
+            return SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM;
+        } break;
+        case BlockFormat::BC7: {
+            return SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM;
+        } break;
+        default: {
+            return SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+        }
+    }
+}
+
+static SDL_GPUTexture* create_atlas_page(SDL_GPUDevice* device, u32 width, u32 height, u32 level_count, BlockFormat format = BlockFormat::RGBA8) {
+    SDL_GPUTextureCreateInfo texture_info = {
+        .type = SDL_GPU_TEXTURETYPE_2D,
+        .format = gpu_texture_format(format),
+        .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
+        .width = width,
+        .height = height,
+        .layer_count_or_depth = 1,
+        .num_levels = level_count,
+        .sample_count = SDL_GPU_SAMPLECOUNT_1
     };
-    assert(atlas.textures);
 
-    ImageData images_data[MAX_TEXTURES_COUNT];
-    u32 images_size = 0;
-    for(size_t image_index = 0; image_index < MAX_TEXTURES_COUNT; ++image_index) {
-        ImageData* data = &images_data[image_index];
+    SDL_GPUTexture* page = SDL_CreateGPUTexture(device, &texture_info);
+    assert(page);
 
-        char path[OL::File::MAX_FILENAME_LENGTH];
-        snprintf(path, OL::File::MAX_FILENAME_LENGTH, "%s%s", ASSETS_DIRECTORY, image_paths[image_index]);
+    return page;
+}
 
-        s32 width, height;
-        data->pixels = stbi_load(path, &width, &height, nullptr, 4);
+// Creates the page texture and uploads `level_count` levels stored back to back from the start of transfer_buffer.
+static SDL_GPUTexture* upload_atlas_page(SDL_GPUDevice* device, SDL_GPUTransferBuffer* transfer_buffer, u32 width, u32 height, u32 level_count,
+                                         BlockFormat format = BlockFormat::RGBA8) {
+    SDL_GPUTexture* page = create_atlas_page(device, width, height, level_count, format);
 
-        data->width = static_cast<u32>(width);
-        data->height = static_cast<u32>(height);
-        data->size = data->width * data->height * 4;
+    SDL_GPUCommandBuffer* command_buffer = SDL_AcquireGPUCommandBuffer(device);
+    SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(command_buffer);
+    u32 buffer_offset = 0;
+    for(u32 level = 0; level < level_count; ++level) {
+        // Levels are tightly packed. Passing the level width as the row length would break block formats on levels
+        // narrower than a block, where a row of blocks still covers 4 texels.
+        SDL_GPUTextureTransferInfo texture_transfer_info = {
+            .transfer_buffer = transfer_buffer,
+            .offset = buffer_offset,
+            .pixels_per_row = 0
+        };
+
+        SDL_GPUTextureRegion texture_region = {
+            .texture = page,
+            .mip_level = level,
+            .w = width,
+            .h = height,
+            .d = 1
+        };
 
-        images_size += data->size;
+        SDL_UploadToGPUTexture(copy_pass, &texture_transfer_info, &texture_region, false);
+
+        buffer_offset += static_cast<u32>(block_format_level_size(format, width, height));
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    SDL_EndGPUCopyPass(copy_pass);
+    SDL_SubmitGPUCommandBuffer(command_buffer);
+
+    return page;
+}
+
+// Points the texture's UVs at `rect` in the page. width and height stay the sprite's own size.
+static void set_texture_region(const TextureAtlas* atlas, Texture* texture, AtlasRect rect) {
+    texture->rect = rect;
+    texture->uv_min = { static_cast<f32>(rect.x) / atlas->page_width, static_cast<f32>(rect.y) / atlas->page_height };
+    texture->uv_max = { static_cast<f32>(rect.x + rect.width) / atlas->page_width, static_cast<f32>(rect.y + rect.height) / atlas->page_height };
+}
+
+static void fill_atlas_textures(TextureAtlas* atlas, const AtlasRect* rects) {
+    for(u32 texture_index = 0; texture_index < atlas->count; ++texture_index) {
+        Texture* texture = &atlas->textures[texture_index];
+        AtlasRect rect = rects[texture_index];
+
+        texture->id = texture_index;
+        texture->handle = atlas->page;
+        texture->width = rect.width;
+        texture->height = rect.height;
+        set_texture_region(atlas, texture, rect);
+    }
+}
+
+// Fast path: the cooked page is copied from the mapped pack straight into the transfer buffer, nothing is decoded. A
+// block compressed page is uploaded as it is, a quarter or an eighth of the RGBA8 size, unless the GPU can't sample
+// its format, in which case it is decompressed to RGBA8 on the way.
+static void load_textures_from_pack(SDL_GPUDevice* device, AssetPack* pack, TextureAtlas* atlas) {
+    const AssetPackHeader* header = pack->header;
+    atlas->page_width = header->page_width;
+    atlas->page_height = header->page_height;
+    atlas->level_count = header->level_count;
+
+    BlockFormat format = header->format;
+    if(format != BlockFormat::RGBA8 && !SDL_GPUTextureSupportsFormat(device, gpu_texture_format(format), SDL_GPU_TEXTURETYPE_2D, SDL_GPU_TEXTUREUSAGE_SAMPLER)) {
+        OL::Logger::log("[load_textures_from_pack()] %s textures are not supported, decompressing the page.", block_format_to_string(format));
+        format = BlockFormat::RGBA8;
+    }
+
+    u64 upload_size = 0;
+    for(u32 level = 0; level < header->level_count; ++level) {
+        upload_size += block_format_level_size(format, header->levels[level].width, header->levels[level].height);
     }
 
     SDL_GPUTransferBufferCreateInfo transfer_buffer_info = {
         .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-        .size = images_size
+        .size = static_cast<u32>(upload_size)
     };
 
     SDL_GPUTransferBuffer* transfer_buffer = SDL_CreateGPUTransferBuffer(device, &transfer_buffer_info);
-    void* transfer_data = SDL_MapGPUTransferBuffer(device, transfer_buffer, false);
-    u32 buffer_offset = 0;
-    for(size_t image_index = 0; image_index < MAX_TEXTURES_COUNT; ++image_index) {
-        ImageData* data = &images_data[image_index];
-        u8* slice = reinterpret_cast<u8*>(transfer_data) + buffer_offset;
-        memcpy_s(slice, images_size, data->pixels, data->size);
-        buffer_offset += data->size;
+    u8* transfer_data = reinterpret_cast<u8*>(SDL_MapGPUTransferBuffer(device, transfer_buffer, false));
+    for(u32 level = 0; level < header->level_count; ++level) {
+        const AssetPackLevel& level_info = header->levels[level];
+        if(format == header->format) {
+            memcpy(transfer_data, pack->level_texels(level), level_info.size);
+        } else {
+            decompress_image(header->format, pack->level_texels(level), level_info.width, level_info.height, transfer_data);
+        }
+        transfer_data += block_format_level_size(format, level_info.width, level_info.height);
     }
     SDL_UnmapGPUTransferBuffer(device, transfer_buffer);
 
-    buffer_offset = 0;
-    SDL_GPUTexture* gpu_textures[MAX_TEXTURES_COUNT];
-    SDL_GPUCommandBuffer* command_buffer = SDL_AcquireGPUCommandBuffer(device);
-    SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(command_buffer);
-    for(size_t image_index = 0; image_index < MAX_TEXTURES_COUNT; ++image_index) {
-        ImageData* data = &images_data[image_index];
-        SDL_GPUTextureTransferInfo texture_transfer_info = {
-            .transfer_buffer = transfer_buffer,
-            .offset = buffer_offset,
-            .pixels_per_row = data->width
-        };
+    atlas->page = upload_atlas_page(device, transfer_buffer, atlas->page_width, atlas->page_height, atlas->level_count, format);
+    OL::Logger::log("[load_textures_from_pack()] %ux%u %s page, %u levels, %llu KB.", atlas->page_width, atlas->page_height, block_format_to_string(format),
+                    atlas->level_count, static_cast<unsigned long long>(upload_size / OL::KB(1)));
+    SDL_ReleaseGPUTransferBuffer(device, transfer_buffer);
 
-        buffer_offset += data->size;
-
-        SDL_GPUTextureCreateInfo texture_info = {
-            .type = SDL_GPU_TEXTURETYPE_2D,
-            .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
-            .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
-            .width = data->width,
-            .height = data->height,
-            .layer_count_or_depth = 1,
-            .num_levels = 1,
-            .sample_count = SDL_GPU_SAMPLECOUNT_1
-        };
+    AtlasRect rects[MAX_TEXTURES_COUNT];
+    for(u32 i = 0; i < atlas->count; ++i) {
+        rects[i] = pack->sprites[i].rect;
+    }
+    fill_atlas_textures(atlas, rects);
+}
 
-        SDL_GPUTexture* gpu_texture = SDL_CreateGPUTexture(device, &texture_info);
-        assert(gpu_texture);
+// Development path when there is no up to date pack. Only the image headers are read up front to pack the page,
+// then the images decode on the job system while the client is already running. Every sprite samples a small
+// checkerboard packed into the same page until its own texels have been uploaded.
+//
+// Each sprite's padded slot gets its own mip chain, built by the decode job, and level n of it is written at
+// (slot.x >> n, slot.y >> n). Slots are packed on a STREAMED_SLOT_ALIGNMENT grid so the first levels land exactly
+// where a whole-page chain would put them; past that they can be off by a texel, which the padding absorbs.
+static constexpr u32 PLACEHOLDER_TEXTURE_SIZE = 4;
+static constexpr u32 STREAMED_SLOT_ALIGNMENT = 4;
+static constexpr u32 TEXTURE_STREAMING_FRAME_BUDGET = OL::MB(8);
 
-        SDL_GPUTextureRegion texture_region = {
-            .texture = gpu_texture,
-            .w = data->width,
-            .h = data->height,
-            .d = 1
-        };
+struct TextureStreamer {
+    TextureAtlas atlas;
+    ImageDecodeBatch decode;
+    ImageData images[MAX_TEXTURES_COUNT];
+    ImageData placeholder;
+    AtlasRect rects[MAX_TEXTURES_COUNT + 1];
+    SDL_GPUTransferBuffer* transfer_buffer;
+    u32 transfer_size;
+    u32 finished_count;
+    u32 failed_count;
+    bool active;
+    OL::Time::Stamp start;
+};
 
-        gpu_textures[image_index] = gpu_texture;
-        SDL_UploadToGPUTexture(copy_pass, &texture_transfer_info, &texture_region, false);
+// The texel area a sprite owns in the page: its rect, the extruded padding and the alignment slack.
+[[nodiscard]] static AtlasRect streamed_slot(AtlasRect rect) {
+    auto slot_size = [](u32 size) {
+        return (size + DEFAULT_ATLAS_PADDING * 2 + STREAMED_SLOT_ALIGNMENT - 1) / STREAMED_SLOT_ALIGNMENT * STREAMED_SLOT_ALIGNMENT;
+    };
+    return { rect.x - DEFAULT_ATLAS_PADDING, rect.y - DEFAULT_ATLAS_PADDING, slot_size(rect.width), slot_size(rect.height) };
+}
+
+// Levels until the slot's smaller side runs out, so no level ever has to be clamped up to cover a neighbour.
+[[nodiscard]] static u32 streamed_slot_level_count(AtlasRect slot, u32 page_level_count) {
+    u32 level_count = 1;
+    while(level_count < page_level_count && (slot.width >> level_count) > 0 && (slot.height >> level_count) > 0) {
+        ++level_count;
     }
+    return level_count;
+}
 
-    SDL_EndGPUCopyPass(copy_pass);
-    SDL_SubmitGPUCommandBuffer(command_buffer);
+// Extrudes `pixels` into a fresh slot-sized image and appends its mip chain. Safe to call from any thread.
+[[nodiscard]] static ImageData build_streamed_slot(AtlasRect rect, const u8* pixels, u32 page_level_count) {
+    AtlasRect slot = streamed_slot(rect);
+    u32 level_count = streamed_slot_level_count(slot, page_level_count);
+    size_t chain_size = mip_chain_size(slot.width, slot.height, level_count);
+
+    ImageData image = {
+        .pixels = static_cast<u8*>(malloc(chain_size)),
+        .size = static_cast<u32>(chain_size),
+        .width = slot.width,
+        .height = slot.height,
+        .level_count = level_count
+    };
+    f32* scratch = static_cast<f32*>(malloc(mip_scratch_size(slot.width, slot.height)));
+    if(!image.pixels || !scratch) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[build_streamed_slot()] Failed to allocate %zu bytes for a %ux%u slot.", chain_size, slot.width, slot.height);
+        free(image.pixels);
+        free(scratch);
+        return {};
+    }
+
+    u8* levels[MAX_MIP_LEVELS];
+    size_t offset = 0;
+    for(u32 level = 0; level < level_count; ++level) {
+        levels[level] = image.pixels + offset;
+        offset += static_cast<size_t>(slot.width >> level) * (slot.height >> level) * ASSET_PACK_BYTES_PER_TEXEL;
+    }
 
-    for(size_t image_index = 0; image_index < MAX_TEXTURES_COUNT; ++image_index) {
-        ImageData* data = &images_data[image_index];
-        Texture* texture = &atlas.textures[image_index];
+    memset(image.pixels, 0, static_cast<size_t>(slot.width) * slot.height * ASSET_PACK_BYTES_PER_TEXEL);
+    blit_atlas_rect(levels[0], slot.width, pixels, { DEFAULT_ATLAS_PADDING, DEFAULT_ATLAS_PADDING, rect.width, rect.height }, DEFAULT_ATLAS_PADDING);
+    generate_mipmaps(levels, slot.width, slot.height, level_count, MIPMAP_SRGB, scratch);
+    free(scratch);
 
-        texture->id = image_index;
-        texture->handle = gpu_textures[image_index];
-        texture->width = data->width;
-        texture->height = data->height;
+    return image;
+}
 
-        stbi_image_free(data->pixels);
+// Decode hook, runs on the worker that decoded the image.
+static void prepare_streamed_texture(void* context, u32 image_index, ImageData* image) {
+    TextureStreamer* streamer = static_cast<TextureStreamer*>(context);
+    AtlasRect rect = streamer->rects[image_index];
+    if(image->width != rect.width || image->height != rect.height) {
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[prepare_streamed_texture()] %s changed size while loading.", image_paths[image_index]);
+        free_images(image, 1);
+        return;
     }
 
+    ImageData slot = build_streamed_slot(rect, image->pixels, streamer->atlas.level_count);
+    free_images(image, 1);
+    *image = slot;
+}
+
+[[nodiscard]] static AtlasRect placeholder_rect(TextureStreamer* streamer) {
+    return streamer->rects[MAX_TEXTURES_COUNT];
+}
+
+[[nodiscard]] static bool start_texture_streaming(SDL_GPUDevice* device, OL::JobSystem* job_system, TextureAtlas* atlas, TextureStreamer* streamer) {
+    streamer->start = OL::Time::Clock::now();
+
+    for(u32 i = 0; i < MAX_TEXTURES_COUNT; ++i) {
+        if(!read_image_size(ASSETS_DIRECTORY, image_paths[i], &streamer->rects[i])) {
+            return false;
+        }
+    }
+    streamer->rects[MAX_TEXTURES_COUNT] = { .width = PLACEHOLDER_TEXTURE_SIZE, .height = PLACEHOLDER_TEXTURE_SIZE };
+
+    AtlasLayout layout;
+    {
+        OL::BufferScope packing_memory(OL::memory.temporary);
+        layout = pack_atlas(streamer->rects, MAX_TEXTURES_COUNT + 1, DEFAULT_ATLAS_PADDING, MAX_ATLAS_PAGE_SIZE, OL::memory.temporary, STREAMED_SLOT_ALIGNMENT);
+    }
+    if(!layout.packed()) {
+        return false;
+    }
+
+    atlas->page_width = layout.width;
+    atlas->page_height = layout.height;
+    atlas->level_count = mip_level_count(layout.width, layout.height);
+    atlas->page = create_atlas_page(device, layout.width, layout.height, atlas->level_count);
+    fill_atlas_textures(atlas, streamer->rects);
+    for(u32 texture_index = 0; texture_index < atlas->count; ++texture_index) {
+        set_texture_region(atlas, &atlas->textures[texture_index], placeholder_rect(streamer));
+    }
+    streamer->atlas = *atlas;
+
+    static constexpr u32 CHECKER_COLORS[] = { 0xFFFF00FF, 0xFF202020 };
+    u32 checker[PLACEHOLDER_TEXTURE_SIZE * PLACEHOLDER_TEXTURE_SIZE];
+    for(u32 y = 0; y < PLACEHOLDER_TEXTURE_SIZE; ++y) {
+        for(u32 x = 0; x < PLACEHOLDER_TEXTURE_SIZE; ++x) {
+            checker[y * PLACEHOLDER_TEXTURE_SIZE + x] = CHECKER_COLORS[((x / 2) + (y / 2)) & 1];
+        }
+    }
+    streamer->placeholder = build_streamed_slot(placeholder_rect(streamer), reinterpret_cast<u8*>(checker), atlas->level_count);
+    if(!streamer->placeholder.pixels) {
+        return false;
+    }
+
+    // Sized so even the largest slot fits in one frame's batch.
+    u32 largest_upload = streamer->placeholder.size;
+    for(u32 i = 0; i < MAX_TEXTURES_COUNT; ++i) {
+        AtlasRect slot = streamed_slot(streamer->rects[i]);
+        u32 upload_size = static_cast<u32>(mip_chain_size(slot.width, slot.height, streamed_slot_level_count(slot, atlas->level_count)));
+        largest_upload = upload_size > largest_upload ? upload_size : largest_upload;
+    }
+    streamer->transfer_size = largest_upload > TEXTURE_STREAMING_FRAME_BUDGET ? largest_upload : TEXTURE_STREAMING_FRAME_BUDGET;
+    SDL_GPUTransferBufferCreateInfo transfer_buffer_info = {
+        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+        .size = streamer->transfer_size
+    };
+    streamer->transfer_buffer = SDL_CreateGPUTransferBuffer(device, &transfer_buffer_info);
+    assert(streamer->transfer_buffer);
+
+    streamer->finished_count = 0;
+    streamer->failed_count = 0;
+    streamer->decode.prepare = prepare_streamed_texture;
+    streamer->decode.prepare_context = streamer;
+    if(!start_image_decode_batch(&streamer->decode, job_system, ASSETS_DIRECTORY, image_paths, streamer->images, MAX_TEXTURES_COUNT)) {
+        return false;
+    }
+    streamer->active = true;
+
+    return true;
+}
+
+// True when there is something to record this frame, so the caller knows to open a copy pass for it. Without
+// worker threads nothing else runs the decode jobs, so the main thread takes one per frame here.
+[[nodiscard]] static bool texture_uploads_ready(TextureStreamer* streamer, OL::JobSystem* job_system) {
+    if(!streamer->active) {
+        return false;
+    }
+
+    if(streamer->placeholder.pixels) {
+        return true;
+    }
+
+    u32 image_index;
+    if(!streamer->decode.completed.peek(&image_index) && job_system->worker_count == 0) {
+        [[maybe_unused]] bool ran = job_system->try_run_job();
+    }
+
+    return streamer->decode.completed.peek(&image_index);
+}
+
+// Records uploads for finished slots, every mip level of each, into the frame's copy pass. At most
+// TEXTURE_STREAMING_FRAME_BUDGET bytes (or one slot) go out per frame so a burst of finished decodes can't stall
+// a frame. Returns true when any texture moved off the placeholder, in which case the caller has to refresh the
+// vertex UVs.
+[[nodiscard]] static bool upload_streamed_textures(SDL_GPUDevice* device, TextureStreamer* streamer, SDL_GPUCopyPass* copy_pass) {
+    OL_PROFILE_ZONE("upload_streamed_textures");
+    struct PendingUpload {
+        u32 offset;
+        AtlasRect slot;
+        u32 level_count;
+    };
+
+    PendingUpload uploads[MAX_TEXTURES_COUNT + 1];
+    u32 upload_count = 0;
+    u32 offset = 0;
+    bool regions_changed = false;
+
+    // Cycle: the previous frame's batch may still be in flight.
+    u8* staging = static_cast<u8*>(SDL_MapGPUTransferBuffer(device, streamer->transfer_buffer, true));
+    assert(staging);
+
+    if(streamer->placeholder.pixels) {
+        memcpy(staging + offset, streamer->placeholder.pixels, streamer->placeholder.size);
+        uploads[upload_count++] = { offset, streamed_slot(placeholder_rect(streamer)), streamer->placeholder.level_count };
+        offset += streamer->placeholder.size;
+        free_images(&streamer->placeholder, 1);
+    }
+
+    u32 image_index;
+    while(streamer->decode.completed.peek(&image_index)) {
+        ImageData* image = &streamer->images[image_index];
+        if(image->pixels && offset + image->size > streamer->transfer_size) {
+            break;
+        }
+
+        [[maybe_unused]] bool popped = streamer->decode.completed.pop(&image_index);
+        ++streamer->finished_count;
+        if(!image->pixels) {
+            ++streamer->failed_count;
+            continue;
+        }
+
+        memcpy(staging + offset, image->pixels, image->size);
+        AtlasRect rect = streamer->rects[image_index];
+        uploads[upload_count++] = { offset, streamed_slot(rect), image->level_count };
+        offset += image->size;
+        free_images(image, 1);
+
+        set_texture_region(&streamer->atlas, &streamer->atlas.textures[image_index], rect);
+        regions_changed = true;
+    }
+
+    SDL_UnmapGPUTransferBuffer(device, streamer->transfer_buffer);
+
+    for(u32 i = 0; i < upload_count; ++i) {
+        u32 level_offset = uploads[i].offset;
+        for(u32 level = 0; level < uploads[i].level_count; ++level) {
+            AtlasRect slot = uploads[i].slot;
+            SDL_GPUTextureTransferInfo texture_transfer_info = {
+                .transfer_buffer = streamer->transfer_buffer,
+                .offset = level_offset,
+                .pixels_per_row = slot.width >> level
+            };
+
+            SDL_GPUTextureRegion texture_region = {
+                .texture = streamer->atlas.page,
+                .mip_level = level,
+                .x = slot.x >> level,
+                .y = slot.y >> level,
+                .w = slot.width >> level,
+                .h = slot.height >> level,
+                .d = 1
+            };
+
+            // No cycle: the rest of the page has to survive the write.
+            SDL_UploadToGPUTexture(copy_pass, &texture_transfer_info, &texture_region, false);
+            level_offset += (slot.width >> level) * (slot.height >> level) * ASSET_PACK_BYTES_PER_TEXEL;
+        }
+    }
+
+    if(streamer->finished_count == MAX_TEXTURES_COUNT) {
+        f64 load_ms = std::chrono::duration<f64, std::milli>(OL::Time::Clock::now() - streamer->start).count();
+        OL::Logger::log("[upload_streamed_textures()] %zu textures resident after %.1f ms, %u failed.", MAX_TEXTURES_COUNT, load_ms, streamer->failed_count);
+        SDL_ReleaseGPUTransferBuffer(device, streamer->transfer_buffer);
+        streamer->transfer_buffer = nullptr;
+        streamer->active = false;
+    }
+
+    return regions_changed;
+}
+
+// Waits for decodes still in flight so no job outlives the streamer, then frees whatever never got uploaded.
+static void stop_texture_streaming(SDL_GPUDevice* device, TextureStreamer* streamer, OL::JobSystem* job_system) {
+    job_system->wait(&streamer->decode.counter);
+
+    u32 image_index;
+    while(streamer->decode.completed.pop(&image_index)) {
+        free_images(&streamer->images[image_index], 1);
+    }
+    free_images(&streamer->placeholder, 1);
+
+    if(streamer->transfer_buffer) {
+        SDL_ReleaseGPUTransferBuffer(device, streamer->transfer_buffer);
+        streamer->transfer_buffer = nullptr;
+    }
+    streamer->active = false;
+}
+
+// Loads the cooked pack when it is up to date, otherwise starts streaming the source images.
+static TextureAtlas load_textures(SDL_GPUDevice* device, OL::JobSystem* job_system, TextureStreamer* streamer) {
+    TextureAtlas atlas = {
+        .textures = OL::memory.persistent->reserve<Texture>(MAX_TEXTURES_COUNT),
+        .count = MAX_TEXTURES_COUNT
+    };
+    assert(atlas.textures);
+
+    AssetPack pack;
+    if(open_asset_pack(ASSET_PACK_PATH, &pack)) {
+        bool matches = asset_pack_matches(&pack, image_paths, MAX_TEXTURES_COUNT);
+        if(matches) {
+            load_textures_from_pack(device, &pack, &atlas);
+        }
+        close_asset_pack(&pack);
+        if(matches) {
+            return atlas;
+        }
+        OL::Logger::log(OL::Logger::LEVEL_ERROR, "[load_textures()] %s does not match image_paths, re-run the cooker.", ASSET_PACK_PATH);
+    }
+
+    bool streaming = start_texture_streaming(device, job_system, &atlas, streamer);
+    assert(streaming);
+
     return atlas;
 }
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "asset_cook.h"
+#include "asset_pack.h"
+
+#include <orshlib/types.h>
+#include <orshlib/time.h>
+#include <orshlib/jobs.h>
+#include <cstdio>
+#include <cstring>
+
+using namespace OL;
+
+// Usage: cooker [output_path] [RGBA8|BC1|BC3|BC7]
+// Decodes every image in image_paths, packs them into one atlas page with its mip chain and writes the pack
+// the client maps at startup. Run from the repository root, like the client. Without a format the page is BC1 when
+// every image is opaque and BC7 otherwise.
+int main(int argc, char** argv) {
+    const char* output_path = argc > 1 ? argv[1] : ASSET_PACK_PATH;
+    Time::Stamp start = Time::Clock::now();
+
+    BlockFormat format = BlockFormat::MAX_COUNT;
+    if(argc > 2) {
+        for(u32 i = 0; i < static_cast<u32>(BlockFormat::MAX_COUNT); ++i) {
+            if(strcmp(argv[2], block_format_to_string(static_cast<BlockFormat>(i))) == 0) {
+                format = static_cast<BlockFormat>(i);
+            }
+        }
+        if(format == BlockFormat::MAX_COUNT) {
+            Logger::log(Logger::LEVEL_ERROR, "[cooker] Unknown format %s, expected RGBA8, BC1, BC3 or BC7.", argv[2]);
+            return 1;
+        }
+    }
+
+    ImageData images[MAX_TEXTURES_COUNT];
+    AtlasRect rects[MAX_TEXTURES_COUNT];
+    if(!decode_images(ASSETS_DIRECTORY, image_paths, MAX_TEXTURES_COUNT, images, rects)) {
+        return 1;
+    }
+
+    if(format == BlockFormat::MAX_COUNT) {
+        format = BlockFormat::BC1;
+        for(u32 i = 0; i < MAX_TEXTURES_COUNT && format == BlockFormat::BC1; ++i) {
+            format = choose_block_format(images[i].pixels, static_cast<size_t>(images[i].width) * images[i].height);
+        }
+    }
+
+    // Slots on the block grid keep every block inside one sprite's padded area.
+    Buffer* scratch = Buffer::allocate(MB(1));
+    u32 alignment = format == BlockFormat::RGBA8 ? 1 : BLOCK_DIMENSION;
+    AtlasLayout layout = pack_atlas(rects, MAX_TEXTURES_COUNT, DEFAULT_ATLAS_PADDING, MAX_ATLAS_PAGE_SIZE, scratch, alignment);
+    if(!layout.packed()) {
+        return 1;
+    }
+
+    AssetPackHeader header = make_asset_pack_header(layout, MAX_TEXTURES_COUNT, DEFAULT_ATLAS_PADDING, format);
+    Buffer* pack = Buffer::allocate(header.file_size);
+    Buffer* cook_scratch = Buffer::allocate(cook_scratch_size(layout, format));
+    if(!pack || !cook_scratch) {
+        return 1;
+    }
+
+    JobSystem job_system;
+    job_system.init();
+    size_t pack_size = cook_asset_pack(images, image_paths, rects, MAX_TEXTURES_COUNT, layout, DEFAULT_ATLAS_PADDING, pack, cook_scratch, format, &job_system);
+    job_system.shutdown();
+    free_images(images, MAX_TEXTURES_COUNT);
+    if(pack_size == 0 || File::write_to_file(output_path, pack, 0, pack_size) != pack_size) {
+        Logger::log(Logger::LEVEL_ERROR, "[cooker] Failed to write %s.", output_path);
+        return 1;
+    }
+
+    f64 elapsed_ms = std::chrono::duration<f64, std::milli>(Time::Clock::now() - start).count();
+    printf("Cooked %zu images into %s: %ux%u %s page, %u levels, %.1f%% packed, %zu bytes in %.1f ms\n", MAX_TEXTURES_COUNT, output_path, layout.width, layout.height,
+           block_format_to_string(format), header.level_count, layout.efficiency() * 100.0, pack_size, elapsed_ms);
+
+    return 0;
+}
\ No newline at end of file